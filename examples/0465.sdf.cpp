@@ -85,7 +85,7 @@ struct my_core : public g::core
         // define a list of integer offsets which describe the relative positioning
         // of the blocks of terrain which will be generated by the density_volume instance below
         std::vector<vec<3>> offsets;
-        auto k = 1;
+        auto k = 2;
         for (float x = -k; x <= k; x++)
         for (float y = -k; y <= k; y++)
         for (float z = -k; z <= k; z++)
@@ -96,7 +96,9 @@ struct my_core : public g::core
         // setup the density_volume instance which will be responsible for terrain generation
         terrain = new g::gfx::density_volume<g::gfx::vertex::pos_norm_tan>(terrain_sdf, generator, offsets);
         terrain->scale = 200; // size of each block in world units
-        terrain->depth = 4; // resolution of terrain blocks
+        terrain->divisions = 64; // resolution of terrain blocks, meshed across multiple threads
+        terrain->lod_levels = 3; // each ring of blocks away from the camera is meshed at half the resolution
+        terrain->triangle_budget = 1000000; // outer rings are coarsened further if more than this are drawn
 
         // Position the camera, define the player's height
         cam.position = { 0, 1100, 0 };
@@ -2,6 +2,7 @@
 #define XMTYPE float
 #include <xmath.h>
 #include <random>
+#include "g.utils.h"
 
 namespace g
 {
@@ -10,6 +11,15 @@ namespace ai
 
 using namespace xmath;
 
+/**
+ * @brief      Generator used by the functions below when none is given.
+ */
+inline g::utils::rng& default_rng()
+{
+    static g::utils::rng generator;
+    return generator;
+}
+
 template<size_t X_SIZE, size_t Y_SIZE, size_t LAYER_SIZE=X_SIZE, size_t LAYERS=1>
 struct mlp
 {
@@ -32,24 +42,27 @@ struct mlp
         return w_out * a;
     }
 
-    void initialize()
-    {
-        static std::default_random_engine generator;
-        std::normal_distribution<double> distribution(0.f, 0.5f);
+    inline void initialize() { initialize(default_rng()); }
 
+    /**
+     * @brief      Draws every weight from a normal distribution using
+     *             `generator`, so that seeding it reproduces the network.
+     */
+    void initialize(g::utils::rng& generator)
+    {
         w_in.initialize([&](float r, float c) {
-            return distribution(generator);
+            return generator.normal(0, 0.5f);
         });
 
         for (unsigned i = LAYERS; i--;)
         {
             w_hidden[i].initialize([&](float r, float c) {
-                return distribution(generator);
+                return generator.normal(0, 0.5f);
             });
         }
 
         w_out.initialize([&](float r, float c) {
-            return distribution(generator);
+            return generator.normal(0, 0.5f);
         });
     }
 };
@@ -68,9 +81,9 @@ struct generation_desc
 };
 
 template<typename T>
-T breed(T& a, T& b, float mutation_rate)
+T breed(T& a, T& b, float mutation_rate, g::utils::rng& generator)
 {
-    T child = rand() % 2 ? a : b;
+    T child = generator.below(2) ? a : b;
 
     uint8_t* a_genome = a.genome_buf();
     uint8_t* b_genome = b.genome_buf();
@@ -78,7 +91,7 @@ T breed(T& a, T& b, float mutation_rate)
 
     for (unsigned i = 0; i < child.genome_size(); i++)
     {
-        if(rand() % 2 == 0)
+        if(generator.below(2) == 0)
         {
             child_genome[i] = a_genome[i];
         }
@@ -89,8 +102,7 @@ T breed(T& a, T& b, float mutation_rate)
 
         for (unsigned j = 0; j < 8; j++)
         {
-            float r = (rand() % 100) / 100.f;
-            if (r < mutation_rate)
+            if (generator.uniform() < mutation_rate)
             {
                 child_genome[i] ^= 1 << j;
             }
@@ -101,7 +113,15 @@ T breed(T& a, T& b, float mutation_rate)
 }
 
 template<typename T>
-void generation(std::vector<T>& g_0, std::vector<T>& g_1, const generation_desc& desc)
+inline T breed(T& a, T& b, float mutation_rate) { return breed(a, b, mutation_rate, default_rng()); }
+
+/**
+ * @brief      Fills `g_1` with the next generation bred from `g_0`. Random
+ *             choices are drawn from `generator`, so a generator seeded the
+ *             same way on each machine breeds the same generation.
+ */
+template<typename T>
+void generation(std::vector<T>& g_0, std::vector<T>& g_1, const generation_desc& desc, g::utils::rng& generator)
 {
     if (g_0.size() == 0)
     {
@@ -111,8 +131,8 @@ void generation(std::vector<T>& g_0, std::vector<T>& g_1, const generation_desc&
 
     g_1.resize(0); // empty without freeing
 
-    // sort the input generation
-    std::sort(g_0.begin(), g_0.end(), [](const T& a, const T& b){
+    // sort the input generation, ties keep their order
+    std::stable_sort(g_0.begin(), g_0.end(), [](const T& a, const T& b){
         return a.score() > b.score();
     });
 
@@ -136,18 +156,21 @@ void generation(std::vector<T>& g_0, std::vector<T>& g_1, const generation_desc&
         g_1.push_back({});
     }
 
-    static std::default_random_engine generator;
-    std::normal_distribution<float> distribution(0, top_performer_count * 0.3);
-
     // breed the top performers
     while(g_1.size() < g_0.size())
     {
-        unsigned i = std::min<float>(abs(distribution(generator)), g_0.size()-1);
-        unsigned j = std::min<float>(abs(distribution(generator)), g_0.size()-1);
-        g_1.push_back(breed(g_0[i], g_0[j], desc.mutation_rate));
+        unsigned i = std::min<float>(fabsf(generator.normal(0, top_performer_count * 0.3f)), g_0.size()-1);
+        unsigned j = std::min<float>(fabsf(generator.normal(0, top_performer_count * 0.3f)), g_0.size()-1);
+        g_1.push_back(breed(g_0[i], g_0[j], desc.mutation_rate, generator));
     }
 }
 
+template<typename T>
+inline void generation(std::vector<T>& g_0, std::vector<T>& g_1, const generation_desc& desc)
+{
+    generation(g_0, g_1, desc, default_rng());
+}
+
 } // end namespace evolution
 
 
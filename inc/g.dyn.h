@@ -1,6 +1,8 @@
 #pragma once
 
+#include <bit>
 #include <limits>
+#include <new>
 
 #ifndef XMTYPE
 #define XMTYPE float
@@ -13,13 +15,144 @@ namespace dyn {
 
 using namespace xmath;
 
+/**
+ * @brief      Signed fixed point number with `FRAC_BITS` fractional bits,
+ * stored in 32 bits. Its arithmetic is integer arithmetic, giving the same
+ * result on every platform and compiler, so state kept in it, such as
+ * `vec<3, fixed>` positions, can be simulated in lockstep. The default
+ * range is +/-32768 with a resolution of 1/65536. Products and quotients
+ * are rounded to nearest, and overflow wraps.
+ */
+template<unsigned FRAC_BITS=16>
+struct fixed_point
+{
+    int32_t raw = 0;
+
+    static constexpr int32_t one = 1 << FRAC_BITS;
+
+    constexpr fixed_point() = default;
+    constexpr fixed_point(int i) : raw((int32_t)((uint32_t)i << FRAC_BITS)) {}
+    fixed_point(float f) : raw((int32_t)std::lround((double)f * one)) {}
+    fixed_point(double d) : raw((int32_t)std::lround(d * one)) {}
+
+    static constexpr fixed_point from_raw(int32_t r) { fixed_point f; f.raw = r; return f; }
+
+    explicit operator float() const { return raw / (float)one; }
+    explicit operator double() const { return raw / (double)one; }
+
+    fixed_point operator-() const { return from_raw((int32_t)(0u - (uint32_t)raw)); }
+
+    friend fixed_point operator+(fixed_point a, fixed_point b) { return from_raw((int32_t)((uint32_t)a.raw + (uint32_t)b.raw)); }
+    friend fixed_point operator-(fixed_point a, fixed_point b) { return from_raw((int32_t)((uint32_t)a.raw - (uint32_t)b.raw)); }
+
+    friend fixed_point operator*(fixed_point a, fixed_point b)
+    {
+        auto p = (int64_t)a.raw * b.raw;
+        return from_raw((int32_t)((p + (1 << (FRAC_BITS - 1))) >> FRAC_BITS));
+    }
+
+    friend fixed_point operator/(fixed_point a, fixed_point b)
+    {
+        auto n = (int64_t)a.raw * one;
+        auto d = (int64_t)b.raw;
+        // round half away from zero
+        auto half = (d < 0 ? -d : d) / 2;
+        return from_raw((int32_t)(((n < 0) == (d < 0) ? n + half : n - half) / d));
+    }
+
+    fixed_point& operator+=(fixed_point o) { return *this = *this + o; }
+    fixed_point& operator-=(fixed_point o) { return *this = *this - o; }
+    fixed_point& operator*=(fixed_point o) { return *this = *this * o; }
+    fixed_point& operator/=(fixed_point o) { return *this = *this / o; }
+
+    friend bool operator==(fixed_point a, fixed_point b) { return a.raw == b.raw; }
+    friend bool operator!=(fixed_point a, fixed_point b) { return a.raw != b.raw; }
+    friend bool operator<(fixed_point a, fixed_point b) { return a.raw < b.raw; }
+    friend bool operator>(fixed_point a, fixed_point b) { return a.raw > b.raw; }
+    friend bool operator<=(fixed_point a, fixed_point b) { return a.raw <= b.raw; }
+    friend bool operator>=(fixed_point a, fixed_point b) { return a.raw >= b.raw; }
+
+    friend fixed_point abs(fixed_point f) { return f.raw < 0 ? -f : f; }
+
+    /**
+     * @brief      Square root rounded down, computed bit by bit. Zero for
+     *             negative numbers.
+     */
+    friend fixed_point sqrt(fixed_point f)
+    {
+        if (f.raw <= 0) { return {}; }
+
+        auto n = (uint64_t)f.raw << FRAC_BITS;
+        uint64_t root = 0, bit = 1ull << 62;
+        while (bit > n) { bit >>= 2; }
+
+        for (; bit; bit >>= 2)
+        {
+            if (n >= root + bit)
+            {
+                n -= root + bit;
+                root = (root >> 1) + bit;
+            }
+            else
+            {
+                root >>= 1;
+            }
+        }
+
+        return from_raw((int32_t)root);
+    }
+};
+
+using fixed = fixed_point<>;
+
+
+/**
+ * @brief      Response to a body's motion from `from` to `to` having been cut
+ * short by `hit`, a `cd::sweep_hit`. The body is returned to the time of
+ * impact, then slides along the surface for the rest of the motion, and its
+ * velocity into the surface is removed.
+ *
+ * @return     The body's corrected position.
+ */
+template<typename HIT>
+static inline vec<3> resolve_sweep(const HIT& hit, const vec<3>& from, const vec<3>& to, vec<3>& velocity)
+{
+	auto n = hit.normal;
+	auto d = to - from;
+	auto rest = d * (1 - hit.time);
+
+	velocity -= n * std::min<float>(0, velocity.dot(n));
+	return from + d * hit.time + rest - n * std::min<float>(0, rest.dot(n));
+}
+
 
 struct particle
 {
 	vec<3> position;
 	vec<3> velocity;
+	bool continuous = false; /**< sweep this particle's motion in `dyn_step(dt, sweep)` */
 
 	inline void dyn_step(float dt) { position += velocity * dt; }
+
+	/**
+	 * @brief      Steps as `dyn_step(dt)`, then if the particle is continuous,
+	 * sweeps its motion with `sweep(from, displacement)` returning a
+	 * `cd::sweep_hit` so that it can't pass through thin geometry however
+	 * large `dt` is. Motion which hits is resolved by `resolve_sweep`.
+	 *
+	 * @return     The hit, if any.
+	 */
+	template<typename SWEEP>
+	auto dyn_step(float dt, const SWEEP& sweep) -> decltype(sweep(position, position))
+	{
+		auto from = position;
+		dyn_step(dt);
+		if (!continuous) { return {}; }
+
+		auto hit = sweep(from, position - from);
+		if (hit) { position = resolve_sweep(hit, from, position, velocity); }
+		return hit;
+	}
 };
 
 
@@ -114,6 +247,27 @@ public:
         }
 	}
 
+    /**
+     * @brief      As `particle::dyn_step(dt, sweep)`. Only the body's
+     * translation is swept, the sweep callback should use the orientation
+     * reached at the end of the step.
+     */
+    template<typename SWEEP>
+    auto dyn_step(float dt, const SWEEP& sweep) -> decltype(sweep(position, position))
+    {
+        auto from = position;
+        dyn_step(dt);
+        if (!continuous) { return {}; }
+
+        auto hit = sweep(from, position - from);
+        if (hit)
+        {
+            position = resolve_sweep(hit, from, position, velocity);
+            linear_momentum = velocity * mass;
+        }
+        return hit;
+    }
+
     vec<3> to_local(const vec<3>& global)
     {
         return orientation.rotate(global);
@@ -153,271 +307,3692 @@ public:
     }
 };
 
-namespace cd //< Collision detection
-{
-
-struct box
-{
-    vec<3> position;
-    vec<3> half_x;
-    vec<3> half_y;
-    vec<3> half_z;
-};
-
-
-struct intersection
+/**
+ * @brief      Allocator returning storage aligned to `ALIGN` bytes, so that
+ * arrays of floats can be loaded a full SIMD register at a time.
+ */
+template<typename T, size_t ALIGN=32>
+struct aligned_allocator
 {
-    float time = std::numeric_limits<float>::quiet_NaN();
-    vec<3> origin = {}, direction = {}, point = {}, normal = {};
+    using value_type = T;
 
-    intersection() = default;
-
-    intersection(float t, const vec<3>& o, const vec<3>& d, const vec<3>& p, const vec<3>& n) : time(t), origin(o), direction(d), point(p), normal(n) {}
-
-    operator bool() { return !std::isnan(time); }
-};
-
-struct ray
-{
-    vec<3> position, direction;
+    template<typename U>
+    struct rebind { using other = aligned_allocator<U, ALIGN>; };
 
-    inline vec<3> point_at(float t) const { return position + direction * t; }
+    aligned_allocator() = default;
+    template<typename U> aligned_allocator(const aligned_allocator<U, ALIGN>&) {}
 
-    intersection intersect_plane(const vec<3>& plane_o, const vec<3>& plane_n)
+    T* allocate(size_t n)
     {
-        auto t = xmath::intersect::ray_plane(position, direction, plane_o, plane_n);
-
-        return {
-            t,
-            position,
-            direction,
-            point_at(t),
-            plane_n
-        };
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(ALIGN)));
     }
 
-    intersection intersect_box(const box& b)
-    {
-        vec<3> half_lengths[] = { b.half_x, b.half_y, b.half_z };
-        auto t = xmath::intersect::ray_box(position, direction, b.position, half_lengths);
-        auto face_normal = vec<3>{}; // TODO: compute normal here
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(ALIGN)); }
 
-        return {
-            t,
-            position,
-            direction,
-            point_at(t),
-            face_normal
-        };
-    }
+    template<typename U> bool operator==(const aligned_allocator<U, ALIGN>&) const { return true; }
+    template<typename U> bool operator!=(const aligned_allocator<U, ALIGN>&) const { return false; }
 };
 
-struct collider
+
+/**
+ * @brief      A population of rigid bodies stored as one array per component
+ * rather than one struct per body. `dyn_step` integrates every body in a
+ * single branch free loop the compiler can vectorize, so many bodies are
+ * advanced per SIMD instruction. Behaves as `rigid_body` does, with two
+ * exceptions: the orientation is advanced with a normalized first order
+ * step rather than `quat<>::from_axis_angle`, avoiding the trig calls, and
+ * forces are gated on their squared magnitudes. Bodies are addressed by
+ * `body` handles offering the same force and frame methods as `rigid_body`.
+ */
+struct rigid_body_system
 {
-    /**
-     * @brief      Returns an intersection with this collider if one can be generated.
-     *
-     * @param[in]  r     Ray to test intersection against.
-     *
-     * @return     Intersection result from test.
-     */
-    virtual intersection ray_intersects(const ray& r) const = 0;
-    
-    /**
-     * @brief      Indicates whether or not this collider can generate rays
-     *
-     * @return     True if rays are generated, false otherwise.
-     */
-    virtual bool generates_rays() = 0;
+    using lane = std::vector<float, aligned_allocator<float>>;
 
-    /**
-     * @brief      Returns a vector of rays cast from this collider.
-     *
-     * @return     Vector of arrays. This vector should be retained by the collider to avoid
-     *             redundant allocations.
-     */
-    virtual std::vector<ray>& rays() = 0;
+    static constexpr size_t LANES = 16; /**< bodies integrated together */
+
+    lane position[3];
+    lane velocity[3];
+    lane linear_momentum[3];
+    lane angular_momentum[3];
+    lane orientation[4];     /**< x, y, z, w */
+    lane mass;
+    lane inv_mass;
+    lane inertia_inv[9];     /**< row major */
+    lane net_f_local[3];     /**< Net force applied to each body wrt its CoM */
+    lane net_t_local[3];     /**< Net torque applied to each body wrt its CoM */
+    std::vector<uint8_t> continuous; /**< bodies swept by `dyn_step(dt, sweep)` */
 
     /**
-     * @brief      Given this collider, and another return a vector of all points of
-     *             intersection between the two colliders
-     *
-     * @param[in]  other  The other collider to test collision with
-     *
-     * @return     { description_of_the_return_value }
+     * @brief      Handle to a single body, valid for the life of the system.
      */
-    virtual const std::vector<intersection>& intersections(collider& other, float max_t=std::numeric_limits<float>::infinity())
+    struct body
     {
-        assert(this->generates_rays() || other.generates_rays());
+        rigid_body_system* system = nullptr;
+        size_t index = 0;
 
-        collider* ray_generator;
-        collider* ray_receiver;
+        inline vec<3> position() const { return system->get(system->position, index); }
+        inline void position(const vec<3>& p) { system->put(system->position, index, p); }
 
-        if (this->generates_rays())
+        inline vec<3> velocity() const { return system->get(system->velocity, index); }
+        inline void velocity(const vec<3>& v)
         {
-            ray_generator = this;
-            ray_receiver = &other;
+            system->put(system->velocity, index, v);
+            system->put(system->linear_momentum, index, v * system->mass[index]);
         }
-        else
+
+        inline vec<3> linear_momentum() const { return system->get(system->linear_momentum, index); }
+        inline vec<3> angular_momentum() const { return system->get(system->angular_momentum, index); }
+        inline void angular_momentum(const vec<3>& l) { system->put(system->angular_momentum, index, l); }
+
+        inline quat<> orientation() const
         {
-            ray_generator = &other;
-            ray_receiver = this;
+            auto& q = system->orientation;
+            return { q[0][index], q[1][index], q[2][index], q[3][index] };
         }
 
-        intersection_list.clear();
-
-        for (const auto& r : ray_generator->rays())
+        inline void orientation(const quat<>& o)
         {
-            auto mag = r.direction.magnitude();
+            for (int c = 0; c < 4; c++) { system->orientation[c][index] = o[c]; }
+        }
 
-            if (mag == 0) { return intersection_list; }
+        inline float mass() const { return system->mass[index]; }
 
-            auto i = ray_receiver->ray_intersects(r);
-            if (i && i.time < max_t) { intersection_list.push_back(i); }
+        inline bool continuous() const { return system->continuous[index]; }
+        inline void continuous(bool c) { system->continuous[index] = c; }
+
+        /**
+         * @brief      Sets the mass, and the inertia tensor to that of
+         * `rigid_body::update_inertia_tensor()`.
+         */
+        void mass(float m)
+        {
+            system->mass[index] = m;
+            system->inv_mass[index] = 1.f / m;
+            update_inertia_tensor({
+                {m, 0, 0},
+                {0, m, 0},
+                {0, 0, m},
+            });
         }
 
-        return intersection_list;
-    }
+        void update_inertia_tensor(const mat<3, 3>& L)
+        {
+            auto inv = L.invert();
+            for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++)
+            {
+                system->inertia_inv[r * 3 + c][index] = inv[r][c];
+            }
+        }
 
-protected:
-    std::vector<intersection> intersection_list;
-};
+        vec<3> forward() const { return orientation().rotate({0, 0, -1}); }
+        vec<3> up() const { return orientation().rotate({0, 1, 0}); }
+        vec<3> left() const { return orientation().rotate({1, 0, 0}); }
 
-struct ray_collider : public collider
-{
-    intersection ray_intersects(const ray& r) const override { return {}; }
+        inline vec<3> acceleration() const { return system->get(system->net_f_local, index) / mass(); }
 
-    bool generates_rays() override { return true; }
+        inline vec<3> angular_velocity() const
+        {
+            auto L = angular_momentum();
+            vec<3> w;
+            for (int r = 0; r < 3; r++)
+            {
+                w[r] = system->inertia_inv[r * 3 + 0][index] * L[0] +
+                       system->inertia_inv[r * 3 + 1][index] * L[1] +
+                       system->inertia_inv[r * 3 + 2][index] * L[2];
+            }
+            return w;
+        }
 
-    std::vector<ray>& rays() override { return ray_list; }
+        inline vec<3> linear_velocity_at(const vec<3>& local_point) const
+        {
+            return vec<3>::cross(to_global(angular_velocity()), to_global(local_point)) + velocity();
+        }
 
-    const std::vector<intersection>& intersections(collider& other, float max_t = std::numeric_limits<float>::infinity()) override
-    {
-        intersection_list.clear();
+        vec<3> to_local(const vec<3>& global) const { return orientation().rotate(global); }
+
+        vec<3> to_global(const vec<3>& local) const { return orientation().inverse().rotate(local); }
 
-        for (const auto& r : rays())
+        void dyn_apply_local_force(const vec<3>& point, const vec<3>& force)
         {
-            auto mag = r.direction.magnitude();
+            system->put(system->net_t_local, index, system->get(system->net_t_local, index) + vec<3>::cross(point, force));
+            system->put(system->net_f_local, index, system->get(system->net_f_local, index) + force);
+        }
 
-            if (mag == 0) { return intersection_list; }
+        void dyn_apply_global_force(const vec<3>& point, const vec<3>& force)
+        {
+            auto f = to_local(force);
+            auto r = to_local(point - position());
+            dyn_apply_local_force(r, f);
+        }
 
-            auto i = other.ray_intersects(r);
-            if (i && i.time < max_t) { intersection_list.push_back(i); }
+        inline mat<4, 4> transform() const
+        {
+            return orientation().to_matrix() * mat<4,4>::translation(position());
         }
+    };
 
-        return intersection_list;
-    }    
+    inline size_t size() const { return mass.size(); }
 
-protected:
-    std::vector<intersection> intersection_list;
-    std::vector<ray> ray_list;
-};
+    inline body operator[](size_t i) { return { this, i }; }
 
-struct sdf_collider : public collider
-{
-    sdf_collider(const g::game::sdf& s) : sdf(s) {}
+    /**
+     * @brief      Adds a body at rest, with the orientation and inertia tensor
+     * a default `rigid_body` of the same mass would have after calling
+     * `update_inertia_tensor()`.
+     */
+    body add(float m=1, const vec<3>& p={}, const quat<>& o={0, 0, 0, 1})
+    {
+        for (auto l : { position, velocity, linear_momentum, angular_momentum, net_f_local, net_t_local })
+        {
+            for (int c = 0; c < 3; c++) { l[c].push_back(0); }
+        }
 
-    intersection ray_intersects(const ray& r) const override
+        for (int c = 0; c < 4; c++) { orientation[c].push_back(0); }
+        for (int c = 0; c < 9; c++) { inertia_inv[c].push_back(0); }
+        mass.push_back(0);
+        inv_mass.push_back(0);
+        continuous.push_back(false);
+
+        body b = { this, size() - 1 };
+        b.mass(m);
+        b.position(p);
+        b.orientation(o);
+
+        return b;
+    }
+
+    /**
+     * @brief      Hash of the state of every body, for detecting when copies
+     * of a simulation stepped in lockstep have diverged.
+     */
+    uint64_t checksum(uint64_t seed=0) const
     {
-        // constexpr auto stop_threshold = 2e-05;
-        vec<3> p0 = r.position;
-        vec<3> p = p0;
-        auto d0 = sdf(p0);
-        auto d = d0;
-        auto t = 0.f;
-        auto dir_mag = r.direction.magnitude();
+        auto h = g::utils::hash64(nullptr, 0, seed ^ size());
+        auto add = [&](const lane& l) { h = g::utils::hash64(l.data(), l.size() * sizeof(float), h); };
 
-        unsigned i = 3;
-        for (; i--;)// && fabsf(d) > stop_threshold;)
+        for (auto l : { position, velocity, linear_momentum, angular_momentum, net_f_local, net_t_local })
         {
-            t += d / dir_mag;
-            p = p0 + r.direction * t;
-            d = sdf(p);
+            for (int c = 0; c < 3; c++) { add(l[c]); }
         }
 
-        // if (d > 0)
-        // {
-        //     auto dw = sdf(p + r.direction);
-        //     auto w = dw / (dw - d);
-        //     std::cerr << w << std::endl;
-        //     //t += w;// / dir_mag;
-        // }
+        for (int c = 0; c < 4; c++) { add(orientation[c]); }
+        for (int c = 0; c < 9; c++) { add(inertia_inv[c]); }
+        add(mass);
+        add(inv_mass);
 
-        auto d0_sign = (d0 > 0) - (d0 < 0);
-        auto d_sign = (d > 0) - (d < 0);
-        if (i > 0 || (d0_sign != d_sign))
-        {
-            auto inter_p = r.point_at(t);
+        return g::utils::hash64(continuous.data(), continuous.size(), h);
+    }
 
-            return {
-                t,
-                r.position,
-                r.direction,
-                inter_p,
-                g::game::normal_from_sdf(sdf, inter_p)
-            };
+    void reserve(size_t n)
+    {
+        for (auto l : { position, velocity, linear_momentum, angular_momentum, net_f_local, net_t_local })
+        {
+            for (int c = 0; c < 3; c++) { l[c].reserve(n); }
         }
 
-        return {}; // no intersection
+        for (int c = 0; c < 4; c++) { orientation[c].reserve(n); }
+        for (int c = 0; c < 9; c++) { inertia_inv[c].reserve(n); }
+        mass.reserve(n);
+        inv_mass.reserve(n);
+        continuous.reserve(n);
     }
 
-    bool generates_rays() override { return false; }
-
-    std::vector<ray>& rays() override
+    /**
+     * @brief      Integrates bodies [begin, end) over `dt`, `LANES` at a time.
+     */
+    void dyn_step(float dt, size_t begin, size_t end)
     {
-        ray_list.clear();
-        return ray_list;
+        auto i = begin;
+        for (; i + LANES <= end; i += LANES) { integrate<LANES>(dt, i); }
+        for (; i < end; i++) { integrate<1>(dt, i); }
     }
 
-    const std::vector<intersection>& intersections(collider& other, float max_t = std::numeric_limits<float>::infinity()) override
+    inline void dyn_step(float dt) { dyn_step(dt, 0, size()); }
+
+    /**
+     * @brief      Integrates only the bodies listed in `bodies`, which must be
+     * sorted. Runs of `LANES` consecutive indices are integrated together.
+     */
+    void dyn_step(float dt, const std::vector<size_t>& bodies)
     {
-        intersection_list.clear();
-        if (other.generates_rays())
+        size_t j = 0;
+        while (j < bodies.size())
         {
-            for (auto& r : other.rays())
+            auto i = bodies[j];
+            if (j + LANES <= bodies.size() && bodies[j + LANES - 1] == i + LANES - 1)
             {
-                auto i = ray_intersects(r);
-                if (i && i.time >= 0 && i.time < max_t) { intersection_list.push_back(i); }
+                integrate<LANES>(dt, i);
+                j += LANES;
+            }
+            else
+            {
+                integrate<1>(dt, i);
+                j++;
             }
         }
-        return intersection_list;
     }
 
-    // ray_collider& operator=(const ray& other)
-    // {
-    //     position = other.position;
-    //     direction = other.direction;
-    // }
-
-private:
-    std::vector<intersection> intersection_list;
-    std::vector<ray> ray_list;
-    g::game::sdf sdf;
-};
+    /**
+     * @brief      Integrates all bodies over `dt`, then sweeps the motion of
+     * each continuous body with `sweep(body, from, displacement)` returning a
+     * `cd::sweep_hit`, as `particle::dyn_step(dt, sweep)` does. Only
+     * translation is swept.
+     */
+    template<typename SWEEP>
+    void dyn_step(float dt, const SWEEP& sweep)
+    {
+        swept.clear();
+        for (size_t i = 0; i < size(); i++)
+        {
+            if (continuous[i]) { swept.push_back({ i, get(position, i) }); }
+        }
 
+        dyn_step(dt);
+        resolve_swept(sweep);
+    }
 
-} // end namespace cd
+    /**
+     * @brief      As `dyn_step(dt, sweep)` for only the sorted `bodies`.
+     */
+    template<typename SWEEP>
+    void dyn_step(float dt, const std::vector<size_t>& bodies, const SWEEP& sweep)
+    {
+        swept.clear();
+        for (auto i : bodies)
+        {
+            if (continuous[i]) { swept.push_back({ i, get(position, i) }); }
+        }
 
+        dyn_step(dt, bodies);
+        resolve_swept(sweep);
+    }
 
-namespace cr //< Collision resolution
-{
     /**
-     * @brief      Resolves collision for and object which only has translational
-     *             degrees of freedom.
-     * 
-     * @param[inout] obj            The object which we are resolving the collision for.
-     * @param[in]    intersections  The intersections.
-     *
-     * @tparam       T            A type compatible with this function must have 
-     *                            `position` and `velocity` vec<3> members
+     * @brief      Integrates all bodies over `dt`, split into batches of
+     * `batch_size` bodies which are integrated in parallel by `pool`.
      */
-    template<typename T>
-    void resolve_linear(T& obj, const std::vector<cd::intersection>& intersections, float static_friction_tol=0.5)
+    template<size_t POOL_SIZE>
+    void dyn_step(float dt, g::proc::thread_pool<POOL_SIZE>& pool, size_t batch_size=1024)
     {
-        // bool printed = false;
+        // keep batches on separate cache lines
+        batch_size = std::max<size_t>((batch_size + 15) & ~(size_t)15, 16);
+        auto batches = (size() + batch_size - 1) / batch_size;
 
-        for (auto& intersection : intersections)
-        {
+        g::proc::parallel_for(pool, batches, [&](size_t b) {
+            dyn_step(dt, b * batch_size, std::min(size(), (b + 1) * batch_size));
+        });
+    }
+
+private:
+    struct swept_body
+    {
+        size_t index;
+        vec<3> from;
+    };
+
+    std::vector<swept_body> swept;
+
+    template<typename SWEEP>
+    void resolve_swept(const SWEEP& sweep)
+    {
+        for (auto& s : swept)
+        {
+            body b = { this, s.index };
+            auto to = b.position();
+            auto hit = sweep(b, s.from, to - s.from);
+            if (!hit) { continue; }
+
+            auto v = b.velocity();
+            b.position(resolve_sweep(hit, s.from, to, v));
+            b.velocity(v);
+        }
+    }
+
+    static inline vec<3> get(const lane l[3], size_t i) { return { l[0][i], l[1][i], l[2][i] }; }
+    static inline void put(lane l[3], size_t i, const vec<3>& v) { l[0][i] = v[0]; l[1][i] = v[1]; l[2][i] = v[2]; }
+
+    /**
+     * @brief      Integrates bodies [i, i + W). Each is copied to local arrays
+     * first, which the compiler knows don't alias, so that the loops over
+     * `k` compile to vector instructions operating on all W bodies at once.
+     */
+    template<size_t W>
+    inline void integrate(float dt, size_t i)
+    {
+        float p[3][W], v[3][W], P[3][W], L[3][W], f[3][W], t[3][W], q[4][W], I[9][W], inv_m[W];
+
+        for (int c = 0; c < 3; c++)
+        for (size_t k = 0; k < W; k++)
+        {
+            p[c][k] = position[c][i + k];
+            P[c][k] = linear_momentum[c][i + k];
+            L[c][k] = angular_momentum[c][i + k];
+            f[c][k] = net_f_local[c][i + k];
+            t[c][k] = net_t_local[c][i + k];
+        }
+        for (int c = 0; c < 4; c++) for (size_t k = 0; k < W; k++) { q[c][k] = orientation[c][i + k]; }
+        for (int c = 0; c < 9; c++) for (size_t k = 0; k < W; k++) { I[c][k] = inertia_inv[c][i + k]; }
+        for (size_t k = 0; k < W; k++) { inv_m[k] = inv_mass[i + k]; }
+
+        constexpr float gate = 0.001f * 0.001f;
+        const float half_dt = dt * 0.5f;
+
+        for (size_t k = 0; k < W; k++)
+        {
+            // apply angular momentum changes
+            float tx = t[0][k], ty = t[1][k], tz = t[2][k];
+            float apply_torque = (tx * tx + ty * ty + tz * tz) >= gate ? 1.f : 0.f;
+            L[0][k] += tx * dt * apply_torque;
+            L[1][k] += ty * dt * apply_torque;
+            L[2][k] += tz * dt * apply_torque;
+            t[0][k] = tx * (1 - apply_torque);
+            t[1][k] = ty * (1 - apply_torque);
+            t[2][k] = tz * (1 - apply_torque);
+
+            // apply momentum changes, rotating the local force into the global frame
+            float qx = q[0][k], qy = q[1][k], qz = q[2][k], qw = q[3][k];
+            float fx = f[0][k], fy = f[1][k], fz = f[2][k];
+            float apply_force = (fx * fx + fy * fy + fz * fz) >= gate ? 1.f : 0.f;
+            float fdt = dt * apply_force;
+            fx *= fdt; fy *= fdt; fz *= fdt;
+
+            // v + 2w(u x v) + 2u x (u x v)
+            float cx = qy * fz - qz * fy, cy = qz * fx - qx * fz, cz = qx * fy - qy * fx;
+            float ccx = qy * cz - qz * cy, ccy = qz * cx - qx * cz, ccz = qx * cy - qy * cx;
+            P[0][k] += fx + 2 * (qw * cx + ccx);
+            P[1][k] += fy + 2 * (qw * cy + ccy);
+            P[2][k] += fz + 2 * (qw * cz + ccz);
+            f[0][k] *= 1 - apply_force;
+            f[1][k] *= 1 - apply_force;
+            f[2][k] *= 1 - apply_force;
+
+            for (int c = 0; c < 3; c++)
+            {
+                v[c][k] = P[c][k] * inv_m[k];
+                p[c][k] += v[c][k] * dt;
+            }
+
+            // w = I^-1 L, then q = q * (w dt / 2, 1) renormalized
+            float Lx = L[0][k], Ly = L[1][k], Lz = L[2][k];
+            float dx = (I[0][k] * Lx + I[1][k] * Ly + I[2][k] * Lz) * half_dt;
+            float dy = (I[3][k] * Lx + I[4][k] * Ly + I[5][k] * Lz) * half_dt;
+            float dz = (I[6][k] * Lx + I[7][k] * Ly + I[8][k] * Lz) * half_dt;
+
+            float nx = qw * dx + qx + qy * dz - qz * dy;
+            float ny = qw * dy - qx * dz + qy + qz * dx;
+            float nz = qw * dz + qx * dy - qy * dx + qz;
+            float nw = qw - qx * dx - qy * dy - qz * dz;
+            // |q|^2 grows by 1 + |w dt / 2|^2, which is unbounded for fast
+            // spins, so 1 / sqrt(s) is seeded from the bits of s to within a
+            // few percent for any s, then refined by newton steps to float
+            // precision. unlike sqrtf this never sets errno, which would stop
+            // the loop being vectorized
+            float s = nx * nx + ny * ny + nz * nz + nw * nw;
+            float n = std::bit_cast<float>(0x5f375a86u - (std::bit_cast<uint32_t>(s) >> 1));
+            n *= 1.5f - 0.5f * s * n * n;
+            n *= 1.5f - 0.5f * s * n * n;
+            n *= 1.5f - 0.5f * s * n * n;
+
+            q[0][k] = nx * n;
+            q[1][k] = ny * n;
+            q[2][k] = nz * n;
+            q[3][k] = nw * n;
+        }
+
+        for (int c = 0; c < 3; c++)
+        for (size_t k = 0; k < W; k++)
+        {
+            position[c][i + k] = p[c][k];
+            velocity[c][i + k] = v[c][k];
+            linear_momentum[c][i + k] = P[c][k];
+            angular_momentum[c][i + k] = L[c][k];
+            net_f_local[c][i + k] = f[c][k];
+            net_t_local[c][i + k] = t[c][k];
+        }
+        for (int c = 0; c < 4; c++) for (size_t k = 0; k < W; k++) { orientation[c][i + k] = q[c][k]; }
+    }
+};
+
+
+/**
+ * @brief      Pool of short lived particles stored as one array per
+ * component, as `rigid_body_system` stores bodies. `update` moves every
+ * particle under gravity and drag and ages it, in loops the compiler
+ * vectorizes, then retires particles which have outlived their lifetime and
+ * spawns new ones from `emitters`. A particle's color and size follow its
+ * age, and are evaluated by `color_of` and `size_of` as it's drawn rather
+ * than stored, as updating is limited by memory bandwidth.
+ * Particles live at indices [0, size()), and are reordered as they retire.
+ */
+struct particle_system
+{
+    using lane = rigid_body_system::lane;
+
+    static constexpr size_t BLOCK = 512; /**< particles updated together, small enough for their lanes to stay in cache */
+
+    /**
+     * @brief      Spawns particles at a steady rate. Each property of a new
+     * particle is jittered uniformly by up to its spread.
+     */
+    struct emitter
+    {
+        vec<3> position = {};
+        float position_spread = 0;
+        vec<3> velocity = {};
+        float velocity_spread = 0;
+        float lifetime = 1;         /**< seconds */
+        float lifetime_spread = 0;
+        float rate = 0;             /**< particles per second */
+        bool active = true;
+        float pending = 0;          /**< fraction of a particle carried to the next update */
+    };
+
+    static constexpr float min_lifetime = 1e-3f;       /**< shorter lifetimes, including jittered ones, are raised to this */
+
+    vec<3> gravity = { 0, -9.81f, 0 };
+    float drag = 0;                                     /**< velocity lost per second, as a fraction of the velocity */
+    vec<4> color_over_life[2] = { { 1, 1, 1, 1 }, { 1, 1, 1, 0 } }; /**< at birth and at death, interpolated between */
+    float size_over_life[2] = { 1, 1 };
+    std::vector<emitter> emitters;
+    g::utils::rng random;                               /**< draws the jitter of emitted particles */
+
+    lane position[3];
+    lane velocity[3];
+    lane age;
+    lane inv_lifetime;
+
+    particle_system(size_t capacity=1 << 16, uint64_t seed=0) : random(seed)
+    {
+        for (auto l : all_lanes()) { l->resize(capacity); }
+    }
+
+    inline size_t size() const { return live; }
+
+    inline size_t capacity() const { return age.size(); }
+
+    /**
+     * @brief      Fraction of particle `i`'s lifetime which has passed.
+     */
+    inline float life(size_t i) const { return std::min(age[i] * inv_lifetime[i], 1.f); }
+
+    inline vec<4> color_of(size_t i) const
+    {
+        return color_over_life[0] + (color_over_life[1] - color_over_life[0]) * life(i);
+    }
+
+    inline float size_of(size_t i) const
+    {
+        return size_over_life[0] + (size_over_life[1] - size_over_life[0]) * life(i);
+    }
+
+    /**
+     * @brief      Spawns one particle, unless the pool is full. `lifetime` is
+     * raised to at least `min_lifetime`.
+     *
+     * @return     False if the particle was dropped.
+     */
+    bool emit(const vec<3>& p, const vec<3>& v, float lifetime)
+    {
+        if (live == capacity()) { return false; }
+
+        auto i = live++;
+        for (int c = 0; c < 3; c++)
+        {
+            position[c][i] = p[c];
+            velocity[c][i] = v[c];
+        }
+        age[i] = 0;
+        inv_lifetime[i] = 1.f / std::max(lifetime, min_lifetime);
+
+        return true;
+    }
+
+    /**
+     * @brief      Spawns the particles `e` emits over `dt`.
+     */
+    void emit(emitter& e, float dt)
+    {
+        if (!e.active) { return; }
+
+        e.pending += e.rate * dt;
+        for (; e.pending >= 1; e.pending -= 1)
+        {
+            vec<3> p, v;
+            for (int c = 0; c < 3; c++)
+            {
+                p[c] = e.position[c] + random.uniform(-e.position_spread, e.position_spread);
+                v[c] = e.velocity[c] + random.uniform(-e.velocity_spread, e.velocity_spread);
+            }
+
+            if (!emit(p, v, e.lifetime + random.uniform(-e.lifetime_spread, e.lifetime_spread)))
+            {
+                e.pending = 0;
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief      Advances particles [begin, end) by `dt`, without retiring
+     * or spawning any.
+     */
+    void integrate(float dt, size_t begin, size_t end)
+    {
+        for (auto i = begin; i < end; i += BLOCK)
+        {
+            integrate_block(dt, i, std::min(end, i + BLOCK));
+        }
+    }
+
+    /**
+     * @brief      Advances every particle by `dt`, then retires the expired
+     * ones and spawns new ones from `emitters`.
+     */
+    void update(float dt)
+    {
+        integrate(dt, 0, size());
+        retire();
+        for (auto& e : emitters) { emit(e, dt); }
+    }
+
+    /**
+     * @brief      As `update(dt)`, with the particles split into batches of
+     * `batch_size` which are integrated in parallel by `pool`.
+     */
+    template<size_t POOL_SIZE>
+    void update(float dt, g::proc::thread_pool<POOL_SIZE>& pool, size_t batch_size=1 << 16)
+    {
+        // whole blocks, keeping batches on separate cache lines
+        batch_size = std::max<size_t>((batch_size + BLOCK - 1) / BLOCK * BLOCK, BLOCK);
+        auto batches = (size() + batch_size - 1) / batch_size;
+
+        g::proc::parallel_for(pool, batches, [&](size_t b) {
+            integrate(dt, b * batch_size, std::min(size(), (b + 1) * batch_size));
+        });
+
+        retire();
+        for (auto& e : emitters) { emit(e, dt); }
+    }
+
+    /**
+     * @brief      Removes particles which have outlived their lifetime, moving
+     * the last particle into each vacated index.
+     */
+    void retire()
+    {
+        size_t i = 0;
+        while (i < live)
+        {
+            if (age[i] * inv_lifetime[i] < 1) { i++; continue; }
+
+            live--;
+            for (auto l : all_lanes()) { (*l)[i] = (*l)[live]; }
+        }
+    }
+
+    void clear() { live = 0; }
+
+private:
+    size_t live = 0;
+
+    std::array<lane*, 8> all_lanes()
+    {
+        return {
+            position + 0, position + 1, position + 2,
+            velocity + 0, velocity + 1, velocity + 2,
+            &age, &inv_lifetime
+        };
+    }
+
+    /**
+     * @brief      Each loop streams through only a couple of lanes, so that
+     * the compiler's checks that they don't overlap stay cheap enough for it
+     * to vectorize them.
+     */
+    void integrate_block(float dt, size_t begin, size_t end)
+    {
+        // implicit, so that large steps or drag never reverse a particle
+        auto damping = 1.f / (1.f + drag * dt);
+
+        for (int c = 0; c < 3; c++)
+        {
+            auto p = position[c].data(), v = velocity[c].data();
+            auto g = gravity[c] * dt;
+            for (auto i = begin; i < end; i++)
+            {
+                v[i] = (v[i] + g) * damping;
+                p[i] += v[i] * dt;
+            }
+        }
+
+        auto a = age.data();
+        for (auto i = begin; i < end; i++) { a[i] += dt; }
+    }
+};
+
+
+namespace cd //< Collision detection
+{
+
+struct box
+{
+    vec<3> position;
+    vec<3> half_x;
+    vec<3> half_y;
+    vec<3> half_z;
+
+    inline vec<3> half(int i) const { return i == 0 ? half_x : (i == 1 ? half_y : half_z); }
+
+    /**
+     * @brief      Corner `i` of 8, bits 0, 1 and 2 of `i` selecting the
+     *             positive side of the x, y and z half extents.
+     */
+    inline vec<3> corner(int i) const
+    {
+        return position + half_x * ((i & 1) ? 1.f : -1.f) + half_y * ((i & 2) ? 1.f : -1.f) + half_z * ((i & 4) ? 1.f : -1.f);
+    }
+
+    /**
+     * @brief      Vertex of the box furthest along `d`.
+     */
+    inline vec<3> support(const vec<3>& d) const
+    {
+        auto p = position;
+        for (int i = 0; i < 3; i++)
+        {
+            auto h = half(i);
+            p += d.dot(h) >= 0 ? h : -h;
+        }
+        return p;
+    }
+
+    inline float margin() const { return 0; }
+};
+
+/**
+ * @brief      Finds where the ray `origin + direction * t` enters `b`.
+ *
+ * @param[out] normal  Outward normal of the face entered.
+ *
+ * @return     Parameter where the ray enters, negative if it starts inside,
+ *             NaN if it misses.
+ */
+static inline float ray_obb(const vec<3>& origin, const vec<3>& direction, const box& b, vec<3>& normal)
+{
+    auto t_enter = -std::numeric_limits<float>::infinity();
+    auto t_exit = std::numeric_limits<float>::infinity();
+    auto rel = origin - b.position;
+
+    for (int i = 0; i < 3; i++)
+    {
+        auto h = b.half(i);
+        auto inv_len2 = 1.f / h.dot(h);
+
+        // in units of the half length along this axis
+        auto o = rel.dot(h) * inv_len2;
+        auto d = direction.dot(h) * inv_len2;
+
+        if (d == 0)
+        {
+            if (o < -1 || o > 1) { return std::numeric_limits<float>::quiet_NaN(); }
+            continue;
+        }
+
+        auto t0 = (-1 - o) / d, t1 = (1 - o) / d;
+        auto n = -h;
+        if (t0 > t1) { std::swap(t0, t1); n = h; }
+
+        if (t0 > t_enter)
+        {
+            t_enter = t0;
+            normal = n * sqrtf(inv_len2);
+        }
+        t_exit = std::min(t_exit, t1);
+    }
+
+    if (t_enter > t_exit || t_exit < 0) { return std::numeric_limits<float>::quiet_NaN(); }
+
+    return t_enter;
+}
+
+
+struct intersection
+{
+    float time = std::numeric_limits<float>::quiet_NaN();
+    vec<3> origin = {}, direction = {}, point = {}, normal = {};
+
+    intersection() = default;
+
+    intersection(float t, const vec<3>& o, const vec<3>& d, const vec<3>& p, const vec<3>& n) : time(t), origin(o), direction(d), point(p), normal(n) {}
+
+    operator bool() { return !std::isnan(time); }
+};
+
+struct ray
+{
+    vec<3> position, direction;
+
+    inline vec<3> point_at(float t) const { return position + direction * t; }
+
+    intersection intersect_plane(const vec<3>& plane_o, const vec<3>& plane_n)
+    {
+        auto t = xmath::intersect::ray_plane(position, direction, plane_o, plane_n);
+
+        return {
+            t,
+            position,
+            direction,
+            point_at(t),
+            plane_n
+        };
+    }
+
+    intersection intersect_box(const box& b)
+    {
+        vec<3> face_normal = {};
+        auto t = ray_obb(position, direction, b, face_normal);
+
+        return {
+            t,
+            position,
+            direction,
+            point_at(t),
+            face_normal
+        };
+    }
+};
+
+struct sphere
+{
+    vec<3> center;
+    float radius;
+
+    inline vec<3> support(const vec<3>& d) const { return center; }
+    inline float margin() const { return radius; }
+};
+
+/**
+ * @brief      Segment from `a` to `b` swept by a sphere of `radius`.
+ */
+struct capsule
+{
+    vec<3> a, b;
+    float radius;
+
+    inline vec<3> support(const vec<3>& d) const { return d.dot(b - a) >= 0 ? b : a; }
+    inline float margin() const { return radius; }
+};
+
+/**
+ * @brief      Convex hull of a set of points.
+ */
+struct convex_hull
+{
+    std::vector<vec<3>> points;
+
+    vec<3> support(const vec<3>& d) const
+    {
+        size_t best = 0;
+        auto best_dot = -std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            auto dot = points[i].dot(d);
+            if (dot > best_dot) { best_dot = dot; best = i; }
+        }
+        return points[best];
+    }
+
+    inline float margin() const { return 0; }
+};
+
+struct contact_point
+{
+    vec<3> point;          /**< world space, between the two surfaces */
+    float depth;           /**< penetration along the manifold's normal */
+    uint32_t feature = 0;  /**< the features of the shapes this point came from, stable as they move */
+};
+
+/**
+ * @brief      Points of contact between two shapes sharing a normal.
+ */
+struct manifold
+{
+    vec<3> normal = {};     /**< unit length, pointing from the first shape toward the second */
+    contact_point points[4];
+    unsigned count = 0;
+
+    inline operator bool() const { return count > 0; }
+
+    inline void add(const vec<3>& p, float depth, uint32_t feature=0)
+    {
+        if (count < 4) { points[count++] = { p, depth, feature }; }
+    }
+
+    /**
+     * @brief      The same contact seen from the second shape.
+     */
+    inline manifold flipped() const
+    {
+        auto m = *this;
+        m.normal = -normal;
+        return m;
+    }
+
+    /**
+     * @brief      Keeps the 4 of `candidates` spanning the largest area,
+     *             starting with the deepest. Fewer are kept if the rest add
+     *             no area.
+     */
+    void reduce(const contact_point* candidates, size_t n)
+    {
+        count = 0;
+        if (n <= 4)
+        {
+            for (size_t i = 0; i < n; i++) { points[count++] = candidates[i]; }
+            return;
+        }
+
+        size_t chosen[4] = {};
+        unsigned k = 1;
+        for (size_t i = 1; i < n; i++)
+        {
+            if (candidates[i].depth > candidates[chosen[0]].depth) { chosen[0] = i; }
+        }
+
+        // chooses the candidate not yet chosen with the highest positive score
+        auto pick = [&](std::function<float(const vec<3>&)> score) {
+            size_t best = n;
+            auto best_score = 0.f;
+            for (size_t i = 0; i < n; i++)
+            {
+                if (std::find(chosen, chosen + k, i) != chosen + k) { continue; }
+
+                auto s = score(candidates[i].point);
+                if (s > best_score) { best_score = s; best = i; }
+            }
+
+            if (best < n) { chosen[k++] = best; }
+            return best < n;
+        };
+
+        auto& p0 = candidates[chosen[0]].point;
+        if (pick([&](const vec<3>& p) { return (p - p0).dot(p - p0); }))
+        {
+            auto& p1 = candidates[chosen[1]].point;
+            if (pick([&](const vec<3>& p) { return fabsf(vec<3>::cross(p1 - p0, p - p0).dot(normal)); }))
+            {
+                auto& p2 = candidates[chosen[2]].point;
+
+                // the point adding the most area to the triangle, outside
+                // whichever of its edges, for either winding about the normal
+                auto winding = vec<3>::cross(p1 - p0, p2 - p0).dot(normal) >= 0 ? -1.f : 1.f;
+                pick([&](const vec<3>& p) {
+                    return std::max(std::max(
+                        vec<3>::cross(p0 - p, p1 - p).dot(normal) * winding,
+                        vec<3>::cross(p1 - p, p2 - p).dot(normal) * winding),
+                        vec<3>::cross(p2 - p, p0 - p).dot(normal) * winding);
+                });
+            }
+        }
+
+        for (unsigned i = 0; i < k; i++) { points[count++] = candidates[chosen[i]]; }
+    }
+};
+
+namespace gjk
+{
+    /**
+     * @brief      Point of the Minkowski difference a - b, with the points of
+     *             a and b it came from.
+     */
+    struct vertex
+    {
+        vec<3> w, a, b;
+    };
+
+    template<typename A, typename B>
+    static inline vertex support(const A& a, const B& b, const vec<3>& d)
+    {
+        auto pa = a.support(d), pb = b.support(-d);
+        return { pa - pb, pa, pb };
+    }
+
+    /**
+     * @brief      Finds the point of the simplex `s` closest to the origin,
+     *             and reduces `s` to the smallest subset containing it.
+     *
+     * @param      s       The simplex, of 1 to 4 vertices.
+     * @param      n       Number of vertices of the simplex.
+     * @param[out] lambda  Barycentric weights of the closest point.
+     * @param[out] v       The closest point.
+     *
+     * @return     False if the origin is enclosed by a tetrahedron.
+     */
+    static bool closest(vertex* s, int& n, float* lambda, vec<3>& v)
+    {
+        auto keep = [&](std::initializer_list<int> idx, std::initializer_list<float> weights) {
+            vertex t[4];
+            int k = 0;
+            for (auto i : idx) { t[k++] = s[i]; }
+            k = 0;
+            for (auto w : weights) { lambda[k++] = w; }
+            n = k;
+            v = {};
+            for (int i = 0; i < n; i++)
+            {
+                s[i] = t[i];
+                v += s[i].w * lambda[i];
+            }
+        };
+
+        // closest point of triangle ijk, after Ericson's Real-Time Collision Detection
+        auto triangle = [&](int i, int j, int k) {
+            auto a = s[i].w, b = s[j].w, c = s[k].w;
+            auto ab = b - a, ac = c - a;
+
+            auto d1 = -ab.dot(a), d2 = -ac.dot(a);
+            if (d1 <= 0 && d2 <= 0) { return keep({ i }, { 1 }); }
+
+            auto d3 = -ab.dot(b), d4 = -ac.dot(b);
+            if (d3 >= 0 && d4 <= d3) { return keep({ j }, { 1 }); }
+
+            auto vc = d1 * d4 - d3 * d2;
+            if (vc <= 0 && d1 >= 0 && d3 <= 0)
+            {
+                auto t = d1 / (d1 - d3);
+                return keep({ i, j }, { 1 - t, t });
+            }
+
+            auto d5 = -ab.dot(c), d6 = -ac.dot(c);
+            if (d6 >= 0 && d5 <= d6) { return keep({ k }, { 1 }); }
+
+            auto vb = d5 * d2 - d1 * d6;
+            if (vb <= 0 && d2 >= 0 && d6 <= 0)
+            {
+                auto t = d2 / (d2 - d6);
+                return keep({ i, k }, { 1 - t, t });
+            }
+
+            auto va = d3 * d6 - d5 * d4;
+            if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+            {
+                auto t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+                return keep({ j, k }, { 1 - t, t });
+            }
+
+            auto sum = va + vb + vc;
+            if (sum <= 0) { return keep({ i, j }, { 0.5f, 0.5f }); } // degenerate
+            auto inv = 1.f / sum;
+            return keep({ i, j, k }, { va * inv, vb * inv, vc * inv });
+        };
+
+        switch (n)
+        {
+            case 1:
+                return keep({ 0 }, { 1 }), true;
+            case 2:
+            {
+                auto ab = s[1].w - s[0].w;
+                auto len2 = ab.dot(ab);
+                auto t = len2 > 0 ? std::max(0.f, std::min(1.f, -s[0].w.dot(ab) / len2)) : 0.f;
+                if (t <= 0) { return keep({ 0 }, { 1 }), true; }
+                if (t >= 1) { return keep({ 1 }, { 1 }), true; }
+                return keep({ 0, 1 }, { 1 - t, t }), true;
+            }
+            case 3:
+                return triangle(0, 1, 2), true;
+            default:
+            {
+                // the closest point lies on a face the origin is outside of
+                const int faces[4][4] = { { 0, 1, 2, 3 }, { 0, 2, 3, 1 }, { 0, 3, 1, 2 }, { 1, 3, 2, 0 } };
+                vertex original[4] = { s[0], s[1], s[2], s[3] };
+                auto best = std::numeric_limits<float>::infinity();
+                vertex best_s[4];
+                float best_lambda[4];
+                int best_n = 0;
+
+                for (auto& f : faces)
+                {
+                    auto& a = original[f[0]].w;
+                    auto normal = vec<3>::cross(original[f[1]].w - a, original[f[2]].w - a);
+                    auto side_origin = -normal.dot(a);
+                    auto side_opposite = normal.dot(original[f[3]].w - a);
+                    if (side_origin * side_opposite > 0) { continue; }
+
+                    for (int i = 0; i < 4; i++) { s[i] = original[i]; }
+                    n = 4;
+                    triangle(f[0], f[1], f[2]);
+
+                    if (v.dot(v) < best)
+                    {
+                        best = v.dot(v);
+                        best_n = n;
+                        for (int i = 0; i < n; i++) { best_s[i] = s[i]; best_lambda[i] = lambda[i]; }
+                    }
+                }
+
+                if (best_n == 0)
+                {
+                    for (int i = 0; i < 4; i++) { s[i] = original[i]; }
+                    n = 4;
+                    return false;
+                }
+
+                n = best_n;
+                v = {};
+                for (int i = 0; i < n; i++)
+                {
+                    s[i] = best_s[i];
+                    lambda[i] = best_lambda[i];
+                    v += s[i].w * lambda[i];
+                }
+                return true;
+            }
+        }
+    }
+
+    struct result
+    {
+        bool overlap = false;
+        vec<3> a, b;        /**< closest points of each shape, when separate */
+        vertex simplex[4];
+        int n = 0;
+    };
+
+    /**
+     * @brief      Finds the closest points of the convex shapes a and b, which
+     *             must provide `support(d)`. Their margins are ignored.
+     */
+    template<typename A, typename B>
+    static result distance(const A& a, const B& b)
+    {
+        result r;
+        float lambda[4] = { 1 };
+        r.simplex[0] = support(a, b, { 1, 0, 0 });
+        r.n = 1;
+        vec<3> v = r.simplex[0].w;
+
+        for (int it = 0; it < 64; it++)
+        {
+            if (v.dot(v) < 1e-12f) { r.overlap = true; break; }
+
+            auto w = support(a, b, -v);
+
+            // no further progress toward the origin
+            if (v.dot(v) - v.dot(w.w) <= 1e-6f * v.dot(v)) { break; }
+
+            bool repeated = false;
+            for (int i = 0; i < r.n; i++) { repeated |= (r.simplex[i].w - w.w).dot(r.simplex[i].w - w.w) < 1e-12f; }
+            if (repeated) { break; }
+
+            r.simplex[r.n++] = w;
+            if (!closest(r.simplex, r.n, lambda, v)) { r.overlap = true; break; }
+        }
+
+        r.a = r.b = {};
+        for (int i = 0; i < r.n; i++)
+        {
+            r.a += r.simplex[i].a * lambda[i];
+            r.b += r.simplex[i].b * lambda[i];
+        }
+
+        return r;
+    }
+
+    /**
+     * @brief      Expanding polytope algorithm. Given a simplex of a - b
+     *             enclosing the origin, finds the smallest translation of b
+     *             separating the shapes.
+     *
+     * @param[out] normal  Direction to move b, from a toward b.
+     * @param[out] point   Point of contact.
+     *
+     * @return     Penetration depth.
+     */
+    template<typename A, typename B>
+    static float penetration(const A& a, const B& b, const vertex* simplex, int n, vec<3>& normal, vec<3>& point)
+    {
+        std::vector<vertex> verts(simplex, simplex + n);
+
+        // grow the simplex into a tetrahedron
+        const vec<3> dirs[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+        for (auto& d : dirs)
+        {
+            if (verts.size() == 4) { break; }
+
+            auto w = support(a, b, d);
+            bool independent = true;
+            switch (verts.size())
+            {
+                case 1: independent = (w.w - verts[0].w).dot(w.w - verts[0].w) > 1e-10f; break;
+                case 2:
+                {
+                    auto c = vec<3>::cross(verts[1].w - verts[0].w, w.w - verts[0].w);
+                    independent = c.dot(c) > 1e-10f;
+                } break;
+                case 3:
+                {
+                    auto nrm = vec<3>::cross(verts[1].w - verts[0].w, verts[2].w - verts[0].w);
+                    independent = fabsf(nrm.dot(w.w - verts[0].w)) > 1e-10f;
+                } break;
+            }
+            if (independent) { verts.push_back(w); }
+        }
+
+        if (verts.size() < 4)
+        {
+            // a - b is flat, so the shapes are only just touching. the least
+            // support of a - b over a set of directions is its penetration
+            // along the best of them, so test the normals of the plane or line
+            // it lies in along with the axes, as a separating axis test would
+            std::vector<vec<3>> axes(std::begin(dirs), std::end(dirs));
+            if (verts.size() == 3)
+            {
+                auto nrm = vec<3>::cross(verts[1].w - verts[0].w, verts[2].w - verts[0].w).unit();
+                axes.push_back(nrm);
+                axes.push_back(-nrm);
+            }
+            else if (verts.size() == 2)
+            {
+                for (auto& d : dirs)
+                {
+                    auto nrm = vec<3>::cross(verts[1].w - verts[0].w, d);
+                    if (nrm.dot(nrm) > 1e-10f) { axes.push_back(nrm.unit()); }
+                }
+            }
+
+            auto best = std::numeric_limits<float>::infinity();
+            for (auto& d : axes)
+            {
+                auto w = support(a, b, d);
+                auto depth = w.w.dot(d);
+                if (depth < best)
+                {
+                    best = depth;
+                    normal = d;
+                    point = (w.a + w.b) * 0.5f;
+                }
+            }
+
+            return std::max(best, 0.f);
+        }
+
+        struct face
+        {
+            int i[3];
+            vec<3> n;
+            float d;
+        };
+
+        std::vector<face> faces;
+        auto add_face = [&](int i0, int i1, int i2) {
+            face f = { { i0, i1, i2 }, vec<3>::cross(verts[i1].w - verts[i0].w, verts[i2].w - verts[i0].w), 0 };
+            auto len = f.n.magnitude();
+            if (len < 1e-12f) { return; }
+            f.n /= len;
+            f.d = f.n.dot(verts[i0].w);
+
+            // face outward, away from the origin
+            if (f.d < 0)
+            {
+                std::swap(f.i[1], f.i[2]);
+                f.n = -f.n;
+                f.d = -f.d;
+            }
+            faces.push_back(f);
+        };
+
+        add_face(0, 1, 2);
+        add_face(0, 3, 1);
+        add_face(0, 2, 3);
+        add_face(1, 3, 2);
+
+        face best = faces[0];
+        for (int it = 0; it < 64 && !faces.empty(); it++)
+        {
+            best = faces[0];
+            for (auto& f : faces) { if (f.d < best.d) { best = f; } }
+
+            auto w = support(a, b, best.n);
+            if (w.w.dot(best.n) - best.d < 1e-4f) { break; }
+
+            // remove faces visible from w, keeping the edges of the hole
+            std::vector<std::pair<int, int>> edges;
+            for (size_t fi = 0; fi < faces.size();)
+            {
+                auto& f = faces[fi];
+                if (f.n.dot(w.w - verts[f.i[0]].w) > 0)
+                {
+                    for (int e = 0; e < 3; e++)
+                    {
+                        std::pair<int, int> edge = { f.i[e], f.i[(e + 1) % 3] };
+                        auto shared = std::find(edges.begin(), edges.end(), std::make_pair(edge.second, edge.first));
+                        if (shared != edges.end()) { edges.erase(shared); }
+                        else { edges.push_back(edge); }
+                    }
+                    faces[fi] = faces.back();
+                    faces.pop_back();
+                }
+                else { fi++; }
+            }
+
+            verts.push_back(w);
+            int wi = verts.size() - 1;
+            for (auto& e : edges) { add_face(e.first, e.second, wi); }
+        }
+
+        normal = best.n;
+
+        // barycentric coordinates of the origin's projection onto the face
+        auto p = best.n * best.d;
+        auto& v0 = verts[best.i[0]]; auto& v1 = verts[best.i[1]]; auto& v2 = verts[best.i[2]];
+        auto e0 = v1.w - v0.w, e1 = v2.w - v0.w, e2 = p - v0.w;
+        auto d00 = e0.dot(e0), d01 = e0.dot(e1), d11 = e1.dot(e1), d20 = e2.dot(e0), d21 = e2.dot(e1);
+        auto denom = d00 * d11 - d01 * d01;
+        float l1 = 0, l2 = 0;
+        if (denom != 0)
+        {
+            l1 = (d11 * d20 - d01 * d21) / denom;
+            l2 = (d00 * d21 - d01 * d20) / denom;
+        }
+        auto l0 = 1 - l1 - l2;
+
+        auto pa = v0.a * l0 + v1.a * l1 + v2.a * l2;
+        auto pb = v0.b * l0 + v1.b * l1 + v2.b * l2;
+        point = (pa + pb) * 0.5f;
+
+        return best.d;
+    }
+
+    /**
+     * @brief      Casts the ray `origin + direction * t` against the convex
+     *             shape `s`, after van den Bergen's GJK ray cast.
+     *
+     * @param[out] normal  Outward normal where the ray enters.
+     *
+     * @return     Parameter where the ray enters, 0 if it starts inside, NaN
+     *             if it misses.
+     */
+    template<typename S>
+    static float raycast(const S& s, const vec<3>& origin, const vec<3>& direction, vec<3>& normal)
+    {
+        float lambda_t = 0;
+        auto x = origin;
+        normal = {};
+
+        vertex simplex[4];
+        vec<3> points[4];
+        float weights[4];
+        int n = 0;
+        auto v = x - s.support({ 1, 0, 0 });
+
+        for (int it = 0; it < 64 && v.dot(v) > 1e-10f; it++)
+        {
+            auto p = s.support(v);
+            auto w = x - p;
+
+            if (v.dot(w) > 0)
+            {
+                if (v.dot(direction) >= 0) { return std::numeric_limits<float>::quiet_NaN(); }
+                lambda_t -= v.dot(w) / v.dot(direction);
+                x = origin + direction * lambda_t;
+                normal = v;
+            }
+
+            bool repeated = false;
+            for (int i = 0; i < n; i++) { repeated |= (points[i] - p).dot(points[i] - p) < 1e-12f; }
+            if (!repeated && n < 4) { points[n++] = p; }
+
+            // the simplex of x - p for each point, as x has moved
+            for (int i = 0; i < n; i++) { simplex[i] = { x - points[i], points[i], {} }; }
+            if (!closest(simplex, n, weights, v)) { break; }
+            for (int i = 0; i < n; i++) { points[i] = simplex[i].a; }
+        }
+
+        if (normal.dot(normal) > 0) { normal = normal.unit(); }
+        return lambda_t;
+    }
+
+} // end namespace gjk
+
+/**
+ * @brief      Contact between any two convex shapes providing `support(d)` and
+ *             `margin()`, by GJK on their cores and EPA where those overlap.
+ *             Yields at most one point.
+ */
+template<typename A, typename B>
+static manifold collide_convex(const A& a, const B& b)
+{
+    manifold m;
+    auto ra = a.margin(), rb = b.margin();
+    auto r = gjk::distance(a, b);
+
+    if (!r.overlap)
+    {
+        auto d = r.b - r.a;
+        auto dist = d.magnitude();
+        if (dist >= ra + rb || dist == 0) { return m; }
+
+        m.normal = d / dist;
+        auto depth = ra + rb - dist;
+        m.add(r.a + m.normal * (ra - depth * 0.5f), depth);
+        return m;
+    }
+
+    vec<3> normal, point;
+    auto depth = gjk::penetration(a, b, r.simplex, r.n, normal, point);
+    m.normal = normal;
+    m.add(point, depth + ra + rb);
+    return m;
+}
+
+static inline vec<3> closest_on_segment(const vec<3>& a, const vec<3>& b, const vec<3>& p)
+{
+    auto ab = b - a;
+    auto len2 = ab.dot(ab);
+    auto t = len2 > 0 ? std::max(0.f, std::min(1.f, (p - a).dot(ab) / len2)) : 0.f;
+    return a + ab * t;
+}
+
+/**
+ * @brief      Closest points of segments p0-p1 and q0-q1.
+ */
+static inline void closest_between_segments(const vec<3>& p0, const vec<3>& p1, const vec<3>& q0, const vec<3>& q1, vec<3>& cp, vec<3>& cq)
+{
+    auto d1 = p1 - p0, d2 = q1 - q0, r = p0 - q0;
+    auto a = d1.dot(d1), e = d2.dot(d2), f = d2.dot(r);
+    float s = 0, t = 0;
+
+    if (a <= 1e-12f && e <= 1e-12f) { cp = p0; cq = q0; return; }
+
+    if (a <= 1e-12f) { t = std::max(0.f, std::min(1.f, f / e)); }
+    else
+    {
+        auto c = d1.dot(r);
+        if (e <= 1e-12f) { s = std::max(0.f, std::min(1.f, -c / a)); }
+        else
+        {
+            auto b = d1.dot(d2);
+            auto denom = a * e - b * b;
+            s = denom != 0 ? std::max(0.f, std::min(1.f, (b * f - c * e) / denom)) : 0.f;
+            t = (b * s + f) / e;
+            if (t < 0) { t = 0; s = std::max(0.f, std::min(1.f, -c / a)); }
+            else if (t > 1) { t = 1; s = std::max(0.f, std::min(1.f, (b - c) / a)); }
+        }
+    }
+
+    cp = p0 + d1 * s;
+    cq = q0 + d2 * t;
+}
+
+static inline manifold collide_points(const vec<3>& pa, float ra, const vec<3>& pb, float rb)
+{
+    manifold m;
+    auto d = pb - pa;
+    auto dist2 = d.dot(d);
+    if (dist2 >= (ra + rb) * (ra + rb)) { return m; }
+
+    auto dist = sqrtf(dist2);
+    m.normal = dist > 0 ? d / dist : vec<3>{ 0, 1, 0 };
+    auto depth = ra + rb - dist;
+    m.add(pa + m.normal * (ra - depth * 0.5f), depth);
+    return m;
+}
+
+static inline manifold collide(const sphere& a, const sphere& b)
+{
+    return collide_points(a.center, a.radius, b.center, b.radius);
+}
+
+static inline manifold collide(const sphere& a, const capsule& b)
+{
+    return collide_points(a.center, a.radius, closest_on_segment(b.a, b.b, a.center), b.radius);
+}
+
+static inline manifold collide(const capsule& a, const sphere& b) { return collide(b, a).flipped(); }
+
+static inline manifold collide(const capsule& a, const capsule& b)
+{
+    vec<3> pa, pb;
+    closest_between_segments(a.a, a.b, b.a, b.b, pa, pb);
+    auto m = collide_points(pa, a.radius, pb, b.radius);
+
+    // parallel capsules rest along a line, report both ends of the overlap
+    if (m)
+    {
+        auto da = (a.b - a.a), db = (b.b - b.a);
+        auto c = vec<3>::cross(da, db);
+        if (c.dot(c) < 1e-6f * da.dot(da) * db.dot(db))
+        {
+            contact_point ends[4];
+            size_t n = 0;
+            auto add = [&](const manifold& e, uint32_t end) {
+                if (e && e.normal.dot(m.normal) > 0.99f) { ends[n] = e.points[0]; ends[n++].feature = end; }
+            };
+
+            add(collide_points(closest_on_segment(a.a, a.b, b.a), a.radius, b.a, b.radius), 1);
+            add(collide_points(closest_on_segment(a.a, a.b, b.b), a.radius, b.b, b.radius), 2);
+            add(collide_points(a.a, a.radius, closest_on_segment(b.a, b.b, a.a), b.radius), 3);
+            add(collide_points(a.b, a.radius, closest_on_segment(b.a, b.b, a.b), b.radius), 4);
+
+            // the two furthest apart
+            float best = 1e-6f;
+            for (size_t i = 0; i < n; i++)
+            for (size_t j = i + 1; j < n; j++)
+            {
+                auto d = ends[i].point - ends[j].point;
+                if (d.dot(d) > best)
+                {
+                    best = d.dot(d);
+                    m.count = 0;
+                    m.add(ends[i].point, ends[i].depth, ends[i].feature);
+                    m.add(ends[j].point, ends[j].depth, ends[j].feature);
+                }
+            }
+        }
+    }
+
+    return m;
+}
+
+static manifold collide(const sphere& a, const box& b)
+{
+    manifold m;
+    auto rel = a.center - b.position;
+    auto closest = b.position;
+    bool inside = true;
+    int shallowest = 0;
+    float shallowest_gap = std::numeric_limits<float>::infinity();
+    float q[3];
+
+    for (int i = 0; i < 3; i++)
+    {
+        auto h = b.half(i);
+        auto e = h.magnitude();
+        auto u = h / e;
+        q[i] = rel.dot(u);
+        auto clamped = std::max(-e, std::min(e, q[i]));
+        inside &= clamped == q[i];
+        closest += u * clamped;
+
+        if (e - fabsf(q[i]) < shallowest_gap)
+        {
+            shallowest_gap = e - fabsf(q[i]);
+            shallowest = i;
+        }
+    }
+
+    if (!inside)
+    {
+        auto d = closest - a.center;
+        auto dist2 = d.dot(d);
+        if (dist2 >= a.radius * a.radius) { return m; }
+
+        auto dist = sqrtf(dist2);
+        m.normal = d / dist;
+        m.add(closest, a.radius - dist);
+        return m;
+    }
+
+    // the center is inside, push it out through the nearest face
+    auto u = b.half(shallowest).unit() * (q[shallowest] >= 0 ? 1.f : -1.f);
+    m.normal = -u;
+    m.add(a.center + u * shallowest_gap, a.radius + shallowest_gap);
+    return m;
+}
+
+static inline manifold collide(const box& a, const sphere& b) { return collide(b, a).flipped(); }
+
+static manifold collide(const capsule& a, const box& b)
+{
+    auto m = collide_convex(a, b);
+    if (!m) { return m; }
+
+    // a capsule lying on a face touches along its length, so report its ends
+    contact_point candidates[3] = { m.points[0] };
+    size_t n = 1;
+    for (uint32_t end = 1; end <= 2; end++)
+    {
+        auto e = collide(sphere{ end == 1 ? a.a : a.b, a.radius }, b);
+        if (e && e.normal.dot(m.normal) > 0.95f) { candidates[n] = e.points[0]; candidates[n++].feature = end; }
+    }
+
+    if (n == 3) { m.reduce(candidates + 1, 2); }
+
+    return m;
+}
+
+static inline manifold collide(const box& a, const capsule& b) { return collide(b, a).flipped(); }
+
+/**
+ * @brief      Separating axis test of two boxes over the 15 axes that could
+ *             separate them. Quantities for each axis are laid out in flat
+ *             arrays so the final overlaps are computed together.
+ *
+ * @param[out] overlap  Overlap along each axis: the 3 face axes of a, the 3
+ *                      of b, then the 9 cross products of their edges.
+ *                      Infinite for degenerate edge axes.
+ */
+static inline void box_sat(const box& a, const box& b, float overlap[15], vec<3> u_a[3], float e_a[3], vec<3> u_b[3], float e_b[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        auto ha = a.half(i), hb = b.half(i);
+        e_a[i] = ha.magnitude(); u_a[i] = ha / e_a[i];
+        e_b[i] = hb.magnitude(); u_b[i] = hb / e_b[i];
+    }
+
+    // b's axes in a's frame, and the offset between them
+    float R[3][3], AR[3][3], t[3];
+    auto T = b.position - a.position;
+    for (int i = 0; i < 3; i++)
+    {
+        t[i] = T.dot(u_a[i]);
+        for (int j = 0; j < 3; j++)
+        {
+            R[i][j] = u_a[i].dot(u_b[j]);
+            AR[i][j] = fabsf(R[i][j]) + 1e-6f;
+        }
+    }
+
+    float ra[15], rb[15], dist[15], inv_len[15];
+
+    for (int i = 0; i < 3; i++)
+    {
+        ra[i] = e_a[i];
+        rb[i] = e_b[0] * AR[i][0] + e_b[1] * AR[i][1] + e_b[2] * AR[i][2];
+        dist[i] = fabsf(t[i]);
+        inv_len[i] = 1;
+
+        ra[3 + i] = e_a[0] * AR[0][i] + e_a[1] * AR[1][i] + e_a[2] * AR[2][i];
+        rb[3 + i] = e_b[i];
+        dist[3 + i] = fabsf(t[0] * R[0][i] + t[1] * R[1][i] + t[2] * R[2][i]);
+        inv_len[3 + i] = 1;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+        for (int j = 0; j < 3; j++)
+        {
+            int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+            auto k = 6 + i * 3 + j;
+            ra[k] = e_a[i1] * AR[i2][j] + e_a[i2] * AR[i1][j];
+            rb[k] = e_b[j1] * AR[i][j2] + e_b[j2] * AR[i][j1];
+            dist[k] = fabsf(t[i2] * R[i1][j] - t[i1] * R[i2][j]);
+
+            auto len2 = 1 - R[i][j] * R[i][j];
+            inv_len[k] = len2 > 1e-6f ? 1 / sqrtf(len2) : 0;
+        }
+    }
+
+    for (int k = 0; k < 15; k++)
+    {
+        overlap[k] = inv_len[k] > 0 ? (ra[k] + rb[k] - dist[k]) * inv_len[k] : std::numeric_limits<float>::infinity();
+    }
+}
+
+/**
+ * @brief      True if the boxes overlap.
+ */
+static inline bool overlaps(const box& a, const box& b)
+{
+    float overlap[15], e_a[3], e_b[3];
+    vec<3> u_a[3], u_b[3];
+    box_sat(a, b, overlap, u_a, e_a, u_b, e_b);
+
+    float smallest = overlap[0];
+    for (int k = 1; k < 15; k++) { smallest = std::min(smallest, overlap[k]); }
+    return smallest >= 0;
+}
+
+/**
+ * @brief      Contact between two boxes. Face contacts clip the face of one
+ *             box most facing the other against the touching face of the
+ *             other, giving up to 4 points. Edge contacts give the single
+ *             point where the edges cross.
+ */
+static manifold collide(const box& a, const box& b)
+{
+    manifold m;
+    float overlap[15], e_a[3], e_b[3];
+    vec<3> u_a[3], u_b[3];
+    box_sat(a, b, overlap, u_a, e_a, u_b, e_b);
+
+    int best_face = 0, best_edge = 6;
+    for (int k = 0; k < 6; k++) { if (overlap[k] < overlap[best_face]) { best_face = k; } }
+    for (int k = 6; k < 15; k++) { if (overlap[k] < overlap[best_edge]) { best_edge = k; } }
+
+    if (overlap[best_face] < 0 || overlap[best_edge] < 0) { return m; }
+
+    auto T = b.position - a.position;
+
+    // prefer faces, which give stabler manifolds, unless an edge is clearly better
+    if (overlap[best_edge] < 0.95f * overlap[best_face] - 0.01f)
+    {
+        int i = (best_edge - 6) / 3, j = (best_edge - 6) % 3;
+        auto n = vec<3>::cross(u_a[i], u_b[j]).unit();
+        if (n.dot(T) < 0) { n = -n; }
+
+        // the edges of each box nearest the other
+        auto pa = a.position, pb = b.position;
+        for (int k = 0; k < 3; k++)
+        {
+            if (k != i) { pa += u_a[k] * (e_a[k] * (u_a[k].dot(n) >= 0 ? 1.f : -1.f)); }
+            if (k != j) { pb -= u_b[k] * (e_b[k] * (u_b[k].dot(n) >= 0 ? 1.f : -1.f)); }
+        }
+
+        vec<3> ca, cb;
+        closest_between_segments(pa - u_a[i] * e_a[i], pa + u_a[i] * e_a[i], pb - u_b[j] * e_b[j], pb + u_b[j] * e_b[j], ca, cb);
+        m.normal = n;
+        m.add((ca + cb) * 0.5f, overlap[best_edge], 1u << 16 | best_edge);
+        return m;
+    }
+
+    // reference face belongs to a for axes 0-2, b for 3-5
+    bool ref_is_a = best_face < 3;
+    auto& ref = ref_is_a ? a : b;
+    auto& inc = ref_is_a ? b : a;
+    auto* u_ref = ref_is_a ? u_a : u_b;
+    auto* e_ref = ref_is_a ? e_a : e_b;
+    auto* u_inc = ref_is_a ? u_b : u_a;
+    auto* e_inc = ref_is_a ? e_b : e_a;
+    int axis = best_face % 3;
+
+    // outward normal of the reference face, toward the incident box
+    auto n_ref = u_ref[axis];
+    if (n_ref.dot(inc.position - ref.position) < 0) { n_ref = -n_ref; }
+
+    // incident face, the one most opposing the reference face
+    int inc_axis = 0;
+    for (int k = 1; k < 3; k++) { if (fabsf(u_inc[k].dot(n_ref)) > fabsf(u_inc[inc_axis].dot(n_ref))) { inc_axis = k; } }
+    auto inc_n = u_inc[inc_axis] * (u_inc[inc_axis].dot(n_ref) > 0 ? -1.f : 1.f);
+    int p = (inc_axis + 1) % 3, q = (inc_axis + 2) % 3;
+    auto face_center = inc.position + inc_n * e_inc[inc_axis];
+
+    // each vertex is tagged with the two lines it lies on, edge k of the
+    // incident face running from vertex k to k + 1 (tags 0-3) or the side
+    // planes of the reference face (tags 4-7), which identify it across steps
+    struct clip_vertex
+    {
+        vec<3> p;
+        uint8_t tag[2];
+
+        inline uint8_t shared(const clip_vertex& o) const { return tag[0] == o.tag[0] || tag[0] == o.tag[1] ? tag[0] : tag[1]; }
+    };
+
+    clip_vertex poly[8], clipped[8];
+    int count = 4;
+    poly[0] = { face_center + u_inc[p] * e_inc[p] + u_inc[q] * e_inc[q], { 3, 0 } };
+    poly[1] = { face_center - u_inc[p] * e_inc[p] + u_inc[q] * e_inc[q], { 0, 1 } };
+    poly[2] = { face_center - u_inc[p] * e_inc[p] - u_inc[q] * e_inc[q], { 1, 2 } };
+    poly[3] = { face_center + u_inc[p] * e_inc[p] - u_inc[q] * e_inc[q], { 2, 3 } };
+
+    // clip against the side planes of the reference face
+    for (int side = 0; side < 4; side++)
+    {
+        auto& u = u_ref[(axis + 1 + side / 2) % 3];
+        auto sign = (side & 1) ? -1.f : 1.f;
+        auto plane_n = u * sign;
+        auto plane_d = plane_n.dot(ref.position) + e_ref[(axis + 1 + side / 2) % 3];
+
+        int out = 0;
+        for (int k = 0; k < count; k++)
+        {
+            auto& s = poly[k];
+            auto& e = poly[(k + 1) % count];
+            auto ds = plane_n.dot(s.p) - plane_d, de = plane_n.dot(e.p) - plane_d;
+
+            if (ds <= 0) { clipped[out++] = s; }
+            if ((ds < 0) != (de < 0) && ds != de && out < 8)
+            {
+                clipped[out++] = { s.p + (e.p - s.p) * (ds / (ds - de)), { s.shared(e), (uint8_t)(4 + side) } };
+            }
+        }
+
+        count = out;
+        for (int k = 0; k < count; k++) { poly[k] = clipped[k]; }
+        if (count == 0) { return m; }
+    }
+
+    // keep the points below the reference face, identified by the two faces
+    // and the lines each point lies on
+    auto ref_d = n_ref.dot(ref.position) + e_ref[axis];
+    uint32_t ref_face = best_face * 2 + (n_ref.dot(u_ref[axis]) < 0);
+    uint32_t inc_face = inc_axis * 2 + (inc_n.dot(u_inc[inc_axis]) < 0);
+    contact_point candidates[8];
+    size_t n = 0;
+    for (int k = 0; k < count; k++)
+    {
+        auto depth = ref_d - n_ref.dot(poly[k].p);
+        auto lo = std::min(poly[k].tag[0], poly[k].tag[1]), hi = std::max(poly[k].tag[0], poly[k].tag[1]);
+        auto feature = (ref_face * 6 + inc_face) << 6 | lo << 3 | hi;
+        if (depth >= 0) { candidates[n++] = { poly[k].p + n_ref * (depth * 0.5f), depth, feature }; }
+    }
+
+    m.normal = ref_is_a ? n_ref : -n_ref;
+    m.reduce(candidates, n);
+    return m;
+}
+
+template<typename S>
+static inline manifold collide(const convex_hull& a, const S& b) { return collide_convex(a, b); }
+
+template<typename S>
+static inline manifold collide(const S& a, const convex_hull& b) { return collide_convex(a, b); }
+
+static inline manifold collide(const convex_hull& a, const convex_hull& b) { return collide_convex(a, b); }
+
+/**
+ * @brief      Contact between points, each with a radius, and the surface of
+ *             an sdf. The manifold's normal is the average of the sdf's
+ *             normals at the penetrating points.
+ */
+static manifold collide(const vec<3>* points, size_t count, float radius, const g::game::sdf& sdf, const g::game::sdf_gradient& gradient=nullptr)
+{
+    manifold m;
+    contact_point candidates[16];
+    vec<3> normal = {};
+    size_t n = 0;
+
+    for (size_t i = 0; i < count && n < 16; i++)
+    {
+        auto d = sdf(points[i]);
+        if (d >= radius) { continue; }
+
+        auto g = gradient ? gradient(points[i]).unit() : g::game::normal_from_sdf(sdf, points[i], 0.01f);
+        normal -= g;
+        candidates[n++] = { points[i] - g * d, radius - d, (uint32_t)i };
+    }
+
+    if (n == 0) { return m; }
+
+    m.normal = normal.unit();
+    m.reduce(candidates, n);
+    return m;
+}
+
+static inline manifold collide(const sphere& a, const g::game::sdf& sdf, const g::game::sdf_gradient& gradient=nullptr)
+{
+    return collide(&a.center, 1, a.radius, sdf, gradient);
+}
+
+static inline manifold collide(const capsule& a, const g::game::sdf& sdf, const g::game::sdf_gradient& gradient=nullptr)
+{
+    vec<3> points[3] = { a.a, (a.a + a.b) * 0.5f, a.b };
+    return collide(points, 3, a.radius, sdf, gradient);
+}
+
+static inline manifold collide(const box& a, const g::game::sdf& sdf, const g::game::sdf_gradient& gradient=nullptr)
+{
+    vec<3> corners[8];
+    for (int i = 0; i < 8; i++) { corners[i] = a.corner(i); }
+    return collide(corners, 8, 0, sdf, gradient);
+}
+
+struct collider
+{
+    /**
+     * @brief      Returns an intersection with this collider if one can be generated.
+     *
+     * @param[in]  r     Ray to test intersection against.
+     *
+     * @return     Intersection result from test.
+     */
+    virtual intersection ray_intersects(const ray& r) const = 0;
+
+    /**
+     * @brief      Tests `count` rays against this collider, writing the result
+     *             for each to `out`. Colliders able to test many rays together
+     *             override this to do so.
+     *
+     * @param[in]  max_t  Intersections further along a ray than this time may
+     *                    be reported as misses.
+     */
+    virtual void rays_intersect(const ray* rays, size_t count, intersection* out, float max_t=std::numeric_limits<float>::infinity()) const
+    {
+        for (size_t i = 0; i < count; i++) { out[i] = ray_intersects(rays[i]); }
+    }
+    
+    /**
+     * @brief      Indicates whether or not this collider can generate rays
+     *
+     * @return     True if rays are generated, false otherwise.
+     */
+    virtual bool generates_rays() = 0;
+
+    /**
+     * @brief      Returns a vector of rays cast from this collider.
+     *
+     * @return     Vector of arrays. This vector should be retained by the collider to avoid
+     *             redundant allocations.
+     */
+    virtual std::vector<ray>& rays() = 0;
+
+    /**
+     * @brief      Given this collider, and another return a vector of all points of
+     *             intersection between the two colliders
+     *
+     * @param[in]  other  The other collider to test collision with
+     *
+     * @return     { description_of_the_return_value }
+     */
+    virtual const std::vector<intersection>& intersections(collider& other, float max_t=std::numeric_limits<float>::infinity())
+    {
+        assert(this->generates_rays() || other.generates_rays());
+
+        collider* ray_generator;
+        collider* ray_receiver;
+
+        if (this->generates_rays())
+        {
+            ray_generator = this;
+            ray_receiver = &other;
+        }
+        else
+        {
+            ray_generator = &other;
+            ray_receiver = this;
+        }
+
+        intersection_list.clear();
+        test_rays(ray_generator->rays(), *ray_receiver, max_t);
+
+        return intersection_list;
+    }
+
+protected:
+    std::vector<intersection> intersection_list;
+    std::vector<intersection> ray_results;
+
+    /**
+     * @brief      Tests `rays` up to the first without a direction against
+     *             `receiver`, appending hits before `max_t` to the intersection
+     *             list.
+     */
+    void test_rays(const std::vector<ray>& rays, const collider& receiver, float max_t)
+    {
+        size_t count = 0;
+        while (count < rays.size() && rays[count].direction.dot(rays[count].direction) > 0) { count++; }
+
+        ray_results.resize(count);
+        receiver.rays_intersect(rays.data(), count, ray_results.data(), max_t);
+
+        for (auto& i : ray_results)
+        {
+            if (i && i.time < max_t) { intersection_list.push_back(i); }
+        }
+    }
+};
+
+struct ray_collider : public collider
+{
+    intersection ray_intersects(const ray& r) const override { return {}; }
+
+    bool generates_rays() override { return true; }
+
+    std::vector<ray>& rays() override { return ray_list; }
+
+    const std::vector<intersection>& intersections(collider& other, float max_t = std::numeric_limits<float>::infinity()) override
+    {
+        intersection_list.clear();
+        test_rays(rays(), other, max_t);
+
+        return intersection_list;
+    }    
+
+protected:
+    std::vector<ray> ray_list;
+};
+
+struct sdf_collider : public collider
+{
+    /**
+     * @brief      Controls how rays are sphere traced through the sdf.
+     */
+    struct tracing
+    {
+        unsigned max_steps = 64;
+        float epsilon = 1e-4f;      /**< distance from the surface at which a ray has hit it */
+        float relaxation = 1;       /**< scales each step, values in (1, 2) take longer steps, backing off where they overshoot */
+        float max_distance = std::numeric_limits<float>::infinity(); /**< distance along a ray past which it misses */
+    };
+
+    static constexpr size_t PACKET = 8; /**< rays traced in lockstep */
+
+    tracing trace;
+
+    /**
+     * @param[in]  s         The sdf to collide against.
+     * @param[in]  gradient  Optional analytic gradient of `s`. If provided it is
+     *                       used for the normals of intersections instead of
+     *                       estimating them by sampling `s`.
+     * @param[in]  batch     Optional batched form of `s`. If provided it is
+     *                       used to evaluate the sdf for a packet of rays at once.
+     */
+    sdf_collider(const g::game::sdf& s, const g::game::sdf_gradient& gradient=nullptr, const g::game::sdf_batch& batch=nullptr) : sdf(s), gradient(gradient), batch(batch) {}
+
+    intersection ray_intersects(const ray& r) const override
+    {
+        intersection i;
+        rays_intersect(&r, 1, &i);
+        return i;
+    }
+
+    /**
+     * @brief      Sphere traces the rays in packets of `PACKET`, taking a step
+     *             along every unfinished ray of a packet each iteration. Rays
+     *             starting inside the surface are traced backward to where
+     *             they entered it, reporting a negative time, or forward to
+     *             where they leave it if it isn't behind them.
+     */
+    void rays_intersect(const ray* rays, size_t count, intersection* out, float max_t=std::numeric_limits<float>::infinity()) const override
+    {
+        for (size_t base = 0; base < count; base += PACKET)
+        {
+            auto n = std::min(PACKET, count - base);
+            trace_packet(rays + base, n, out + base, max_t);
+        }
+    }
+
+    bool generates_rays() override { return false; }
+
+    std::vector<ray>& rays() override
+    {
+        ray_list.clear();
+        return ray_list;
+    }
+
+    const std::vector<intersection>& intersections(collider& other, float max_t = std::numeric_limits<float>::infinity()) override
+    {
+        intersection_list.clear();
+        if (other.generates_rays())
+        {
+            auto& others = other.rays();
+            ray_results.resize(others.size());
+            rays_intersect(others.data(), others.size(), ray_results.data(), max_t);
+
+            for (auto& i : ray_results)
+            {
+                if (i && i.time >= 0 && i.time < max_t) { intersection_list.push_back(i); }
+            }
+        }
+        return intersection_list;
+    }
+
+private:
+    std::vector<ray> ray_list;
+    g::game::sdf sdf;
+    g::game::sdf_gradient gradient;
+    g::game::sdf_batch batch;
+
+    void trace_packet(const ray* rays, size_t count, intersection* out, float max_t) const
+    {
+        vec<3> dir[PACKET], points[PACKET];
+        float inv_mag[PACKET], limit[PACKET], s[PACKET], step[PACKET], prev_r[PACKET], omega[PACKET], sign[PACKET], dist[PACKET];
+        bool hit[PACKET], inside[PACKET];
+        size_t active[PACKET], lanes = 0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            auto mag = rays[i].direction.magnitude();
+            out[i] = {};
+            hit[i] = false;
+
+            if (mag == 0) { continue; }
+
+            dir[i] = rays[i].direction / mag;
+            inv_mag[i] = 1 / mag;
+            limit[i] = std::min(trace.max_distance, max_t * mag);
+            s[i] = step[i] = prev_r[i] = 0;
+            omega[i] = trace.relaxation;
+            sign[i] = 1;
+            inside[i] = false;
+            active[lanes++] = i;
+        }
+
+        for (unsigned k = 0; k < trace.max_steps && lanes > 0; k++)
+        {
+            for (size_t l = 0; l < lanes; l++)
+            {
+                auto i = active[l];
+                points[l] = rays[i].position + dir[i] * s[i];
+            }
+
+            if (batch) { batch(points, dist, lanes); }
+            else { for (size_t l = 0; l < lanes; l++) { dist[l] = sdf(points[l]); } }
+
+            size_t remaining = 0;
+            for (size_t l = 0; l < lanes; l++)
+            {
+                auto i = active[l];
+                auto r = dist[l];
+
+                // rays starting inside step back toward where they entered,
+                // without over relaxing, which would step past the surface
+                if (k == 0 && r < 0)
+                {
+                    omega[i] = 1;
+                    inside[i] = true;
+                }
+
+                if (inside[i] && sign[i] > 0 && k > 0 && fabsf(r) > prev_r[i])
+                {
+                    // getting deeper, so the surface isn't behind the ray. trace
+                    // forward to where it leaves instead
+                    sign[i] = -1;
+                    s[i] = prev_r[i] = 0;
+                    active[remaining++] = i;
+                    continue;
+                }
+
+                // a relaxed step overshot if it crossed the surface, or left
+                // the sphere known to be empty around the last point
+                if (omega[i] > 1 && (r < 0 || fabsf(r) + prev_r[i] < step[i]))
+                {
+                    step[i] -= omega[i] * step[i];
+                    omega[i] = 1;
+                }
+                else if (fabsf(r) < trace.epsilon)
+                {
+                    hit[i] = true;
+                    continue;
+                }
+                else
+                {
+                    step[i] = r * omega[i] * sign[i];
+                }
+
+                prev_r[i] = fabsf(r);
+                s[i] += step[i];
+
+                if (s[i] <= limit[i] && -s[i] <= trace.max_distance) { active[remaining++] = i; }
+            }
+
+            lanes = remaining;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!hit[i]) { continue; }
+
+            auto& r = rays[i];
+            auto t = s[i] * inv_mag[i];
+            auto p = r.point_at(t);
+
+            out[i] = {
+                t,
+                r.position,
+                r.direction,
+                p,
+                gradient ? gradient(p).unit() : g::game::normal_from_sdf(sdf, p)
+            };
+        }
+    }
+};
+
+/**
+ * @brief      Collider for a sphere, capsule, box or convex hull. Rays are
+ *             tested against the shape exactly, and `contact` produces the
+ *             manifold between two shapes for collision response.
+ */
+struct shape_collider : public collider
+{
+    enum class kind { sphere, capsule, box, hull };
+
+    kind type;
+    cd::sphere sphere_shape = {};
+    cd::capsule capsule_shape = {};
+    cd::box box_shape = {};
+    cd::convex_hull hull_shape;
+
+    shape_collider(const cd::sphere& s) : type(kind::sphere), sphere_shape(s) {}
+    shape_collider(const cd::capsule& c) : type(kind::capsule), capsule_shape(c) {}
+    shape_collider(const cd::box& b) : type(kind::box), box_shape(b) {}
+    shape_collider(const cd::convex_hull& h) : type(kind::hull), hull_shape(h) {}
+
+    intersection ray_intersects(const ray& r) const override
+    {
+        float t = std::numeric_limits<float>::quiet_NaN();
+        vec<3> normal = {};
+
+        switch (type)
+        {
+            case kind::sphere:
+                t = ray_sphere(r, sphere_shape.center, sphere_shape.radius);
+                break;
+            case kind::capsule:
+                t = ray_capsule(r);
+                break;
+            case kind::box:
+                t = ray_obb(r.position, r.direction, box_shape, normal);
+                break;
+            case kind::hull:
+                t = gjk::raycast(hull_shape, r.position, r.direction, normal);
+                break;
+        }
+
+        if (std::isnan(t)) { return {}; }
+
+        auto p = r.point_at(t);
+        switch (type)
+        {
+            case kind::sphere: normal = (p - sphere_shape.center).unit(); break;
+            case kind::capsule: normal = (p - closest_on_segment(capsule_shape.a, capsule_shape.b, p)).unit(); break;
+            default: break;
+        }
+
+        return { t, r.position, r.direction, p, normal };
+    }
+
+    bool generates_rays() override { return false; }
+
+    std::vector<ray>& rays() override
+    {
+        ray_list.clear();
+        return ray_list;
+    }
+
+    const std::vector<intersection>& intersections(collider& other, float max_t = std::numeric_limits<float>::infinity()) override
+    {
+        intersection_list.clear();
+        if (other.generates_rays())
+        {
+            for (auto& r : other.rays())
+            {
+                auto i = ray_intersects(r);
+                if (i && i.time >= 0 && i.time < max_t) { intersection_list.push_back(i); }
+            }
+        }
+        return intersection_list;
+    }
+
+    /**
+     * @brief      Contact manifold between this shape and `other`, with its
+     *             normal pointing from this shape toward `other`.
+     */
+    manifold contact(const shape_collider& other) const
+    {
+        return visit([&](const auto& a) {
+            return other.visit([&](const auto& b) -> manifold { return collide(a, b); });
+        });
+    }
+
+    /**
+     * @brief      Contact manifold between this shape and the surface of an sdf.
+     */
+    manifold contact(const g::game::sdf& sdf, const g::game::sdf_gradient& gradient=nullptr) const
+    {
+        return visit([&](const auto& a) -> manifold {
+            if constexpr (std::is_same_v<std::decay_t<decltype(a)>, cd::convex_hull>)
+            {
+                return collide(a.points.data(), a.points.size(), 0, sdf, gradient);
+            }
+            else
+            {
+                return collide(a, sdf, gradient);
+            }
+        });
+    }
+
+private:
+    std::vector<ray> ray_list;
+
+    template<typename FN>
+    manifold visit(FN fn) const
+    {
+        switch (type)
+        {
+            case kind::sphere: return fn(sphere_shape);
+            case kind::capsule: return fn(capsule_shape);
+            case kind::box: return fn(box_shape);
+            default: return fn(hull_shape);
+        }
+    }
+
+    static float ray_sphere(const ray& r, const vec<3>& center, float radius)
+    {
+        auto oc = r.position - center;
+        auto a = r.direction.dot(r.direction);
+        auto b = oc.dot(r.direction);
+        auto c = oc.dot(oc) - radius * radius;
+        auto h = b * b - a * c;
+        if (h < 0 || a == 0) { return std::numeric_limits<float>::quiet_NaN(); }
+
+        h = sqrtf(h);
+        if ((-b + h) / a < 0) { return std::numeric_limits<float>::quiet_NaN(); }
+        return (-b - h) / a;
+    }
+
+    float ray_capsule(const ray& r) const
+    {
+        auto& c = capsule_shape;
+        auto ba = c.b - c.a, oa = r.position - c.a;
+        auto baba = ba.dot(ba), bard = ba.dot(r.direction), baoa = ba.dot(oa);
+        auto rdrd = r.direction.dot(r.direction), rdoa = r.direction.dot(oa), oaoa = oa.dot(oa);
+
+        // infinite cylinder, kept where it lies between the caps
+        auto A = baba * rdrd - bard * bard;
+        auto B = baba * rdoa - baoa * bard;
+        auto C = baba * oaoa - baoa * baoa - c.radius * c.radius * baba;
+        auto h = B * B - A * C;
+
+        if (h >= 0 && A != 0)
+        {
+            auto t = (-B - sqrtf(h)) / A;
+            auto y = baoa + t * bard;
+            if (y > 0 && y < baba && (-B + sqrtf(h)) / A >= 0) { return t; }
+        }
+
+        // otherwise the nearer of the caps
+        auto ta = ray_sphere(r, c.a, c.radius), tb = ray_sphere(r, c.b, c.radius);
+        if (std::isnan(ta)) { return tb; }
+        if (std::isnan(tb)) { return ta; }
+        return std::min(ta, tb);
+    }
+};
+
+
+/**
+ * @brief      First contact of a shape moving along a displacement.
+ */
+struct sweep_hit
+{
+    float time = std::numeric_limits<float>::quiet_NaN(); /**< fraction of the displacement covered before contact */
+    vec<3> point = {};      /**< on the surface hit */
+    vec<3> normal = {};     /**< unit length, pointing from the surface hit toward the moving shape */
+
+    inline operator bool() const { return !std::isnan(time); }
+};
+
+/**
+ * @brief      A convex shape moved by `offset`.
+ */
+template<typename S>
+struct translated
+{
+    const S& shape;
+    vec<3> offset;
+
+    inline vec<3> support(const vec<3>& d) const { return shape.support(d) + offset; }
+    inline float margin() const { return shape.margin(); }
+};
+
+/**
+ * @brief      Time of impact of convex shape `a` translated by `displacement`
+ *             against the stationary convex shape `b`, by conservative
+ *             advancement. Each iteration finds the closest points with GJK
+ *             and advances `a` to the plane separating them, which it can't
+ *             have crossed. Shapes already touching only hit if `a` moves
+ *             further into `b`.
+ *
+ * @param[in]  tolerance  Gap at which the shapes are considered to touch, `a`
+ *                        stops about half of this short of `b`.
+ */
+template<typename A, typename B>
+static sweep_hit sweep_convex(const A& a, const vec<3>& displacement, const B& b, float tolerance=1e-3f)
+{
+    auto margins = a.margin() + b.margin();
+    float t = 0;
+
+    for (int it = 0; it < 64; it++)
+    {
+        translated<A> moved = { a, displacement * t };
+        auto r = gjk::distance(moved, b);
+
+        if (r.overlap)
+        {
+            auto m = collide_convex(moved, b);
+            if (!m || displacement.dot(m.normal) <= 0) { return {}; }
+            return { t, m.points[0].point, -m.normal };
+        }
+
+        auto d = r.b - r.a;
+        auto dist = d.magnitude();
+        auto n = d / dist;
+        auto gap = dist - margins;
+
+        // the distance between convex shapes moving apart never decreases
+        auto closing = displacement.dot(n);
+        if (closing <= 0) { return {}; }
+
+        if (gap <= tolerance) { return { t, r.b - n * b.margin(), -n }; }
+
+        t += (gap - tolerance * 0.5f) / closing;
+        if (t > 1) { return {}; }
+    }
+
+    // grazing contact which hasn't converged, stop rather than risk passing through
+    auto r = gjk::distance(translated<A>{ a, displacement * t }, b);
+    auto n = (r.b - r.a).unit();
+    return { t, r.b - n * b.margin(), -n };
+}
+
+/**
+ * @brief      Time of impact of points, each with a radius, translated by
+ *             `displacement` against the surface of an sdf. The points are
+ *             advanced together by the smallest distance to the surface
+ *             among them, as in sphere tracing. Points touching the surface
+ *             only hit if they move into it.
+ *
+ * @param[in]  trace  `epsilon` is the distance at which a point touches the
+ *                    surface, and `max_steps` bounds the iterations, after
+ *                    which the motion stops where it has reached.
+ */
+static sweep_hit sweep(const vec<3>* points, size_t count, float radius, const vec<3>& displacement, const g::game::sdf& sdf, const g::game::sdf_gradient& gradient=nullptr, const sdf_collider::tracing& trace={})
+{
+    auto len = displacement.magnitude();
+    float t = 0;
+    vec<3> closest = {};
+    float gap = 0;
+
+    auto hit = [&]() -> sweep_hit {
+        auto n = gradient ? gradient(closest).unit() : g::game::normal_from_sdf(sdf, closest, 0.01f);
+        return { t, closest - n * (gap + radius), n };
+    };
+
+    for (unsigned step = 0; step < trace.max_steps; step++)
+    {
+        auto offset = displacement * t;
+        gap = std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < count; i++)
+        {
+            auto p = points[i] + offset;
+            auto d = sdf(p) - radius;
+            if (d < gap) { gap = d; closest = p; }
+        }
+
+        if (len == 0) { return {}; }
+
+        if (gap <= trace.epsilon)
+        {
+            auto h = hit();
+            if (displacement.dot(h.normal) < 0) { return h; }
+
+            // moving along or out of the surface, creep past the contact
+            t += trace.epsilon / len;
+        }
+        else
+        {
+            t += gap / len;
+        }
+
+        if (t > 1) { return {}; }
+    }
+
+    return hit();
+}
+
+static inline sweep_hit sweep(const sphere& s, const vec<3>& displacement, const g::game::sdf& sdf, const g::game::sdf_gradient& gradient=nullptr, const sdf_collider::tracing& trace={})
+{
+    return sweep(&s.center, 1, s.radius, displacement, sdf, gradient, trace);
+}
+
+/**
+ * @brief      As the sdf contacts of a box, only its corners are swept.
+ */
+static inline sweep_hit sweep(const box& b, const vec<3>& displacement, const g::game::sdf& sdf, const g::game::sdf_gradient& gradient=nullptr, const sdf_collider::tracing& trace={})
+{
+    vec<3> corners[8];
+    for (int i = 0; i < 8; i++) { corners[i] = b.corner(i); }
+    return sweep(corners, 8, 0, displacement, sdf, gradient, trace);
+}
+
+/**
+ * @brief      Time of impact of a convex shape translated by `displacement`
+ *             against the stationary shape of `other`.
+ */
+template<typename S>
+static sweep_hit sweep(const S& s, const vec<3>& displacement, const shape_collider& other, float tolerance=1e-3f)
+{
+    switch (other.type)
+    {
+        case shape_collider::kind::sphere: return sweep_convex(s, displacement, other.sphere_shape, tolerance);
+        case shape_collider::kind::capsule: return sweep_convex(s, displacement, other.capsule_shape, tolerance);
+        case shape_collider::kind::box: return sweep_convex(s, displacement, other.box_shape, tolerance);
+        case shape_collider::kind::hull: return sweep_convex(s, displacement, other.hull_shape, tolerance);
+    }
+    return {};
+}
+
+
+/**
+ * @brief      Collides rays against a voxel volume by stepping through the voxels
+ * each ray passes through in order (Amanatides & Woo). Bricks of `BRICK_SIZE`^3
+ * voxels that are entirely empty are crossed in a single step.
+ *
+ * The volume's voxel (0, 0, 0) spans `position` to `position + scale`.
+ *
+ * @tparam     VOXELS      Any volume providing `size` and a const `idx(x, y, z)`
+ *                         where a default constructed value is empty, such as
+ *                         `voxels` or `sparse_voxels`.
+ * @tparam     BRICK_SIZE  Side length of the bricks used to skip empty space.
+ */
+template<typename VOXELS=g::game::voxels<uint8_t>, size_t BRICK_SIZE=8>
+struct voxel_collider : public collider
+{
+    /**
+     * @brief      Result of a ray cast, `voxel` is only valid if `hit` is.
+     */
+    struct voxel_hit
+    {
+        intersection hit;
+        vec<3, size_t> voxel;
+    };
+
+    using voxel_type = std::decay_t<decltype(std::declval<const VOXELS&>().idx(0, 0, 0))>;
+
+    vec<3> position = {};
+    float scale = 1;
+
+    /**
+     * @brief      Collides against `vox`, which is referenced rather than
+     *             copied so it must outlive the collider.
+     */
+    voxel_collider(const VOXELS& vox, const vec<3>& position={}, float scale=1) : position(position), scale(scale), vox(vox)
+    {
+        brick_dims = ((vox.size + (BRICK_SIZE - 1)) / BRICK_SIZE).template cast<int>();
+        bricks.resize(brick_dims[0] * brick_dims[1] * brick_dims[2]);
+        update({0, 0, 0}, vox.size - 1);
+    }
+
+    /**
+     * @brief      Recomputes which bricks are empty for those overlapping the
+     * inclusive box [min, max]. Must be called after the voxels in it change.
+     */
+    void update(const vec<3, size_t>& min, const vec<3, size_t>& max)
+    {
+        auto lo = min / BRICK_SIZE;
+        auto hi = max.take_min(vox.size - 1) / BRICK_SIZE;
+
+        for (size_t bz = lo[2]; bz <= hi[2]; bz++)
+        for (size_t by = lo[1]; by <= hi[1]; by++)
+        for (size_t bx = lo[0]; bx <= hi[0]; bx++)
+        {
+            vec<3, size_t> o = vec<3, size_t>{bx, by, bz} * BRICK_SIZE;
+            auto end = (o + BRICK_SIZE).take_min(vox.size);
+            bool occupied = false;
+
+            for (size_t z = o[2]; z < end[2] && !occupied; z++)
+            for (size_t y = o[1]; y < end[1] && !occupied; y++)
+            for (size_t x = o[0]; x < end[0] && !occupied; x++)
+            {
+                occupied = vox.idx(x, y, z) != voxel_type{};
+            }
+
+            bricks[bx + brick_dims[0] * (by + brick_dims[1] * bz)] = occupied;
+        }
+    }
+
+    /**
+     * @brief      Finds the first solid voxel along `r` no further than `max_t`.
+     */
+    voxel_hit cast(const ray& r, float max_t=std::numeric_limits<float>::infinity()) const
+    {
+        constexpr auto inf = std::numeric_limits<float>::infinity();
+        constexpr int B = (int)BRICK_SIZE;
+        const vec<3> o = (r.position - position) / scale;
+        const vec<3> d = r.direction / scale;
+        const int size[3] = { (int)vox.size[0], (int)vox.size[1], (int)vox.size[2] };
+
+        if (d[0] == 0 && d[1] == 0 && d[2] == 0) { return {}; }
+
+        int step[3];
+        float inv_d[3];
+        for (int a = 0; a < 3; a++)
+        {
+            step[a] = d[a] > 0 ? 1 : (d[a] < 0 ? -1 : 0);
+            inv_d[a] = d[a] != 0 ? 1.f / d[a] : inf;
+        }
+
+        // clip the ray to the volume's bounds
+        float t_enter = -inf, t_exit = inf;
+        int axis = -1;
+        for (int a = 0; a < 3; a++)
+        {
+            if (step[a] == 0)
+            {
+                if (o[a] < 0 || o[a] >= size[a]) { return {}; }
+                continue;
+            }
+
+            auto t0 = (0 - o[a]) * inv_d[a], t1 = (size[a] - o[a]) * inv_d[a];
+            if (t0 > t1) { std::swap(t0, t1); }
+            if (t0 > t_enter) { t_enter = t0; axis = a; }
+            t_exit = std::min(t_exit, t1);
+        }
+
+        if (t_enter > t_exit || t_exit < 0) { return {}; }
+
+        float t = std::max(t_enter, 0.f);
+        if (t_enter < 0) { axis = -1; } // started inside the volume
+        t_exit = std::min(t_exit, max_t);
+        if (t > t_exit) { return {}; }
+
+        int voxel[3];
+        for (int a = 0; a < 3; a++)
+        {
+            voxel[a] = std::min(std::max((int)floorf(o[a] + d[a] * t), 0), size[a] - 1);
+        }
+
+        if (axis >= 0)
+        { // the entry face is exact, don't trust rounding
+            voxel[axis] = step[axis] > 0 ? 0 : size[axis] - 1;
+        }
+
+        while (true)
+        {
+            int brick[3] = { voxel[0] / B, voxel[1] / B, voxel[2] / B };
+            float t_max[3];
+
+            if (!bricks[brick[0] + brick_dims[0] * (brick[1] + brick_dims[1] * brick[2])])
+            { // jump to where the ray leaves this empty brick
+                for (int a = 0; a < 3; a++)
+                {
+                    t_max[a] = step[a] != 0 ? ((brick[a] + (step[a] > 0)) * B - o[a]) * inv_d[a] : inf;
+                }
+
+                int m = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+                t = t_max[m];
+                axis = m;
+
+                for (int a = 0; a < 3; a++)
+                {
+                    if (a == m) { continue; }
+
+                    auto lo = brick[a] * B;
+                    auto hi = std::min(lo + B, size[a]) - 1;
+                    voxel[a] = std::min(std::max((int)floorf(o[a] + d[a] * t), lo), hi);
+                }
+
+                voxel[m] = step[m] > 0 ? (brick[m] + 1) * B : brick[m] * B - 1;
+            }
+            else
+            { // step voxel by voxel until the ray hits something or leaves the brick
+                float t_delta[3];
+                int lo[3], hi[3];
+
+                for (int a = 0; a < 3; a++)
+                {
+                    t_max[a] = step[a] != 0 ? ((voxel[a] + (step[a] > 0)) - o[a]) * inv_d[a] : inf;
+                    t_delta[a] = fabsf(inv_d[a]);
+                    lo[a] = brick[a] * B;
+                    hi[a] = std::min(lo[a] + B, size[a]) - 1;
+                }
+
+                while (true)
+                {
+                    if (vox.idx(voxel[0], voxel[1], voxel[2]) != voxel_type{})
+                    {
+                        vec<3> normal = {};
+
+                        if (axis >= 0) { normal[axis] = -step[axis]; }
+                        else
+                        { // started inside a solid voxel, oppose the ray's dominant axis
+                            int m = 0;
+                            for (int a = 1; a < 3; a++) { if (fabsf(d[a]) > fabsf(d[m])) { m = a; } }
+                            normal[m] = -step[m];
+                        }
+
+                        return {
+                            { t, r.position, r.direction, r.point_at(t), normal },
+                            { (size_t)voxel[0], (size_t)voxel[1], (size_t)voxel[2] }
+                        };
+                    }
+
+                    int m = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+                    t = t_max[m];
+                    axis = m;
+                    voxel[m] += step[m];
+                    t_max[m] += t_delta[m];
+
+                    if (voxel[m] < lo[m] || voxel[m] > hi[m] || t > t_exit) { break; }
+                }
+            }
+
+            if (t > t_exit || voxel[axis] < 0 || voxel[axis] >= size[axis]) { return {}; }
+        }
+    }
+
+    /**
+     * @brief      Casts `count` rays writing the result of each to `hits`.
+     */
+    void cast(const ray* rays, size_t count, voxel_hit* hits, float max_t=std::numeric_limits<float>::infinity()) const
+    {
+        for (size_t i = 0; i < count; i++) { hits[i] = cast(rays[i], max_t); }
+    }
+
+    void cast(const std::vector<ray>& rays, std::vector<voxel_hit>& hits, float max_t=std::numeric_limits<float>::infinity()) const
+    {
+        hits.resize(rays.size());
+        cast(rays.data(), rays.size(), hits.data(), max_t);
+    }
+
+    /**
+     * @brief      Casts `rays` in batches spread across the workers of `pool`.
+     */
+    template<size_t POOL_SIZE>
+    void cast(const std::vector<ray>& rays, std::vector<voxel_hit>& hits, g::proc::thread_pool<POOL_SIZE>& pool, float max_t=std::numeric_limits<float>::infinity(), size_t batch=256) const
+    {
+        hits.resize(rays.size());
+
+        g::proc::parallel_for(pool, (rays.size() + batch - 1) / batch, [&](size_t b) {
+            auto start = b * batch;
+            cast(rays.data() + start, std::min(batch, rays.size() - start), hits.data() + start, max_t);
+        });
+    }
+
+    intersection ray_intersects(const ray& r) const override { return cast(r).hit; }
+
+    bool generates_rays() override { return false; }
+
+    std::vector<ray>& rays() override
+    {
+        ray_list.clear();
+        return ray_list;
+    }
+
+    const std::vector<intersection>& intersections(collider& other, float max_t = std::numeric_limits<float>::infinity()) override
+    {
+        intersection_list.clear();
+        if (other.generates_rays())
+        {
+            for (auto& r : other.rays())
+            {
+                auto i = cast(r, max_t).hit;
+                if (i) { intersection_list.push_back(i); }
+            }
+        }
+        return intersection_list;
+    }
+
+private:
+    std::vector<ray> ray_list;
+    const VOXELS& vox;
+    vec<3, int> brick_dims;
+    std::vector<uint8_t> bricks; /**< non-zero if any voxel in the brick is solid */
+};
+
+/**
+ * @brief      Incrementally updated bounding volume tree of boxes tagged with
+ * integer proxies, in the spirit of Box2D's dynamic tree. Boxes are inserted
+ * beside the sibling that least increases the tree's surface area, and the
+ * tree is rebalanced with rotations as it changes.
+ */
+struct aabb_tree
+{
+    struct node
+    {
+        vec<3> box[2];
+        int parent = -1;
+        int left = -1, right = -1; /**< both -1 for leaves */
+        int height = 0;            /**< 0 for leaves, -1 for free nodes */
+        int proxy = -1;
+
+        inline bool is_leaf() const { return left < 0; }
+    };
+
+    std::vector<aabb_tree::node> nodes;
+    int root = -1;
+
+    /**
+     * @brief      Adds `box` to the tree.
+     *
+     * @return     The leaf holding it, used to update or remove it.
+     */
+    int insert(const vec<3> box[2], int proxy)
+    {
+        auto leaf = allocate();
+        nodes[leaf].box[0] = box[0];
+        nodes[leaf].box[1] = box[1];
+        nodes[leaf].proxy = proxy;
+        nodes[leaf].height = 0;
+        insert_leaf(leaf);
+
+        return leaf;
+    }
+
+    void remove(int leaf)
+    {
+        remove_leaf(leaf);
+        release(leaf);
+    }
+
+    /**
+     * @brief      Replaces the box of `leaf`, moving it within the tree.
+     */
+    void update(int leaf, const vec<3> box[2])
+    {
+        remove_leaf(leaf);
+        nodes[leaf].box[0] = box[0];
+        nodes[leaf].box[1] = box[1];
+        insert_leaf(leaf);
+    }
+
+    /**
+     * @brief      Calls `fn(proxy)` for every box overlapping `box`.
+     */
+    template<typename FN>
+    void query(const vec<3> box[2], FN fn) const
+    {
+        if (root < 0) { return; }
+
+        traversal_stack stack;
+        stack.push(root);
+
+        while (!stack.empty())
+        {
+            auto& n = nodes[stack.pop()];
+
+            if (!g::game::bvh::overlaps(n.box, box)) { continue; }
+
+            if (n.is_leaf()) { fn(n.proxy); }
+            else
+            {
+                stack.push(n.left);
+                stack.push(n.right);
+            }
+        }
+    }
+
+    /**
+     * @brief      Calls `fn(proxy, t)` for every box entered by the ray
+     * `origin + direction * t` for t in [0, max_t].
+     */
+    template<typename FN>
+    void raycast(const vec<3>& origin, const vec<3>& direction, FN fn, float max_t=std::numeric_limits<float>::infinity()) const
+    {
+        if (root < 0) { return; }
+
+        vec<3> inv_d;
+        for (int a = 0; a < 3; a++) { inv_d[a] = 1.f / direction[a]; }
+
+        traversal_stack stack;
+        stack.push(root);
+
+        while (!stack.empty())
+        {
+            auto& n = nodes[stack.pop()];
+
+            auto t = g::game::bvh::ray_box(origin, inv_d, n.box, max_t);
+            if (t > max_t) { continue; }
+
+            if (n.is_leaf()) { fn(n.proxy, t); }
+            else
+            {
+                stack.push(n.left);
+                stack.push(n.right);
+            }
+        }
+    }
+
+    inline int height() const { return root < 0 ? 0 : nodes[root].height; }
+
+private:
+    std::vector<int> free_nodes;
+
+    /**
+     * @brief      Nodes left to visit in one query. Each query owns its stack so
+     * callbacks may query the tree again, it only touches the heap for trees
+     * deeper than a balanced tree of billions of leaves.
+     */
+    struct traversal_stack
+    {
+        int local[64];
+        std::vector<int> spilled;
+        int* data = local;
+        size_t top = 0, capacity = 64;
+
+        traversal_stack() = default;
+        traversal_stack(const traversal_stack&) = delete;
+
+        inline bool empty() const { return top == 0; }
+
+        inline int pop() { return data[--top]; }
+
+        inline void push(int n)
+        {
+            if (top == capacity)
+            {
+                spilled.resize(capacity * 2);
+                if (data == local) { std::copy(local, local + top, spilled.begin()); }
+                data = spilled.data();
+                capacity = spilled.size();
+            }
+
+            data[top++] = n;
+        }
+    };
+
+    static inline float area(const vec<3> box[2])
+    {
+        auto d = box[1] - box[0];
+        return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+    }
+
+    static inline float area(const vec<3> a[2], const vec<3> b[2])
+    {
+        vec<3> c[2] = { a[0].take_min(b[0]), a[1].take_max(b[1]) };
+        return area(c);
+    }
+
+    inline void fit(int i)
+    {
+        auto& n = nodes[i];
+        auto& l = nodes[n.left];
+        auto& r = nodes[n.right];
+        n.box[0] = l.box[0].take_min(r.box[0]);
+        n.box[1] = l.box[1].take_max(r.box[1]);
+        n.height = 1 + std::max(l.height, r.height);
+    }
+
+    int allocate()
+    {
+        if (free_nodes.empty())
+        {
+            nodes.push_back({});
+            return nodes.size() - 1;
+        }
+
+        auto i = free_nodes.back();
+        free_nodes.pop_back();
+        nodes[i] = {};
+        return i;
+    }
+
+    void release(int i)
+    {
+        nodes[i].height = -1;
+        free_nodes.push_back(i);
+    }
+
+    void insert_leaf(int leaf)
+    {
+        if (root < 0)
+        {
+            root = leaf;
+            nodes[root].parent = -1;
+            return;
+        }
+
+        // descend toward the sibling whose union with the leaf costs the least
+        auto box = nodes[leaf].box;
+        int i = root;
+        while (!nodes[i].is_leaf())
+        {
+            auto& n = nodes[i];
+            auto a = area(n.box);
+            auto combined = area(n.box, box);
+
+            auto cost = 2 * combined;                 // new parent for this node and the leaf
+            auto inherited = 2 * (combined - a);      // growth pushed onto every ancestor below
+
+            auto child_cost = [&](int c) {
+                auto& cn = nodes[c];
+                auto grown = area(cn.box, box);
+                return cn.is_leaf() ? grown + inherited : (grown - area(cn.box)) + inherited;
+            };
+
+            auto cost_l = child_cost(n.left);
+            auto cost_r = child_cost(n.right);
+
+            if (cost < cost_l && cost < cost_r) { break; }
+
+            i = cost_l < cost_r ? n.left : n.right;
+        }
+
+        // join the sibling and the leaf under a new parent
+        int sibling = i;
+        int old_parent = nodes[sibling].parent;
+        int parent = allocate();
+        nodes[parent].parent = old_parent;
+        nodes[parent].left = sibling;
+        nodes[parent].right = leaf;
+        nodes[sibling].parent = parent;
+        nodes[leaf].parent = parent;
+        fit(parent);
+
+        if (old_parent < 0) { root = parent; }
+        else if (nodes[old_parent].left == sibling) { nodes[old_parent].left = parent; }
+        else { nodes[old_parent].right = parent; }
+
+        refit_from(nodes[parent].parent);
+    }
+
+    void remove_leaf(int leaf)
+    {
+        if (leaf == root)
+        {
+            root = -1;
+            return;
+        }
+
+        int parent = nodes[leaf].parent;
+        int grand_parent = nodes[parent].parent;
+        int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+        // the sibling takes the parent's place
+        if (grand_parent < 0)
+        {
+            root = sibling;
+            nodes[sibling].parent = -1;
+        }
+        else
+        {
+            if (nodes[grand_parent].left == parent) { nodes[grand_parent].left = sibling; }
+            else { nodes[grand_parent].right = sibling; }
+            nodes[sibling].parent = grand_parent;
+        }
+
+        release(parent);
+        refit_from(grand_parent);
+    }
+
+    /**
+     * @brief      Refits and rebalances `i` and each of its ancestors.
+     */
+    void refit_from(int i)
+    {
+        while (i >= 0)
+        {
+            i = balance(i);
+            fit(i);
+            i = nodes[i].parent;
+        }
+    }
+
+    /**
+     * @brief      Rotates the taller grandchild of `a` up if its children's
+     * heights differ by more than one.
+     *
+     * @return     The node now in `a`'s place.
+     */
+    int balance(int a)
+    {
+        auto& A = nodes[a];
+        if (A.is_leaf() || A.height < 2) { return a; }
+
+        int b = A.left, c = A.right;
+        int diff = nodes[c].height - nodes[b].height;
+
+        if (diff > 1) { return rotate(a, c, b); }
+        if (diff < -1) { return rotate(a, b, c); }
+
+        return a;
+    }
+
+    /**
+     * @brief      Promotes `up`, the taller child of `a`, into `a`'s place. The
+     * taller child of `up` stays beneath it, the shorter one moves under `a`
+     * in place of `up`. `other` is `a`'s remaining child.
+     */
+    int rotate(int a, int up, int other)
+    {
+        int f = nodes[up].left, g = nodes[up].right;
+        if (nodes[f].height < nodes[g].height) { std::swap(f, g); } // f is taller, stays under up
+
+        // up replaces a
+        nodes[up].parent = nodes[a].parent;
+        if (nodes[up].parent < 0) { root = up; }
+        else if (nodes[nodes[up].parent].left == a) { nodes[nodes[up].parent].left = up; }
+        else { nodes[nodes[up].parent].right = up; }
+
+        // a becomes a child of up, adopting g in place of up
+        nodes[up].left = a;
+        nodes[up].right = f;
+        nodes[a].parent = up;
+        nodes[f].parent = up;
+
+        nodes[a].left = other;
+        nodes[a].right = g;
+        nodes[other].parent = a;
+        nodes[g].parent = a;
+
+        fit(a);
+        fit(up);
+
+        return up;
+    }
+};
+
+/**
+ * @brief      Uniform grid of cells holding the proxies whose boxes overlap
+ * them. Suits many similarly sized objects, each spanning few cells.
+ */
+struct aabb_grid
+{
+    float cell_size = 4;
+
+    aabb_grid(float cell_size=4) : cell_size(cell_size) {}
+
+    void insert(int proxy, const vec<3> box[2])
+    {
+        if ((size_t)proxy >= ranges.size()) { ranges.resize(proxy + 1); }
+        cell_range(box, ranges[proxy].lo, ranges[proxy].hi);
+
+        each_cell(box, [&](uint64_t key) { cells[key].push_back(proxy); });
+    }
+
+    void remove(int proxy, const vec<3> box[2])
+    {
+        each_cell(box, [&](uint64_t key) {
+            auto itr = cells.find(key);
+            if (itr == cells.end()) { return; }
+
+            auto& list = itr->second;
+            auto p = std::find(list.begin(), list.end(), proxy);
+            if (p != list.end())
+            {
+                *p = list.back();
+                list.pop_back();
+            }
+
+            if (list.empty()) { cells.erase(itr); }
+        });
+    }
+
+    /**
+     * @brief      Calls `fn(proxy)` once for every proxy sharing a cell with
+     * `box`. Proxies may not actually overlap `box`. A proxy is only reported
+     * from the first cell it shares with `box`, so queries keep no state and
+     * callbacks may query the grid again.
+     */
+    template<typename FN>
+    void query(const vec<3> box[2], FN fn) const
+    {
+        int lo[3], hi[3];
+        cell_range(box, lo, hi);
+
+        for (int z = lo[2]; z <= hi[2]; z++)
+        for (int y = lo[1]; y <= hi[1]; y++)
+        for (int x = lo[0]; x <= hi[0]; x++)
+        {
+            auto itr = cells.find(key(x, y, z));
+            if (itr == cells.end()) { continue; }
+
+            for (auto proxy : itr->second)
+            {
+                auto& r = ranges[proxy];
+                if (x != std::max(lo[0], r.lo[0]) || y != std::max(lo[1], r.lo[1]) || z != std::max(lo[2], r.lo[2])) { continue; }
+
+                fn(proxy);
+            }
+        }
+    }
+
+private:
+    struct cell_span
+    {
+        int lo[3], hi[3];
+    };
+
+    std::unordered_map<uint64_t, std::vector<int>> cells;
+    std::vector<cell_span> ranges; /**< cells covered by each proxy as of its insertion */
+
+    inline void cell_range(const vec<3> box[2], int lo[3], int hi[3]) const
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            lo[a] = (int)floorf(box[0][a] / cell_size);
+            hi[a] = (int)floorf(box[1][a] / cell_size);
+        }
+    }
+
+    static inline uint64_t key(int x, int y, int z)
+    {
+        // 21 bits per axis
+        return ((uint64_t)(x & 0x1fffff)) | ((uint64_t)(y & 0x1fffff) << 21) | ((uint64_t)(z & 0x1fffff) << 42);
+    }
+
+    template<typename FN>
+    void each_cell(const vec<3> box[2], FN fn) const
+    {
+        int lo[3], hi[3];
+        cell_range(box, lo, hi);
+
+        for (int z = lo[2]; z <= hi[2]; z++)
+        for (int y = lo[1]; y <= hi[1]; y++)
+        for (int x = lo[0]; x <= hi[0]; x++)
+        {
+            fn(key(x, y, z));
+        }
+    }
+};
+
+/**
+ * @brief      Uniform grid of points, for finding the points near a
+ * position, such as an agent's neighbours. Unlike `aabb_grid` it isn't
+ * updated incrementally. It's rebuilt from every point at once, typically
+ * each frame, by counting sort. This leaves the points of each cell next to
+ * each other, in the order they were given, so queries read memory in
+ * order. Cells are hashed into buckets, at least as many as there are
+ * points unless `buckets` is given, so the grid is unbounded. Points are
+ * identified by their index in the array the hash was built from.
+ */
+struct spatial_hash
+{
+    spatial_hash(float cell_size=1, size_t buckets=0) : cell_size(cell_size), inv_cell_size(1 / cell_size), fixed_buckets(buckets)
+    {
+        starts.resize(2, 0);
+    }
+
+    inline size_t size() const { return sorted.size(); }
+
+    inline float cell() const { return cell_size; }
+
+    /**
+     * @brief      Replaces the hashed points with `count` points. `cell_size`
+     * is best near the radius usually queried.
+     */
+    void rebuild(const vec<3>* points, size_t count)
+    {
+        begin_rebuild(count, 1);
+        count_batch(points, 0);
+        prefix_sum();
+        scatter_batch(points, 0);
+    }
+
+    void rebuild(const std::vector<vec<3>>& points) { rebuild(points.data(), points.size()); }
+
+    /**
+     * @brief      As `rebuild(points, count)`, with the points split into a
+     * batch per thread of `pool`, which are counted and scattered in
+     * parallel. The result is identical.
+     */
+    template<size_t POOL_SIZE>
+    void rebuild(const vec<3>* points, size_t count, g::proc::thread_pool<POOL_SIZE>& pool)
+    {
+        // each batch keeps a count per bucket, so use few
+        auto batches = std::max<size_t>(std::min<size_t>(POOL_SIZE, count / 4096), 1);
+
+        begin_rebuild(count, batches);
+        g::proc::parallel_for(pool, batches, [&](size_t b) { count_batch(points, b); });
+        prefix_sum();
+        g::proc::parallel_for(pool, batches, [&](size_t b) { scatter_batch(points, b); });
+    }
+
+    /**
+     * @brief      Calls `fn(index)` once for every point within `radius` of `p`.
+     */
+    template<typename FN>
+    void within(const vec<3>& p, float radius, FN fn) const
+    {
+        auto r2 = radius * radius;
+        int lo[3], hi[3];
+        for (int a = 0; a < 3; a++)
+        {
+            lo[a] = cell_coord(p[a] - radius);
+            hi[a] = cell_coord(p[a] + radius);
+        }
+
+        // visiting more cells than buckets would visit buckets repeatedly
+        auto cells = (double)(hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1);
+        if (cells >= buckets())
+        {
+            for (auto& e : sorted)
+            {
+                if ((e.position - p).dot(e.position - p) <= r2) { fn((size_t)e.index); }
+            }
+            return;
+        }
+
+        for (int z = lo[2]; z <= hi[2]; z++)
+        for (int y = lo[1]; y <= hi[1]; y++)
+        for (int x = lo[0]; x <= hi[0]; x++)
+        {
+            each_in_cell(x, y, z, [&](const entry& e) {
+                if ((e.position - p).dot(e.position - p) <= r2) { fn((size_t)e.index); }
+            });
+        }
+    }
+
+    /**
+     * @brief      Appends the indices of the points within `radius` of `p` to `out`.
+     *
+     * @return     The number of points appended.
+     */
+    size_t within(const vec<3>& p, float radius, std::vector<size_t>& out) const
+    {
+        auto n = out.size();
+        within(p, radius, [&](size_t i) { out.push_back(i); });
+        return out.size() - n;
+    }
+
+    /**
+     * @brief      Finds the `k` points nearest to `p`, ignoring any further
+     * than `max_radius`. Cells are searched in growing shells around `p`'s
+     * cell, until no unsearched point could be nearer than those found.
+     *
+     * @param      out   Replaced by the points' indices, nearest first. Ties
+     *                   are ordered by index.
+     *
+     * @return     The number of points found, at most `k`.
+     */
+    size_t nearest(const vec<3>& p, size_t k, std::vector<size_t>& out, float max_radius=std::numeric_limits<float>::infinity()) const
+    {
+        out.clear();
+        if (k == 0 || sorted.empty()) { return 0; }
+
+        auto r2 = max_radius * max_radius;
+
+        // max heap of the best candidates found so far
+        std::vector<std::pair<float, size_t>> best;
+        auto consider = [&](const entry& e) {
+            auto d = e.position - p;
+            std::pair<float, size_t> candidate = { d.dot(d), (size_t)e.index };
+            if (candidate.first > r2) { return; }
+            if (best.size() == k)
+            {
+                if (!(candidate < best.front())) { return; }
+                std::pop_heap(best.begin(), best.end());
+                best.pop_back();
+            }
+            best.push_back(candidate);
+            std::push_heap(best.begin(), best.end());
+        };
+
+        int c[3] = { cell_coord(p[0]), cell_coord(p[1]), cell_coord(p[2]) };
+        size_t seen = 0;
+
+        for (int s = 0;; s++)
+        {
+            auto shell = (double)(2 * s + 1) * (2 * s + 1) * (2 * s + 1);
+            if (shell >= buckets())
+            {
+                // the shells cover the table, so check each point once instead
+                best.clear();
+                for (auto& e : sorted) { consider(e); }
+                break;
+            }
+
+            for (int z = c[2] - s; z <= c[2] + s; z++)
+            for (int y = c[1] - s; y <= c[1] + s; y++)
+            {
+                // inside the shell only its two end cells along x are new
+                auto inner = std::abs(z - c[2]) < s && std::abs(y - c[1]) < s;
+                auto step = inner ? 2 * s : 1;
+                for (int x = c[0] - s; x <= c[0] + s; x += step)
+                {
+                    each_in_cell(x, y, z, [&](const entry& e) { seen++; consider(e); });
+                }
+            }
+
+            if (seen == sorted.size()) { break; }
+
+            // the nearest any point outside the searched cells could be
+            float reach = std::numeric_limits<float>::infinity();
+            for (int a = 0; a < 3; a++)
+            {
+                reach = std::min(reach, p[a] - (c[a] - s) * cell_size);
+                reach = std::min(reach, (c[a] + s + 1) * cell_size - p[a]);
+            }
+
+            if (reach * reach > r2) { break; }
+            if (best.size() == k && reach * reach >= best.front().first) { break; }
+        }
+
+        std::sort_heap(best.begin(), best.end());
+        for (auto& b : best) { out.push_back(b.second); }
+
+        return out.size();
+    }
+
+private:
+    struct entry
+    {
+        vec<3> position;
+        uint32_t index; /**< index the point was given at */
+    };
+
+    float cell_size, inv_cell_size;
+    size_t fixed_buckets;
+    std::vector<uint32_t> starts; /**< index of each bucket's first point in `sorted`, and the point count */
+    std::vector<entry> sorted;    /**< points in bucket order */
+    std::vector<uint32_t> keys;   /**< bucket of each point, in the order given */
+    std::vector<uint32_t> counts; /**< points per bucket in each batch, then where each batch's points go */
+    size_t batch_size = 0, batch_count = 0, point_count = 0;
+
+    inline size_t buckets() const { return starts.size() - 1; }
+
+    inline int cell_coord(float x) const { return (int)floorf(x * inv_cell_size); }
+
+    inline uint32_t bucket(int x, int y, int z) const
+    {
+        auto h = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+        return h & (uint32_t)(buckets() - 1);
+    }
+
+    /**
+     * @brief      Calls `fn(entry)` for each point in cell x, y, z. Points of
+     * other cells sharing its bucket are skipped.
+     */
+    template<typename FN>
+    inline void each_in_cell(int x, int y, int z, FN fn) const
+    {
+        auto b = bucket(x, y, z);
+        for (auto i = starts[b]; i < starts[b + 1]; i++)
+        {
+            auto& q = sorted[i].position;
+            if (cell_coord(q[0]) != x || cell_coord(q[1]) != y || cell_coord(q[2]) != z) { continue; }
+            fn(sorted[i]);
+        }
+    }
+
+    void begin_rebuild(size_t count, size_t batches)
+    {
+        assert(count <= std::numeric_limits<uint32_t>::max());
+
+        size_t n = 1;
+        while (n < (fixed_buckets ? fixed_buckets : std::max<size_t>(count, 1024))) { n <<= 1; }
+        starts.resize(n + 1);
+
+        point_count = count;
+        batch_count = batches;
+        batch_size = (count + batches - 1) / batches;
+        keys.resize(count);
+        sorted.resize(count);
+        counts.assign(batches * buckets(), 0);
+    }
+
+    void count_batch(const vec<3>* points, size_t b)
+    {
+        auto hist = counts.data() + b * buckets();
+        auto end = std::min(point_count, (b + 1) * batch_size);
+        for (auto i = b * batch_size; i < end; i++)
+        {
+            auto& q = points[i];
+            keys[i] = bucket(cell_coord(q[0]), cell_coord(q[1]), cell_coord(q[2]));
+            hist[keys[i]]++;
+        }
+    }
+
+    /**
+     * @brief      Turns the per batch counts into the index each batch writes
+     * its first point of each bucket to, so batches scatter independently.
+     */
+    void prefix_sum()
+    {
+        uint32_t total = 0;
+        for (size_t k = 0; k < buckets(); k++)
+        {
+            starts[k] = total;
+            for (size_t b = 0; b < batch_count; b++)
+            {
+                auto& c = counts[b * buckets() + k];
+                auto n = c;
+                c = total;
+                total += n;
+            }
+        }
+        starts[buckets()] = total;
+    }
+
+    void scatter_batch(const vec<3>* points, size_t b)
+    {
+        auto next = counts.data() + b * buckets();
+        auto end = std::min(point_count, (b + 1) * batch_size);
+        for (auto i = b * batch_size; i < end; i++)
+        {
+            sorted[next[keys[i]]++] = { points[i], (uint32_t)i };
+        }
+    }
+};
+
+/**
+ * @brief      Tracks which registered colliders may be touching, and runs the
+ * narrowphase only on those pairs. Each collider is registered with a box
+ * bounding it. Boxes are stored enlarged by `margin`, so small movements
+ * don't disturb the broadphase. When a collider moves out of its enlarged
+ * box, it is reinserted and its new candidate pairs are found. Pairs are
+ * dropped once their enlarged boxes no longer overlap.
+ */
+struct collision_world
+{
+    enum class method
+    {
+        tree, /**< dynamic aabb tree, suits objects of varied size */
+        grid, /**< uniform grid, suits many similarly sized objects */
+    };
+
+    using handle = int;
+
+    struct pair
+    {
+        handle a, b;
+    };
+
+    float margin = 0.1f; /**< distance boxes are enlarged by */
+
+    collision_world(method m=method::tree, float cell_size=4, float margin=0.1f) : margin(margin), broadphase(m), grid(cell_size) {}
+
+    /**
+     * @brief      Registers `c`, which must outlive its registration.
+     */
+    handle add(collider* c, const vec<3> box[2])
+    {
+        handle h;
+        if (free_handles.empty())
+        {
+            h = proxies.size();
+            proxies.push_back({});
+        }
+        else
+        {
+            h = free_handles.back();
+            free_handles.pop_back();
+        }
+
+        auto& p = proxies[h];
+        p = {};
+        p.c = c;
+        p.alive = true;
+        enlarge(p, box, {});
+
+        if (broadphase == method::tree) { p.leaf = tree.insert(p.fat, h); }
+        else { grid.insert(h, p.fat); }
+
+        mark_moved(h);
+        return h;
+    }
+
+    void remove(handle h)
+    {
+        auto& p = proxies[h];
+        assert(p.alive);
+
+        if (broadphase == method::tree) { tree.remove(p.leaf); }
+        else { grid.remove(h, p.fat); }
+
+        p.alive = false;
+        p.c = nullptr;
+        free_handles.push_back(h);
+
+        // forget its pairs
+        for (auto itr = pair_set.begin(); itr != pair_set.end();)
+        {
+            auto a = (handle)(*itr >> 32), b = (handle)(*itr & 0xffffffff);
+            if (a == h || b == h) { itr = pair_set.erase(itr); }
+            else { itr++; }
+        }
+    }
+
+    /**
+     * @brief      Updates the box bounding `h`. `displacement` is how far it is
+     * expected to move before the next update, its box is stretched in that
+     * direction so it needn't be reinserted every step.
+     *
+     * @return     True if the collider left its enlarged box and was reinserted.
+     */
+    bool move(handle h, const vec<3> box[2], const vec<3>& displacement={})
+    {
+        auto& p = proxies[h];
+        assert(p.alive);
+
+        bool contained = true;
+        for (int a = 0; a < 3; a++)
+        {
+            contained &= box[0][a] >= p.fat[0][a] && box[1][a] <= p.fat[1][a];
+        }
+
+        if (contained) { return false; }
+
+        if (broadphase == method::grid) { grid.remove(h, p.fat); }
+        enlarge(p, box, displacement);
+
+        if (broadphase == method::tree) { tree.update(p.leaf, p.fat); }
+        else { grid.insert(h, p.fat); }
+
+        mark_moved(h);
+        return true;
+    }
+
+    inline collider* collider_of(handle h) const { return proxies[h].c; }
+
+    /**
+     * @brief      Finds new candidate pairs for colliders reinserted since the
+     * last update, and drops pairs whose boxes have separated.
+     */
+    void update_pairs()
+    {
+        // drop separated pairs
+        for (auto itr = pair_set.begin(); itr != pair_set.end();)
+        {
+            auto a = (handle)(*itr >> 32), b = (handle)(*itr & 0xffffffff);
+            if (!g::game::bvh::overlaps(proxies[a].fat, proxies[b].fat)) { itr = pair_set.erase(itr); }
+            else { itr++; }
+        }
+
+        for (auto h : moved)
+        {
+            auto& p = proxies[h];
+            p.moved = false;
+            if (!p.alive) { continue; }
+
+            auto add_pair = [&](int other) {
+                if (other == h || !g::game::bvh::overlaps(p.fat, proxies[other].fat)) { return; }
+                pair_set.insert(key(h, other));
+            };
+
+            if (broadphase == method::tree) { tree.query(p.fat, add_pair); }
+            else { grid.query(p.fat, add_pair); }
+        }
+
+        moved.clear();
+
+        // sorted, so that the order doesn't depend on the hash set's implementation
+        pair_keys.assign(pair_set.begin(), pair_set.end());
+        std::sort(pair_keys.begin(), pair_keys.end());
+
+        pair_list.clear();
+        for (auto k : pair_keys) { pair_list.push_back({ (handle)(k >> 32), (handle)(k & 0xffffffff) }); }
+    }
+
+    /**
+     * @brief      Current candidate pairs ordered by their handles, valid after
+     * `update_pairs()`.
+     */
+    inline const std::vector<pair>& pairs() const { return pair_list; }
+
+    /**
+     * @brief      Updates the candidate pairs, then tests each pair in which at
+     * least one collider generates rays with `collider::intersections`. `fn`
+     * is called for each pair with any intersections.
+     */
+    void collide(std::function<void(handle a, handle b, const std::vector<intersection>& intersections)> fn, float max_t=std::numeric_limits<float>::infinity())
+    {
+        update_pairs();
+
+        for (auto& pr : pair_list)
+        {
+            auto a = proxies[pr.a].c, b = proxies[pr.b].c;
+            if (!a->generates_rays() && !b->generates_rays()) { continue; }
+
+            auto& hits = a->intersections(*b, max_t);
+            if (!hits.empty()) { fn(pr.a, pr.b, hits); }
+        }
+    }
+
+    /**
+     * @brief      Calls `fn(h)` for every collider whose enlarged box overlaps
+     * `box`.
+     */
+    void query(const vec<3> box[2], std::function<void(handle h)> fn) const
+    {
+        auto filter = [&](int h) { if (g::game::bvh::overlaps(proxies[h].fat, box)) { fn(h); } };
+
+        if (broadphase == method::tree) { tree.query(box, filter); }
+        else { grid.query(box, filter); }
+    }
+
+private:
+    struct proxy
+    {
+        collider* c = nullptr;
+        vec<3> fat[2];
+        int leaf = -1;
+        bool alive = false;
+        bool moved = false;
+    };
+
+    method broadphase;
+    aabb_tree tree;
+    aabb_grid grid;
+    std::vector<proxy> proxies;
+    std::vector<handle> free_handles;
+    std::vector<handle> moved;
+    std::unordered_set<uint64_t> pair_set;
+    std::vector<uint64_t> pair_keys;
+    std::vector<pair> pair_list;
+
+    static inline uint64_t key(handle a, handle b)
+    {
+        if (a > b) { std::swap(a, b); }
+        return ((uint64_t)a << 32) | (uint32_t)b;
+    }
+
+    void mark_moved(handle h)
+    {
+        if (proxies[h].moved) { return; }
+        proxies[h].moved = true;
+        moved.push_back(h);
+    }
+
+    void enlarge(proxy& p, const vec<3> box[2], const vec<3>& displacement)
+    {
+        p.fat[0] = box[0] - margin;
+        p.fat[1] = box[1] + margin;
+
+        for (int a = 0; a < 3; a++)
+        {
+            if (displacement[a] < 0) { p.fat[0][a] += 2 * displacement[a]; }
+            else { p.fat[1][a] += 2 * displacement[a]; }
+        }
+    }
+};
+
+} // end namespace cd
+
+
+namespace cr //< Collision resolution
+{
+    /**
+     * @brief      Resolves collision for and object which only has translational
+     *             degrees of freedom.
+     * 
+     * @param[inout] obj            The object which we are resolving the collision for.
+     * @param[in]    intersections  The intersections.
+     *
+     * @tparam       T            A type compatible with this function must have 
+     *                            `position` and `velocity` vec<3> members
+     */
+    template<typename T>
+    void resolve_linear(T& obj, const std::vector<cd::intersection>& intersections, float static_friction_tol=0.5)
+    {
+        // bool printed = false;
+
+        for (auto& intersection : intersections)
+        {
             auto n = intersection.normal;
 
             // correct penetration
@@ -436,6 +4011,640 @@ namespace cr //< Collision resolution
 
         } 
     }
+    /**
+     * @brief      Body index standing in for immovable geometry in contacts
+     *             and joints.
+     */
+    constexpr int fixed = -1;
+
+    /**
+     * @brief      A point of contact between two bodies, found by the
+     *             narrowphase and handed to the `solver` for one step.
+     */
+    struct contact
+    {
+        int a = fixed, b = fixed;   /**< bodies in contact */
+        vec<3> point = {};          /**< world space */
+        vec<3> normal = {};         /**< unit length, pointing from a toward b */
+        float depth = 0;            /**< penetration, positive when overlapping */
+        uint32_t feature = 0;       /**< identifies this contact between a and b across steps, for warm starting */
+        float friction = 0.5f;
+        float restitution = 0;
+    };
+
+    /**
+     * @brief      Holds a point of body a and a point of body b together.
+     */
+    struct ball_joint
+    {
+        int a = fixed, b = fixed;
+        vec<3> anchor_a = {}, anchor_b = {}; /**< in each body's frame, or in world space for fixed */
+        vec<3> impulse = {};                  /**< accumulated across steps for warm starting */
+    };
+
+    /**
+     * @brief      Sequential impulse solver for the contacts and joints between
+     * the bodies of a `rigid_body_system`. Each step, bodies linked by
+     * constraints are gathered into islands that are solved independently,
+     * optionally in parallel. Impulses are carried from one step to the next
+     * to warm start the solve. Islands whose bodies have all been at rest for
+     * `time_to_sleep` are put to sleep, after which they aren't integrated or
+     * solved until a constraint links them to an awake body, or a force is
+     * applied to one of them.
+     */
+    struct solver
+    {
+        rigid_body_system& bodies;
+
+        vec<3> gravity = { 0, -9.81f, 0 };
+        unsigned iterations = 10;
+        float baumgarte = 0.2f;                 /**< fraction of penetration corrected per step */
+        float slop = 0.005f;                    /**< penetration tolerated without correction */
+        bool warm_starting = true;
+        bool sleeping = true;
+        float linear_sleep_tolerance = 0.05f;   /**< speed below which a body is resting */
+        float angular_sleep_tolerance = 0.05f;  /**< rad/s below which a body is resting */
+        float time_to_sleep = 0.5f;
+        bool deterministic = false;             /**< solve contacts in an order independent of the order they were added */
+
+        std::vector<contact> contacts;         /**< contacts for the next step, cleared by `step` */
+        std::vector<ball_joint> joints;
+
+        /**
+         * @brief      If set, sweeps the motion of continuous bodies as they're
+         *             integrated, see `rigid_body_system::dyn_step(dt, sweep)`.
+         */
+        std::function<cd::sweep_hit (rigid_body_system::body b, const vec<3>& from, const vec<3>& displacement)> sweep;
+
+        solver(rigid_body_system& bodies) : bodies(bodies) {}
+
+        /**
+         * @brief      Adds a contact for each point of `m`, found between
+         *             bodies a and b with its normal pointing from a to b.
+         */
+        void add(const cd::manifold& m, int a, int b, float friction=0.5f, float restitution=0)
+        {
+            for (unsigned i = 0; i < m.count; i++)
+            {
+                contact c;
+                c.a = a;
+                c.b = b;
+                c.point = m.points[i].point;
+                c.normal = m.normal;
+                c.depth = m.points[i].depth;
+                c.feature = m.points[i].feature;
+                c.friction = friction;
+                c.restitution = restitution;
+                contacts.push_back(c);
+            }
+        }
+
+        inline bool is_awake(size_t body) const { return body >= awake.size() || awake[body]; }
+
+        void wake(size_t body)
+        {
+            sync();
+            awake[body] = true;
+            sleep_time[body] = 0;
+        }
+
+        /**
+         * @brief      Hash of the bodies' state, along with the sleep timers and
+         * warm starting impulses which influence the next step. Simulations
+         * stepped in lockstep should agree on it after every step, a
+         * mismatch means they have diverged.
+         */
+        uint64_t checksum() const
+        {
+            auto h = bodies.checksum();
+            h = g::utils::hash64(awake.data(), awake.size(), h);
+            h = g::utils::hash64(sleep_time.data(), sleep_time.size() * sizeof(float), h);
+
+            // summed, so that the map's iteration order doesn't matter
+            uint64_t impulses = 0;
+            for (auto& kv : warm) { impulses += g::utils::hash64(kv.second.data(), sizeof(kv.second), kv.first); }
+            h = g::utils::hash64(&impulses, sizeof(impulses), h);
+
+            for (auto& j : joints) { h = g::utils::hash64(&j.impulse, sizeof(j.impulse), h); }
+            return h;
+        }
+
+        /**
+         * @brief      Number of islands solved in the last step.
+         */
+        inline size_t island_count() const { return island_total; }
+
+        /**
+         * @brief      Number of bodies integrated in the last step.
+         */
+        inline size_t awake_count() const { return awake_list.size(); }
+
+        /**
+         * @brief      Advances every awake body by `dt`, applying gravity, the
+         * forces accumulated on each body and the impulses needed to satisfy
+         * `contacts` and `joints`.
+         */
+        void step(float dt)
+        {
+            prepare(dt);
+            for (size_t i = 0; i < island_total; i++) { solve_island(i, dt); }
+            finish(dt);
+        }
+
+        /**
+         * @brief      As `step(dt)`, with islands solved in parallel by `pool`.
+         */
+        template<size_t POOL_SIZE>
+        void step(float dt, g::proc::thread_pool<POOL_SIZE>& pool)
+        {
+            prepare(dt);
+            g::proc::parallel_for(pool, island_total, [&](size_t i) { solve_island(i, dt); });
+            finish(dt);
+        }
+
+    private:
+        struct island
+        {
+            std::vector<size_t> bodies, contacts, joints;
+        };
+
+        /**
+         * @brief      Velocities and world space inverse inertia of a body over
+         *             a step, along with the impulses applied to it.
+         */
+        struct body_state
+        {
+            vec<3> v, w;
+            float inv_m;
+            float inv_I[9];
+            vec<3> x;
+            quat<> q;
+            vec<3> dP, dL; /**< world space linear and angular impulse */
+        };
+
+        struct contact_state
+        {
+            vec<3> r_a, r_b, t[2];
+            float mass_n, mass_t[2];
+            float target;   /**< normal velocity the contact works toward */
+            float lambda_n, lambda_t[2];
+        };
+
+        struct joint_state
+        {
+            vec<3> r_a, r_b, bias;
+            float K_inv[9];
+        };
+
+        std::vector<uint8_t> awake;
+        std::vector<float> sleep_time;
+        std::vector<body_state> state;
+        std::vector<contact_state> contact_states;
+        std::vector<joint_state> joint_states;
+        std::vector<int> parent;
+        std::vector<int> island_of;
+        std::vector<island> islands;
+        size_t island_total = 0;
+        std::vector<size_t> awake_list;
+        std::unordered_map<uint64_t, std::array<float, 3>> warm, warm_next;
+
+        static inline vec<3> rotate(const quat<>& q, const vec<3>& v)
+        {
+            // v + 2w(u x v) + 2u x (u x v), as body::to_global
+            vec<3> u = { q[0], q[1], q[2] };
+            auto c = vec<3>::cross(u, v);
+            return v + (c * q[3] + vec<3>::cross(u, c)) * 2;
+        }
+
+        static inline vec<3> unrotate(const quat<>& q, const vec<3>& v)
+        {
+            return rotate({ -q[0], -q[1], -q[2], q[3] }, v);
+        }
+
+        static inline vec<3> mul(const float m[9], const vec<3>& v)
+        {
+            return {
+                m[0] * v[0] + m[1] * v[1] + m[2] * v[2],
+                m[3] * v[0] + m[4] * v[1] + m[5] * v[2],
+                m[6] * v[0] + m[7] * v[1] + m[8] * v[2],
+            };
+        }
+
+        static void invert(const float m[9], float out[9])
+        {
+            out[0] = m[4] * m[8] - m[5] * m[7];
+            out[1] = m[2] * m[7] - m[1] * m[8];
+            out[2] = m[1] * m[5] - m[2] * m[4];
+            out[3] = m[5] * m[6] - m[3] * m[8];
+            out[4] = m[0] * m[8] - m[2] * m[6];
+            out[5] = m[2] * m[3] - m[0] * m[5];
+            out[6] = m[3] * m[7] - m[4] * m[6];
+            out[7] = m[1] * m[6] - m[0] * m[7];
+            out[8] = m[0] * m[4] - m[1] * m[3];
+
+            auto det = m[0] * out[0] + m[1] * out[3] + m[2] * out[6];
+            auto inv_det = det != 0 ? 1.f / det : 0.f;
+            for (int i = 0; i < 9; i++) { out[i] *= inv_det; }
+        }
+
+        static inline uint64_t warm_key(int a, int b, uint32_t feature)
+        {
+            return ((uint64_t)((a + 1) & 0xfffff) << 44) | ((uint64_t)((b + 1) & 0xfffff) << 24) | (feature & 0xffffff);
+        }
+
+        inline bool dynamic(int b) const { return b != fixed; }
+
+        int find(int i)
+        {
+            while (parent[i] != i)
+            {
+                parent[i] = parent[parent[i]];
+                i = parent[i];
+            }
+            return i;
+        }
+
+        void sync()
+        {
+            if (awake.size() < bodies.size())
+            {
+                awake.resize(bodies.size(), true);
+                sleep_time.resize(bodies.size(), 0);
+                state.resize(bodies.size());
+            }
+        }
+
+        /**
+         * @brief      Wakes bodies as needed, applies forces to the awake ones
+         *             and partitions them into islands.
+         */
+        void prepare(float dt)
+        {
+            sync();
+            auto n = bodies.size();
+
+            if (deterministic)
+            {
+                std::stable_sort(contacts.begin(), contacts.end(), [](const contact& l, const contact& r) {
+                    return warm_key(l.a, l.b, l.feature) < warm_key(r.a, r.b, r.feature);
+                });
+            }
+
+            // forces applied to sleeping bodies wake them
+            for (size_t i = 0; i < n; i++)
+            {
+                if (awake[i]) { continue; }
+
+                float f = 0;
+                for (int c = 0; c < 3; c++) { f += fabsf(bodies.net_f_local[c][i]) + fabsf(bodies.net_t_local[c][i]); }
+                if (f > 0) { wake(i); }
+            }
+
+            // bodies linked by constraints share an island
+            parent.resize(n);
+            for (size_t i = 0; i < n; i++) { parent[i] = i; }
+
+            auto link = [&](int a, int b) {
+                if (!dynamic(a) || !dynamic(b)) { return; }
+                auto ra = find(a), rb = find(b);
+                if (ra != rb) { parent[ra] = rb; }
+            };
+
+            for (auto& c : contacts) { link(c.a, c.b); }
+            for (auto& j : joints) { link(j.a, j.b); }
+
+            // islands with any awake body are awake entirely
+            island_of.assign(n, -1);
+            for (size_t i = 0; i < n; i++)
+            {
+                if (awake[i]) { island_of[find(i)] = 0; }
+            }
+
+            island_total = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                auto r = find(i);
+                if (island_of[r] < 0) { continue; }
+                if (!awake[i]) { awake[i] = true; sleep_time[i] = 0; }
+                if (r == (int)i) { island_of[r] = island_total++; }
+            }
+
+            if (islands.size() < island_total) { islands.resize(island_total); }
+            for (size_t i = 0; i < island_total; i++)
+            {
+                islands[i].bodies.clear();
+                islands[i].contacts.clear();
+                islands[i].joints.clear();
+            }
+
+            auto island_index = [&](int a, int b) { return island_of[find(dynamic(a) ? a : b)]; };
+
+            awake_list.clear();
+            for (size_t i = 0; i < n; i++)
+            {
+                auto k = island_of[find(i)];
+                if (k < 0) { continue; }
+
+                // apply forces
+                quat<> q = { bodies.orientation[0][i], bodies.orientation[1][i], bodies.orientation[2][i], bodies.orientation[3][i] };
+                vec<3> f = { bodies.net_f_local[0][i], bodies.net_f_local[1][i], bodies.net_f_local[2][i] };
+                auto dP = rotate(q, f * dt) + gravity * (bodies.mass[i] * dt);
+                for (int c = 0; c < 3; c++)
+                {
+                    bodies.linear_momentum[c][i] += dP[c];
+                    bodies.angular_momentum[c][i] += bodies.net_t_local[c][i] * dt;
+                    bodies.net_f_local[c][i] = 0;
+                    bodies.net_t_local[c][i] = 0;
+                }
+
+                islands[k].bodies.push_back(i);
+            }
+
+            contact_states.resize(contacts.size());
+            for (size_t ci = 0; ci < contacts.size(); ci++)
+            {
+                auto& c = contacts[ci];
+                if (!dynamic(c.a) && !dynamic(c.b)) { continue; }
+
+                auto k = island_index(c.a, c.b);
+                if (k < 0) { continue; }
+
+                islands[k].contacts.push_back(ci);
+
+                auto& cs = contact_states[ci];
+                cs.lambda_n = cs.lambda_t[0] = cs.lambda_t[1] = 0;
+                if (warm_starting)
+                {
+                    auto itr = warm.find(warm_key(c.a, c.b, c.feature));
+                    if (itr != warm.end())
+                    {
+                        cs.lambda_n = itr->second[0];
+                        cs.lambda_t[0] = itr->second[1];
+                        cs.lambda_t[1] = itr->second[2];
+                    }
+                }
+            }
+
+            joint_states.resize(joints.size());
+            for (size_t ji = 0; ji < joints.size(); ji++)
+            {
+                auto& j = joints[ji];
+                if (!dynamic(j.a) && !dynamic(j.b)) { continue; }
+
+                auto k = island_index(j.a, j.b);
+                if (k >= 0) { islands[k].joints.push_back(ji); }
+                if (!warm_starting) { j.impulse = {}; }
+            }
+        }
+
+        /**
+         * @brief      Integrates the awake bodies, records the impulses for
+         *             warm starting the next step, and clears the contacts.
+         */
+        void finish(float dt)
+        {
+            awake_list.clear();
+            for (size_t i = 0; i < bodies.size(); i++)
+            {
+                if (awake[i]) { awake_list.push_back(i); }
+            }
+
+            if (sweep) { bodies.dyn_step(dt, awake_list, sweep); }
+            else { bodies.dyn_step(dt, awake_list); }
+
+            // contacts of sleeping islands keep their impulses for when they wake
+            auto& next = warm_next;
+            next.clear();
+            for (size_t ci = 0; ci < contacts.size(); ci++)
+            {
+                auto& c = contacts[ci];
+                auto key = warm_key(c.a, c.b, c.feature);
+                auto body = dynamic(c.a) ? c.a : c.b;
+
+                if (body == fixed) { continue; }
+
+                if (awake[body])
+                {
+                    auto& cs = contact_states[ci];
+                    next[key] = { cs.lambda_n, cs.lambda_t[0], cs.lambda_t[1] };
+                }
+                else
+                {
+                    auto itr = warm.find(key);
+                    if (itr != warm.end()) { next[key] = itr->second; }
+                }
+            }
+
+            warm.swap(next);
+            contacts.clear();
+        }
+
+        inline vec<3> velocity_at(const body_state* s, const vec<3>& r) const
+        {
+            return s ? s->v + vec<3>::cross(s->w, r) : vec<3>{};
+        }
+
+        inline void apply(body_state* s, const vec<3>& r, const vec<3>& J)
+        {
+            if (!s) { return; }
+
+            auto L = vec<3>::cross(r, J);
+            s->v += J * s->inv_m;
+            s->w += mul(s->inv_I, L);
+            s->dP += J;
+            s->dL += L;
+        }
+
+        /**
+         * @brief      Velocity change at offset `r` from the body's center due
+         *             to a unit impulse `J` there.
+         */
+        inline vec<3> response(const body_state* s, const vec<3>& r, const vec<3>& J) const
+        {
+            if (!s) { return {}; }
+            return J * s->inv_m + vec<3>::cross(mul(s->inv_I, vec<3>::cross(r, J)), r);
+        }
+
+        void solve_island(size_t k, float dt)
+        {
+            auto& isl = islands[k];
+            auto inv_dt = 1.f / dt;
+
+            // gather the bodies' state
+            for (auto i : isl.bodies)
+            {
+                auto& s = state[i];
+                s.q = { bodies.orientation[0][i], bodies.orientation[1][i], bodies.orientation[2][i], bodies.orientation[3][i] };
+                s.inv_m = bodies.inv_mass[i];
+                for (int c = 0; c < 3; c++)
+                {
+                    s.x[c] = bodies.position[c][i];
+                    s.v[c] = bodies.linear_momentum[c][i] * s.inv_m;
+                }
+
+                // R I^-1 R^T, column by column
+                vec<3> L = { bodies.angular_momentum[0][i], bodies.angular_momentum[1][i], bodies.angular_momentum[2][i] };
+                float I_body[9];
+                for (int c = 0; c < 9; c++) { I_body[c] = bodies.inertia_inv[c][i]; }
+
+                for (int col = 0; col < 3; col++)
+                {
+                    vec<3> e = {};
+                    e[col] = 1;
+                    auto column = rotate(s.q, mul(I_body, unrotate(s.q, e)));
+                    for (int row = 0; row < 3; row++) { s.inv_I[row * 3 + col] = column[row]; }
+                }
+
+                s.w = rotate(s.q, mul(I_body, L));
+                s.dP = s.dL = {};
+            }
+
+            auto body = [&](int i) -> body_state* { return dynamic(i) ? &state[i] : nullptr; };
+
+            // contacts, precomputed and warm started
+            for (auto ci : isl.contacts)
+            {
+                auto& c = contacts[ci];
+                auto& cs = contact_states[ci];
+                auto a = body(c.a), b = body(c.b);
+                auto& n = c.normal;
+
+                cs.r_a = a ? c.point - a->x : vec<3>{};
+                cs.r_b = b ? c.point - b->x : vec<3>{};
+
+                cs.t[0] = fabsf(n[0]) < 0.57735f ? vec<3>::cross(n, { 1, 0, 0 }).unit() : vec<3>::cross(n, { 0, 1, 0 }).unit();
+                cs.t[1] = vec<3>::cross(n, cs.t[0]);
+
+                cs.mass_n = 1.f / (response(a, cs.r_a, n) + response(b, cs.r_b, n)).dot(n);
+                for (int t = 0; t < 2; t++)
+                {
+                    cs.mass_t[t] = 1.f / (response(a, cs.r_a, cs.t[t]) + response(b, cs.r_b, cs.t[t])).dot(cs.t[t]);
+                }
+
+                auto vn = (velocity_at(b, cs.r_b) - velocity_at(a, cs.r_a)).dot(n);
+                cs.target = baumgarte * inv_dt * std::max(c.depth - slop, 0.f);
+                if (vn < -1) { cs.target = std::max(cs.target, -c.restitution * vn); }
+
+                auto J = n * cs.lambda_n + cs.t[0] * cs.lambda_t[0] + cs.t[1] * cs.lambda_t[1];
+                apply(a, cs.r_a, -J);
+                apply(b, cs.r_b, J);
+            }
+
+            // joints, precomputed and warm started
+            for (auto ji : isl.joints)
+            {
+                auto& j = joints[ji];
+                auto& js = joint_states[ji];
+                auto a = body(j.a), b = body(j.b);
+
+                js.r_a = a ? rotate(a->q, j.anchor_a) : vec<3>{};
+                js.r_b = b ? rotate(b->q, j.anchor_b) : vec<3>{};
+                auto p_a = a ? a->x + js.r_a : j.anchor_a;
+                auto p_b = b ? b->x + js.r_b : j.anchor_b;
+                js.bias = (p_b - p_a) * (-baumgarte * inv_dt);
+
+                float K[9];
+                for (int col = 0; col < 3; col++)
+                {
+                    vec<3> e = {};
+                    e[col] = 1;
+                    auto column = response(a, js.r_a, e) + response(b, js.r_b, e);
+                    for (int row = 0; row < 3; row++) { K[row * 3 + col] = column[row]; }
+                }
+                invert(K, js.K_inv);
+
+                apply(a, js.r_a, -j.impulse);
+                apply(b, js.r_b, j.impulse);
+            }
+
+            for (unsigned it = 0; it < iterations; it++)
+            {
+                for (auto ji : isl.joints)
+                {
+                    auto& j = joints[ji];
+                    auto& js = joint_states[ji];
+                    auto a = body(j.a), b = body(j.b);
+
+                    auto dv = velocity_at(b, js.r_b) - velocity_at(a, js.r_a);
+                    auto lambda = mul(js.K_inv, js.bias - dv);
+                    j.impulse += lambda;
+
+                    apply(a, js.r_a, -lambda);
+                    apply(b, js.r_b, lambda);
+                }
+
+                for (auto ci : isl.contacts)
+                {
+                    auto& c = contacts[ci];
+                    auto& cs = contact_states[ci];
+                    auto a = body(c.a), b = body(c.b);
+
+                    // friction, bounded by the normal impulse
+                    for (int t = 0; t < 2; t++)
+                    {
+                        auto dv = velocity_at(b, cs.r_b) - velocity_at(a, cs.r_a);
+                        auto lambda = -cs.mass_t[t] * dv.dot(cs.t[t]);
+                        auto limit = c.friction * cs.lambda_n;
+                        auto acc = std::max(-limit, std::min(cs.lambda_t[t] + lambda, limit));
+                        lambda = acc - cs.lambda_t[t];
+                        cs.lambda_t[t] = acc;
+
+                        apply(a, cs.r_a, cs.t[t] * -lambda);
+                        apply(b, cs.r_b, cs.t[t] * lambda);
+                    }
+
+                    // non-penetration, which can only push
+                    auto dv = velocity_at(b, cs.r_b) - velocity_at(a, cs.r_a);
+                    auto lambda = cs.mass_n * (cs.target - dv.dot(c.normal));
+                    auto acc = std::max(cs.lambda_n + lambda, 0.f);
+                    lambda = acc - cs.lambda_n;
+                    cs.lambda_n = acc;
+
+                    apply(a, cs.r_a, c.normal * -lambda);
+                    apply(b, cs.r_b, c.normal * lambda);
+                }
+            }
+
+            // write back the impulses, and see if the island is resting
+            auto min_sleep_time = std::numeric_limits<float>::infinity();
+            for (auto i : isl.bodies)
+            {
+                auto& s = state[i];
+                auto dL = unrotate(s.q, s.dL);
+                for (int c = 0; c < 3; c++)
+                {
+                    bodies.linear_momentum[c][i] += s.dP[c];
+                    bodies.angular_momentum[c][i] += dL[c];
+                }
+
+                if (s.v.dot(s.v) > linear_sleep_tolerance * linear_sleep_tolerance ||
+                    s.w.dot(s.w) > angular_sleep_tolerance * angular_sleep_tolerance)
+                {
+                    sleep_time[i] = 0;
+                }
+                else
+                {
+                    sleep_time[i] += dt;
+                }
+
+                min_sleep_time = std::min(min_sleep_time, sleep_time[i]);
+            }
+
+            if (sleeping && min_sleep_time >= time_to_sleep)
+            {
+                for (auto i : isl.bodies)
+                {
+                    awake[i] = false;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        bodies.linear_momentum[c][i] = 0;
+                        bodies.angular_momentum[c][i] = 0;
+                        bodies.velocity[c][i] = 0;
+                    }
+                }
+            }
+        }
+    };
 } // end namespace cr
 
 } // end namespace dyn
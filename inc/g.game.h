@@ -1,14 +1,21 @@
 #pragma once
 #define XMTYPE float
 #include "xmath.h"
+#include "g.utils.h"
+#include "g.proc.h"
 #include <string.h>
 #include <stddef.h>
 #include <ogt_vox.h>
 #include <assert.h>
 
 #include <unordered_set>
+#include <type_traits>
+#include <utility>
 #include <unordered_map>
 #include <vector>
+#include <array>
+#include <limits>
+#include <bit>
 #include <iostream>
 
 #define G_TERM_GREEN "\033[0;32m"
@@ -60,27 +67,454 @@ struct pose
  */
 using sdf = std::function<float (const vec<3>&)>;
 
-inline vec<3> normal_from_sdf(sdf f, const vec<3>& p, float step=1)
+/**
+ * Analytic gradient of an sdf, for fields which can compute one more cheaply
+ * or precisely than by sampling the field.
+ */
+using sdf_gradient = std::function<vec<3> (const vec<3>&)>;
+
+/**
+ * Evaluates an sdf at `count` points at once, writing each distance to
+ * `distances`, for fields which can be computed faster in bulk.
+ */
+using sdf_batch = std::function<void (const vec<3>* points, float* distances, size_t count)>;
+
+/**
+ * @brief      Estimates the gradient of `f` at `p` from 4 samples taken at the
+ * vertices of a tetrahedron around `p`, rather than the 6 needed for central
+ * differences.
+ *
+ * @param[in]  f     The sdf.
+ * @param[in]  p     Point to evaluate the gradient at.
+ * @param[in]  step  Distance from `p` along each axis to each sample.
+ *
+ * @return     The gradient, unnormalized.
+ */
+inline vec<3> gradient_from_sdf(const sdf& f, const vec<3>& p, float step=1)
 {
+    const vec<3> k[4] = {
+        { 1, -1, -1 },
+        { -1, -1, 1 },
+        { -1, 1, -1 },
+        { 1, 1, 1 },
+    };
+
     vec<3> grad = {};
-    vec<3> deltas[3][2] = {
-        {{ step, 0, 0 }, { -step, 0, 0 }},
-        {{ 0, step, 0 }, { 0, -step, 0 }},
-        {{ 0, 0, step }, { 0,  0, -step }},
+
+    for (int i = 0; i < 4; i++)
+    {
+        grad += k[i] * f(p + k[i] * step);
+    }
+
+    return grad / (4 * step);
+}
+
+inline vec<3> normal_from_sdf(const sdf& f, const vec<3>& p, float step=1)
+{
+    return gradient_from_sdf(f, p, step).unit();
+}
+
+/**
+ * @brief      Computes the normals of `f` for many points. Each tap of the
+ * estimator is evaluated for every point before moving to the next, so fields
+ * with expensive setup or large lookup tables stay warm in cache.
+ *
+ * @param[in]  f        The sdf.
+ * @param[in]  points   Points to evaluate.
+ * @param      normals  Unit normals for each point, resized to match `points`.
+ * @param[in]  step     Distance from each point along each axis to each sample.
+ */
+inline void normals_from_sdf(const sdf& f, const std::vector<vec<3>>& points, std::vector<vec<3>>& normals, float step=1)
+{
+    const vec<3> k[4] = {
+        { 1, -1, -1 },
+        { -1, -1, 1 },
+        { -1, 1, -1 },
+        { 1, 1, 1 },
     };
 
-    for (int j = 3; j--;)
+    normals.assign(points.size(), {});
+
+    for (int i = 0; i < 4; i++)
     {
-        vec<3> samples[2];
-        samples[0] = p + deltas[j][0];
-        samples[1] = p + deltas[j][1];
-        grad[j] = f(samples[0]) - f(samples[1]);
+        auto offset = k[i] * step;
+
+        for (size_t j = 0; j < points.size(); j++)
+        {
+            normals[j] += k[i] * f(points[j] + offset);
+        }
     }
 
-    return grad.unit();
+    for (auto& n : normals) { n = n.unit(); }
 }
 
-template<typename DAT>
+/**
+ * @brief      Samples of an sdf taken at the corners of a regular grid of cells
+ * spanning a volume. Each corner is evaluated only once and is shared by all of
+ * the cells that touch it. Samples are stored x fastest, z slowest so that
+ * each z-slab of the grid is contiguous.
+ */
+struct sdf_grid
+{
+	vec<3> corners[2];
+	vec<3> cell_size;
+	unsigned divisions = 0; /**< number of cells along each axis */
+	std::vector<float> samples; /**< (divisions + 1)^3 densities */
+
+	/**
+	 * @brief      Prepares the grid to span a new volume. Previously allocated
+	 * storage is kept so that a grid can be reused without reallocating.
+	 *
+	 * @param[in]  volume_corners  Min and max corners of the volume.
+	 * @param[in]  cell_divisions  Number of cells along each axis.
+	 */
+	void resize(const vec<3> volume_corners[2], unsigned cell_divisions)
+	{
+		corners[0] = volume_corners[0];
+		corners[1] = volume_corners[1];
+		divisions = cell_divisions;
+		cell_size = (corners[1] - corners[0]) / (float)divisions;
+
+		auto n = (size_t)divisions + 1;
+		samples.resize(n * n * n);
+	}
+
+	inline size_t idx(unsigned x, unsigned y, unsigned z) const
+	{
+		size_t n = divisions + 1;
+		return x + n * (y + n * z);
+	}
+
+	inline float at(unsigned x, unsigned y, unsigned z) const { return samples[idx(x, y, z)]; }
+
+	inline vec<3> position(unsigned x, unsigned y, unsigned z) const
+	{
+		return corners[0] + cell_size * vec<3>{ (float)x, (float)y, (float)z };
+	}
+
+	/**
+	 * @brief      Evaluates the sdf for every corner whose z index is in [z0, z1).
+	 * Disjoint ranges may be sampled concurrently.
+	 */
+	void sample_slab(const sdf& f, unsigned z0, unsigned z1)
+	{
+		for (unsigned z = z0; z < z1; z++)
+		for (unsigned y = 0; y <= divisions; y++)
+		for (unsigned x = 0; x <= divisions; x++)
+		{
+			samples[idx(x, y, z)] = f(position(x, y, z));
+		}
+	}
+
+	void sample(const sdf& f) { sample_slab(f, 0, divisions + 1); }
+
+	/**
+	 * @brief      Gradient at a grid corner from the neighboring samples, without
+	 * evaluating the sdf. Central differences are used inside the grid, one
+	 * sided differences on its faces.
+	 */
+	vec<3> gradient(unsigned x, unsigned y, unsigned z) const
+	{
+		unsigned i[3] = { x, y, z };
+		vec<3> grad;
+
+		for (int a = 0; a < 3; a++)
+		{
+			unsigned lo[3] = { x, y, z }, hi[3] = { x, y, z };
+			if (i[a] > 0) { lo[a]--; }
+			if (i[a] < divisions) { hi[a]++; }
+
+			grad[a] = (at(hi[0], hi[1], hi[2]) - at(lo[0], lo[1], lo[2])) / (cell_size[a] * (hi[a] - lo[a]));
+		}
+
+		return grad;
+	}
+
+	/**
+	 * @brief      Gradient at any point within the grid, trilinearly interpolated
+	 * from the gradients at the corners of the containing cell.
+	 */
+	vec<3> gradient(const vec<3>& p) const
+	{
+		auto g = (p - corners[0]) / cell_size;
+		unsigned c[3];
+		vec<3> w;
+
+		for (int a = 0; a < 3; a++)
+		{
+			auto f = std::min(std::max(g[a], 0.f), (float)divisions);
+			c[a] = std::min((unsigned)f, divisions - 1);
+			w[a] = f - c[a];
+		}
+
+		vec<3> grad = {};
+
+		for (int i = 0; i < 8; i++)
+		{
+			unsigned o[3] = { (unsigned)(i & 1), (unsigned)((i >> 1) & 1), (unsigned)((i >> 2) & 1) };
+			float weight = 1;
+
+			for (int a = 0; a < 3; a++) { weight *= o[a] ? w[a] : 1 - w[a]; }
+
+			grad += gradient(c[0] + o[0], c[1] + o[1], c[2] + o[2]) * weight;
+		}
+
+		return grad;
+	}
+};
+
+/**
+ * Policies describing the order voxels of a `voxels` volume are stored in.
+ * Each provides `index` mapping a coordinate to its offset in storage and
+ * `each` visiting every coordinate in storage order, so algorithms walking a
+ * volume touch memory sequentially whatever the layout.
+ */
+namespace voxel_layout
+{
+
+/**
+ * @brief      x is the slowest changing axis, z the fastest.
+ */
+struct x_major
+{
+	vec<3, size_t> size;
+
+	void resize(const vec<3, size_t>& s) { size = s; }
+
+	size_t storage_size() const { return size[0] * size[1] * size[2]; }
+
+	inline size_t index(size_t x, size_t y, size_t z) const
+	{
+		return (x * size[1] * size[2]) + (y * size[2]) + z;
+	}
+
+	inline void coord(size_t i, size_t& x, size_t& y, size_t& z) const
+	{
+		z = i % size[2];
+		y = (i / size[2]) % size[1];
+		x = i / (size[1] * size[2]);
+	}
+
+	template<typename FN>
+	void each(FN fn) const
+	{
+		size_t i = 0;
+		for (size_t x = 0; x < size[0]; x++)
+		for (size_t y = 0; y < size[1]; y++)
+		for (size_t z = 0; z < size[2]; z++)
+		{
+			fn(x, y, z, i++);
+		}
+	}
+};
+
+/**
+ * @brief      z is the slowest changing axis, x the fastest. This is the order
+ * of the voxel data in .vox files.
+ */
+struct z_major
+{
+	vec<3, size_t> size;
+
+	void resize(const vec<3, size_t>& s) { size = s; }
+
+	size_t storage_size() const { return size[0] * size[1] * size[2]; }
+
+	inline size_t index(size_t x, size_t y, size_t z) const
+	{
+		return x + (y * size[0]) + (z * size[0] * size[1]);
+	}
+
+	inline void coord(size_t i, size_t& x, size_t& y, size_t& z) const
+	{
+		x = i % size[0];
+		y = (i / size[0]) % size[1];
+		z = i / (size[0] * size[1]);
+	}
+
+	template<typename FN>
+	void each(FN fn) const
+	{
+		size_t i = 0;
+		for (size_t z = 0; z < size[2]; z++)
+		for (size_t y = 0; y < size[1]; y++)
+		for (size_t x = 0; x < size[0]; x++)
+		{
+			fn(x, y, z, i++);
+		}
+	}
+};
+
+/**
+ * @brief      Morton (Z-order) curve. The bits of each coordinate are
+ * interleaved, so voxels near each other along any axis are usually near each
+ * other in memory. Each axis is padded to a power of two, axes with fewer bits
+ * stop contributing once their bits run out.
+ */
+struct morton
+{
+	vec<3, size_t> size;
+	std::vector<size_t> spread[3]; /**< bits of each coordinate moved to their interleaved positions */
+	unsigned bits = 0; /**< total number of bits in an index */
+	uint8_t bit_axis[64]; /**< axis each bit of an index belongs to, used for decoding */
+	uint8_t axis_bit[64]; /**< position of each bit of an index within its axis' coordinate */
+
+	void resize(const vec<3, size_t>& s)
+	{
+		size = s;
+		bits = 0;
+
+		unsigned axis_bits[3] = {};
+		for (int a = 0; a < 3; a++)
+		{
+			while (((size_t)1 << axis_bits[a]) < s[a]) { axis_bits[a]++; }
+			spread[a].assign(s[a], 0);
+		}
+
+		for (unsigned b = 0; b < 21; b++)
+		for (int a = 0; a < 3; a++)
+		{
+			if (b >= axis_bits[a]) { continue; }
+
+			for (size_t c = 0; c < s[a]; c++)
+			{
+				spread[a][c] |= ((c >> b) & 1) << bits;
+			}
+
+			bit_axis[bits] = a;
+			axis_bit[bits++] = b;
+		}
+	}
+
+	size_t storage_size() const
+	{
+		if (size[0] == 0 || size[1] == 0 || size[2] == 0) { return 0; }
+		return (size_t)1 << bits;
+	}
+
+	inline size_t index(size_t x, size_t y, size_t z) const
+	{
+		return spread[0][x] | spread[1][y] | spread[2][z];
+	}
+
+	inline void coord(size_t i, size_t& x, size_t& y, size_t& z) const
+	{
+		size_t c[3] = {}, shift[3] = {};
+
+		for (unsigned b = 0; b < bits; b++)
+		{
+			auto a = bit_axis[b];
+			c[a] |= ((i >> b) & 1) << shift[a]++;
+		}
+
+		x = c[0]; y = c[1]; z = c[2];
+	}
+
+	template<typename FN>
+	void each(FN fn) const
+	{
+		auto count = storage_size();
+		size_t c[3] = {};
+
+		for (size_t i = 0; i < count; i++)
+		{
+			// skip the padding
+			if (c[0] < size[0] && c[1] < size[1] && c[2] < size[2]) { fn(c[0], c[1], c[2], i); }
+
+			if (i + 1 == count) { break; }
+
+			// incrementing clears the trailing ones of i and sets the bit above
+			// them, two bits on average, rather than decoding every index
+			unsigned b = 0;
+			for (; (i >> b) & 1; b++) { c[bit_axis[b]] &= ~((size_t)1 << axis_bit[b]); }
+			c[bit_axis[b]] |= (size_t)1 << axis_bit[b];
+		}
+	}
+};
+
+} // end namespace voxel_layout
+
+/**
+ * @brief      One bit per voxel marking which voxels are non-zero, indexed in
+ * the storage order of the volume. A summary bit is kept for each 64 bit word
+ * of the mask, so each summary word covers a brick of 4096 voxels (16^3
+ * voxels for the morton layout). Scans skip empty bricks and words entirely
+ * and counts are taken with popcount.
+ */
+struct occupancy_mask
+{
+	std::vector<uint64_t> bits; /**< 1 bit per voxel */
+	std::vector<uint64_t> summary; /**< 1 bit per word of `bits`, set if the word is non-zero */
+	bool enabled = false;
+	bool stale = false; /**< voxels may have been written since the mask was last rebuilt */
+
+	/**
+	 * @brief      True if the mask is enabled and matches the voxels.
+	 */
+	inline bool current() const { return enabled && !stale; }
+
+	void resize(size_t voxel_count)
+	{
+		bits.assign((voxel_count + 63) / 64, 0);
+		summary.assign((bits.size() + 63) / 64, 0);
+	}
+
+	inline bool get(size_t i) const { return (bits[i >> 6] >> (i & 63)) & 1; }
+
+	inline void set(size_t i, bool occupied)
+	{
+		auto w = i >> 6;
+		auto mask = 1ull << (i & 63);
+
+		if (occupied) { bits[w] |= mask; }
+		else { bits[w] &= ~mask; }
+
+		auto summary_mask = 1ull << (w & 63);
+		if (bits[w]) { summary[w >> 6] |= summary_mask; }
+		else { summary[w >> 6] &= ~summary_mask; }
+	}
+
+	/**
+	 * @brief      Number of occupied voxels.
+	 */
+	size_t count() const
+	{
+		size_t total = 0;
+
+		for (size_t s = 0; s < summary.size(); s++)
+		{
+			for (auto sw = summary[s]; sw; sw &= sw - 1)
+			{
+				total += std::popcount(bits[(s << 6) + std::countr_zero(sw)]);
+			}
+		}
+
+		return total;
+	}
+
+	/**
+	 * @brief      Calls `fn(i)` with the storage index of each occupied voxel,
+	 * in increasing order.
+	 */
+	template<typename FN>
+	void each(FN fn) const
+	{
+		for (size_t s = 0; s < summary.size(); s++)
+		{
+			for (auto sw = summary[s]; sw; sw &= sw - 1)
+			{
+				auto w = (s << 6) + std::countr_zero(sw);
+
+				for (auto bw = bits[w]; bw; bw &= bw - 1)
+				{
+					fn((w << 6) + std::countr_zero(bw));
+				}
+			}
+		}
+	}
+};
+
+template<typename DAT, typename LAYOUT=voxel_layout::z_major>
 struct voxels
 {
 	struct itr
@@ -151,34 +585,43 @@ struct voxels
 
 	size_t width, height, depth;
 	vec<3, size_t> size;
-	std::vector<DAT> v;
+	LAYOUT layout;
+	std::vector<DAT> v; /**< voxels, in the order defined by `layout` */
+	occupancy_mask occupancy; /**< optional, see `track_occupancy` */
 	vec<3> com;
 
+	static constexpr size_t hash_brick_voxels = 4096;
+	std::vector<uint64_t> brick_hashes; /**< hash of each brick as of the last call to `hash` */
+	std::vector<uint8_t> dirty_bricks; /**< bricks changed since their hash was computed */
+
 	voxels() = default;
 
-	voxels(vec<3, int> s) : size(s.cast<size_t>())
+	voxels(vec<3, int> s)
 	{
-		width = s[0];
-		height = s[1];
-		depth = s[2];
-		v.resize(width * height * depth);
+		resize(s[0], s[1], s[2]);
 	}
 
-	voxels(size_t w, size_t h, size_t d) : size({w, h, d})
+	voxels(size_t w, size_t h, size_t d)
 	{
-		width = w;
-		height = h;
-		depth = d;
-		v.resize(w * h * d);
+		resize(w, h, d);
 	}
 
-	voxels(const DAT* ptr, size_t w, size_t h, size_t d) : size({ w, h, d })
+	/**
+	 * @brief      Copies voxels stored x fastest, z slowest, as they are in .vox files.
+	 */
+	voxels(const DAT* ptr, size_t w, size_t h, size_t d)
 	{
-		width = w;
-		height = h;
-		depth = d;
-		v.resize(w * h * d);
-		memcpy(v.data(), ptr, sizeof(DAT) * w * h * d);
+		resize(w, h, d);
+
+		if (std::is_same<LAYOUT, voxel_layout::z_major>::value)
+		{
+			memcpy(v.data(), ptr, sizeof(DAT) * w * h * d);
+			return;
+		}
+
+		layout.each([&](size_t x, size_t y, size_t z, size_t i) {
+			v[i] = ptr[x + (y * w) + (z * w * h)];
+		});
 	}
 
 	void resize(size_t w, size_t h, size_t d)
@@ -187,106 +630,1123 @@ struct voxels
 		height = h;
 		depth = d;
 		size = vec<3, size_t>{ w, h, d };
-		v.resize(w * h * d);
+		layout.resize(size);
+		v.resize(layout.storage_size());
+		brick_hashes.clear();
+
+		if (occupancy.enabled) { update_occupancy(); }
 	}
 
-	uint32_t hash()
+	/**
+	 * @brief      Enables or disables the occupancy mask. While enabled `count`,
+	 * `center_of_mass` and `find` only visit non-zero voxels. `set` keeps the
+	 * mask current. Every other non-const accessor marks it stale, and it's
+	 * rebuilt by the next non-const query. Const queries scan every voxel
+	 * while it's stale. Writes made to `v` directly must be followed by
+	 * `mark_dirty`, `invalidate_hash` or `update_occupancy`.
+	 */
+	void track_occupancy(bool enable=true)
 	{
-		auto data_len = width * height * depth * sizeof(DAT);
-		uint32_t* data = static_cast<uint32_t*>(v.data());
-		uint32_t h = 0;
-
-	    const uint32_t m = 0x5bd1e995;
-	    while (data_len >= 4)
-	    {
-	        uint32_t k = data[0];
-	        k *= m;
-	        k ^= k >> (signed)24;
-	        k *= m;
-	        h *= m;
-	        h ^= k;
-	        data++;
-	        data_len -= 4;
-	    }
+		occupancy.enabled = enable;
 
-	    return h;
+		if (enable) { update_occupancy(); }
+		else { occupancy.resize(0); }
 	}
 
-	vec<3> center_of_bounds()
+	/**
+	 * @brief      Rebuilds the occupancy mask from the voxels.
+	 */
+	void update_occupancy()
 	{
-		return { (float)width / 2, (float)height / 2, (float)depth / 2};
-	}
+		occupancy.resize(v.size());
+		occupancy.stale = false;
 
-	vec<3>& center_of_mass(bool recompute=false)
-	{
-		if (recompute)
+		for (size_t w = 0; w < occupancy.bits.size(); w++)
 		{
-			com = {0, 0, 0};
-			auto count = 0;
-			for (size_t w = 0; w < width; w++)
-			for (size_t h = 0; h < height; h++)
-			for (size_t d = 0; d < depth; d++)
+			uint64_t word = 0;
+			auto end = std::min<size_t>(64, v.size() - (w << 6));
+
+			for (size_t b = 0; b < end; b++)
 			{
-				auto vox = this->idx2(w, h, d);
-				if (vox)
-				{
-					com += {(float)w + 0.5f, (float)h + 0.5f, (float)d + 0.5f};
-					count += 1;
-				}
+				word |= (uint64_t)(v[(w << 6) + b] != DAT{}) << b;
 			}
 
-			com /= count;
-			//com += vec<3>{0.5f, 0.5f, 0.5};
+			occupancy.bits[w] = word;
+			if (word) { occupancy.summary[w >> 6] |= 1ull << (w & 63); }
 		}
-
-		return com;
 	}
 
-	void find(const DAT& needle, std::function<void(size_t x, size_t y, size_t z)> found_cb)
+	/**
+	 * @brief      Writes a voxel, keeping the occupancy mask and hash current.
+	 */
+	inline void set(size_t x, size_t y, size_t z, const DAT& vox)
 	{
-		for (size_t w = 0; w < width; w++)
-		for (size_t h = 0; h < height; h++)
-		for (size_t d = 0; d < depth; d++)
-		{
-			if (this->idx(w, h, d) == needle)
-			{
-				found_cb(w, h, d);
-			}
-		}
-	}
+		auto i = layout.index(x, y, z);
+		v[i] = vox;
 
-	inline const DAT& idx(size_t x, size_t y, size_t z) const
-	{
-		return v.at((x * height * depth) + (y * depth) + z);
+		if (occupancy.current()) { occupancy.set(i, vox != DAT{}); }
+		mark_brick(i);
 	}
 
-	inline DAT& idx(size_t x, size_t y, size_t z)
+	/**
+	 * @brief      Number of non-zero voxels.
+	 */
+	size_t count()
 	{
-		return v[(x * height * depth) + (y * depth) + z];
+		refresh_occupancy();
+		return std::as_const(*this).count();
 	}
 
-	inline DAT& idx2(size_t x, size_t y, size_t z) const
+	size_t count() const
 	{
-		return v.at(x + (y * width) + (z * width * height));
-	}
+		if (occupancy.current()) { return occupancy.count(); }
 
-	inline DAT& idx2(size_t x, size_t y, size_t z)
-	{
-		return v[x + (y * width) + (z * width * height)];
+		size_t total = 0;
+		for (auto& vox : v) { total += vox != DAT{}; }
+		return total;
 	}
 
-	slice operator[](size_t idx_w)
+	/**
+	 * @brief      64 bit hash of the volume's dimensions and contents. Storage is
+	 * split into bricks of `hash_brick_voxels` voxels, each hashed separately.
+	 * The result is the hash of the brick hashes, so after the first call only
+	 * bricks marked dirty are rehashed. Every non-const accessor marks the
+	 * bricks it exposes dirty, so references must not be held across calls to
+	 * `hash`. Writes made to `v` directly must be followed by `mark_dirty` or
+	 * `invalidate_hash`.
+	 */
+	uint64_t hash()
 	{
-		return { v + (idx_w * height * depth), depth };
-	}
+		auto brick_count = (v.size() + hash_brick_voxels - 1) / hash_brick_voxels;
 
-	inline DAT& operator[](const vec<3, size_t>& idx)
+		if (brick_hashes.size() != brick_count)
+		{
+			brick_hashes.assign(brick_count, 0);
+			dirty_bricks.assign(brick_count, true);
+		}
+
+		for (size_t b = 0; b < brick_count; b++)
+		{
+			if (!dirty_bricks[b]) { continue; }
+
+			auto first = b * hash_brick_voxels;
+			auto count = v.size() - first;
+			if (count > hash_brick_voxels) { count = hash_brick_voxels; }
+			brick_hashes[b] = g::utils::hash64(v.data() + first, count * sizeof(DAT));
+			dirty_bricks[b] = false;
+		}
+
+		uint64_t dims[3] = { width, height, depth };
+		auto seed = g::utils::hash64(dims, sizeof(dims));
+
+		return g::utils::hash64(brick_hashes.data(), brick_hashes.size() * sizeof(uint64_t), seed);
+	}
+
+	/**
+	 * @brief      Marks the brick containing a voxel as changed since the last `hash`.
+	 */
+	inline void mark_dirty(size_t x, size_t y, size_t z) { touch(layout.index(x, y, z)); }
+
+	/**
+	 * @brief      Marks the brick containing storage index `i` as changed since
+	 * the last `hash`.
+	 */
+	inline void mark_brick(size_t i)
+	{
+		auto b = i / hash_brick_voxels;
+		if (b < dirty_bricks.size()) { dirty_bricks[b] = true; }
+	}
+
+	/**
+	 * @brief      Marks storage index `i` as changed, its brick is rehashed by
+	 * the next `hash` and the occupancy mask is rebuilt before it's next used.
+	 */
+	inline void touch(size_t i)
+	{
+		mark_brick(i);
+		occupancy.stale = occupancy.enabled;
+	}
+
+	/**
+	 * @brief      Forces the next `hash` to rehash every brick, and the
+	 * occupancy mask to be rebuilt before it's next used.
+	 */
+	void invalidate_hash()
+	{
+		dirty_bricks.assign(dirty_bricks.size(), true);
+		occupancy.stale = occupancy.enabled;
+	}
+
+	/**
+	 * @brief      Rebuilds the occupancy mask if it's enabled but stale.
+	 */
+	inline void refresh_occupancy()
+	{
+		if (occupancy.enabled && occupancy.stale) { update_occupancy(); }
+	}
+
+	/**
+	 * @brief      Calls `fn(x, y, z, voxel)` for every voxel, in storage order.
+	 * As `fn` may write to any voxel, the whole volume is rehashed by the next
+	 * `hash`, iterate a const volume to avoid it.
+	 */
+	template<typename FN>
+	void each(FN fn)
+	{
+		invalidate_hash();
+		layout.each([&](size_t x, size_t y, size_t z, size_t i) { fn(x, y, z, v[i]); });
+	}
+
+	template<typename FN>
+	void each(FN fn) const
+	{
+		layout.each([&](size_t x, size_t y, size_t z, size_t i) { fn(x, y, z, v[i]); });
+	}
+
+	vec<3> center_of_bounds()
+	{
+		return { (float)width / 2, (float)height / 2, (float)depth / 2};
+	}
+
+	vec<3>& center_of_mass(bool recompute=false)
+	{
+		if (recompute)
+		{
+			com = {0, 0, 0};
+			auto count = 0;
+
+			refresh_occupancy();
+			if (occupancy.enabled)
+			{
+				occupancy.each([&](size_t i) {
+					size_t x, y, z;
+					layout.coord(i, x, y, z);
+					com += {(float)x + 0.5f, (float)y + 0.5f, (float)z + 0.5f};
+					count += 1;
+				});
+			}
+			else
+			{
+				std::as_const(*this).each([&](size_t x, size_t y, size_t z, const DAT& vox) {
+					if (vox)
+					{
+						com += {(float)x + 0.5f, (float)y + 0.5f, (float)z + 0.5f};
+						count += 1;
+					}
+				});
+			}
+
+			com /= count;
+			//com += vec<3>{0.5f, 0.5f, 0.5};
+		}
+
+		return com;
+	}
+
+	void find(const DAT& needle, std::function<void(size_t x, size_t y, size_t z)> found_cb)
+	{
+		refresh_occupancy();
+
+		if (occupancy.enabled && needle != DAT{})
+		{ // only occupied voxels can match
+			occupancy.each([&](size_t i) {
+				if (v[i] == needle)
+				{
+					size_t x, y, z;
+					layout.coord(i, x, y, z);
+					found_cb(x, y, z);
+				}
+			});
+
+			return;
+		}
+
+		std::as_const(*this).each([&](size_t x, size_t y, size_t z, const DAT& vox) {
+			if (vox == needle)
+			{
+				found_cb(x, y, z);
+			}
+		});
+	}
+
+	inline const DAT& idx(size_t x, size_t y, size_t z) const
+	{
+		return v.at(layout.index(x, y, z));
+	}
+
+	inline DAT& idx(size_t x, size_t y, size_t z)
+	{
+		auto i = layout.index(x, y, z);
+		touch(i);
+		return v[i];
+	}
+
+	/**
+	 * @brief      Same as `idx`. Previously `idx` and `idx2` assumed different
+	 * orders, both now address voxels through `layout`.
+	 */
+	inline const DAT& idx2(size_t x, size_t y, size_t z) const
+	{
+		return idx(x, y, z);
+	}
+
+	inline DAT& idx2(size_t x, size_t y, size_t z)
+	{
+		return idx(x, y, z);
+	}
+
+	slice operator[](size_t idx_w)
+	{
+		invalidate_hash();
+		return { v + (idx_w * height * depth), depth };
+	}
+
+	inline DAT& operator[](const vec<3, size_t>& idx)
+	{
+		return idx2(idx[0], idx[1], idx[2]);
+	}
+
+	itr begin() { invalidate_hash(); return itr(v, width, height, depth, false); }
+	itr end() { return itr(v, width, height, depth, true); }
+};
+
+/**
+ * @brief      Voxel volume which only allocates storage for the regions which
+ * contain non-zero voxels. The volume is divided into cubic bricks of
+ * `BRICK_SIZE` voxels per side, a dense top level index maps each brick to its
+ * storage or marks it empty. Empty bricks read as zero and are skipped by
+ * iteration, queries and meshing. Voxels within a brick are stored x fastest,
+ * z slowest, matching `voxels::idx2`.
+ */
+template<typename DAT, size_t BRICK_SIZE=8>
+struct sparse_voxels
+{
+	static constexpr size_t brick_volume = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+	static constexpr uint32_t empty_brick = 0xffffffff;
+
+	size_t width = 0, height = 0, depth = 0;
+	vec<3, size_t> size;
+	vec<3, size_t> bricks_size; /**< number of bricks along each axis */
+	std::vector<uint32_t> brick_index; /**< top level index, offset of each brick in `bricks` or `empty_brick` */
+	std::vector<DAT> bricks; /**< storage for all allocated bricks, `brick_volume` voxels each */
+	std::vector<vec<3, size_t>> brick_origins; /**< voxel coordinate of the min corner of each allocated brick */
+	vec<3> com;
+
+	sparse_voxels() = default;
+
+	sparse_voxels(vec<3, int> s) { resize(s[0], s[1], s[2]); }
+
+	sparse_voxels(size_t w, size_t h, size_t d) { resize(w, h, d); }
+
+	/**
+	 * @brief      Copies the non-zero voxels of a dense volume.
+	 */
+	template<typename LAYOUT>
+	sparse_voxels(const voxels<DAT, LAYOUT>& dense)
+	{
+		resize(dense.width, dense.height, dense.depth);
+
+		dense.each([&](size_t x, size_t y, size_t z, const DAT& v) {
+			if (v != DAT{}) { idx(x, y, z) = v; }
+		});
+	}
+
+	/**
+	 * @brief      Clears the volume and sets new dimensions.
+	 */
+	void resize(size_t w, size_t h, size_t d)
+	{
+		width = w;
+		height = h;
+		depth = d;
+		size = vec<3, size_t>{ w, h, d };
+		bricks_size = vec<3, size_t>{
+			(w + BRICK_SIZE - 1) / BRICK_SIZE,
+			(h + BRICK_SIZE - 1) / BRICK_SIZE,
+			(d + BRICK_SIZE - 1) / BRICK_SIZE,
+		};
+
+		brick_index.assign(bricks_size[0] * bricks_size[1] * bricks_size[2], empty_brick);
+		bricks.clear();
+		brick_origins.clear();
+	}
+
+	inline size_t brick_of(size_t x, size_t y, size_t z) const
+	{
+		return (x / BRICK_SIZE) + bricks_size[0] * ((y / BRICK_SIZE) + bricks_size[1] * (z / BRICK_SIZE));
+	}
+
+	static inline size_t offset_in_brick(size_t x, size_t y, size_t z)
+	{
+		return (x % BRICK_SIZE) + BRICK_SIZE * ((y % BRICK_SIZE) + BRICK_SIZE * (z % BRICK_SIZE));
+	}
+
+	/**
+	 * @brief      Number of bricks with storage allocated.
+	 */
+	size_t brick_count() const { return brick_origins.size(); }
+
+	/**
+	 * @brief      Bytes used for voxel storage and the brick index.
+	 */
+	size_t memory_usage() const
+	{
+		return bricks.size() * sizeof(DAT) + brick_index.size() * sizeof(uint32_t) + brick_origins.size() * sizeof(vec<3, size_t>);
+	}
+
+	/**
+	 * @brief      Reads a voxel. Voxels in empty bricks read as zero.
+	 */
+	inline const DAT& idx(size_t x, size_t y, size_t z) const
+	{
+		static const DAT zero = {};
+		assert(x < width && y < height && z < depth);
+
+		auto b = brick_index[brick_of(x, y, z)];
+		if (b == empty_brick) { return zero; }
+
+		return bricks[b * brick_volume + offset_in_brick(x, y, z)];
+	}
+
+	/**
+	 * @brief      Writable reference to a voxel, allocating its brick if needed.
+	 * Use `set` when writing zeros to avoid allocating empty bricks.
+	 */
+	inline DAT& idx(size_t x, size_t y, size_t z)
+	{
+		assert(x < width && y < height && z < depth);
+
+		auto& b = brick_index[brick_of(x, y, z)];
+		if (b == empty_brick)
+		{
+			b = brick_origins.size();
+			bricks.resize(bricks.size() + brick_volume);
+			brick_origins.push_back(vec<3, size_t>{
+				(x / BRICK_SIZE) * BRICK_SIZE,
+				(y / BRICK_SIZE) * BRICK_SIZE,
+				(z / BRICK_SIZE) * BRICK_SIZE,
+			});
+		}
+
+		return bricks[b * brick_volume + offset_in_brick(x, y, z)];
+	}
+
+	inline const DAT& idx2(size_t x, size_t y, size_t z) const { return idx(x, y, z); }
+
+	inline DAT& idx2(size_t x, size_t y, size_t z) { return idx(x, y, z); }
+
+	inline DAT& operator[](const vec<3, size_t>& i) { return idx(i[0], i[1], i[2]); }
+
+	inline const DAT& operator[](const vec<3, size_t>& i) const { return idx(i[0], i[1], i[2]); }
+
+	void set(size_t x, size_t y, size_t z, const DAT& v)
+	{
+		if (v == DAT{} && brick_index[brick_of(x, y, z)] == empty_brick) { return; }
+		idx(x, y, z) = v;
+	}
+
+	/**
+	 * @brief      Calls `cb` for each allocated brick with the coordinate of its
+	 * min corner and its `brick_volume` voxels.
+	 */
+	void each_brick(std::function<void(const vec<3, size_t>& origin, DAT* brick)> cb)
+	{
+		for (size_t b = 0; b < brick_origins.size(); b++)
+		{
+			cb(brick_origins[b], bricks.data() + b * brick_volume);
+		}
+	}
+
+	/**
+	 * @brief      Calls `cb` for every voxel within the volume of an allocated brick.
+	 * Voxels in empty bricks are skipped.
+	 */
+	void each(std::function<void(size_t x, size_t y, size_t z, DAT& v)> cb)
+	{
+		each_brick([&](const vec<3, size_t>& o, DAT* brick) {
+			auto end = (o + BRICK_SIZE).take_min(size);
+
+			for (size_t z = o[2]; z < end[2]; z++)
+			for (size_t y = o[1]; y < end[1]; y++)
+			for (size_t x = o[0]; x < end[0]; x++)
+			{
+				cb(x, y, z, brick[offset_in_brick(x, y, z)]);
+			}
+		});
+	}
+
+	vec<3> center_of_bounds()
+	{
+		return { (float)width / 2, (float)height / 2, (float)depth / 2};
+	}
+
+	vec<3>& center_of_mass(bool recompute=false)
+	{
+		if (recompute)
+		{
+			com = {0, 0, 0};
+			auto count = 0;
+
+			each([&](size_t x, size_t y, size_t z, DAT& v) {
+				if (v)
+				{
+					com += {(float)x + 0.5f, (float)y + 0.5f, (float)z + 0.5f};
+					count += 1;
+				}
+			});
+
+			com /= count;
+		}
+
+		return com;
+	}
+
+	void find(const DAT& needle, std::function<void(size_t x, size_t y, size_t z)> found_cb)
+	{
+		if (needle == DAT{})
+		{ // zeros may be anywhere, every voxel of an empty brick is one
+			for (size_t z = 0; z < depth; z++)
+			for (size_t y = 0; y < height; y++)
+			for (size_t x = 0; x < width; x++)
+			{
+				auto b = brick_index[brick_of(x, y, z)];
+				if (b == empty_brick || bricks[b * brick_volume + offset_in_brick(x, y, z)] == needle) { found_cb(x, y, z); }
+			}
+
+			return;
+		}
+
+		each([&](size_t x, size_t y, size_t z, DAT& v) {
+			if (v == needle) { found_cb(x, y, z); }
+		});
+	}
+
+	/**
+	 * @brief      Copies the volume into a dense voxel volume.
+	 */
+	template<typename LAYOUT=voxel_layout::z_major>
+	voxels<DAT, LAYOUT> dense()
+	{
+		voxels<DAT, LAYOUT> out(width, height, depth);
+
+		each([&](size_t x, size_t y, size_t z, DAT& v) {
+			out.idx(x, y, z) = v;
+		});
+
+		return out;
+	}
+};
+
+/**
+ * @brief      Signed Euclidean distance to the surface of a voxel volume,
+ * computed with the separable exact transform of Felzenszwalb and
+ * Huttenlocher. Distances are stored at voxel centers, with a one voxel
+ * border of empty space around the volume, and are negative inside solid
+ * voxels. The surface lies halfway between solid and empty voxel centers.
+ */
+struct distance_field
+{
+	vec<3, size_t> size;          /**< samples along each axis, the volume plus its border */
+	std::vector<float> distances; /**< signed distances in world units, x fastest */
+	vec<3> position = {};         /**< world position of the min corner of voxel (0, 0, 0) */
+	float scale = 1;              /**< world size of a voxel */
+
+	distance_field() = default;
+
+	template<typename VOXELS>
+	distance_field(const VOXELS& vox, const vec<3>& position={}, float scale=1) : position(position), scale(scale)
+	{
+		build(vox);
+	}
+
+	template<typename VOXELS, size_t POOL_SIZE>
+	distance_field(const VOXELS& vox, g::proc::thread_pool<POOL_SIZE>& pool, const vec<3>& position={}, float scale=1) : position(position), scale(scale)
+	{
+		build(vox, pool);
+	}
+
+	/**
+	 * @brief      Computes distances for any volume providing `size` and a const
+	 * `idx(x, y, z)` where a default constructed value is empty.
+	 */
+	template<typename VOXELS>
+	void build(const VOXELS& vox)
+	{
+		build(vox, [](size_t count, const std::function<void(size_t)>& fn) {
+			for (size_t i = 0; i < count; i++) { fn(i); }
+		});
+	}
+
+	/**
+	 * @brief      Same as `build(vox)`, the lines of each pass are transformed
+	 * concurrently on the workers of `pool`.
+	 */
+	template<typename VOXELS, size_t POOL_SIZE>
+	void build(const VOXELS& vox, g::proc::thread_pool<POOL_SIZE>& pool)
+	{
+		build(vox, [&](size_t count, const std::function<void(size_t)>& fn) {
+			g::proc::parallel_for(pool, count, fn);
+		});
+	}
+
+	inline size_t idx(size_t x, size_t y, size_t z) const { return x + size[0] * (y + size[1] * z); }
+
+	/**
+	 * @brief      Distance at the center of voxel (x, y, z) of the padded grid,
+	 * which is voxel (x - 1, y - 1, z - 1) of the volume.
+	 */
+	inline float at(size_t x, size_t y, size_t z) const { return distances[idx(x, y, z)]; }
+
+	/**
+	 * @brief      Trilinearly interpolated distance at the world position `p`.
+	 * Beyond the grid a lower bound is returned, so the field remains safe to
+	 * sphere trace.
+	 */
+	float sample(const vec<3>& p) const
+	{
+		auto u = (p - position) / scale + 0.5f; // sample i sits at u = i
+		size_t c[3];
+		vec<3> w, clamped;
+
+		for (int a = 0; a < 3; a++)
+		{
+			clamped[a] = std::min(std::max(u[a], 0.f), (float)(size[a] - 1));
+			c[a] = std::min((size_t)clamped[a], size[a] - 2);
+			w[a] = clamped[a] - c[a];
+		}
+
+		float d = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			size_t o[3] = { (size_t)(i & 1), (size_t)((i >> 1) & 1), (size_t)((i >> 2) & 1) };
+			float weight = 1;
+
+			for (int a = 0; a < 3; a++) { weight *= o[a] ? w[a] : 1 - w[a]; }
+
+			d += at(c[0] + o[0], c[1] + o[1], c[2] + o[2]) * weight;
+		}
+
+		auto outside = (u - clamped) * scale;
+		auto outside_sq = outside.dot(outside);
+
+		if (outside_sq > 0)
+		{ // everything solid is inside the grid, and no nearer than d to its boundary
+			d = sqrtf(outside_sq + std::max(d, 0.f) * std::max(d, 0.f));
+		}
+
+		return d;
+	}
+
+	/**
+	 * @brief      Gradient of the field at `p` by central differences across
+	 * half a voxel.
+	 */
+	vec<3> gradient(const vec<3>& p) const
+	{
+		auto h = scale * 0.5f;
+		vec<3> grad;
+
+		for (int a = 0; a < 3; a++)
+		{
+			vec<3> dp = {};
+			dp[a] = h;
+			grad[a] = (sample(p + dp) - sample(p - dp)) / (2 * h);
+		}
+
+		return grad;
+	}
+
+	/**
+	 * @brief      The field as an `sdf`. It refers to this object, which must
+	 * outlive it.
+	 */
+	sdf to_sdf() const { return [this](const vec<3>& p) -> float { return sample(p); }; }
+
+	sdf_gradient to_gradient() const { return [this](const vec<3>& p) -> vec<3> { return gradient(p); }; }
+
+private:
+	/**
+	 * @brief      Squared distance transform of a single line of `n` samples,
+	 * `f` holds 0 for features and a large value elsewhere. `v` and `z` are
+	 * scratch space of at least `n` and `n + 1` elements.
+	 */
+	static void transform_line(const float* f, float* d, size_t n, int* v, float* z)
+	{
+		constexpr auto inf = std::numeric_limits<float>::infinity();
+		int k = 0;
+		v[0] = 0;
+		z[0] = -inf;
+		z[1] = inf;
+
+		// lower envelope of the parabolas rooted at each sample
+		for (int q = 1; q < (int)n; q++)
+		{
+			float s;
+			while (true)
+			{
+				auto r = v[k];
+				s = ((f[q] + q * q) - (f[r] + r * r)) / (2 * q - 2 * r);
+				if (s > z[k] || k == 0) { break; }
+				k--;
+			}
+
+			k++;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = inf;
+		}
+
+		k = 0;
+		for (int q = 0; q < (int)n; q++)
+		{
+			while (z[k + 1] < q) { k++; }
+			auto r = v[k];
+			d[q] = (q - r) * (q - r) + f[r];
+		}
+	}
+
+	template<typename VOXELS>
+	void build(const VOXELS& vox, const std::function<void(size_t count, const std::function<void(size_t)>& fn)>& for_each)
+	{
+		constexpr float far = 1e20f;
+		size = vox.size + 2;
+		auto n = size[0] * size[1] * size[2];
+
+		// squared distances to the nearest solid, and nearest empty voxel
+		std::vector<float> to_solid(n), to_empty(n);
+
+		for_each(size[2], [&](size_t z) {
+			for (size_t y = 0; y < size[1]; y++)
+			for (size_t x = 0; x < size[0]; x++)
+			{
+				bool solid = x > 0 && y > 0 && z > 0 &&
+				             x <= vox.size[0] && y <= vox.size[1] && z <= vox.size[2] &&
+				             vox.idx(x - 1, y - 1, z - 1) != std::decay_t<decltype(vox.idx(0, 0, 0))>{};
+				to_solid[idx(x, y, z)] = solid ? 0 : far;
+				to_empty[idx(x, y, z)] = solid ? far : 0;
+			}
+		});
+
+		// one pass per axis, each line along the axis is independent
+		for (int axis = 0; axis < 3; axis++)
+		{
+			size_t stride[3] = { 1, size[0], size[0] * size[1] };
+			int u = (axis + 1) % 3, w = (axis + 2) % 3;
+			auto len = size[axis];
+
+			for_each(size[w], [&](size_t j) {
+				static thread_local std::vector<float> f, d, z;
+				static thread_local std::vector<int> v;
+				f.resize(len); d.resize(len); z.resize(len + 1); v.resize(len);
+
+				for (size_t i = 0; i < size[u]; i++)
+				{
+					auto base = i * stride[u] + j * stride[w];
+
+					for (auto grid : { &to_solid, &to_empty })
+					{
+						auto& g = *grid;
+						for (size_t q = 0; q < len; q++) { f[q] = g[base + q * stride[axis]]; }
+						transform_line(f.data(), d.data(), len, v.data(), z.data());
+						for (size_t q = 0; q < len; q++) { g[base + q * stride[axis]] = d[q]; }
+					}
+				}
+			});
+		}
+
+		distances.resize(n);
+		for_each(size[2], [&](size_t z) {
+			for (size_t i = z * size[0] * size[1]; i < (z + 1) * size[0] * size[1]; i++)
+			{
+				distances[i] = to_empty[i] > 0 ? -(sqrtf(to_empty[i]) - 0.5f) * scale : (sqrtf(to_solid[i]) - 0.5f) * scale;
+			}
+		});
+	}
+};
+
+/**
+ * @brief      Bounding volume hierarchy over a set of axis aligned boxes, each
+ * identified by its index in the list the tree was built from. Supports ray,
+ * box and frustum queries, and refitting in place when items move.
+ */
+struct bvh
+{
+	using bounds = std::array<vec<3>, 2>; /**< min and max corners */
+
+	struct node
 	{
-		return idx2(idx[0], idx[1], idx[2]);
+		vec<3> box[2];
+		int left = -1, right = -1; /**< children, both -1 for leaves */
+		int parent = -1;
+		unsigned first = 0, count = 0; /**< range of `items` held by a leaf */
+
+		inline bool is_leaf() const { return left < 0; }
+	};
+
+	std::vector<bvh::node> nodes; /**< root first */
+	std::vector<size_t> items;    /**< item indices, those of each leaf are contiguous */
+	std::vector<int> leaf_of;     /**< leaf node holding each item */
+	std::vector<bounds> boxes;    /**< current bounds of each item */
+	unsigned leaf_size = 4;       /**< max items per leaf */
+
+	/**
+	 * @brief      Builds the tree over `item_boxes`. With `sah` set, splits are
+	 * chosen by the surface area heuristic which gives faster queries at a
+	 * higher build cost, suited to static sets. Otherwise items are split at the
+	 * median along the longest axis.
+	 */
+	void build(const std::vector<bounds>& item_boxes, bool sah=true)
+	{
+		boxes = item_boxes;
+		items.resize(boxes.size());
+		leaf_of.assign(boxes.size(), -1);
+		nodes.clear();
+
+		for (size_t i = 0; i < items.size(); i++) { items[i] = i; }
+		if (items.empty()) { return; }
+
+		nodes.reserve(2 * items.size());
+		build_node(0, items.size(), -1, sah);
 	}
 
-	itr begin() { return itr(v, width, height, depth, false); }
-	itr end() { return itr(v, width, height, depth, true); }
+	inline bool empty() const { return nodes.empty(); }
+
+	/**
+	 * @brief      Updates the bounds of every node after `boxes` has been
+	 * modified. The tree's structure is kept, so refitting is cheap but queries
+	 * degrade if items move far from where they were when it was built.
+	 */
+	void refit()
+	{
+		// children are always created after their parent
+		for (size_t n = nodes.size(); n--;) { fit(nodes[n]); }
+	}
+
+	/**
+	 * @brief      Moves a single item and refits only its ancestors.
+	 */
+	void refit(size_t item, const bounds& box)
+	{
+		boxes[item] = box;
+
+		for (int n = leaf_of[item]; n >= 0; n = nodes[n].parent) { fit(nodes[n]); }
+	}
+
+	/**
+	 * @brief      Calls `fn(item)` for every item whose bounds overlap `box`.
+	 */
+	template<typename FN>
+	void query(const vec<3> box[2], FN fn) const
+	{
+		traverse([&](const vec<3> b[2]) { return overlaps(b, box); }, fn);
+	}
+
+	/**
+	 * @brief      Calls `fn(item)` for every item whose bounds may be inside the
+	 * frustum described by the view projection matrix `vp`.
+	 */
+	template<typename FN>
+	void query(const mat<4, 4>& vp, FN fn) const
+	{
+		traverse([&](const vec<3> b[2]) { return in_frustum(vp, b); }, fn);
+	}
+
+	/**
+	 * @brief      Calls `fn(item, t)` for every item whose bounds the ray
+	 * `origin + direction * t` enters for some t in [0, max_t], where `t` is
+	 * where the ray enters them. Nearer children are visited first.
+	 */
+	template<typename FN>
+	void raycast(const vec<3>& origin, const vec<3>& direction, FN fn, float max_t=std::numeric_limits<float>::infinity()) const
+	{
+		if (nodes.empty()) { return; }
+
+		vec<3> inv_d;
+		for (int a = 0; a < 3; a++) { inv_d[a] = 1.f / direction[a]; }
+
+		int stack[64];
+		int top = 0;
+
+		if (ray_box(origin, inv_d, nodes[0].box, max_t) <= max_t) { stack[top++] = 0; }
+
+		while (top > 0)
+		{
+			auto& n = nodes[stack[--top]];
+
+			if (n.is_leaf())
+			{
+				for (unsigned i = n.first; i < n.first + n.count; i++)
+				{
+					vec<3> b[2] = { boxes[items[i]][0], boxes[items[i]][1] };
+					auto t = ray_box(origin, inv_d, b, max_t);
+					if (t <= max_t) { fn(items[i], t); }
+				}
+
+				continue;
+			}
+
+			auto t_l = ray_box(origin, inv_d, nodes[n.left].box, max_t);
+			auto t_r = ray_box(origin, inv_d, nodes[n.right].box, max_t);
+
+			// push the farther child first so the nearer one is visited next
+			if (t_l <= t_r)
+			{
+				if (t_r <= max_t) { stack[top++] = n.right; }
+				if (t_l <= max_t) { stack[top++] = n.left; }
+			}
+			else
+			{
+				if (t_l <= max_t) { stack[top++] = n.left; }
+				if (t_r <= max_t) { stack[top++] = n.right; }
+			}
+		}
+	}
+
+	static inline bool overlaps(const vec<3> a[2], const vec<3> b[2])
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			if (a[1][i] < b[0][i] || b[1][i] < a[0][i]) { return false; }
+		}
+
+		return true;
+	}
+
+	/**
+	 * @brief      Parameter where a ray with reciprocal direction `inv_d` enters
+	 * `box`, clamped to 0 if it starts inside. Infinity if it misses or would
+	 * enter beyond `max_t`.
+	 */
+	static inline float ray_box(const vec<3>& origin, const vec<3>& inv_d, const vec<3> box[2], float max_t)
+	{
+		float t_enter = 0, t_exit = max_t;
+
+		for (int a = 0; a < 3; a++)
+		{
+			auto t0 = (box[0][a] - origin[a]) * inv_d[a];
+			auto t1 = (box[1][a] - origin[a]) * inv_d[a];
+			if (t0 > t1) { std::swap(t0, t1); }
+
+			// NaN arises when the ray lies in a slab's plane, treat that as inside
+			if (t0 > t_enter) { t_enter = t0; }
+			if (t1 < t_exit) { t_exit = t1; }
+		}
+
+		return t_enter <= t_exit ? t_enter : std::numeric_limits<float>::infinity();
+	}
+
+	/**
+	 * @brief      True if any part of `box` may be inside the frustum described by
+	 * the view projection matrix `vp`.
+	 */
+	static bool in_frustum(const mat<4, 4>& vp, const vec<3> box[2])
+	{
+		int outside[6] = {};
+
+		for (int i = 0; i < 8; i++)
+		{
+			vec<4> p = { box[i & 1][0], box[(i >> 1) & 1][1], box[(i >> 2) & 1][2], 1 };
+			vec<4> c = vp * p;
+
+			for (int a = 0; a < 3; a++)
+			{
+				outside[a * 2 + 0] += c[a] < -c[3];
+				outside[a * 2 + 1] += c[a] > c[3];
+			}
+		}
+
+		for (int i = 0; i < 6; i++)
+		{
+			if (outside[i] == 8) { return false; }
+		}
+
+		return true;
+	}
+
+private:
+	static inline float area(const vec<3> box[2])
+	{
+		auto d = box[1] - box[0];
+		return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+	}
+
+	static inline void grow(vec<3> box[2], const vec<3> other[2])
+	{
+		box[0] = box[0].take_min(other[0]);
+		box[1] = box[1].take_max(other[1]);
+	}
+
+	void fit(bvh::node& n)
+	{
+		if (n.is_leaf())
+		{
+			n.box[0] = boxes[items[n.first]][0];
+			n.box[1] = boxes[items[n.first]][1];
+
+			for (unsigned i = n.first + 1; i < n.first + n.count; i++)
+			{
+				vec<3> b[2] = { boxes[items[i]][0], boxes[items[i]][1] };
+				grow(n.box, b);
+			}
+		}
+		else
+		{
+			n.box[0] = nodes[n.left].box[0];
+			n.box[1] = nodes[n.left].box[1];
+			grow(n.box, nodes[n.right].box);
+		}
+	}
+
+	template<typename PRED, typename FN>
+	void traverse(PRED test, FN fn) const
+	{
+		if (nodes.empty()) { return; }
+
+		int stack[64];
+		int top = 0;
+		stack[top++] = 0;
+
+		while (top > 0)
+		{
+			auto& n = nodes[stack[--top]];
+
+			if (!test(n.box)) { continue; }
+
+			if (n.is_leaf())
+			{
+				for (unsigned i = n.first; i < n.first + n.count; i++)
+				{
+					vec<3> b[2] = { boxes[items[i]][0], boxes[items[i]][1] };
+					if (test(b)) { fn(items[i]); }
+				}
+			}
+			else
+			{
+				stack[top++] = n.left;
+				stack[top++] = n.right;
+			}
+		}
+	}
+
+	int build_node(size_t first, size_t last, int parent, bool sah, unsigned depth=0)
+	{
+		// past this depth splits fall back to the median so the tree's depth,
+		// and the stacks used to traverse it, stay bounded
+		constexpr unsigned max_sah_depth = 32;
+
+		int idx = nodes.size();
+		nodes.push_back({});
+		nodes[idx].parent = parent;
+		nodes[idx].first = first;
+		nodes[idx].count = last - first;
+		fit(nodes[idx]);
+
+		auto count = last - first;
+		if (count <= leaf_size)
+		{
+			for (size_t i = first; i < last; i++) { leaf_of[items[i]] = idx; }
+			return idx;
+		}
+
+		auto centroid = [&](size_t item) { return (boxes[item][0] + boxes[item][1]) * 0.5f; };
+
+		// split along the axis the centroids are spread furthest
+		vec<3> c_box[2] = { centroid(items[first]), centroid(items[first]) };
+		for (size_t i = first + 1; i < last; i++)
+		{
+			auto c = centroid(items[i]);
+			c_box[0] = c_box[0].take_min(c);
+			c_box[1] = c_box[1].take_max(c);
+		}
+
+		auto extent = c_box[1] - c_box[0];
+		int axis = extent[0] > extent[1] ? (extent[0] > extent[2] ? 0 : 2) : (extent[1] > extent[2] ? 1 : 2);
+		size_t mid = first + count / 2;
+
+		if (sah && depth < max_sah_depth && extent[axis] > 0)
+		{ // binned surface area heuristic
+			constexpr int bin_count = 12;
+			struct bin { vec<3> box[2]; size_t count = 0; } bins[bin_count];
+			auto bin_of = [&](size_t item) {
+				auto b = (int)(bin_count * (centroid(item)[axis] - c_box[0][axis]) / extent[axis]);
+				return std::min(b, bin_count - 1);
+			};
+
+			for (size_t i = first; i < last; i++)
+			{
+				auto& b = bins[bin_of(items[i])];
+				vec<3> box[2] = { boxes[items[i]][0], boxes[items[i]][1] };
+				if (b.count++ == 0) { b.box[0] = box[0]; b.box[1] = box[1]; }
+				else { grow(b.box, box); }
+			}
+
+			// cost of splitting after each bin, sweeping from both ends
+			float right_cost[bin_count] = {};
+			{
+				vec<3> box[2];
+				size_t n = 0;
+				for (int i = bin_count - 1; i > 0; i--)
+				{
+					if (bins[i].count > 0)
+					{
+						if (n == 0) { box[0] = bins[i].box[0]; box[1] = bins[i].box[1]; }
+						else { grow(box, bins[i].box); }
+						n += bins[i].count;
+					}
+					right_cost[i - 1] = n > 0 ? area(box) * n : 0;
+				}
+			}
+
+			int best = -1;
+			float best_cost = area(nodes[idx].box) * count; // cost of not splitting
+			{
+				vec<3> box[2];
+				size_t n = 0;
+				for (int i = 0; i < bin_count - 1; i++)
+				{
+					if (bins[i].count > 0)
+					{
+						if (n == 0) { box[0] = bins[i].box[0]; box[1] = bins[i].box[1]; }
+						else { grow(box, bins[i].box); }
+						n += bins[i].count;
+					}
+
+					if (n == 0 || n == count) { continue; }
+
+					auto cost = area(box) * n + right_cost[i];
+					if (cost < best_cost) { best_cost = cost; best = i; }
+				}
+			}
+
+			if (best >= 0)
+			{
+				auto split = std::partition(items.begin() + first, items.begin() + last, [&](size_t item) {
+					return bin_of(item) <= best;
+				});
+				mid = split - items.begin();
+			}
+			else
+			{
+				std::nth_element(items.begin() + first, items.begin() + mid, items.begin() + last, [&](size_t a, size_t b) {
+					return centroid(a)[axis] < centroid(b)[axis];
+				});
+			}
+		}
+		else
+		{
+			std::nth_element(items.begin() + first, items.begin() + mid, items.begin() + last, [&](size_t a, size_t b) {
+				return centroid(a)[axis] < centroid(b)[axis];
+			});
+		}
+
+		nodes[idx].count = 0;
+		auto left = build_node(first, mid, idx, sah, depth + 1);
+		auto right = build_node(mid, last, idx, sah, depth + 1);
+		nodes[idx].left = left;
+		nodes[idx].right = right;
+
+		return idx;
+	}
 };
 
 /**
@@ -414,6 +1874,77 @@ struct vox_scene
 	std::vector<group> groups;
 	std::unordered_map<std::string, model_instance> instances;
 
+	/**
+	 * @brief      Computes the transform of every group relative to the root
+	 * reference frame. Each group is visited once, parents before their
+	 * children, rather than walking the parent chain once per instance.
+	 * Results are in the same order as `groups`.
+	 */
+	std::vector<mat<4, 4>> group_transforms() const
+	{
+		std::vector<mat<4, 4>> world(groups.size());
+		std::vector<bool> resolved(groups.size(), false);
+
+		std::function<const mat<4, 4>&(size_t)> resolve = [&](size_t i) -> const mat<4, 4>& {
+			if (!resolved[i])
+			{
+				auto& g = groups[i];
+				world[i] = g.transform;
+
+				if (g.parent != nullptr)
+				{
+					world[i] *= resolve(g.parent - groups.data());
+				}
+
+				resolved[i] = true;
+			}
+
+			return world[i];
+		};
+
+		for (size_t i = 0; i < groups.size(); i++) { resolve(i); }
+
+		return world;
+	}
+
+	/**
+	 * @brief      Equivalent to `inst.global_transform()` using group transforms
+	 * precomputed by `group_transforms()`.
+	 */
+	mat<4, 4> world_transform(const model_instance& inst, const std::vector<mat<4, 4>>& group_world) const
+	{
+		auto T = inst.transform;
+
+		if (inst.group != nullptr)
+		{
+			T *= group_world[inst.group - groups.data()];
+		}
+
+		return T;
+	}
+
+	/**
+	 * @brief      Hash of everything that determines the result of `flatten()`,
+	 * the world transform and voxels of each instance.
+	 */
+	uint64_t content_hash()
+	{
+		auto group_world = group_transforms();
+		uint64_t h = g::utils::hash64(nullptr, 0, instances.size());
+
+		for (auto& kvp : instances)
+		{
+			auto& inst = kvp.second;
+			auto T = world_transform(inst, group_world);
+			uint64_t model_hash = inst.model->hash();
+
+			h = g::utils::hash64(&T, sizeof(T), h);
+			h = g::utils::hash64(&model_hash, sizeof(model_hash), h);
+		}
+
+		return h;
+	}
+
 	/**
 	 * @brief      The extents of this voxel scene. In other words, the min
 	 * and max corners considering all model instances.
@@ -425,31 +1956,122 @@ struct vox_scene
 	 */
 	std::tuple<vec<3, int>, vec<3, int>> corners(const group* parent = nullptr) const
 	{
-		vec<3, int> m = { 0, 0, 0 }, M = { 0, 0, 0 };
-		auto first = true;
+		return instance_corners();
+	}
+
+	/**
+	 * @brief      World space bounds of `inst` given its world transform `T`.
+	 */
+	static bvh::bounds instance_bounds(const model_instance& inst, const mat<4, 4>& T)
+	{
+		auto c = inst.corners(T);
+		auto a = std::get<0>(c).cast<float>(), b = std::get<1>(c).cast<float>();
+
+		return { a.take_min(b), a.take_max(b) };
+	}
+
+	/**
+	 * @brief      Builds a bounding volume hierarchy over the world space bounds
+	 * of every instance. `sah` trades build time for query speed, see
+	 * `bvh::build`. Queries and refits build the tree if needed, and rebuild it
+	 * when the number of instances has changed. Removed instances are never
+	 * reported, but one added in place of a removed one is only found once the
+	 * tree is rebuilt.
+	 */
+	void build_bvh(bool sah=true)
+	{
+		auto group_world = group_transforms();
+		std::vector<bvh::bounds> boxes;
+
+		bvh_names.clear();
+		bvh_items.clear();
 
 		for (auto& kvp : instances)
 		{
-			auto& inst = kvp.second;
-			auto T = inst.global_transform();
-			std::tuple<vec<3, int>, vec<3, int>> corners = inst.corners(T);
+			bvh_items[kvp.first] = bvh_names.size();
+			bvh_names.push_back(kvp.first);
+			boxes.push_back(instance_bounds(kvp.second, world_transform(kvp.second, group_world)));
+		}
 
-			if (first)
-			{
-				m = std::get<0>(corners);
-				M = std::get<1>(corners);
-				first = false;
-			}
-			else
-			{
-				m = m.take_min(std::get<0>(corners));
-				m = m.take_min(std::get<1>(corners));
-				M = M.take_max(std::get<0>(corners));
-				M = M.take_max(std::get<1>(corners));
-			}
+		instance_bvh.build(boxes, sah);
+		bvh_built = true;
+	}
+
+	/**
+	 * @brief      Updates the instance BVH after any instance or group transforms
+	 * have changed, without rebuilding it.
+	 */
+	void refit_bvh()
+	{
+		if (bvh_stale()) { build_bvh(); return; }
+
+		auto group_world = group_transforms();
+
+		for (size_t i = 0; i < bvh_names.size(); i++)
+		{
+			auto inst = bvh_instance(i);
+			if (!inst) { build_bvh(); return; }
+
+			instance_bvh.boxes[i] = instance_bounds(*inst, world_transform(*inst, group_world));
 		}
 
-		return { m, M };
+		instance_bvh.refit();
+	}
+
+	/**
+	 * @brief      Updates the instance BVH after the instance `name` has moved.
+	 * Only the nodes above it are refit.
+	 */
+	void refit_bvh(const std::string& name)
+	{
+		auto item = bvh_items.find(name);
+		if (bvh_stale() || item == bvh_items.end() || !bvh_instance(item->second)) { build_bvh(); return; }
+
+		auto& inst = *bvh_instance(item->second);
+		instance_bvh.refit(item->second, instance_bounds(inst, world_transform(inst, group_transforms())));
+	}
+
+	/**
+	 * @brief      Calls `fn` for every instance whose bounds overlap `box`.
+	 */
+	void instances_in(const vec<3> box[2], std::function<void(const std::string& name, model_instance& inst)> fn)
+	{
+		if (bvh_stale()) { build_bvh(); }
+
+		instance_bvh.query(box, [&](size_t i) {
+			if (auto inst = bvh_instance(i)) { fn(bvh_names[i], *inst); }
+		});
+	}
+
+	/**
+	 * @brief      Calls `fn` for every instance whose bounds may be inside the
+	 * frustum described by the view projection matrix `vp`.
+	 */
+	void instances_in(const mat<4, 4>& vp, std::function<void(const std::string& name, model_instance& inst)> fn)
+	{
+		if (bvh_stale()) { build_bvh(); }
+
+		instance_bvh.query(vp, [&](size_t i) {
+			if (auto inst = bvh_instance(i)) { fn(bvh_names[i], *inst); }
+		});
+	}
+
+	/**
+	 * @brief      Calls `fn` for every instance whose bounds are entered by the
+	 * ray `origin + direction * t` for t in [0, max_t]. `t` passed to `fn` is
+	 * where the ray enters the instance's bounds.
+	 */
+	void instances_along(
+		const vec<3>& origin,
+		const vec<3>& direction,
+		std::function<void(const std::string& name, model_instance& inst, float t)> fn,
+		float max_t=std::numeric_limits<float>::infinity())
+	{
+		if (bvh_stale()) { build_bvh(); }
+
+		instance_bvh.raycast(origin, direction, [&](size_t i, float t) {
+			if (auto inst = bvh_instance(i)) { fn(bvh_names[i], *inst, t); }
+		}, max_t);
 	}
 
 	/**
@@ -484,56 +2106,197 @@ struct vox_scene
 	void duplicate_instance(const model_instance& inst, const std::string& dup_name)
 	{
 		instances[dup_name] = inst;
+		bvh_built = false;
 	}
 
 	/**
 	 * @brief      Transform and copy each model instance into a single voxel model
-	 * sized appropriately to fit the extents of each model post global transformation
+	 * sized appropriately to fit the extents of each model post global transformation.
+	 * The result is cached, if the scene's `content_hash()` hasn't changed since
+	 * the last call the cached model is returned.
+	 *
+	 * @return     The cached model, valid until the scene is next flattened.
+	 * Copy it to keep it, or use `flatten<voxels<uint8_t>>()`.
+	 */
+	const voxels<uint8_t>& flatten()
+	{
+		auto h = content_hash();
+
+		if (!flattened_valid || flattened_hash != h)
+		{
+			flattened = flatten<voxels<uint8_t>>();
+			flattened_hash = h;
+			flattened_valid = true;
+		}
+
+		return flattened;
+	}
+
+	/**
+	 * @brief      Same as `flatten()`, but the slices of each instance are
+	 * rasterized concurrently on the workers of `pool`.
+	 */
+	template<size_t POOL_SIZE>
+	const voxels<uint8_t>& flatten(g::proc::thread_pool<POOL_SIZE>& pool)
+	{
+		auto h = content_hash();
+
+		if (!flattened_valid || flattened_hash != h)
+		{
+			auto group_world = group_transforms();
+			auto c = instance_corners();
+			auto min = std::get<0>(c);
+			vec<3, int> size = std::get<1>(c) - min;
+
+			flattened = voxels<uint8_t>(size);
+
+			for (auto& kvp : instances)
+			{
+				auto& inst = kvp.second;
+				auto T = world_transform(inst, group_world);
+
+				// instance transforms are rotations and translations, so no two
+				// voxels of an instance land in the same output voxel
+				g::proc::parallel_for(pool, inst.model->depth, [&](size_t z) {
+					rasterize(flattened, inst, T, min, size, z, z + 1);
+				});
+			}
+
+			flattened_hash = h;
+			flattened_valid = true;
+		}
+
+		return flattened;
+	}
+
+	/**
+	 * @brief      Flattens the scene like `flatten()`, but only allocates
+	 * storage for regions of the scene which contain voxels.
 	 *
 	 * @return     Resulting model
 	 */
-	voxels<uint8_t> flatten()
+	sparse_voxels<uint8_t> flatten_sparse()
 	{
-		auto c = corners();
+		return flatten<sparse_voxels<uint8_t>>();
+	}
+
+	/**
+	 * @brief      Flattens the scene into a new `VOXELS` volume, bypassing the cache.
+	 */
+	template<typename VOXELS>
+	VOXELS flatten()
+	{
+		auto group_world = group_transforms();
+		auto c = instance_corners();
 		auto min = std::get<0>(c);
-		auto min_f = min.cast<float>();
 		vec<3, int> size = std::get<1>(c) - min;
 
-		voxels<uint8_t> out(size);
+		VOXELS out(size);
 
 		for (auto& kvp : instances)
 		{
 			auto& inst = kvp.second;
-			auto T = inst.global_transform();
+			rasterize(out, inst, world_transform(inst, group_world), min, size, 0, inst.model->depth);
+		}
+
+		return out;
+	}
 
-			auto half = (inst.model->size.cast<float>() / 2) - 0.5f;
+	/**
+	 * @brief      Copies the voxels of `inst` with z in [z0, z1) into `out`. The
+	 * transformed position is stepped along each row rather than transforming
+	 * every voxel by `T`.
+	 */
+	template<typename VOXELS>
+	static void rasterize(VOXELS& out, const model_instance& inst, const mat<4, 4>& T, const vec<3, int>& min, const vec<3, int>& size, size_t z0, size_t z1)
+	{
+		const auto& model = *inst.model;
+		auto half = (model.size.cast<float>() / 2) - 0.5f;
+		auto min_f = min.cast<float>();
+		auto step = T * vec<3>{ 1, 0, 0 } - T * vec<3>{ 0, 0, 0 };
 
-			for (unsigned z = 0; z < inst.model->depth; z++)
-			for (unsigned y = 0; y < inst.model->height; y++)
-			for (unsigned x = 0; x < inst.model->width; x++)
+		for (size_t z = z0; z < z1; z++)
+		for (size_t y = 0; y < model.height; y++)
+		{
+			auto coord = ((T * (vec<3>{ 0, (float)y, (float)z } - half)) - min_f);
+
+			for (size_t x = 0; x < model.width; x++, coord += step)
 			{
-				auto v = inst.model->idx2(x, y, z);
+				auto v = model.idx(x, y, z);
 
 				if (0 == v) { continue; }
 
-				assert(x < inst.model->width);
-				assert(y < inst.model->height);
-				assert(z < inst.model->depth);
-				auto coord = ((T * (vec<3>{(float)x, (float)y, (float)z} - half)) - min_f);
-
 				assert(coord[0] < size[0]);
 				assert(coord[1] < size[1]);
 				assert(coord[2] < size[2]);
 
 				out[coord.cast<size_t>()] = v;
-			
 			}
+		}
+	}
+
+private:
+	/**
+	 * @brief      Scene extents computed from the bounds of every instance.
+	 */
+	std::tuple<vec<3, int>, vec<3, int>> instance_corners() const
+	{
+		vec<3, int> m = { 0, 0, 0 }, M = { 0, 0, 0 };
+		auto first = true;
+
+		auto group_world = group_transforms();
 
+		for (auto& kvp : instances)
+		{
+			auto& inst = kvp.second;
+			auto T = world_transform(inst, group_world);
+			std::tuple<vec<3, int>, vec<3, int>> corners = inst.corners(T);
+
+			if (first)
+			{
+				m = std::get<0>(corners);
+				M = std::get<1>(corners);
+				first = false;
+			}
+			else
+			{
+				m = m.take_min(std::get<0>(corners));
+				m = m.take_min(std::get<1>(corners));
+				M = M.take_max(std::get<0>(corners));
+				M = M.take_max(std::get<1>(corners));
+			}
 		}
 
-		return out;
+		return { m, M };
+	}
+
+	/**
+	 * @brief      True if the instance BVH hasn't been built, or instances have
+	 * been added or removed since it was.
+	 */
+	bool bvh_stale() const
+	{
+		return !bvh_built || bvh_names.size() != instances.size();
+	}
+
+	/**
+	 * @brief      Instance of bvh item `i`, or nullptr if it has been removed
+	 * since the BVH was built.
+	 */
+	model_instance* bvh_instance(size_t i)
+	{
+		auto itr = instances.find(bvh_names[i]);
+		return itr == instances.end() ? nullptr : &itr->second;
 	}
 
+	voxels<uint8_t> flattened;
+	uint64_t flattened_hash = 0;
+	bool flattened_valid = false;
+
+	bvh instance_bvh;
+	std::vector<std::string> bvh_names; /**< instance of each bvh item */
+	std::unordered_map<std::string, size_t> bvh_items; /**< bvh item of each instance */
+	bool bvh_built = false;
 };
 
 struct voxels_paletted : public voxels<uint8_t>
@@ -556,20 +2319,447 @@ struct voxels_paletted : public voxels<uint8_t>
 	{
 		palette = src.palette;
 		this->resize(src.width, src.height, src.depth);
-		for (size_t w = 0; w < width; w++)
-		for (size_t h = 0; h < height; h++)
-		for (size_t d = 0; d < depth; d++)
-		{
-			auto sv = src.idx(w, h, d);
+
+		// both volumes share a layout, so voxels can be copied in storage order
+		auto copy = [&](size_t i) {
+			auto sv = src.v[i];
 
 			// copy only voxels that are not marked as excluded
 			if (exclude.find(sv) == exclude.end())
 			{
-				this->idx(w, h, d) = sv;
+				v[i] = sv;
+			}
+		};
+
+		if (src.occupancy.current() && exclude.count(0) > 0)
+		{ // zeros are excluded, so only occupied voxels need copying
+			src.occupancy.each(copy);
+		}
+		else
+		{
+			for (size_t i = 0; i < v.size(); i++) { copy(i); }
+		}
+
+		if (occupancy.enabled) { update_occupancy(); }
+	}
+};
+
+/**
+ * Compact encoding of `voxels<uint8_t>` models for storage and transmission.
+ *
+ * The distinct values used by a model are gathered into a table, and each
+ * voxel is replaced by its position in that table packed into as few bits as
+ * the table needs. Each column of voxels along x is then run length encoded
+ * as a series of tokens. Each token is a varint. Its low bit selects between
+ * a run of one repeated code, and a literal span of codes bit packed after
+ * the token. A model can also be encoded as a delta against a base model of
+ * the same size, where unchanged voxels become long runs of zeros.
+ *
+ * Layout, multi-byte values are little endian:
+ *   "GVX" version:u8 width:u32 height:u32 depth:u32 flags:u8 bits:u8
+ *   [base_hash:u64 if delta] table_size:u16 table:u8[table_size] tokens...
+ */
+namespace voxel_codec
+{
+
+enum flags : uint8_t
+{
+	delta = 1, /**< values are xor'd with a base model */
+};
+
+constexpr uint8_t version = 1;
+constexpr size_t min_run = 3; /**< shorter runs are cheaper to store as literals */
+constexpr size_t default_max_voxels = 1 << 24; /**< largest model decoded unless a decoder allows more */
+
+inline void put_varint(std::vector<uint8_t>& out, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		out.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+
+	out.push_back((uint8_t)v);
+}
+
+/**
+ * @brief      Reads a varint from [p, end), advancing p. Returns false if the
+ * varint is incomplete or malformed.
+ */
+inline bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v)
+{
+	v = 0;
+
+	for (unsigned shift = 0; p < end && shift < 64; shift += 7)
+	{
+		auto b = *p++;
+		v |= (uint64_t)(b & 0x7f) << shift;
+		if (!(b & 0x80)) { return true; }
+	}
+
+	return false;
+}
+
+/**
+ * @brief      Number of bytes starting at `p` equal to `p[0]`, at most `n`.
+ * Compares eight bytes at a time.
+ */
+inline size_t run_length(const uint8_t* p, size_t n)
+{
+	const uint64_t pattern = 0x0101010101010101ull * p[0];
+	size_t len = 0;
+
+	for (; len + 8 <= n; len += 8)
+	{
+		uint64_t word;
+		memcpy(&word, p + len, sizeof(word));
+
+		if (auto diff = word ^ pattern)
+		{ // the first differing byte
+			if constexpr (std::endian::native == std::endian::little) { return len + std::countr_zero(diff) / 8; }
+			else { return len + std::countl_zero(diff) / 8; }
+		}
+	}
+
+	while (len < n && p[len] == p[0]) { len++; }
+
+	return len;
+}
+
+inline uint64_t base_hash(const voxels<uint8_t>& base)
+{
+	return g::utils::hash64(base.v.data(), base.v.size(), base.width ^ (base.height << 16) ^ ((uint64_t)base.depth << 32));
+}
+
+/**
+ * @brief      Encodes `vox`. If `base` is provided, `vox` is encoded as a delta
+ * against it, and the same base must be passed to decode it.
+ */
+inline std::vector<uint8_t> encode(const voxels<uint8_t>& vox, const voxels<uint8_t>* base=nullptr)
+{
+	assert(base == nullptr || base->size == vox.size);
+
+	const size_t w = vox.width;
+	const size_t columns = vox.height * vox.depth;
+	std::vector<uint8_t> values(vox.v.size());
+
+	// xor against the base so unchanged voxels become 0
+	if (base) { for (size_t i = 0; i < values.size(); i++) { values[i] = vox.v[i] ^ base->v[i]; } }
+	else { values = vox.v; }
+
+	bool used[256] = {};
+	for (auto v : values) { used[v] = true; }
+
+	uint8_t code_of[256] = {};
+	std::vector<uint8_t> table;
+	for (unsigned v = 0; v < 256; v++)
+	{
+		if (!used[v]) { continue; }
+		code_of[v] = table.size();
+		table.push_back(v);
+	}
+
+	uint8_t bits = 0;
+	while ((1u << bits) < table.size()) { bits++; }
+
+	std::vector<uint8_t> out = { 'G', 'V', 'X', version };
+	auto put = [&](uint64_t v, int bytes) {
+		for (int i = 0; i < bytes; i++) { out.push_back((uint8_t)(v >> (8 * i))); }
+	};
+
+	put(vox.width, 4);
+	put(vox.height, 4);
+	put(vox.depth, 4);
+	put(base ? flags::delta : 0, 1);
+	put(bits, 1);
+	if (base) { put(base_hash(*base), 8); }
+	put(table.size(), 2);
+	out.insert(out.end(), table.begin(), table.end());
+
+	auto put_literals = [&](const uint8_t* p, size_t count) {
+		if (count == 0) { return; }
+
+		put_varint(out, ((uint64_t)(count - 1) << 1) | 1);
+
+		uint32_t acc = 0;
+		unsigned acc_bits = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			acc |= (uint32_t)code_of[p[i]] << acc_bits;
+			for (acc_bits += bits; acc_bits >= 8; acc_bits -= 8, acc >>= 8) { out.push_back((uint8_t)acc); }
+		}
+
+		if (acc_bits > 0) { out.push_back((uint8_t)acc); }
+	};
+
+	for (size_t c = 0; c < columns; c++)
+	{
+		const uint8_t* col = values.data() + c * w;
+		size_t literal_start = 0;
+
+		for (size_t x = 0; x < w;)
+		{
+			auto len = run_length(col + x, w - x);
+
+			if (len >= min_run)
+			{
+				put_literals(col + literal_start, x - literal_start);
+				put_varint(out, ((uint64_t)(len - 1) << (bits + 1)) | ((uint64_t)code_of[col[x]] << 1));
+				literal_start = x + len;
+			}
+
+			x += len;
+		}
+
+		put_literals(col + literal_start, w - literal_start);
+	}
+
+	return out;
+}
+
+/**
+ * @brief      Decodes a model incrementally as its bytes arrive, so decoding
+ * can overlap transmission. Whole columns are written to `vox` as soon as
+ * their tokens have been received. Storage for `vox` grows as columns are
+ * decoded rather than being allocated from the header, so a header claiming
+ * a huge model can't force a huge allocation by itself.
+ */
+struct decoder
+{
+	voxels<uint8_t> vox;           /**< decoded model, valid once `done()` */
+	const voxels<uint8_t>* base;  /**< model deltas are applied to */
+	size_t max_voxels;            /**< models with more voxels than this are rejected */
+	size_t stream_size = 0;       /**< total encoded size if known up front, otherwise 0 */
+
+	decoder(const voxels<uint8_t>* base=nullptr, size_t max_voxels=default_max_voxels) : base(base), max_voxels(max_voxels) {}
+
+	inline bool done() const { return state == stage::finished; }
+
+	inline bool failed() const { return state == stage::error; }
+
+	/**
+	 * @brief      Number of columns along x fully decoded so far. Column c holds
+	 * the voxels with y = c % height and z = c / height.
+	 */
+	inline size_t columns_ready() const { return vox.width > 0 ? cursor / vox.width : 0; }
+
+	/**
+	 * @brief      Consumes the next `len` bytes of an encoded model.
+	 *
+	 * @return     False if the data is malformed, doesn't match `base`, or
+	 * continues past the end of the model.
+	 */
+	bool feed(const uint8_t* data, size_t len)
+	{
+		if (state == stage::error) { return false; }
+
+		pending.insert(pending.end(), data, data + len);
+
+		const uint8_t* p = pending.data() + consumed;
+		const uint8_t* end = pending.data() + pending.size();
+
+		while (state != stage::error && state != stage::finished && p < end)
+		{
+			auto before = p;
+			if (!step(p, end)) { p = before; break; } // wait for more bytes
+		}
+
+		if (state == stage::finished && p != end) { state = stage::error; }
+
+		// drop consumed bytes once they make up most of the buffer
+		consumed = p - pending.data();
+		if (consumed > 4096 && consumed * 2 > pending.size())
+		{
+			pending.erase(pending.begin(), pending.begin() + consumed);
+			consumed = 0;
+		}
+
+		return state != stage::error;
+	}
+
+private:
+	enum class stage { header, table, tokens, finished, error };
+
+	stage state = stage::header;
+	std::vector<uint8_t> pending;
+	size_t consumed = 0;
+	size_t cursor = 0; /**< voxels decoded */
+	size_t total = 0;  /**< voxels in the model */
+	uint8_t bits = 0;
+	uint8_t header_flags = 0;
+	std::vector<uint8_t> table;
+
+	static uint64_t get(const uint8_t* p, int bytes)
+	{
+		uint64_t v = 0;
+		for (int i = 0; i < bytes; i++) { v |= (uint64_t)p[i] << (8 * i); }
+		return v;
+	}
+
+	/**
+	 * @brief      Writes `count` values starting at `cursor`, applying the delta
+	 * against `base` when enabled.
+	 */
+	inline void write_run(uint8_t value, size_t count)
+	{
+		if (vox.v.size() < cursor + count) { vox.v.resize(cursor + count); }
+
+		auto dst = vox.v.data() + cursor;
+
+		if (header_flags & flags::delta)
+		{
+			auto src = base->v.data() + cursor;
+			for (size_t i = 0; i < count; i++) { dst[i] = src[i] ^ value; }
+		}
+		else
+		{
+			memset(dst, value, count);
+		}
+
+		cursor += count;
+	}
+
+	/**
+	 * @brief      Parses one piece of the stream. Returns false without
+	 * consuming anything if more bytes are needed.
+	 */
+	bool step(const uint8_t*& p, const uint8_t* end)
+	{
+		switch (state)
+		{
+			case stage::header:
+			{
+				constexpr size_t header_size = 4 + 12 + 2;
+				if ((size_t)(end - p) < header_size) { return false; }
+				if (p[0] != 'G' || p[1] != 'V' || p[2] != 'X' || p[3] != version) { state = stage::error; return true; }
+
+				auto w = get(p + 4, 4), h = get(p + 8, 4), d = get(p + 12, 4);
+				header_flags = p[16];
+				bits = p[17];
+
+				size_t extra = (header_flags & flags::delta) ? 8 : 0;
+				if ((size_t)(end - p) < header_size + extra) { return false; }
+
+				constexpr uint64_t max_side = 1 << 16;
+				if (bits > 8 || w * h * d == 0 || w > max_side || h > max_side || d > max_side || w * h * d > max_voxels)
+				{
+					state = stage::error;
+					return true;
+				}
+
+				// every column takes at least one token byte, after a table of at least one entry
+				if (stream_size > 0 && stream_size < header_size + extra + 3 + h * d)
+				{
+					state = stage::error;
+					return true;
+				}
+
+				if (header_flags & flags::delta)
+				{
+					if (base == nullptr || base->width != w || base->height != h || base->depth != d ||
+					    base_hash(*base) != get(p + header_size, 8))
+					{
+						state = stage::error;
+						return true;
+					}
+				}
+
+				vox = voxels<uint8_t>();
+				vox.width = w;
+				vox.height = h;
+				vox.depth = d;
+				vox.size = { w, h, d };
+				vox.layout.resize(vox.size);
+				total = w * h * d;
+
+				p += header_size + extra;
+				state = stage::table;
+				return true;
+			}
+			case stage::table:
+			{
+				if (end - p < 2) { return false; }
+				auto count = get(p, 2);
+				if ((size_t)(end - p) < 2 + count) { return false; }
+				if (count == 0 || count > 256 || count > (1u << bits)) { state = stage::error; return true; }
+
+				table.assign(p + 2, p + 2 + count);
+				p += 2 + count;
+				state = stage::tokens;
+				return true;
+			}
+			case stage::tokens:
+			{
+				uint64_t token;
+				if (!get_varint(p, end, token)) { return false; }
+
+				const size_t column_left = vox.width - cursor % vox.width;
+
+				if (token & 1)
+				{ // literal span
+					auto count = (token >> 1) + 1;
+					auto bytes = (count * bits + 7) / 8;
+					if (count > column_left) { state = stage::error; return true; }
+					if ((uint64_t)(end - p) < bytes) { return false; }
+
+					const uint32_t mask = (1u << bits) - 1;
+					uint32_t acc = 0;
+					unsigned acc_bits = 0;
+
+					for (size_t i = 0; i < count; i++)
+					{
+						for (; acc_bits < bits; acc_bits += 8) { acc |= (uint32_t)(*p++) << acc_bits; }
+
+						auto code = acc & mask;
+						acc >>= bits;
+						acc_bits -= bits;
+
+						if (code >= table.size()) { state = stage::error; return true; }
+						write_run(table[code], 1);
+					}
+				}
+				else
+				{ // run of a single code
+					auto code = (token >> 1) & ((1u << bits) - 1);
+					auto count = (token >> (bits + 1)) + 1;
+					if (code >= table.size() || count > column_left) { state = stage::error; return true; }
+
+					write_run(table[code], count);
+				}
+
+				if (cursor == total) { state = stage::finished; }
+				return true;
 			}
+			default:
+				return true;
 		}
 	}
 };
 
+/**
+ * @brief      Decodes a complete encoded model into `out`. `base` must be the
+ * model it was encoded against if it was encoded as a delta.
+ *
+ * @return     False if the data is malformed, truncated or describes a model
+ * with more than `max_voxels` voxels.
+ */
+inline bool decode(const uint8_t* data, size_t len, voxels<uint8_t>& out, const voxels<uint8_t>* base=nullptr, size_t max_voxels=default_max_voxels)
+{
+	decoder dec(base, max_voxels);
+	dec.stream_size = len;
+
+	if (!dec.feed(data, len) || !dec.done()) { return false; }
+
+	out = std::move(dec.vox);
+	return true;
+}
+
+inline bool decode(const std::vector<uint8_t>& data, voxels<uint8_t>& out, const voxels<uint8_t>* base=nullptr, size_t max_voxels=default_max_voxels)
+{
+	return decode(data.data(), data.size(), out, base, max_voxels);
+}
+
+} // namespace voxel_codec
+
 } // end namespace game
 } // end namespace g
@@ -9,10 +9,15 @@
 
 #include <iostream>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <set>
 #include <algorithm>
 #include <memory>
+#include <array>
+#include <deque>
+#include <list>
+#include <queue>
 
 #include <string.h>
 #include <assert.h>
@@ -273,6 +278,12 @@ struct texture_factory
 
 	texture_factory& fill(unsigned char* buffer);
 
+	/**
+	 * @brief      Single channel float 3D texture of the signed distances in
+	 * `field`, one texel per sample.
+	 */
+	texture_factory& from_distance_field(const g::game::distance_field& field);
+
 	texture create();
 };
 
@@ -509,6 +520,32 @@ struct shader
 			return *this;
 		}
 
+		/**
+		 * @brief      Draws `count` instances of the attached vertices. Every
+		 * attribute's divisor is reset afterward, so that attributes set up
+		 * per instance don't leak into later draws.
+		 */
+		template<GLenum PRIM>
+		usage& draw_instanced(size_t count)
+		{
+			assert(gl_get_error());
+			if (indices > 0)
+			{
+				glDrawElementsInstanced(PRIM, indices, GL_UNSIGNED_INT, NULL, count);
+			}
+			else
+			{
+				glDrawArraysInstanced(PRIM, 0, vertices, count);
+			}
+			assert(gl_get_error());
+
+			GLint attribs = 0;
+			glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &attribs);
+			for (GLint i = 0; i < attribs; i++) { glVertexAttribDivisor(i, 0); }
+
+			return *this;
+		}
+
 		usage& draw_tri_fan()
 		{
 			return draw<GL_TRIANGLE_FAN>();
@@ -732,6 +769,139 @@ namespace vertex
 }
 
 
+/**
+ * @brief      Quadratic error function used to place dual contouring vertices.
+ * Accumulates the planes (point and normal) where a surface crosses the edges of
+ * a cell. The point minimizing the summed squared distance to all planes lies on
+ * any sharp edges or corners of the surface within the cell. Terms are kept in
+ * double precision so the error of large collapsed regions remains meaningful.
+ */
+struct qef
+{
+	double ata[3][3] = {}; /**< A^T A */
+	vec<3, double> atb = {}; /**< A^T b */
+	double btb = 0; /**< b^T b */
+	vec<3, double> mass = {}; /**< sum of all points added */
+	unsigned count = 0;
+
+	void add(const vec<3>& point, const vec<3>& normal)
+	{
+		auto p = point.cast<double>();
+		auto n = normal.cast<double>();
+		auto d = n.dot(p);
+
+		for (int r = 0; r < 3; r++)
+		for (int c = 0; c < 3; c++)
+		{
+			ata[r][c] += n[r] * n[c];
+		}
+
+		atb += n * d;
+		btb += d * d;
+		mass += p;
+		count++;
+	}
+
+	void add(const qef& q)
+	{
+		for (int r = 0; r < 3; r++)
+		for (int c = 0; c < 3; c++)
+		{
+			ata[r][c] += q.ata[r][c];
+		}
+
+		atb += q.atb;
+		btb += q.btb;
+		mass += q.mass;
+		count += q.count;
+	}
+
+	/**
+	 * @brief      Sum of squared distances from `x` to each of the planes.
+	 */
+	double error(const vec<3>& x) const
+	{
+		auto p = x.cast<double>();
+		vec<3, double> ata_p = {};
+
+		for (int r = 0; r < 3; r++)
+		{
+			ata_p[r] = ata[r][0] * p[0] + ata[r][1] * p[1] + ata[r][2] * p[2];
+		}
+
+		return std::max(0.0, p.dot(ata_p) - 2 * p.dot(atb) + btb);
+	}
+
+	/**
+	 * @brief      Finds the point minimizing the error. The system is solved with
+	 * a pseudo inverse about the mass point, discarding directions whose
+	 * eigenvalue is below `threshold` times the largest, so flat and creased
+	 * regions settle at the mass point along their unconstrained directions.
+	 */
+	vec<3> solve(double threshold=0.1) const
+	{
+		if (count == 0) { return {}; }
+
+		auto c = mass / (double)count;
+		double a[3][3], v[3][3] = {{ 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 }};
+		vec<3, double> rhs = atb;
+
+		for (int r = 0; r < 3; r++)
+		{
+			rhs[r] -= ata[r][0] * c[0] + ata[r][1] * c[1] + ata[r][2] * c[2];
+			for (int k = 0; k < 3; k++) { a[r][k] = ata[r][k]; }
+		}
+
+		// jacobi eigen decomposition of the symmetric matrix A^T A
+		for (int sweep = 0; sweep < 8; sweep++)
+		for (int p = 0; p < 2; p++)
+		for (int q = p + 1; q < 3; q++)
+		{
+			if (std::abs(a[p][q]) < 1e-12) { continue; }
+
+			auto theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+			auto t = (theta >= 0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+			auto cs = 1 / std::sqrt(t * t + 1), sn = t * cs;
+
+			for (int k = 0; k < 3; k++)
+			{
+				auto akp = a[k][p], akq = a[k][q];
+				a[k][p] = cs * akp - sn * akq;
+				a[k][q] = sn * akp + cs * akq;
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				auto apk = a[p][k], aqk = a[q][k];
+				a[p][k] = cs * apk - sn * aqk;
+				a[q][k] = sn * apk + cs * aqk;
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				auto vkp = v[k][p], vkq = v[k][q];
+				v[k][p] = cs * vkp - sn * vkq;
+				v[k][q] = sn * vkp + cs * vkq;
+			}
+		}
+
+		auto max_eig = std::max(std::abs(a[0][0]), std::max(std::abs(a[1][1]), std::abs(a[2][2])));
+		vec<3, double> x = c;
+
+		// x = c + V diag(1 / eig) V^T rhs
+		for (int e = 0; e < 3; e++)
+		{
+			if (std::abs(a[e][e]) <= threshold * max_eig || a[e][e] == 0) { continue; }
+
+			auto proj = v[0][e] * rhs[0] + v[1][e] * rhs[1] + v[2][e] * rhs[2];
+			for (int r = 0; r < 3; r++) { x[r] += v[r][e] * proj / a[e][e]; }
+		}
+
+		return x.cast<float>();
+	}
+};
+
+
 template<typename V>
 struct mesh
 {
@@ -1011,210 +1181,939 @@ struct mesh
 	}
 
 
-	void from_sdf(
+	/**
+	 * Vertex generator which is also given the gradient of the sdf at `pos`. The
+	 * gradient is interpolated from the density samples the mesher already took,
+	 * so normals can be computed without evaluating the sdf again.
+	 */
+	using gradient_generator = std::function<V (const g::game::sdf& sdf, const vec<3>& pos, const vec<3>& gradient)>;
+
+	static inline V edge_vertex(
+		const std::function<V (const g::game::sdf& sdf, const vec<3>& pos)>& generator,
+		const g::game::sdf& sdf,
+		const g::game::sdf_grid& grid,
+		const vec<3>& pos,
+		const unsigned c0[3],
+		const unsigned c1[3],
+		float w)
+	{
+		return generator(sdf, pos);
+	}
+
+	static inline V edge_vertex(
+		const gradient_generator& generator,
+		const g::game::sdf& sdf,
+		const g::game::sdf_grid& grid,
+		const vec<3>& pos,
+		const unsigned c0[3],
+		const unsigned c1[3],
+		float w)
+	{
+		auto grad = grid.gradient(c1[0], c1[1], c1[2]) * w + grid.gradient(c0[0], c0[1], c0[2]) * (1 - w);
+		return generator(sdf, pos, grad);
+	}
+
+	/**
+	 * @brief      Runs marching cubes over the cells of `grid` whose z index is in
+	 * [z0, z1), appending the resulting triangles to `vertices_out` and `indices_out`.
+	 * Indices are relative to the vertices appended by this call. `GEN` is either
+	 * a plain vertex generator or a `gradient_generator`.
+	 */
+	template<typename GEN>
+	static void march_slab(
 		std::vector<V>& vertices_out,
 		std::vector<uint32_t>& indices_out,
-		const g::game::sdf& sdf, 
-		std::function<V (const g::game::sdf& sdf, const vec<3>& pos)> generator, 
-		vec<3> corners[2],
-		unsigned divisions=32)
+		const g::game::sdf_grid& grid,
+		const g::game::sdf& sdf,
+		const GEN& generator,
+		unsigned z0,
+		unsigned z1)
 	{
 		#include "data/marching.cubes.lut"
 
-		vertices_out.clear();
-		indices_out.clear();
+		const unsigned c[8][3] = {
+			{ 0, 0, 0 },
+			{ 0, 1, 0 },
+			{ 1, 1, 0 },
+			{ 1, 0, 0 },
 
-		float div = divisions;
+			{ 0, 0, 1 },
+			{ 0, 1, 1 },
+			{ 1, 1, 1 },
+			{ 1, 0, 1 },
+		};
 
-		auto& p0 = corners[0];
-		auto& p1 = corners[1];
-		auto block_delta = (p1 - p0);
-		auto voxel_delta = block_delta / div;
+		auto base = vertices_out.size();
 
-		for (int x = divisions; x--;)
-		for (int y = divisions; y--;)
-		for (int z = divisions; z--;)
+		for (unsigned z = z0; z < z1; z++)
+		for (unsigned y = 0; y < grid.divisions; y++)
+		for (unsigned x = 0; x < grid.divisions; x++)
 		{
-			vec<3> voxel_index({ (float)x, (float)y, (float)z });
-			vec<3> p[8];  // voxel corners
 			float d[8]; // densities at each corner
 			uint8_t voxel_case = 0;
 
-			vec<3> c[8] = {
-				{ 0.f, 0.f, 0.f },
-				{ 0.f, 1.f, 0.f },
-				{ 1.f, 1.f, 0.f },
-				{ 1.f, 0.f, 0.f },
-
-				{ 0.f, 0.f, 1.f },
-				{ 0.f, 1.f, 1.f },
-				{ 1.f, 1.f, 1.f },
-				{ 1.f, 0.f, 1.f },
-			};
-
-			// compute positions of the corners for voxel x,y,z as well
-			// as the case for the voxel
 			for (int i = 8; i--;)
 			{
-				c[i] *= voxel_delta;
-				p[i] = p0 + (voxel_delta * voxel_index) + c[i];
-				d[i] = sdf(p[i]);
-
+				d[i] = grid.at(x + c[i][0], y + c[i][1], z + c[i][2]);
 				voxel_case |= ((d[i] >= 0) << i);
 			}
 
-			// compute lerp weights between verts for each edge
-			float w[12];
-			for (int i = 0; i < 12; ++i)
+			if (voxel_case == 0 || voxel_case == 255) { continue; }
+
+			for (int i = 0; i < 15; ++i)
 			{
 				int e_i = tri_edge_list_case[voxel_case][i];
 
 				if (e_i == -1) break;
 
-				// v0 * w + v1 * (1 - w)
-				// w = 0.5
-				// -1 * w + 1 * (1 - w) = 0
-				//
-				// d0 * w + d1 * (1 - w) = 0
-				// d0 * w + d1 - d1 * w = 0
-				// (d0 * w - d1 * w) / w = -d1 / w
-				// d0 - d1 = -d1 / w
-				// -d1 / (d0 - d1) = w
-
 				int p0_i = edge_list[e_i][0];
 				int p1_i = edge_list[e_i][1];
 
 				// solve for the weight that will lerp between
-				w[i] = d[p0_i] / (d[p0_i] - d[p1_i]);
+				// the corners such that the density is 0
+				auto w = d[p0_i] / (d[p0_i] - d[p1_i]);
+				unsigned c0[3] = { x + c[p0_i][0], y + c[p0_i][1], z + c[p0_i][2] };
+				unsigned c1[3] = { x + c[p1_i][0], y + c[p1_i][1], z + c[p1_i][2] };
+				auto p0 = grid.position(c0[0], c0[1], c0[2]);
+				auto p1 = grid.position(c1[0], c1[1], c1[2]);
 
-				vec<3> _p = p[p1_i] * w[i] + p[p0_i] * (1 - w[i]);
-				
-				indices_out.push_back(vertices_out.size());
-				vertices_out.push_back(generator(sdf, _p));
-			}
+				vec<3> _p = p1 * w + p0 * (1 - w);
 
+				indices_out.push_back(vertices_out.size() - base);
+				vertices_out.push_back(edge_vertex(generator, sdf, grid, _p, c0, c1, w));
+			}
 		}
 	}
 
-	void from_sdf(
+	template<typename GEN>
+	static void march_grid(
+		std::vector<V>& vertices_out,
+		std::vector<uint32_t>& indices_out,
 		const g::game::sdf& sdf,
-		std::function<V(const g::game::sdf& sdf, const vec<3>& pos)> generator,
+		const GEN& generator,
 		vec<3> corners[2],
-		unsigned divisions = 32)
+		unsigned divisions)
 	{
-		static std::vector<V> vertices;
-		static std::vector<uint32_t> indices;
+		static thread_local g::game::sdf_grid grid;
 
-		from_sdf(vertices, indices, sdf, generator, corners, divisions);
+		vertices_out.clear();
+		indices_out.clear();
 
-		set_vertices(vertices);
-		set_indices(indices);
+		grid.resize(corners, divisions);
+		grid.sample(sdf);
+
+		march_slab(vertices_out, indices_out, grid, sdf, generator, 0, divisions);
 	}
-};
 
+	void from_sdf(
+		std::vector<V>& vertices_out,
+		std::vector<uint32_t>& indices_out,
+		const g::game::sdf& sdf, 
+		std::function<V (const g::game::sdf& sdf, const vec<3>& pos)> generator, 
+		vec<3> corners[2],
+		unsigned divisions=32)
+	{
+		march_grid(vertices_out, indices_out, sdf, generator, corners, divisions);
+	}
 
-struct mesh_factory
-{
-	static mesh<vertex::pos_uv_norm> plane(const vec<3>& normal={0, 0, 1}, const vec<2>& size={1, 1});
+	void from_sdf(
+		std::vector<V>& vertices_out,
+		std::vector<uint32_t>& indices_out,
+		const g::game::sdf& sdf, 
+		gradient_generator generator, 
+		vec<3> corners[2],
+		unsigned divisions=32)
+	{
+		march_grid(vertices_out, indices_out, sdf, generator, corners, divisions);
+	}
 
-	static mesh<vertex::pos> slice_cube(unsigned slices);
+	template<size_t POOL_SIZE, typename GEN>
+	static void march_grid(
+		std::vector<V>& vertices_out,
+		std::vector<uint32_t>& indices_out,
+		const g::game::sdf& sdf, 
+		const GEN& generator, 
+		vec<3> corners[2],
+		unsigned divisions,
+		g::proc::thread_pool<POOL_SIZE>& pool,
+		g::game::sdf_grid& grid)
+	{
+		struct slab
+		{
+			std::vector<V> vertices;
+			std::vector<uint32_t> indices;
+		};
 
-	static mesh<vertex::pos_uv_norm> cube();
+		// a few slabs per worker keeps them busy if some slabs are
+		// much more expensive than others
+		const unsigned slab_count = std::min<unsigned>(divisions, (POOL_SIZE + 1) * 4);
+		std::vector<slab> slabs(slab_count);
 
-	static mesh<vertex::pos_uv_norm> from_obj(const std::string& path);
+		auto slab_range = [&](unsigned si, unsigned& z0, unsigned& z1) {
+			z0 = (si * divisions) / slab_count;
+			z1 = ((si + 1) * divisions) / slab_count;
+		};
 
-	template<typename VERT>
-	static mesh<VERT> from_voxels(const g::game::voxels<uint8_t>& vox, ogt_vox_palette& palette, std::function<VERT(ogt_mesh_vertex* vert_in)> generator)
-	{
-		ogt_voxel_meshify_context empty_ctx = {};
-		mesh<VERT> m;
-		glGenBuffers(2, &m.vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, m.vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.ibo);
+		vertices_out.clear();
+		indices_out.clear();
 
-		assert(GL_TRUE == glIsBuffer(m.vbo));
-		assert(GL_TRUE == glIsBuffer(m.ibo));
+		grid.resize(corners, divisions);
 
-		auto mesh = ogt_mesh_from_paletted_voxels_simple(&empty_ctx, vox.v.data(), vox.width, vox.height, vox.depth, (const ogt_mesh_rgba*)palette.color);
+		g::proc::parallel_for(pool, slab_count, [&](size_t si) {
+			unsigned z0, z1;
+			slab_range(si, z0, z1);
 
-		VERT* verts = new VERT[mesh->vertex_count];
-		uint32_t* inds = new uint32_t[mesh->index_count];
-		for (unsigned i = 0; i < mesh->vertex_count; i++)
+			// the last slab also samples the far face of the grid
+			grid.sample_slab(sdf, z0, si == slab_count - 1 ? z1 + 1 : z1);
+		});
+
+		g::proc::parallel_for(pool, slab_count, [&](size_t si) {
+			unsigned z0, z1;
+			slab_range(si, z0, z1);
+			march_slab(slabs[si].vertices, slabs[si].indices, grid, sdf, generator, z0, z1);
+		});
+
+		size_t vertex_count = 0, index_count = 0;
+		for (auto& s : slabs)
 		{
-			verts[i] = generator(mesh->vertices + i);
+			vertex_count += s.vertices.size();
+			index_count += s.indices.size();
 		}
 
-		// reverse index order so backface culling works correctly
-		for (unsigned i = 0; i < mesh->index_count; i++)
+		vertices_out.reserve(vertex_count);
+		indices_out.reserve(index_count);
+
+		for (auto& s : slabs)
 		{
-			inds[i] = mesh->indices[(mesh->index_count - 1) - i];
+			auto base = (uint32_t)vertices_out.size();
+			vertices_out.insert(vertices_out.end(), s.vertices.begin(), s.vertices.end());
+
+			for (auto i : s.indices) { indices_out.push_back(base + i); }
 		}
+	}
 
-		m.set_vertices(verts, mesh->vertex_count);
-		m.set_indices(inds, mesh->index_count);
 
-		ogt_mesh_destroy(&empty_ctx, mesh);
-		delete[] verts;
-		delete[] inds;
+	/**
+	 * @brief      Multithreaded marching cubes. The density grid is sampled once into
+	 * `grid`, then the grid is split into z-slabs which are meshed concurrently on
+	 * the workers of `pool`. The output of each slab is merged in order, so the
+	 * result is identical to that of the single threaded `from_sdf`.
+	 *
+	 * @param      vertices_out  Vertices of the resulting triangles.
+	 * @param      indices_out   Indices of the resulting triangles.
+	 * @param[in]  sdf           Density function to mesh.
+	 * @param[in]  generator     Creates a vertex for a point on the surface. Called
+	 *                           concurrently, so it must be thread safe.
+	 * @param      corners       Min and max corners of the volume to mesh.
+	 * @param[in]  divisions     Number of cells along each axis.
+	 * @param      pool          Pool whose workers will take part in the meshing.
+	 * @param      grid          Storage for density samples, reused between calls.
+	 */
+	template<size_t POOL_SIZE>
+	void from_sdf(
+		std::vector<V>& vertices_out,
+		std::vector<uint32_t>& indices_out,
+		const g::game::sdf& sdf, 
+		std::function<V (const g::game::sdf& sdf, const vec<3>& pos)> generator, 
+		vec<3> corners[2],
+		unsigned divisions,
+		g::proc::thread_pool<POOL_SIZE>& pool,
+		g::game::sdf_grid& grid)
+	{
+		march_grid(vertices_out, indices_out, sdf, generator, corners, divisions, pool, grid);
+	}
 
-		return m;
+	template<size_t POOL_SIZE>
+	void from_sdf(
+		std::vector<V>& vertices_out,
+		std::vector<uint32_t>& indices_out,
+		const g::game::sdf& sdf, 
+		gradient_generator generator, 
+		vec<3> corners[2],
+		unsigned divisions,
+		g::proc::thread_pool<POOL_SIZE>& pool,
+		g::game::sdf_grid& grid)
+	{
+		march_grid(vertices_out, indices_out, sdf, generator, corners, divisions, pool, grid);
 	}
 
-	template<typename VERT>
-	static mesh<VERT> from_voxels(g::game::voxels_paletted& vox, std::function<VERT(ogt_mesh_vertex* vert_in)> generator)
+	template<size_t POOL_SIZE>
+	void from_sdf(
+		std::vector<V>& vertices_out,
+		std::vector<uint32_t>& indices_out,
+		const g::game::sdf& sdf, 
+		std::function<V (const g::game::sdf& sdf, const vec<3>& pos)> generator, 
+		vec<3> corners[2],
+		unsigned divisions,
+		g::proc::thread_pool<POOL_SIZE>& pool)
 	{
-		return from_voxels<VERT>(vox, vox.palette, generator);
+		static thread_local g::game::sdf_grid grid;
+
+		from_sdf(vertices_out, indices_out, sdf, generator, corners, divisions, pool, grid);
 	}
 
-	template<typename VERT>
-	static mesh<VERT> from_voxels(g::game::vox_scene& vox, std::function<VERT(ogt_mesh_vertex* vert_in)> generator)
+	void from_sdf(
+		const g::game::sdf& sdf,
+		std::function<V(const g::game::sdf& sdf, const vec<3>& pos)> generator,
+		vec<3> corners[2],
+		unsigned divisions = 32)
 	{
-		ogt_voxel_meshify_context empty_ctx = {};
-		mesh<VERT> m;
-		std::vector<VERT> verts;
-		std::vector<uint32_t> indices;
+		static std::vector<V> vertices;
+		static std::vector<uint32_t> indices;
 
-		glGenBuffers(2, &m.vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, m.vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.ibo);
+		from_sdf(vertices, indices, sdf, generator, corners, divisions);
 
-		assert(GL_TRUE == glIsBuffer(m.vbo));
-		assert(GL_TRUE == glIsBuffer(m.ibo));
+		set_vertices(vertices);
+		set_indices(indices);
+	}
 
-		for (auto& kvp : vox.instances)
+	/**
+	 * @brief      Dual contouring. Places one vertex per cell crossed by the surface
+	 * at the minimizer of the cell's QEF, so sharp edges and corners of the sdf are
+	 * reproduced without raising `divisions`. Quads are emitted for every grid edge
+	 * crossed by the surface, joining the vertices of the 4 cells sharing it.
+	 *
+	 * When `max_error` is greater than zero cells are also merged bottom up in an
+	 * octree. Eight sibling nodes collapse into their parent if the combined QEF
+	 * can be satisfied within `max_error` by a point inside the parent, in which
+	 * case all of the cells beneath share one vertex and triangles that
+	 * degenerate are dropped. Flat regions then use far fewer triangles.
+	 *
+	 * @param      vertices_out  Vertices of the resulting triangles.
+	 * @param      indices_out   Indices of the resulting triangles.
+	 * @param[in]  sdf           Density function to mesh.
+	 * @param[in]  generator     Creates a vertex for a point on the surface.
+	 * @param      corners       Min and max corners of the volume to mesh.
+	 * @param[in]  divisions     Number of cells along each axis.
+	 * @param[in]  max_error     Largest QEF error allowed for a collapsed node.
+	 * @param[in]  gradient      Gradient of `sdf`. Estimated by central differences
+	 *                           if not provided.
+	 */
+	void from_sdf_dual(
+		std::vector<V>& vertices_out,
+		std::vector<uint32_t>& indices_out,
+		const g::game::sdf& sdf,
+		std::function<V (const g::game::sdf& sdf, const vec<3>& pos)> generator,
+		vec<3> corners[2],
+		unsigned divisions=32,
+		float max_error=0,
+		g::game::sdf_gradient gradient=nullptr)
+	{
+		static thread_local g::game::sdf_grid grid;
+
+		struct node
 		{
-			auto& inst = kvp.second;
-			auto T = inst.global_transform();
-			auto mesh = ogt_mesh_from_paletted_voxels_simple(&empty_ctx, inst.model->v.data(), inst.model->width, inst.model->height, inst.model->depth, (const ogt_mesh_rgba*)vox.palette.color);
-			auto half = (inst.model->size / 2).cast<float>();
+			g::gfx::qef qef;
+			vec<3> position;
+			int vertex = -1;
+			bool collapsible = true; /**< leaf, or all children merged into this node */
+		};
 
-			verts.reserve(verts.size() + mesh->vertex_count);
-			auto last_vert_count = verts.size();
-			for (unsigned i = 0; i < mesh->vertex_count; i++)
-			{
-				auto v = T * vec<3>{ mesh->vertices[i].pos.x, mesh->vertices[i].pos.y, mesh->vertices[i].pos.z } - half;
-				mesh->vertices[i].pos.x = v[0];
-				mesh->vertices[i].pos.y = v[1];
-				mesh->vertices[i].pos.z = v[2];
-				auto vert = generator(mesh->vertices + i);
-				verts.push_back(vert);
-			}
+		const unsigned c[8][3] = {
+			{ 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 },
+			{ 0, 0, 1 }, { 1, 0, 1 }, { 0, 1, 1 }, { 1, 1, 1 },
+		};
 
-			// reverse index order so backface culling works correctly
-			indices.reserve(indices.size() + mesh->index_count);
-			for (unsigned i = 0; i < mesh->index_count; i++)
-			{
-				indices.push_back(mesh->indices[(mesh->index_count - 1) - i] + last_vert_count);
-			}
+		const int edge_list[12][2] = {
+			{ 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 }, // x
+			{ 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 }, // y
+			{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }, // z
+		};
 
-			ogt_mesh_destroy(&empty_ctx, mesh);
-		}
+		vertices_out.clear();
+		indices_out.clear();
 
-		m.set_vertices(verts);
-		m.set_indices(indices);
+		grid.resize(corners, divisions);
+		grid.sample(sdf);
 
-		return m;
-	}
+		auto step = std::min(grid.cell_size[0], std::min(grid.cell_size[1], grid.cell_size[2])) * 0.01f;
+		auto normal_at = [&](const vec<3>& p) -> vec<3> {
+			return (gradient ? gradient(p) : g::game::gradient_from_sdf(sdf, p, step)).unit();
+		};
+
+		auto inside = [](const vec<3>& p, const vec<3> box[2]) -> bool {
+			const float eps = 1e-4f;
+			for (int i = 0; i < 3; i++)
+			{
+				auto pad = (box[1][i] - box[0][i]) * eps;
+				if (p[i] < box[0][i] - pad || p[i] > box[1][i] + pad) { return false; }
+			}
+			return true;
+		};
+
+		// levels[k] holds nodes spanning 2^k cells per axis
+		std::vector<std::vector<node>> levels;
+		std::vector<unsigned> level_size;
+
+		levels.emplace_back((size_t)divisions * divisions * divisions);
+		level_size.push_back(divisions);
+
+		auto node_idx = [&](unsigned k, unsigned x, unsigned y, unsigned z) -> size_t {
+			auto n = (size_t)level_size[k];
+			return x + n * (y + n * z);
+		};
+
+		for (unsigned z = 0; z < divisions; z++)
+		for (unsigned y = 0; y < divisions; y++)
+		for (unsigned x = 0; x < divisions; x++)
+		{
+			auto& n = levels[0][node_idx(0, x, y, z)];
+			float d[8];
+
+			for (int i = 0; i < 8; i++)
+			{
+				d[i] = grid.at(x + c[i][0], y + c[i][1], z + c[i][2]);
+			}
+
+			for (int e = 0; e < 12; e++)
+			{
+				auto i0 = edge_list[e][0], i1 = edge_list[e][1];
+
+				if ((d[i0] >= 0) == (d[i1] >= 0)) { continue; }
+
+				auto w = d[i0] / (d[i0] - d[i1]);
+				auto p0 = grid.position(x + c[i0][0], y + c[i0][1], z + c[i0][2]);
+				auto p1 = grid.position(x + c[i1][0], y + c[i1][1], z + c[i1][2]);
+				vec<3> p = p1 * w + p0 * (1 - w);
+
+				n.qef.add(p, normal_at(p));
+			}
+
+			if (n.qef.count == 0) { continue; }
+
+			vec<3> box[2] = { grid.position(x, y, z), grid.position(x + 1, y + 1, z + 1) };
+			n.position = n.qef.solve();
+
+			// the planes may meet outside of the cell, such as at a corner whose
+			// cell isn't crossed by the surface. Keep the vertex inside the cell
+			n.position = n.position.take_max(box[0]).take_min(box[1]);
+		}
+
+		for (unsigned k = 1; max_error > 0 && level_size.back() > 1; k++)
+		{
+			auto size = (level_size.back() + 1) / 2;
+			level_size.push_back(size);
+			levels.emplace_back((size_t)size * size * size);
+
+			auto collapsed = 0;
+
+			for (unsigned z = 0; z < size; z++)
+			for (unsigned y = 0; y < size; y++)
+			for (unsigned x = 0; x < size; x++)
+			{
+				auto& n = levels[k][node_idx(k, x, y, z)];
+
+				for (int i = 0; i < 8; i++)
+				{
+					unsigned cx = x * 2 + c[i][0], cy = y * 2 + c[i][1], cz = z * 2 + c[i][2];
+					if (cx >= level_size[k - 1] || cy >= level_size[k - 1] || cz >= level_size[k - 1]) { continue; }
+
+					auto& child = levels[k - 1][node_idx(k - 1, cx, cy, cz)];
+					n.collapsible &= child.collapsible;
+					n.qef.add(child.qef);
+				}
+
+				if (!n.collapsible || n.qef.count == 0) { continue; }
+
+				auto span = 1u << k;
+				vec<3> box[2] = {
+					grid.position(x * span, y * span, z * span),
+					grid.position(std::min((x + 1) * span, divisions), std::min((y + 1) * span, divisions), std::min((z + 1) * span, divisions))
+				};
+
+				n.position = n.qef.solve();
+				n.collapsible = inside(n.position, box) && n.qef.error(n.position) <= max_error;
+				collapsed += n.collapsible;
+			}
+
+			if (collapsed == 0) { break; }
+		}
+
+		// the vertex of a cell is that of its highest collapsed ancestor
+		auto vertex_of = [&](unsigned x, unsigned y, unsigned z) -> int {
+			unsigned k = 0;
+
+			while (k + 1 < levels.size() && levels[k + 1][node_idx(k + 1, x >> (k + 1), y >> (k + 1), z >> (k + 1))].collapsible)
+			{
+				k++;
+			}
+
+			auto& n = levels[k][node_idx(k, x >> k, y >> k, z >> k)];
+
+			if (n.vertex < 0)
+			{
+				n.vertex = vertices_out.size();
+				vertices_out.push_back(generator(sdf, n.position));
+			}
+
+			return n.vertex;
+		};
+
+		auto emit = [&](int i0, int i1, int i2) {
+			if (i0 == i1 || i1 == i2 || i0 == i2) { return; }
+			indices_out.push_back(i0);
+			indices_out.push_back(i1);
+			indices_out.push_back(i2);
+		};
+
+		// each edge crossing the surface is shared by 4 cells, connect their
+		// vertices with a quad. Edges on the boundary of the volume are skipped
+		for (unsigned axis = 0; axis < 3; axis++)
+		{
+			auto u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+			for (unsigned z = 0; z <= divisions; z++)
+			for (unsigned y = 0; y <= divisions; y++)
+			for (unsigned x = 0; x <= divisions; x++)
+			{
+				unsigned o[3] = { x, y, z };
+
+				if (o[axis] == divisions) { continue; }
+				if (o[u] == 0 || o[u] == divisions || o[v] == 0 || o[v] == divisions) { continue; }
+
+				unsigned e[3] = { x, y, z };
+				e[axis]++;
+
+				auto d0 = grid.at(x, y, z);
+				auto d1 = grid.at(e[0], e[1], e[2]);
+
+				if ((d0 >= 0) == (d1 >= 0)) { continue; }
+
+				int q[4];
+				const unsigned around[4][2] = { { 1, 1 }, { 0, 1 }, { 0, 0 }, { 1, 0 } };
+
+				for (int i = 0; i < 4; i++)
+				{
+					unsigned cell[3] = { x, y, z };
+					cell[u] -= around[i][0];
+					cell[v] -= around[i][1];
+					q[i] = vertex_of(cell[0], cell[1], cell[2]);
+				}
+
+				if (d0 >= 0)
+				{
+					emit(q[0], q[1], q[2]);
+					emit(q[0], q[2], q[3]);
+				}
+				else
+				{
+					emit(q[0], q[2], q[1]);
+					emit(q[0], q[3], q[2]);
+				}
+			}
+		}
+	}
+
+	void from_sdf_dual(
+		const g::game::sdf& sdf,
+		std::function<V(const g::game::sdf& sdf, const vec<3>& pos)> generator,
+		vec<3> corners[2],
+		unsigned divisions=32,
+		float max_error=0,
+		g::game::sdf_gradient gradient=nullptr)
+	{
+		static std::vector<V> vertices;
+		static std::vector<uint32_t> indices;
+
+		from_sdf_dual(vertices, indices, sdf, generator, corners, divisions, max_error, gradient);
+
+		set_vertices(vertices);
+		set_indices(indices);
+	}
+};
+
+
+/**
+ * Algorithms available for meshing voxel volumes
+ */
+enum class voxel_mesher
+{
+	simple,  /**< a quad for every exposed voxel face */
+	greedy,  /**< coplanar faces of the same color merged into larger quads */
+	polygon, /**< coplanar faces merged into polygons, can't be used with chunked meshing */
+};
+
+struct mesh_factory
+{
+	static mesh<vertex::pos_uv_norm> plane(const vec<3>& normal={0, 0, 1}, const vec<2>& size={1, 1});
+
+	static mesh<vertex::pos> slice_cube(unsigned slices);
+
+	static mesh<vertex::pos_uv_norm> cube();
+
+	static mesh<vertex::pos_uv_norm> from_obj(const std::string& path);
+
+	/**
+	 * @brief      Meshes `size` voxels stored x fastest with the chosen mesher,
+	 * appending the result to `verts` and `indices`. Index order is reversed so
+	 * backface culling works correctly. `transform` is applied to each vertex
+	 * position before it is passed to `generator`.
+	 */
+	template<typename VERT>
+	static void mesh_voxels(
+		const uint8_t* voxels,
+		const vec<3, size_t>& size,
+		const ogt_mesh_rgba* palette,
+		voxel_mesher mode,
+		const std::function<VERT(ogt_mesh_vertex* vert_in)>& generator,
+		const std::function<vec<3>(const vec<3>& pos)>& transform,
+		std::vector<VERT>& verts,
+		std::vector<uint32_t>& indices)
+	{
+		ogt_voxel_meshify_context empty_ctx = {};
+		ogt_mesh* mesh = nullptr;
+
+		switch (mode)
+		{
+			case voxel_mesher::simple:
+				mesh = ogt_mesh_from_paletted_voxels_simple(&empty_ctx, voxels, size[0], size[1], size[2], palette);
+				break;
+			case voxel_mesher::greedy:
+				mesh = ogt_mesh_from_paletted_voxels_greedy(&empty_ctx, voxels, size[0], size[1], size[2], palette);
+				break;
+			case voxel_mesher::polygon:
+				mesh = ogt_mesh_from_paletted_voxels_polygon(&empty_ctx, voxels, size[0], size[1], size[2], palette);
+				break;
+		}
+
+		auto base = verts.size();
+		auto index_base = indices.size();
+		verts.resize(base + mesh->vertex_count);
+		indices.resize(index_base + mesh->index_count);
+
+		for (unsigned i = 0; i < mesh->vertex_count; i++)
+		{
+			auto& v_in = mesh->vertices[i];
+
+			if (transform)
+			{
+				auto p = transform(vec<3>{ v_in.pos.x, v_in.pos.y, v_in.pos.z });
+				v_in.pos = { p[0], p[1], p[2] };
+			}
+
+			verts[base + i] = generator(&v_in);
+		}
+
+		for (unsigned i = 0; i < mesh->index_count; i++)
+		{
+			indices[index_base + i] = mesh->indices[(mesh->index_count - 1) - i] + base;
+		}
+
+		ogt_mesh_destroy(&empty_ctx, mesh);
+	}
+
+	/**
+	 * @brief      Meshes one chunk of a larger volume. `padded` holds the chunk's
+	 * voxels surrounded by a one voxel apron copied from its neighbors, so no
+	 * faces are generated between touching chunks. Faces belonging to apron
+	 * voxels are discarded and greedy quads reaching into the apron are clipped
+	 * to the chunk, so neighboring chunks never overlap.
+	 *
+	 * @param      padded   (extent + 2)^3 voxels, x fastest.
+	 * @param[in]  extent   Size of the chunk without its apron.
+	 * @param[in]  offset   Position of the chunk's min corner in the volume.
+	 */
+	template<typename VERT>
+	static void mesh_chunk(
+		const uint8_t* padded,
+		const vec<3, size_t>& extent,
+		const vec<3>& offset,
+		const ogt_mesh_rgba* palette,
+		voxel_mesher mode,
+		const std::function<VERT(ogt_mesh_vertex* vert_in)>& generator,
+		std::vector<VERT>& verts,
+		std::vector<uint32_t>& indices)
+	{
+		assert(mode != voxel_mesher::polygon); // polygons can't be clipped to the chunk
+
+		ogt_voxel_meshify_context empty_ctx = {};
+		auto padded_size = extent + 2;
+		ogt_mesh* mesh = mode == voxel_mesher::greedy ?
+			ogt_mesh_from_paletted_voxels_greedy(&empty_ctx, padded, padded_size[0], padded_size[1], padded_size[2], palette) :
+			ogt_mesh_from_paletted_voxels_simple(&empty_ctx, padded, padded_size[0], padded_size[1], padded_size[2], palette);
+
+		std::vector<int> remap(mesh->vertex_count, -1);
+
+		auto clip = [&](const ogt_mesh_vec3& p) -> vec<3> {
+			vec<3> c = { p.x, p.y, p.z };
+			for (int a = 0; a < 3; a++) { c[a] = std::min(std::max(c[a], 1.f), 1.f + extent[a]); }
+			return c;
+		};
+
+		for (unsigned i = mesh->index_count; i >= 3; i -= 3)
+		{
+			uint32_t tri[3] = { mesh->indices[i - 1], mesh->indices[i - 2], mesh->indices[i - 3] };
+			auto& n = mesh->vertices[tri[0]].normal;
+			const float normal[3] = { n.x, n.y, n.z };
+			bool keep = true;
+
+			// step back from the face along its normal into the voxel it belongs to
+			for (int a = 0; a < 3; a++)
+			{
+				if (normal[a] == 0) { continue; }
+
+				auto plane = (&mesh->vertices[tri[0]].pos.x)[a];
+				auto owner = plane - normal[a] * 0.5f;
+				keep &= owner > 1 && owner < 1 + extent[a];
+			}
+
+			if (!keep) { continue; }
+
+			auto p0 = clip(mesh->vertices[tri[0]].pos);
+			auto p1 = clip(mesh->vertices[tri[1]].pos);
+			auto p2 = clip(mesh->vertices[tri[2]].pos);
+
+			// entirely within the apron
+			if (vec<3>::cross(p1 - p0, p2 - p0).magnitude() == 0) { continue; }
+
+			for (auto t : tri)
+			{
+				if (remap[t] < 0)
+				{
+					auto v = mesh->vertices[t];
+					auto p = clip(v.pos) + offset - 1.f;
+					v.pos = { p[0], p[1], p[2] };
+					remap[t] = verts.size();
+					verts.push_back(generator(&v));
+				}
+
+				indices.push_back(remap[t]);
+			}
+		}
+
+		ogt_mesh_destroy(&empty_ctx, mesh);
+	}
+
+	/**
+	 * @brief      Copies the chunk of `vox` spanning [origin, origin + extent)
+	 * along with a one voxel apron into `padded`, x fastest.
+	 */
+	template<typename VOXELS>
+	static void pad_chunk(const VOXELS& vox, const vec<3, size_t>& origin, const vec<3, size_t>& extent, std::vector<uint8_t>& padded)
+	{
+		auto P = extent + 2;
+		padded.resize(P[0] * P[1] * P[2]);
+
+		for (size_t z = 0; z < P[2]; z++)
+		for (size_t y = 0; y < P[1]; y++)
+		for (size_t x = 0; x < P[0]; x++)
+		{
+			long c[3] = { (long)(origin[0] + x) - 1, (long)(origin[1] + y) - 1, (long)(origin[2] + z) - 1 };
+			auto& p = padded[x + P[0] * (y + P[1] * z)];
+			p = 0;
+
+			if (c[0] < 0 || c[1] < 0 || c[2] < 0) { continue; }
+			if (c[0] >= (long)vox.width || c[1] >= (long)vox.height || c[2] >= (long)vox.depth) { continue; }
+
+			p = vox.idx(c[0], c[1], c[2]);
+		}
+	}
+
+	template<typename VERT>
+	static mesh<VERT> from_voxels(const g::game::voxels<uint8_t>& vox, ogt_vox_palette& palette, std::function<VERT(ogt_mesh_vertex* vert_in)> generator, voxel_mesher mode=voxel_mesher::simple)
+	{
+		mesh<VERT> m;
+		std::vector<VERT> verts;
+		std::vector<uint32_t> indices;
+
+		glGenBuffers(2, &m.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, m.vbo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.ibo);
+
+		assert(GL_TRUE == glIsBuffer(m.vbo));
+		assert(GL_TRUE == glIsBuffer(m.ibo));
+
+		mesh_voxels<VERT>(vox.v.data(), vox.size, (const ogt_mesh_rgba*)palette.color, mode, generator, nullptr, verts, indices);
+
+		m.set_vertices(verts);
+		m.set_indices(indices);
+
+		return m;
+	}
+
+	/**
+	 * @brief      Meshes `vox` in cubic chunks of `chunk_size` voxels per side,
+	 * which are meshed concurrently on the workers of `pool`. The output of each
+	 * chunk is then copied into vertex and index buffers sized to fit all chunks.
+	 */
+	template<typename VERT, size_t POOL_SIZE>
+	static mesh<VERT> from_voxels(
+		const g::game::voxels<uint8_t>& vox,
+		ogt_vox_palette& palette,
+		std::function<VERT(ogt_mesh_vertex* vert_in)> generator,
+		voxel_mesher mode,
+		g::proc::thread_pool<POOL_SIZE>& pool,
+		size_t chunk_size=32)
+	{
+		struct chunk
+		{
+			std::vector<VERT> verts;
+			std::vector<uint32_t> indices;
+		};
+
+		mesh<VERT> m;
+		glGenBuffers(2, &m.vbo);
+
+		vec<3, size_t> chunks = (vox.size + (chunk_size - 1)) / chunk_size;
+		std::vector<chunk> meshed(chunks[0] * chunks[1] * chunks[2]);
+
+		g::proc::parallel_for(pool, meshed.size(), [&](size_t ci) {
+			static thread_local std::vector<uint8_t> padded;
+			vec<3, size_t> c = { ci % chunks[0], (ci / chunks[0]) % chunks[1], ci / (chunks[0] * chunks[1]) };
+			auto origin = c * chunk_size;
+			auto extent = (origin + chunk_size).take_min(vox.size) - origin;
+
+			pad_chunk(vox, origin, extent, padded);
+			mesh_chunk<VERT>(padded.data(), extent, origin.template cast<float>(), (const ogt_mesh_rgba*)palette.color, mode, generator, meshed[ci].verts, meshed[ci].indices);
+		});
+
+		std::vector<size_t> vert_base(meshed.size() + 1, 0), index_base(meshed.size() + 1, 0);
+		for (size_t i = 0; i < meshed.size(); i++)
+		{
+			vert_base[i + 1] = vert_base[i] + meshed[i].verts.size();
+			index_base[i + 1] = index_base[i] + meshed[i].indices.size();
+		}
+
+		std::vector<VERT> verts(vert_base.back());
+		std::vector<uint32_t> indices(index_base.back());
+
+		g::proc::parallel_for(pool, meshed.size(), [&](size_t ci) {
+			std::copy(meshed[ci].verts.begin(), meshed[ci].verts.end(), verts.begin() + vert_base[ci]);
+
+			for (size_t i = 0; i < meshed[ci].indices.size(); i++)
+			{
+				indices[index_base[ci] + i] = meshed[ci].indices[i] + vert_base[ci];
+			}
+		});
+
+		m.set_vertices(verts);
+		m.set_indices(indices);
+
+		return m;
+	}
+
+	/**
+	 * @brief      Meshes a sparse voxel volume one brick at a time, skipping empty
+	 * bricks. Each brick is meshed along with a one voxel apron copied from its
+	 * neighbors so no faces are generated between touching bricks.
+	 */
+	template<typename VERT, size_t BRICK_SIZE>
+	static mesh<VERT> from_voxels(g::game::sparse_voxels<uint8_t, BRICK_SIZE>& vox, ogt_vox_palette& palette, std::function<VERT(ogt_mesh_vertex* vert_in)> generator, voxel_mesher mode=voxel_mesher::simple)
+	{
+		mesh<VERT> m;
+		std::vector<VERT> verts;
+		std::vector<uint32_t> indices;
+		std::vector<uint8_t> padded;
+
+		glGenBuffers(2, &m.vbo);
+
+		vox.each_brick([&](const vec<3, size_t>& origin, uint8_t* brick) {
+			auto extent = (origin + BRICK_SIZE).take_min(vox.size) - origin;
+
+			pad_chunk(vox, origin, extent, padded);
+			mesh_chunk<VERT>(padded.data(), extent, origin.template cast<float>(), (const ogt_mesh_rgba*)palette.color, mode, generator, verts, indices);
+		});
+
+		m.set_vertices(verts);
+		m.set_indices(indices);
+
+		return m;
+	}
+
+	template<typename VERT>
+	static mesh<VERT> from_voxels(g::game::voxels_paletted& vox, std::function<VERT(ogt_mesh_vertex* vert_in)> generator, voxel_mesher mode=voxel_mesher::simple)
+	{
+		return from_voxels<VERT>(vox, vox.palette, generator, mode);
+	}
+
+	template<typename VERT>
+	static mesh<VERT> from_voxels(g::game::vox_scene& vox, std::function<VERT(ogt_mesh_vertex* vert_in)> generator, voxel_mesher mode=voxel_mesher::simple)
+	{
+		mesh<VERT> m;
+		std::vector<VERT> verts;
+		std::vector<uint32_t> indices;
+
+		glGenBuffers(2, &m.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, m.vbo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.ibo);
+
+		assert(GL_TRUE == glIsBuffer(m.vbo));
+		assert(GL_TRUE == glIsBuffer(m.ibo));
+
+		auto group_world = vox.group_transforms();
+
+		for (auto& kvp : vox.instances)
+		{
+			auto& inst = kvp.second;
+			auto T = vox.world_transform(inst, group_world);
+			auto half = (inst.model->size / 2).cast<float>();
+
+			mesh_voxels<VERT>(inst.model->v.data(), inst.model->size, (const ogt_mesh_rgba*)vox.palette.color, mode, generator, [&](const vec<3>& p) -> vec<3> {
+				return T * p - half;
+			}, verts, indices);
+		}
+
+		m.set_vertices(verts);
+		m.set_indices(indices);
+
+		return m;
+	}
+
+	/**
+	 * @brief      Meshes every instance of a scene concurrently on the workers of
+	 * `pool`, then copies the results in order into buffers sized to fit.
+	 */
+	template<typename VERT, size_t POOL_SIZE>
+	static mesh<VERT> from_voxels(g::game::vox_scene& vox, std::function<VERT(ogt_mesh_vertex* vert_in)> generator, voxel_mesher mode, g::proc::thread_pool<POOL_SIZE>& pool)
+	{
+		struct instance_mesh
+		{
+			const g::game::vox_scene::model_instance* inst;
+			std::vector<VERT> verts;
+			std::vector<uint32_t> indices;
+		};
+
+		mesh<VERT> m;
+		glGenBuffers(2, &m.vbo);
+
+		auto group_world = vox.group_transforms();
+		std::vector<instance_mesh> meshed;
+		for (auto& kvp : vox.instances) { meshed.push_back({ &kvp.second }); }
+
+		g::proc::parallel_for(pool, meshed.size(), [&](size_t i) {
+			const g::game::vox_scene::model_instance& inst = *meshed[i].inst;
+			auto T = vox.world_transform(inst, group_world);
+			auto half = (inst.model->size / 2).cast<float>();
+
+			mesh_voxels<VERT>(inst.model->v.data(), inst.model->size, (const ogt_mesh_rgba*)vox.palette.color, mode, generator, [&](const vec<3>& p) -> vec<3> {
+				return T * p - half;
+			}, meshed[i].verts, meshed[i].indices);
+		});
+
+		size_t vert_count = 0, index_count = 0;
+		for (auto& im : meshed)
+		{
+			vert_count += im.verts.size();
+			index_count += im.indices.size();
+		}
+
+		std::vector<VERT> verts;
+		std::vector<uint32_t> indices;
+		verts.reserve(vert_count);
+		indices.reserve(index_count);
+
+		for (auto& im : meshed)
+		{
+			auto base = (uint32_t)verts.size();
+			verts.insert(verts.end(), im.verts.begin(), im.verts.end());
+			for (auto i : im.indices) { indices.push_back(i + base); }
+		}
+
+		m.set_vertices(verts);
+		m.set_indices(indices);
+
+		return m;
+	}
 
 	template<typename VERT>
 	static mesh<VERT> from_heightmap(const texture& tex, std::function<VERT(const texture& tex, int x, int y)> generator)
@@ -1294,6 +2193,26 @@ struct mesh_factory
 		return m;
 	}
 
+	/**
+	 * @brief      Creates a mesh of `sdf` by dual contouring, see `mesh::from_sdf_dual`.
+	 */
+	template<typename VERT>
+	static mesh<VERT> from_sdf_dual(
+		g::game::sdf sdf,
+		std::function<VERT(const g::game::sdf& sdf, const vec<3>& pos)> generator,
+		vec<3> volume_corners[2],
+		unsigned divisions=32,
+		float max_error=0,
+		g::game::sdf_gradient gradient=nullptr)
+	{
+		mesh<VERT> m;
+		glGenBuffers(2, &m.vbo);
+
+		m.from_sdf_dual(sdf, generator, volume_corners, divisions, max_error, gradient);
+
+		return m;
+	}
+
 	template<typename V>
 	static mesh<V> empty_mesh()
 	{
@@ -1364,9 +2283,36 @@ namespace debug
 }
 
 
-template<typename V>
+template<typename V, size_t MESHER_THREADS=4>
 struct density_volume
 {
+    /**
+     * @brief      Lattice levels of a block and each of its 26 neighbours. Index 13
+     * is the block itself, the neighbour at offset (x, y, z) is found at
+     * (x + 1) + 3 * ((y + 1) + 3 * (z + 1)).
+     */
+    using lod_signature = std::array<unsigned, 27>;
+
+    enum class residency
+    {
+        free,     /**< unused, may be handed out for any block index */
+        resident, /**< in range of the camera and drawn */
+        cached,   /**< out of range, mesh kept in case the camera returns */
+    };
+
+    /**
+     * @brief      Spatial hash of integer block indices
+     */
+    struct index_hash
+    {
+        size_t operator()(const vec<3, int>& i) const
+        {
+            return ((size_t)(uint32_t)i[0] * 73856093u) ^
+                   ((size_t)(uint32_t)i[1] * 19349663u) ^
+                   ((size_t)(uint32_t)i[2] * 83492791u);
+        }
+    };
+
     struct block
     {
         g::gfx::mesh<V> mesh;
@@ -1377,6 +2323,9 @@ struct density_volume
         vec<3> bounding_box[2];
         uint8_t vertex_case = 0;
         bool regenerating = false;
+        residency state = residency::free;
+        lod_signature lods = {};
+        size_t triangles = 0;
         std::chrono::time_point<std::chrono::system_clock> start;
 
         inline bool contains(const vec<3>& pos) const
@@ -1388,135 +2337,552 @@ struct density_volume
 
         inline bool contains(const vec<3, int> idx) const
         {
-            return index == idx;
+            return index == idx;
+        }
+    };
+
+    /**
+     * @brief      Stitches a block to neighbours meshed at coarser levels of detail
+     * in the spirit of Transvoxel's transition cells. Densities sampled on a face,
+     * edge or corner that is shared with a coarser block are interpolated from
+     * the coarsest lattice touching that point, so both blocks see the same
+     * field there. Vertices emitted on a shared face are then snapped onto the
+     * coarse block's iso-segments so the finer boundary lies exactly on the
+     * coarser one and no cracks open between them.
+     */
+    struct seam
+    {
+        const g::game::sdf& sdf;
+        vec<3> box[2];
+        float block_size;
+        unsigned base_divisions;
+        lod_signature lods;
+
+        inline float cell(unsigned lod) const
+        {
+            return block_size / (float)std::max<unsigned>(1, base_divisions >> lod);
+        }
+
+        /**
+         * @brief      Finds which faces of the block `p` lies on. Each element of
+         * side is -1 for the min face, 1 for the max face or 0 for neither.
+         *
+         * @return     Number of faces p lies on.
+         */
+        int sides(const vec<3>& p, int side[3]) const
+        {
+            constexpr float eps = 1e-4f;
+            int count = 0;
+
+            for (int a = 0; a < 3; a++)
+            {
+                auto t = (p[a] - box[0][a]) / block_size;
+                side[a] = (t <= eps) ? -1 : ((t >= 1 - eps) ? 1 : 0);
+                count += side[a] != 0;
+            }
+
+            return count;
+        }
+
+        /**
+         * @brief      The coarsest level of detail of all blocks touching `p`.
+         */
+        unsigned level_at(const int side[3]) const
+        {
+            unsigned level = lods[13];
+
+            for (int z = std::min(0, side[2]); z <= std::max(0, side[2]); z++)
+            for (int y = std::min(0, side[1]); y <= std::max(0, side[1]); y++)
+            for (int x = std::min(0, side[0]); x <= std::max(0, side[0]); x++)
+            {
+                level = std::max(level, lods[(x + 1) + 3 * ((y + 1) + 3 * (z + 1))]);
+            }
+
+            return level;
+        }
+
+        /**
+         * @brief      Indices of the lattice cell at `level` containing p along `axis`
+         * and the fractional position of p within that cell.
+         */
+        inline int lattice(const vec<3>& p, int axis, unsigned level, float& frac) const
+        {
+            auto c = cell(level);
+            auto u = (p[axis] - box[0][axis]) / c;
+            auto max_i = (int)std::max<unsigned>(1, base_divisions >> level) - 1;
+            auto i = std::min(max_i, std::max(0, (int)floorf(u)));
+            frac = u - i;
+            return i;
+        }
+
+        float field(const vec<3>& p) const
+        {
+            constexpr float eps = 1e-3f;
+            int side[3];
+            auto count = sides(p, side);
+
+            if (count == 0 || count == 3) { return sdf(p); }
+
+            auto level = level_at(side);
+            if (level <= lods[13]) { return sdf(p); }
+
+            auto c = cell(level);
+
+            if (count == 2)
+            { // on an edge shared by up to 4 blocks, lerp along the free axis
+                int f = side[0] == 0 ? 0 : (side[1] == 0 ? 1 : 2);
+                float t;
+                auto i = lattice(p, f, level, t);
+
+                if (t < eps || t > 1 - eps) { return sdf(p); }
+
+                auto p0 = p, p1 = p;
+                p0[f] = box[0][f] + i * c;
+                p1[f] = box[0][f] + (i + 1) * c;
+
+                return sdf(p0) * (1 - t) + sdf(p1) * t;
+            }
+
+            // on a face shared with one block, bilerp across the coarse square
+            int a = side[0] != 0 ? 0 : (side[1] != 0 ? 1 : 2);
+            int f0 = (a + 1) % 3, f1 = (a + 2) % 3;
+            float t0, t1;
+            auto i0 = lattice(p, f0, level, t0);
+            auto i1 = lattice(p, f1, level, t1);
+
+            if ((t0 < eps || t0 > 1 - eps) && (t1 < eps || t1 > 1 - eps)) { return sdf(p); }
+
+            float d[2][2];
+            for (int j = 0; j < 2; j++)
+            for (int i = 0; i < 2; i++)
+            {
+                auto q = p;
+                q[f0] = box[0][f0] + (i0 + i) * c;
+                q[f1] = box[0][f1] + (i1 + j) * c;
+                d[j][i] = field(q);
+            }
+
+            return (d[0][0] * (1 - t0) + d[0][1] * t0) * (1 - t1) +
+                   (d[1][0] * (1 - t0) + d[1][1] * t0) * t1;
+        }
+
+        vec<3> snap(const vec<3>& p) const
+        {
+            int side[3];
+            if (sides(p, side) != 1) { return p; }
+
+            auto level = level_at(side);
+            if (level <= lods[13]) { return p; }
+
+            auto c = cell(level);
+            int a = side[0] != 0 ? 0 : (side[1] != 0 ? 1 : 2);
+            int f0 = (a + 1) % 3, f1 = (a + 2) % 3;
+            float t0, t1;
+            auto i0 = lattice(p, f0, level, t0);
+            auto i1 = lattice(p, f1, level, t1);
+
+            // corners of the coarse square, wound around its perimeter
+            const int square[4][2] = { {0, 0}, {1, 0}, {1, 1}, {0, 1} };
+            vec<3> q[4];
+            float d[4];
+            for (int k = 0; k < 4; k++)
+            {
+                q[k] = p;
+                q[k][f0] = box[0][f0] + (i0 + square[k][0]) * c;
+                q[k][f1] = box[0][f1] + (i1 + square[k][1]) * c;
+                d[k] = field(q[k]);
+            }
+
+            // points where the coarse block's surface crosses the square's edges
+            vec<3> x[4];
+            int crossings = 0;
+            for (int k = 0; k < 4; k++)
+            {
+                auto& d0 = d[k];
+                auto& d1 = d[(k + 1) % 4];
+                if ((d0 >= 0) == (d1 >= 0)) { continue; }
+
+                auto w = d0 / (d0 - d1);
+                x[crossings++] = q[k] + (q[(k + 1) % 4] - q[k]) * w;
+            }
+
+            if (crossings < 2) { return p; }
+
+            auto nearest = p;
+            auto best = std::numeric_limits<float>::infinity();
+            for (int k = 0; k < crossings; k++)
+            {
+                // with 4 crossings the square is ambiguous, consider every pairing
+                if (crossings == 2 && k > 0) { break; }
+
+                auto& s0 = x[k];
+                auto& s1 = x[(k + 1) % crossings];
+                auto s = s1 - s0;
+                auto len_sqr = s.dot(s);
+                auto t = len_sqr > 0 ? std::min(1.f, std::max(0.f, (p - s0).dot(s) / len_sqr)) : 0.f;
+                auto on_seg = s0 + s * t;
+                auto dist = (on_seg - p).dot(on_seg - p);
+
+                if (dist < best) { best = dist; nearest = on_seg; }
+            }
+
+            return nearest;
+        }
+    };
+
+    std::deque<density_volume::block> blocks; /**< storage for all blocks, a deque so pointers remain valid as it grows */
+    std::vector<vec<3>> offsets;
+
+    const g::game::sdf& sdf;
+    std::function<V(const g::game::sdf& sdf, const vec<3>& pos)> generator;
+    float scale = 1;
+    unsigned depth = 1;
+    unsigned kernel = 2;
+    unsigned divisions = 0; /**< when non-zero blocks are meshed on a uniform grid of this many cells per axis using `mesher_pool` instead of `from_sdf_r` */
+    unsigned lod_levels = 1; /**< number of detail levels, each halves `divisions`. Requires `divisions` > 0 */
+    unsigned lod_ring_width = 1; /**< width in blocks of the ring of blocks around the camera sharing a level */
+    unsigned lod_bias = 0; /**< extra levels applied beyond the camera's block, raised and lowered to meet `triangle_budget` */
+    size_t triangle_budget = 0; /**< max triangles drawn per frame, 0 for unlimited */
+    size_t triangles = 0; /**< triangles drawn in the last frame */
+    size_t in_flight = 0; /**< blocks being remeshed */
+    size_t cache_size = 32; /**< number of out of range block meshes kept for reuse */
+    float hidden_penalty = 4; /**< blocks outside the view frustum are scheduled as if they were this many times further away */
+    g::proc::thread_pool<MESHER_THREADS> mesher_pool;
+    g::proc::thread_pool<2> generator_pool; /**< declared after `mesher_pool`, so it's joined first as its tasks queue work on `mesher_pool` */
+
+    std::unordered_map<vec<3, int>, density_volume::block*, index_hash> resident;
+    std::unordered_map<vec<3, int>, typename std::list<density_volume::block*>::iterator, index_hash> cached;
+    std::list<density_volume::block*> lru; /**< cached blocks, most recently used first */
+    std::vector<density_volume::block*> free_blocks;
+    std::unordered_set<vec<3, int>, index_hash> in_range; /**< offsets as block indices, rebuilt each update */
+
+    density_volume() = default;
+
+    density_volume(
+        const g::game::sdf& sdf,
+        std::function<V(const g::game::sdf& sdf, const vec<3>& pos)> generator,
+        const std::vector<vec<3>>& offset_config) :
+        
+        offsets(offset_config),
+        sdf(sdf)
+    {
+        // this->sdf = sdf;
+        this->generator = generator;
+
+        for (auto& offset : offsets)
+        {
+            // meshes are created once a block is first uploaded
+            density_volume::block block;
+
+            // auto pipo = offset.template cast<int>();
+
+            // block.bounding_box[0] = (pipo * scale).template cast<float>();
+            // block.bounding_box[1] = ((pipo + 1) * scale).template cast<float>();
+
+            // block.index = (offset * scale).template cast<int>();
+
+            // // block.mesh.from_sdf_r(sdf, generator, block.bounding_box, depth);
+            // block.mesh.from_sdf(sdf, generator, block.bounding_box);
+
+            blocks.push_back(block);
+            free_blocks.push_back(&blocks.back());
+        }
+    }
+
+    /**
+     * @brief      Level of detail a block should be meshed at given the block
+     * the camera is in. Levels increase (coarsen) with each ring of blocks.
+     */
+    unsigned lod_at(const vec<3, int>& block_idx, const vec<3, int>& camera_idx) const
+    {
+        if (divisions == 0) { return 0; }
+
+        auto d = block_idx - camera_idx;
+        unsigned ring = std::max(abs(d[0]), std::max(abs(d[1]), abs(d[2])));
+        unsigned lod = ring / std::max<unsigned>(1, lod_ring_width) + (ring > 0 ? lod_bias : 0);
+        unsigned max_lod = lod_levels > 0 ? lod_levels - 1 : 0;
+
+        // never coarser than a single cell per block
+        while (max_lod > 0 && (divisions >> max_lod) == 0) { max_lod--; }
+
+        return std::min(lod, max_lod);
+    }
+
+    lod_signature lods_at(const vec<3, int>& block_idx, const vec<3, int>& camera_idx) const
+    {
+        lod_signature lods;
+
+        for (int z = -1; z <= 1; z++)
+        for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++)
+        {
+            lods[(x + 1) + 3 * ((y + 1) + 3 * (z + 1))] = lod_at(block_idx + vec<3, int>{x, y, z}, camera_idx);
+        }
+
+        return lods;
+    }
+
+    /**
+     * @brief      Schedules meshing of `block_ptr` for the block at `block_idx`.
+     * The block's current mesh is still drawn until the new one is ready.
+     */
+    void regenerate(density_volume::block* block_ptr, const vec<3, int>& block_idx, const lod_signature& lods)
+    {
+        block_ptr->regenerating = true;
+        block_ptr->lods = lods;
+        in_flight++;
+        block_ptr->bounding_box[0] = (block_idx * scale).template cast<float>();
+        block_ptr->bounding_box[1] = ((block_idx + 1) * scale).template cast<float>();
+        block_ptr->index = block_idx;
+
+        generator_pool.run(
+        // generation task
+        [this, block_ptr](){
+        	block_ptr->start = std::chrono::system_clock::now();
+
+            if (divisions > 0)
+            {
+                seam s = { sdf, { block_ptr->bounding_box[0], block_ptr->bounding_box[1] }, scale, divisions, block_ptr->lods };
+                auto block_divisions = std::max<unsigned>(1, divisions >> block_ptr->lods[13]);
+
+                g::game::sdf field = [&s](const vec<3>& p) -> float { return s.field(p); };
+                std::function<V(const g::game::sdf&, const vec<3>&)> stitched = [&](const g::game::sdf&, const vec<3>& p) -> V {
+                    return generator(sdf, s.snap(p));
+                };
+
+                block_ptr->mesh.from_sdf(block_ptr->vertices, block_ptr->indices, field, stitched, block_ptr->bounding_box, block_divisions, mesher_pool);
+
+                // from_sdf_r emits the opposite winding of from_sdf, flip to match
+                auto& inds = block_ptr->indices;
+                for (size_t i = 0; i + 2 < inds.size(); i += 3) { std::swap(inds[i + 1], inds[i + 2]); }
+            }
+            else
+            {
+                block_ptr->mesh.from_sdf_r(block_ptr->vertices, block_ptr->indices, sdf, generator, block_ptr->bounding_box, depth);
+            }
+            // block_ptr->mesh.from_sdf(block_ptr->vertices, block_ptr->indices, sdf, generator, block_ptr->bounding_box);
+        },
+        // on finish
+        [this, block_ptr](){
+            if (!block_ptr->mesh.is_initialized()) { block_ptr->mesh = g::gfx::mesh_factory{}.empty_mesh<V>(); }
+            block_ptr->mesh.set_vertices(block_ptr->vertices);
+            block_ptr->mesh.set_indices(block_ptr->indices);
+            block_ptr->triangles = block_ptr->indices.size() / 3;
+            // cleared only once uploaded so the block can't be rescheduled while
+            // its vertices are still waiting to be copied to the gpu
+            block_ptr->regenerating = false;
+            in_flight--;
+
+#ifdef G_GFX_DENSITY_VOLUME_DEBUG
+            char buf[256];
+            std::chrono::duration<float> diff = std::chrono::system_clock::now() - block_ptr->start;
+            snprintf(buf, sizeof(buf), "%lu vertices - block %s in %f sec\n", block_ptr->vertices.size(), block_ptr->index.to_string().c_str(), diff.count());
+            write(1, buf, strlen(buf));
+#endif
+        });
+    }
+
+    /**
+     * @brief      Moves a resident block into the cache, dropping the least
+     * recently used cached blocks if the cache is full.
+     */
+    void cache(density_volume::block* block_ptr)
+    {
+        resident.erase(block_ptr->index);
+        block_ptr->state = residency::cached;
+        lru.push_front(block_ptr);
+        cached[block_ptr->index] = lru.begin();
+
+        while (lru.size() > cache_size)
+        {
+            auto evicted = lru.back();
+            lru.pop_back();
+            cached.erase(evicted->index);
+            evicted->state = residency::free;
+            free_blocks.push_back(evicted);
+        }
+    }
+
+    /**
+     * @brief      Finds a block which can be meshed for a new block index. Free
+     * blocks are used first, then the least recently used cached block, and
+     * a new block is allocated if neither are available.
+     */
+    density_volume::block* acquire()
+    {
+        density_volume::block* block_ptr = nullptr;
+
+        if (free_blocks.size() > 0)
+        {
+            block_ptr = free_blocks.back();
+            free_blocks.pop_back();
+        }
+        else if (lru.size() > 0)
+        {
+            block_ptr = lru.back();
+            lru.pop_back();
+            cached.erase(block_ptr->index);
+        }
+        else
+        {
+            blocks.push_back({});
+            block_ptr = &blocks.back();
         }
-    };
 
-    std::vector<density_volume::block> blocks;
-    std::vector<vec<3>> offsets;
+        // don't draw geometry from the block's previous location
+        block_ptr->triangles = 0;
+        block_ptr->state = residency::resident;
 
-    const g::game::sdf& sdf;
-    std::function<V(const g::game::sdf& sdf, const vec<3>& pos)> generator;
-    float scale = 1;
-    unsigned depth = 1;
-    unsigned kernel = 2;
-    std::vector<density_volume::block*> to_regenerate;
-    g::proc::thread_pool<2> generator_pool;
+        return block_ptr;
+    }
 
-    density_volume() = default;
+    struct candidate
+    {
+        float priority;
+        vec<3, int> index;
+        density_volume::block* block_ptr; /**< null if a block must be acquired */
+    };
 
-    density_volume(
-        const g::game::sdf& sdf,
-        std::function<V(const g::game::sdf& sdf, const vec<3>& pos)> generator,
-        const std::vector<vec<3>>& offset_config) :
-        
-        offsets(offset_config),
-        sdf(sdf)
+    /**
+     * @brief      Retires blocks which have left the range of a camera at `pos`
+     * into the cache, then finds the blocks in range which need meshing.
+     *
+     * @param[in]  vp    View projection matrix of the camera, blocks outside
+     *                   its frustum are deprioritized.
+     *
+     * @return     Blocks to mesh, most urgent first.
+     */
+    std::vector<candidate> schedule(const vec<3>& pos, const mat<4, 4>& vp)
     {
-        // this->sdf = sdf;
-        this->generator = generator;
+        auto pidx = ((pos / scale) - 0.5f).template cast<int>();
 
-        for (auto& offset : offsets)
-        {
-            density_volume::block block;
-            block.mesh = g::gfx::mesh_factory{}.empty_mesh<V>();
+        in_range.clear();
+        for (auto& offset : offsets) { in_range.insert(offset.template cast<int>()); }
 
-            // auto pipo = offset.template cast<int>();
+        { // retire blocks that have fallen out of range into the cache
+            std::vector<density_volume::block*> out_of_range;
 
-            // block.bounding_box[0] = (pipo * scale).template cast<float>();
-            // block.bounding_box[1] = ((pipo + 1) * scale).template cast<float>();
+            for (auto& kvp : resident)
+            {
+                auto block_ptr = kvp.second;
 
-            // block.index = (offset * scale).template cast<int>();
+                if (block_ptr->regenerating) { continue; }
+                if (in_range.count(block_ptr->index - pidx) > 0) { continue; }
 
-            // // block.mesh.from_sdf_r(sdf, generator, block.bounding_box, depth);
-            // block.mesh.from_sdf(sdf, generator, block.bounding_box);
+                out_of_range.push_back(block_ptr);
+            }
 
-            blocks.push_back(block);
+            for (auto block_ptr : out_of_range) { cache(block_ptr); }
         }
-    }
-
-    void update(const g::game::camera& cam)
-    {
-        auto pos = cam.position;
-        std::set<unsigned> unvisited;
 
-        for (unsigned i = 0; i < offsets.size(); i++) { unvisited.insert(i); }
+        std::vector<candidate> pending;
 
-        auto pidx = ((pos / scale) - 0.5f).template cast<int>();
-
-        generator_pool.update();
-
-        for (auto& block : blocks)
+        for (auto& offset : offsets)
         {
-            if (block.regenerating) { continue; }
-
-            bool needs_regen = true;
+            auto idx = pidx + offset.template cast<int>();
+            auto lods = lods_at(idx, pidx);
+            density_volume::block* block_ptr = nullptr;
 
-            for (auto oi : unvisited)
+            auto res_itr = resident.find(idx);
+            if (res_itr != resident.end())
             {
-                auto pipo = pidx + offsets[oi].template cast<int>();
-
-                if (block.contains(pipo))
-                {
-                    unvisited.erase(oi);
-                    needs_regen = false;
-                    break;
+                block_ptr = res_itr->second;
+            }
+            else
+            {
+                auto cache_itr = cached.find(idx);
+                if (cache_itr != cached.end())
+                { // revisited, reuse the cached mesh
+                    block_ptr = *cache_itr->second;
+                    lru.erase(cache_itr->second);
+                    cached.erase(cache_itr);
+                    block_ptr->state = residency::resident;
+                    resident[idx] = block_ptr;
                 }
             }
 
-            if (needs_regen) { to_regenerate.push_back(&block); }
+            if (block_ptr != nullptr && (block_ptr->regenerating || block_ptr->lods == lods)) { continue; }
+
+            vec<3> box[2] = { (idx * scale).template cast<float>(), ((idx + 1) * scale).template cast<float>() };
+            auto center = (box[0] + box[1]) * 0.5f;
+            auto priority = (center - pos).magnitude();
+
+            if (!g::game::bvh::in_frustum(vp, box)) { priority *= hidden_penalty; }
+
+            pending.push_back({ priority, idx, block_ptr });
         }
 
-        // remaining 'unvisited' offset positions need to be regenerated
-        for (auto oi : unvisited)
-        {
-            if (to_regenerate.size() == 0) { break; }
+        std::stable_sort(pending.begin(), pending.end(), [](const candidate& a, const candidate& b) {
+            return a.priority < b.priority;
+        });
+
+        return pending;
+    }
+
+    /**
+     * @brief      Coarsens or refines the outer rings by one level to bring
+     * `triangles` within `triangle_budget`. `triangles` lags while blocks are
+     * remeshed, so the bias is only moved once every block has been meshed at
+     * the current one, otherwise it overshoots and the rings keep remeshing.
+     *
+     * @param[in]  scheduled  Number of blocks still waiting to be remeshed.
+     *
+     * @return     True if the bias changed.
+     */
+    bool balance_lod(size_t scheduled)
+    {
+        if (triangle_budget == 0 || divisions == 0 || in_flight > 0 || scheduled > 0) { return false; }
 
-            auto offset = offsets[oi];
-            auto block_ptr = to_regenerate.back();
-            block_ptr->regenerating = true;
-            to_regenerate.pop_back();
+        if (triangles > triangle_budget && lod_bias + 1 < lod_levels) { lod_bias++; return true; }
+        if (triangles < triangle_budget / 2 && lod_bias > 0) { lod_bias--; return true; }
 
-            generator_pool.run(
-            // generation task
-            [this, oi, pidx, block_ptr](){
-            	block_ptr->start = std::chrono::system_clock::now();
+        return false;
+    }
 
-                auto pipo = pidx + offsets[oi].template cast<int>();
+    void update(const g::game::camera& cam)
+    {
+        auto pidx = ((cam.position / scale) - 0.5f).template cast<int>();
+        auto vp = cam.projection() * cam.view();
 
-                block_ptr->bounding_box[0] = (pipo * scale).template cast<float>();
-                block_ptr->bounding_box[1] = ((pipo + 1) * scale).template cast<float>();
-                block_ptr->index = pipo;
+        generator_pool.update();
 
-                block_ptr->mesh.from_sdf_r(block_ptr->vertices, block_ptr->indices, sdf, generator, block_ptr->bounding_box, depth);
-                // block_ptr->mesh.from_sdf(block_ptr->vertices, block_ptr->indices, sdf, generator, block_ptr->bounding_box);
-                block_ptr->regenerating = false;
-            },
-            // on finish
-            [block_ptr](){
-                block_ptr->mesh.set_vertices(block_ptr->vertices);
-                block_ptr->mesh.set_indices(block_ptr->indices);
+        auto pending = schedule(cam.position, vp);
+        if (balance_lod(pending.size())) { pending = schedule(cam.position, vp); }
 
-#ifdef G_GFX_DENSITY_VOLUME_DEBUG
-                char buf[256];
-                std::chrono::duration<float> diff = std::chrono::system_clock::now() - block_ptr->start;
-                snprintf(buf, sizeof(buf), "%lu vertices - block %s in %f sec\n", block_ptr->vertices.size(), block_ptr->index.to_string().c_str(), diff.count());
-                write(1, buf, strlen(buf));
-#endif
-            });
+        // only dispatch as much work as there are idle workers, so the remaining
+        // candidates are reprioritized next frame as the camera moves
+        auto idle = std::min<size_t>(generator_pool.idle_threads(), pending.size());
+        for (size_t i = 0; i < idle; i++)
+        {
+            auto& c = pending[i];
+
+            if (c.block_ptr == nullptr)
+            {
+                c.block_ptr = acquire();
+                resident[c.index] = c.block_ptr;
+            }
+
+            regenerate(c.block_ptr, c.index, lods_at(c.index, pidx));
         }
     }
 
     void draw(g::game::camera& cam, g::gfx::shader& s, std::function<void(g::gfx::shader::usage&)> draw_config=nullptr)
     {
-        for (auto& block : blocks)
+        triangles = 0;
+
+        for (auto& kvp : resident)
         {
+            auto& block = *kvp.second;
+
+            if (block.triangles == 0) { continue; }
+
             auto chain = block.mesh.using_shader(s)
 				                   .set_camera(cam);
 
             if (draw_config) { draw_config(chain); }
 
             chain.template draw<GL_TRIANGLES>();
+            triangles += block.triangles;
 
 #ifdef G_GFX_DENSITY_VOLUME_DEBUG
            g::gfx::debug::print{&cam}.color({1, 1, 1, 1}).box(block.bounding_box);
@@ -1525,6 +2891,326 @@ struct density_volume
     }
 };
 
+/**
+ * @brief      An editable voxel volume split into cubic chunks which are each
+ * meshed and drawn separately. Writes mark every chunk whose mesh could be
+ * affected as dirty, and `update()` remeshes only those chunks on worker threads
+ * before replacing their buffers on the calling thread.
+ *
+ * @tparam     V                Vertex type produced by `generator`.
+ * @tparam     MESHER_THREADS   Number of threads meshing dirty chunks.
+ */
+template<typename V, size_t MESHER_THREADS=4>
+struct voxel_world
+{
+	struct chunk
+	{
+		g::gfx::mesh<V> mesh;
+		std::vector<uint8_t> padded; /**< snapshot of the chunk and its apron taken when meshing was scheduled */
+		std::vector<V> vertices;
+		std::vector<uint32_t> indices;
+		size_t vertex_capacity = 0; /**< vertices the gpu buffer can hold without being reallocated */
+		size_t index_capacity = 0;
+
+		vec<3, size_t> origin;
+		vec<3, size_t> extent;
+		uint32_t version = 0;        /**< incremented by every write touching the chunk */
+		uint32_t meshed_version = 0; /**< version of the voxels the current mesh was built from */
+		uint32_t meshing_version = 0;
+		bool meshing = false;
+		bool queued = false;
+		size_t triangles = 0;
+
+		inline bool is_dirty() const { return version != meshed_version; }
+	};
+
+	g::game::voxels<uint8_t> volume;
+	ogt_vox_palette palette;
+	std::function<V(ogt_mesh_vertex* vert_in)> generator;
+	voxel_mesher mode = voxel_mesher::greedy;
+	size_t chunk_size = 32;
+	vec<3, size_t> chunk_dims;
+	std::vector<voxel_world::chunk> chunks;
+	std::vector<size_t> dirty; /**< indices of chunks waiting to be meshed, in the order they were dirtied */
+	size_t in_flight = 0;      /**< chunks currently being meshed by a worker */
+	size_t triangles = 0;      /**< triangles drawn in the last frame */
+	g::proc::thread_pool<MESHER_THREADS> mesher_pool;
+
+	voxel_world() = default;
+
+	voxel_world(
+		const g::game::voxels<uint8_t>& vox,
+		const ogt_vox_palette& palette,
+		std::function<V(ogt_mesh_vertex* vert_in)> generator,
+		voxel_mesher mode=voxel_mesher::greedy,
+		size_t chunk_size=32) :
+
+		volume(vox),
+		palette(palette),
+		generator(generator),
+		mode(mode),
+		chunk_size(chunk_size)
+	{
+		assert(mode != voxel_mesher::polygon); // polygons can't be clipped to a chunk
+
+		chunk_dims = (volume.size + (chunk_size - 1)) / chunk_size;
+		chunks.resize(chunk_dims[0] * chunk_dims[1] * chunk_dims[2]);
+
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			auto& c = chunks[i];
+			vec<3, size_t> ci = { i % chunk_dims[0], (i / chunk_dims[0]) % chunk_dims[1], i / (chunk_dims[0] * chunk_dims[1]) };
+			c.origin = ci * chunk_size;
+			c.extent = (c.origin + chunk_size).take_min(volume.size) - c.origin;
+			mark_dirty(i);
+		}
+	}
+
+	voxel_world(
+		const vec<3, size_t>& size,
+		const ogt_vox_palette& palette,
+		std::function<V(ogt_mesh_vertex* vert_in)> generator,
+		voxel_mesher mode=voxel_mesher::greedy,
+		size_t chunk_size=32) :
+
+		voxel_world(g::game::voxels<uint8_t>(size[0], size[1], size[2]), palette, generator, mode, chunk_size) { }
+
+	~voxel_world()
+	{
+		for (auto& c : chunks)
+		{
+			if (c.mesh.is_initialized()) { c.mesh.destroy(); }
+		}
+	}
+
+	inline size_t chunk_index(const vec<3, size_t>& ci) const
+	{
+		return ci[0] + chunk_dims[0] * (ci[1] + chunk_dims[1] * ci[2]);
+	}
+
+	inline uint8_t get(size_t x, size_t y, size_t z) const { return volume.idx(x, y, z); }
+
+	/**
+	 * @brief      Writes a single voxel, 0 removes it.
+	 */
+	void set(size_t x, size_t y, size_t z, uint8_t value)
+	{
+		if (volume.idx(x, y, z) == value) { return; }
+
+		volume.set(x, y, z, value);
+		mark_dirty({x, y, z}, {x, y, z});
+	}
+
+	/**
+	 * @brief      Writes `value` to every voxel in the inclusive box [min, max],
+	 * clamped to the volume.
+	 */
+	void fill(const vec<3, size_t>& min, const vec<3, size_t>& max, uint8_t value)
+	{
+		auto hi = max.take_min(volume.size - 1);
+
+		for (size_t z = min[2]; z <= hi[2]; z++)
+		for (size_t y = min[1]; y <= hi[1]; y++)
+		for (size_t x = min[0]; x <= hi[0]; x++)
+		{
+			volume.set(x, y, z, value);
+		}
+
+		mark_dirty(min, hi);
+	}
+
+	/**
+	 * @brief      Marks every chunk whose mesh depends on the voxels in the
+	 * inclusive box [min, max]. Those are the chunks overlapping the box, and
+	 * the chunks sharing a face with it, since faces are culled against the
+	 * neighboring voxel across the chunk border.
+	 */
+	void mark_dirty(const vec<3, size_t>& min, const vec<3, size_t>& max)
+	{
+		for (int grow = -1; grow < 3; grow++)
+		{ // the box itself, then the box grown by a voxel along each axis
+			vec<3, size_t> lo, hi;
+
+			for (int a = 0; a < 3; a++)
+			{
+				lo[a] = min[a];
+				hi[a] = max[a];
+
+				if (a == grow)
+				{
+					lo[a] = min[a] > 0 ? min[a] - 1 : 0;
+					hi[a] = std::min(max[a] + 1, volume.size[a] - 1);
+				}
+
+				lo[a] /= chunk_size;
+				hi[a] /= chunk_size;
+			}
+
+			for (size_t z = lo[2]; z <= hi[2]; z++)
+			for (size_t y = lo[1]; y <= hi[1]; y++)
+			for (size_t x = lo[0]; x <= hi[0]; x++)
+			{
+				mark_dirty(chunk_index({x, y, z}));
+			}
+		}
+	}
+
+	void mark_dirty(size_t ci)
+	{
+		auto& c = chunks[ci];
+		c.version++;
+
+		if (!c.queued)
+		{
+			c.queued = true;
+			dirty.push_back(ci);
+		}
+	}
+
+	/**
+	 * @brief      Meshes the snapshot taken of a chunk into its vertex and index
+	 * staging buffers. Safe to call from any thread while `c.meshing` is set.
+	 */
+	void mesh_chunk(voxel_world::chunk& c) const
+	{
+		c.vertices.clear();
+		c.indices.clear();
+		mesh_factory::mesh_chunk<V>(c.padded.data(), c.extent, c.origin.template cast<float>(), (const ogt_mesh_rgba*)palette.color, mode, generator, c.vertices, c.indices);
+	}
+
+	/**
+	 * @brief      Replaces a chunk's gpu buffers with its staging buffers. Buffers
+	 * are updated in place when the new mesh fits, and otherwise reallocated with
+	 * room to grow so a chunk being edited isn't reallocated every frame.
+	 */
+	void upload(voxel_world::chunk& c)
+	{
+		c.triangles = c.indices.size() / 3;
+		c.meshed_version = c.meshing_version;
+		c.meshing = false;
+
+		if (c.triangles == 0 && !c.mesh.is_initialized()) { return; }
+		if (!c.mesh.is_initialized()) { glGenBuffers(2, &c.mesh.vbo); }
+
+		glBindBuffer(GL_ARRAY_BUFFER, c.mesh.vbo);
+		if (c.vertices.size() > c.vertex_capacity)
+		{
+			c.vertex_capacity = c.vertices.size() + c.vertices.size() / 2;
+			glBufferData(GL_ARRAY_BUFFER, c.vertex_capacity * sizeof(V), nullptr, GL_DYNAMIC_DRAW);
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, 0, c.vertices.size() * sizeof(V), c.vertices.data());
+		c.mesh.vertex_count = c.vertices.size();
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, c.mesh.ibo);
+		if (c.indices.size() > c.index_capacity)
+		{
+			c.index_capacity = c.indices.size() + c.indices.size() / 2;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, c.index_capacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+		}
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, c.indices.size() * sizeof(uint32_t), c.indices.data());
+		c.mesh.index_count = c.indices.size();
+		assert(gl_get_error());
+	}
+
+	/**
+	 * @brief      Uploads chunks that finished meshing, then schedules every dirty
+	 * chunk not already being meshed. A chunk written to while it was being
+	 * meshed stays dirty and is meshed again once its current job finishes.
+	 */
+	void update()
+	{
+		mesher_pool.update();
+
+		std::vector<size_t> still_dirty;
+
+		for (auto ci : dirty)
+		{
+			auto& c = chunks[ci];
+
+			if (c.meshing)
+			{ // wait for the current job before scheduling another
+				still_dirty.push_back(ci);
+				continue;
+			}
+
+			c.queued = false;
+			if (!c.is_dirty()) { continue; }
+
+			// snapshot on this thread so edits made while the job runs can't race it
+			mesh_factory::pad_chunk(volume, c.origin, c.extent, c.padded);
+			c.meshing_version = c.version;
+			c.meshing = true;
+			in_flight++;
+
+			auto c_ptr = &c;
+			mesher_pool.run(
+			// meshing task
+			[this, c_ptr]() {
+				mesh_chunk(*c_ptr);
+			},
+			// on finish
+			[this, c_ptr]() {
+				upload(*c_ptr);
+				in_flight--;
+			});
+		}
+
+		dirty = still_dirty;
+	}
+
+	/**
+	 * @brief      Meshes and uploads every dirty chunk before returning, using the
+	 * calling thread along with the workers. Use when edits must appear in the
+	 * frame they were made in.
+	 */
+	void flush()
+	{
+		while (in_flight > 0)
+		{
+			mesher_pool.update();
+			std::this_thread::yield();
+		}
+
+		std::vector<voxel_world::chunk*> pending;
+
+		for (auto ci : dirty)
+		{
+			auto& c = chunks[ci];
+			c.queued = false;
+			if (!c.is_dirty()) { continue; }
+
+			mesh_factory::pad_chunk(volume, c.origin, c.extent, c.padded);
+			c.meshing_version = c.version;
+			c.meshing = true;
+			pending.push_back(&c);
+		}
+
+		dirty.clear();
+
+		g::proc::parallel_for(mesher_pool, pending.size(), [&](size_t i) { mesh_chunk(*pending[i]); });
+
+		for (auto c_ptr : pending) { upload(*c_ptr); }
+	}
+
+	void draw(g::game::camera& cam, g::gfx::shader& s, std::function<void(g::gfx::shader::usage&)> draw_config=nullptr)
+	{
+		triangles = 0;
+
+		for (auto& c : chunks)
+		{
+			if (c.triangles == 0) { continue; }
+
+			auto chain = c.mesh.using_shader(s)
+			                   .set_camera(cam);
+
+			if (draw_config) { draw_config(chain); }
+
+			chain.template draw<GL_TRIANGLES>();
+			triangles += c.triangles;
+		}
+	}
+};
+
 namespace effect
 {
 
@@ -1744,6 +3430,191 @@ struct text : public renderer<std::string>
 	void measure(const std::string& str, vec<2>& dims_out, vec<2>& offset_out);
 };
 
+/**
+ * @brief      Draws a `g::dyn::particle_system` as camera facing quads, one
+ * instance per particle, sorted back to front so that blended particles
+ * composite correctly. The sort is a radix sort on each particle's depth, so
+ * its cost grows linearly with the number of particles. Sorting assumes the
+ * model matrix doesn't rotate the particles.
+ *
+ * Shaders receive the quad's corner as `a_position`, in [-0.5, 0.5], and the
+ * instance's `i_position`, `i_size` and `i_color`. `default_shader()` draws
+ * soft round particles.
+ */
+struct particles : public renderer<g::dyn::particle_system>
+{
+	struct instance
+	{
+		vec<3> position;
+		float size;
+		vec<4, uint8_t> color;
+
+		static void attributes(GLuint prog)
+		{
+			auto pos_loc = glGetAttribLocation(prog, "i_position");
+			auto size_loc = glGetAttribLocation(prog, "i_size");
+			auto color_loc = glGetAttribLocation(prog, "i_color");
+
+			if (pos_loc > -1) glEnableVertexAttribArray(pos_loc);
+			if (size_loc > -1) glEnableVertexAttribArray(size_loc);
+			if (color_loc > -1) glEnableVertexAttribArray(color_loc);
+
+			auto p_size = sizeof(position);
+			auto s_size = sizeof(size);
+
+			if (pos_loc > -1) glVertexAttribPointer(pos_loc, 3, GL_FLOAT, false, sizeof(instance), (void*)0);
+			if (size_loc > -1) glVertexAttribPointer(size_loc, 1, GL_FLOAT, false, sizeof(instance), (void*)p_size);
+			if (color_loc > -1) glVertexAttribPointer(color_loc, 4, GL_UNSIGNED_BYTE, true, sizeof(instance), (void*)(p_size + s_size));
+
+			if (pos_loc > -1) glVertexAttribDivisor(pos_loc, 1);
+			if (size_loc > -1) glVertexAttribDivisor(size_loc, 1);
+			if (color_loc > -1) glVertexAttribDivisor(color_loc, 1);
+		}
+	};
+
+	std::vector<instance> instances; /**< particles in the order they're drawn, filled by `sort` */
+
+	/**
+	 * @brief      Fills `instances` with the live particles of `ps`, furthest
+	 * along `forward` from `eye` first.
+	 */
+	void sort(const g::dyn::particle_system& ps, const vec<3>& eye, const vec<3>& forward)
+	{
+		auto n = ps.size();
+		keys.resize(n);
+		order.resize(n);
+		scratch_keys.resize(n);
+		scratch_order.resize(n);
+
+		for (size_t i = 0; i < n; i++)
+		{
+			float depth = (ps.position[0][i] - eye[0]) * forward[0] +
+			              (ps.position[1][i] - eye[1]) * forward[1] +
+			              (ps.position[2][i] - eye[2]) * forward[2];
+
+			// order preserving map of floats to unsigned ints, inverted to put far first
+			uint32_t bits;
+			memcpy(&bits, &depth, sizeof(bits));
+			bits ^= (bits >> 31) ? 0xffffffff : 0x80000000;
+			keys[i] = ~bits;
+			order[i] = i;
+		}
+
+		// least significant digit first, 11 bits at a time
+		for (int shift = 0; shift < 32; shift += 11)
+		{
+			uint32_t counts[2048] = {};
+			for (size_t i = 0; i < n; i++) { counts[(keys[i] >> shift) & 2047]++; }
+
+			uint32_t total = 0;
+			for (auto& c : counts) { auto t = c; c = total; total += t; }
+
+			for (size_t i = 0; i < n; i++)
+			{
+				auto dst = counts[(keys[i] >> shift) & 2047]++;
+				scratch_keys[dst] = keys[i];
+				scratch_order[dst] = order[i];
+			}
+
+			keys.swap(scratch_keys);
+			order.swap(scratch_order);
+		}
+
+		instances.resize(n);
+		auto to_byte = [](float c) { return (uint8_t)(std::min(std::max(c, 0.f), 1.f) * 255.f + 0.5f); };
+		for (size_t i = 0; i < n; i++)
+		{
+			auto j = order[i];
+			auto& inst = instances[i];
+			auto c = ps.color_of(j);
+			inst.position = { ps.position[0][j], ps.position[1][j], ps.position[2][j] };
+			inst.size = ps.size_of(j);
+			inst.color = { to_byte(c[0]), to_byte(c[1]), to_byte(c[2]), to_byte(c[3]) };
+		}
+	}
+
+	/**
+	 * @brief      Sorts the particles for `cam`, uploads them and binds them,
+	 * along with the quad they're drawn as, to `shader`.
+	 */
+	shader::usage using_shader(g::gfx::shader& shader,
+	                           const g::dyn::particle_system& ps,
+	                           g::game::camera& cam,
+	                           const mat<4, 4>& model) override
+	{
+		sort(ps, cam.position, cam.forward());
+
+		if (!quad.is_initialized())
+		{
+			quad = mesh_factory::empty_mesh<vertex::pos>();
+			vertex::pos corners[] = { {{ -0.5f, -0.5f, 0 }}, {{ 0.5f, -0.5f, 0 }}, {{ 0.5f, 0.5f, 0 }}, {{ -0.5f, 0.5f, 0 }} };
+			quad.set_vertices(corners, 4);
+			glGenBuffers(1, &instance_vbo);
+		}
+
+		auto usage = quad.using_shader(shader);
+
+		glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+		glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(instance), instances.data(), GL_STREAM_DRAW);
+		usage.attach_attributes<instance>(shader);
+
+		usage.set_camera(cam)["u_model"].mat4(model);
+
+		return usage;
+	}
+
+	void draw(g::gfx::shader& shader,
+	          const g::dyn::particle_system& ps,
+	          g::game::camera& cam,
+	          const mat<4, 4>& model) override
+	{
+		using_shader(shader, ps, cam, model).draw_instanced<GL_TRIANGLE_FAN>(instances.size());
+	}
+
+	static g::gfx::shader& default_shader()
+	{
+		static g::gfx::shader shader;
+
+		if (!shader.is_initialized())
+		{
+			shader = shader_factory{}
+				.add_src<GL_VERTEX_SHADER>(
+					"in vec3 a_position;"
+					"in vec3 i_position;"
+					"in float i_size;"
+					"in vec4 i_color;"
+					"uniform mat4 u_model;"
+					"uniform mat4 u_view;"
+					"uniform mat4 u_proj;"
+					"out vec4 v_color;"
+					"out vec2 v_uv;"
+					"void main (void) {"
+					"vec4 center = u_view * u_model * vec4(i_position, 1.0);"
+					"center.xy += a_position.xy * i_size;"
+					"gl_Position = u_proj * center;"
+					"v_color = i_color;"
+					"v_uv = a_position.xy * 2.0;"
+					"}")
+				.add_src<GL_FRAGMENT_SHADER>(
+					"in vec4 v_color;"
+					"in vec2 v_uv;"
+					"out vec4 color;"
+					"void main (void) {"
+					"float falloff = clamp(1.0 - length(v_uv), 0.0, 1.0);"
+					"color = vec4(v_color.rgb, v_color.a * falloff);"
+					"}")
+				.create();
+		}
+
+		return shader;
+	}
+
+private:
+	g::gfx::mesh<vertex::pos> quad;
+	GLuint instance_vbo = 0;
+	std::vector<uint32_t> keys, order, scratch_keys, scratch_order;
+};
+
 }; // end namespace primative
 }; // end namespace gfx
 }; // end namespace g
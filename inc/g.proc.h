@@ -5,6 +5,9 @@
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
 
 namespace g
 {
@@ -169,6 +172,59 @@ private:
 	std::deque<std::function<void(void)>> pending_finishes;
 };
 
+/**
+ * @brief      Invokes `fn` once for every index in [0, count) spreading the calls
+ *             across the workers of `pool`. The calling thread also takes indices
+ *             so this will make progress even if every worker is busy, which also
+ *             makes it safe to call from inside a task already running on `pool`.
+ *             Returns once every index has been processed.
+ *
+ * @param      pool   The pool whose workers should help with the work.
+ * @param[in]  count  The number of indices to process.
+ * @param[in]  fn     Work to do for a single index. Must be thread safe.
+ */
+template<size_t POOL_SIZE>
+void parallel_for(thread_pool<POOL_SIZE>& pool, size_t count, std::function<void(size_t i)> fn)
+{
+	if (count == 0) { return; }
+
+	// shared with the queued tasks, some of which may start only after we have
+	// returned and find no work left to do
+	struct state
+	{
+		std::atomic<size_t> next = 0;
+		std::atomic<size_t> done = 0;
+		size_t count;
+		std::function<void(size_t i)> fn;
+		std::mutex m;
+		std::condition_variable cv;
+	};
+
+	auto s = std::make_shared<state>();
+	s->count = count;
+	s->fn = fn;
+
+	auto work = [s]() {
+		for (size_t i; (i = s->next++) < s->count;)
+		{
+			s->fn(i);
+
+			if (++s->done == s->count)
+			{
+				std::lock_guard<std::mutex> lk(s->m);
+				s->cv.notify_all();
+			}
+		}
+	};
+
+	for (size_t i = std::min(POOL_SIZE, count - 1); i--;) { pool.run(work); }
+
+	work();
+
+	std::unique_lock<std::mutex> lk(s->m);
+	s->cv.wait(lk, [&] { return s->done == s->count; });
+}
+
 }; // namespace proc
 
 }; // namespace g
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 #include <string>
 
 namespace g {
@@ -52,6 +54,158 @@ private:
 };
 
 
+/**
+ * @brief      64 bit non-cryptographic hash of a buffer (XXH64). Input is consumed
+ * in 32 byte stripes by 4 independent accumulators, so consecutive words
+ * don't wait on each other and the loop pipelines well. Buffers of any length
+ * and alignment are supported.
+ *
+ * @param[in]  data  The data to hash.
+ * @param[in]  len   Length of `data` in bytes.
+ * @param[in]  seed  Seed, different seeds produce unrelated hashes.
+ *
+ * @return     The hash.
+ */
+inline uint64_t hash64(const void* data, size_t len, uint64_t seed=0)
+{
+	const uint64_t p1 = 0x9E3779B185EBCA87ull;
+	const uint64_t p2 = 0xC2B2AE3D27D4EB4Full;
+	const uint64_t p3 = 0x165667B19E3779F9ull;
+	const uint64_t p4 = 0x85EBCA77C2B2AE63ull;
+	const uint64_t p5 = 0x27D4EB2F165667C5ull;
+
+	auto rotl = [](uint64_t x, int r) -> uint64_t { return (x << r) | (x >> (64 - r)); };
+	auto read64 = [](const uint8_t* p) -> uint64_t { uint64_t v; memcpy(&v, p, sizeof(v)); return v; };
+	auto read32 = [](const uint8_t* p) -> uint32_t { uint32_t v; memcpy(&v, p, sizeof(v)); return v; };
+	auto round = [&](uint64_t acc, uint64_t input) -> uint64_t { return rotl(acc + input * p2, 31) * p1; };
+	auto merge = [&](uint64_t acc, uint64_t val) -> uint64_t { return (acc ^ round(0, val)) * p1 + p4; };
+
+	auto p = static_cast<const uint8_t*>(data);
+	auto end = p + len;
+	uint64_t h;
+
+	if (len >= 32)
+	{
+		uint64_t acc[4] = { seed + p1 + p2, seed + p2, seed, seed - p1 };
+
+		for (; p + 32 <= end; p += 32)
+		{
+			acc[0] = round(acc[0], read64(p));
+			acc[1] = round(acc[1], read64(p + 8));
+			acc[2] = round(acc[2], read64(p + 16));
+			acc[3] = round(acc[3], read64(p + 24));
+		}
+
+		h = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+		for (int i = 0; i < 4; i++) { h = merge(h, acc[i]); }
+	}
+	else
+	{
+		h = seed + p5;
+	}
+
+	h += len;
+
+	for (; p + 8 <= end; p += 8)
+	{
+		h = rotl(h ^ round(0, read64(p)), 27) * p1 + p4;
+	}
+
+	if (p + 4 <= end)
+	{
+		h = rotl(h ^ (read32(p) * p1), 23) * p2 + p3;
+		p += 4;
+	}
+
+	for (; p < end; p++)
+	{
+		h = rotl(h ^ (*p * p5), 11) * p1;
+	}
+
+	h ^= h >> 33;
+	h *= p2;
+	h ^= h >> 29;
+	h *= p3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+/**
+ * @brief      Explicitly seeded random number generator (PCG32). For a given
+ * seed the sequence, including that of each distribution below, is the same
+ * on every platform, unlike `rand()` or the standard library's distributions.
+ * Simulations run in lockstep on several machines should each own one.
+ * Also satisfies UniformRandomBitGenerator.
+ */
+struct rng
+{
+	using result_type = uint32_t;
+
+	uint64_t state = 0;
+	uint64_t inc = 1;
+
+	rng(uint64_t seed=0x853c49e6748fea9bull, uint64_t stream=0xda3e39cb94b95bdbull) { this->seed(seed, stream); }
+
+	void seed(uint64_t seed, uint64_t stream=0xda3e39cb94b95bdbull)
+	{
+		state = 0;
+		inc = (stream << 1) | 1;
+		next();
+		state += seed;
+		next();
+	}
+
+	inline uint32_t next()
+	{
+		auto old = state;
+		state = old * 6364136223846793005ull + inc;
+		auto xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+		auto rot = (uint32_t)(old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+	}
+
+	inline uint32_t operator()() { return next(); }
+	static constexpr uint32_t min() { return 0; }
+	static constexpr uint32_t max() { return 0xffffffff; }
+
+	/**
+	 * @brief      Uniformly distributed integer in [0, n), without bias. The
+	 * range is empty for n = 0, which returns 0 without advancing the state.
+	 */
+	uint32_t below(uint32_t n)
+	{
+		if (n == 0) { return 0; }
+
+		auto threshold = (uint32_t)(-n) % n;
+		for (;;)
+		{
+			auto r = next();
+			if (r >= threshold) { return r % n; }
+		}
+	}
+
+	/**
+	 * @brief      Uniformly distributed float in [0, 1).
+	 */
+	inline float uniform() { return (next() >> 8) * (1.f / 16777216.f); }
+
+	inline float uniform(float lo, float hi) { return lo + (hi - lo) * uniform(); }
+
+	/**
+	 * @brief      Approximately normally distributed float, the sum of twelve
+	 * uniform samples. Needs no transcendental functions, whose results
+	 * differ between platforms, and never strays more than 6 deviations
+	 * from the mean.
+	 */
+	float normal(float mean=0, float stddev=1)
+	{
+		float sum = 0;
+		for (int i = 0; i < 12; i++) { sum += uniform(); }
+		return mean + (sum - 6) * stddev;
+	}
+};
+
 // std::string base64_encode(uint8_t const* buf, size_t len);
 void base64_encode(void *dst, const void *src, size_t len); // thread-safe, re-entrant
 
@@ -271,7 +271,18 @@ void texture::set_pixels(size_t w, size_t h, size_t d, unsigned char* data, GLen
 	if (h > 1 && d > 1)
 	{
 		type = GL_TEXTURE_3D;
-		glTexImage3D(GL_TEXTURE_3D, 0, color_type, size[0], size[1], size[2], 0, color_type, storage_type, data);
+		GLenum internal_format = color_type;
+		if (storage_type == GL_FLOAT)
+		{ // keep full precision and range, unsized formats are normalized
+			switch (color_type)
+			{
+				case GL_RED: internal_format = GL_R32F; break;
+				case GL_RG: internal_format = GL_RG32F; break;
+				case GL_RGB: internal_format = GL_RGB32F; break;
+				case GL_RGBA: internal_format = GL_RGBA32F; break;
+			}
+		}
+		glTexImage3D(GL_TEXTURE_3D, 0, internal_format, size[0], size[1], size[2], 0, color_type, storage_type, data);
 	}
 	else if (h >= 1)
 	{
@@ -602,6 +613,22 @@ texture_factory& texture_factory::fill(unsigned char* buffer)
 	return *this;
 }
 
+texture_factory& texture_factory::from_distance_field(const g::game::distance_field& field)
+{
+	texture_type = GL_TEXTURE_3D;
+	size[0] = field.size[0];
+	size[1] = field.size[1];
+	size[2] = field.size[2];
+	components(1);
+	type(GL_FLOAT);
+
+	auto bytes = field.distances.size() * sizeof(float);
+	data = new unsigned char[bytes];
+	memcpy(data, field.distances.data(), bytes);
+
+	return *this;
+}
+
 
 texture texture_factory::create()
 {
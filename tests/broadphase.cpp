@@ -0,0 +1,198 @@
+#include ".test.h"
+#include "g.h"
+#include <set>
+
+using namespace g::dyn;
+
+struct probe : public cd::ray_collider
+{
+    void cast(const vec<3>& o, const vec<3>& d)
+    {
+        ray_list.clear();
+        ray_list.push_back({ o, d });
+    }
+};
+
+static float rnd(float lo, float hi) { return lo + (hi - lo) * (rand() / (float)RAND_MAX); }
+
+static void check_world(cd::collision_world::method m)
+{
+    constexpr int n = 200;
+    const float margin = 0.25f;
+    cd::collision_world world(m, 2.f, margin);
+    probe dummy;
+
+    std::vector<std::array<vec<3>, 2>> boxes(n);
+    std::vector<vec<3>> vel(n);
+    std::vector<cd::collision_world::handle> handles(n);
+
+    for (int i = 0; i < n; i++)
+    {
+        auto c = vec<3>{ rnd(-20, 20), rnd(-20, 20), rnd(-20, 20) };
+        auto h = vec<3>{ rnd(0.1f, 1.5f), rnd(0.1f, 1.5f), rnd(0.1f, 1.5f) };
+        boxes[i] = { c - h, c + h };
+        vel[i] = { rnd(-0.3f, 0.3f), rnd(-0.3f, 0.3f), rnd(-0.3f, 0.3f) };
+        handles[i] = world.add(&dummy, boxes[i].data());
+    }
+
+    for (int step = 0; step < 60; step++)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            boxes[i][0] += vel[i];
+            boxes[i][1] += vel[i];
+            world.move(handles[i], boxes[i].data(), vel[i]);
+        }
+
+        world.update_pairs();
+
+        std::set<std::pair<int, int>> found;
+        for (auto& p : world.pairs())
+        {
+            assert(p.a != p.b);
+            found.insert({ std::min(p.a, p.b), std::max(p.a, p.b) });
+        }
+        assert(found.size() == world.pairs().size());
+
+        // every touching pair must be reported
+        for (int i = 0; i < n; i++)
+        for (int j = i + 1; j < n; j++)
+        {
+            if (g::game::bvh::overlaps(boxes[i].data(), boxes[j].data()))
+            {
+                assert(found.count({ std::min(handles[i], handles[j]), std::max(handles[i], handles[j]) }));
+            }
+        }
+    }
+
+    // removed colliders drop out of the pairs
+    for (int i = 0; i < n; i += 2) { world.remove(handles[i]); }
+    world.update_pairs();
+
+    for (auto& p : world.pairs())
+    {
+        for (int i = 0; i < n; i += 2) { assert(p.a != handles[i] && p.b != handles[i]); }
+    }
+}
+
+TEST
+{
+    srand(1);
+
+    { // tree stays balanced and answers queries like brute force
+        cd::aabb_tree tree;
+        std::vector<std::array<vec<3>, 2>> boxes;
+        std::vector<int> leaves;
+
+        for (int i = 0; i < 1000; i++)
+        {
+            // inserted in sorted order, the worst case for an unbalanced tree
+            auto c = vec<3>{ i * 0.5f, 0, 0 };
+            boxes.push_back({ c - 0.3f, c + 0.3f });
+            leaves.push_back(tree.insert(boxes.back().data(), i));
+        }
+
+        assert(tree.height() <= 20);
+
+        for (int i = 0; i < 1000; i += 3) { tree.remove(leaves[i]); }
+
+        vec<3> q[2] = { { 100, -1, -1 }, { 120, 1, 1 } };
+        std::set<int> hits;
+        tree.query(q, [&](int p) { hits.insert(p); });
+
+        for (int i = 0; i < 1000; i++)
+        {
+            bool expect = i % 3 != 0 && g::game::bvh::overlaps(boxes[i].data(), q);
+            assert(hits.count(i) == (expect ? 1 : 0));
+        }
+
+        int ray_hits = 0;
+        tree.raycast({ -10, 0, 0 }, { 1, 0, 0 }, [&](int p, float t) { ray_hits++; assert(t >= 0); }, 20);
+        // boxes whose near face lies within t = 20 of the origin
+        int expect = 0;
+        for (int i = 0; i < 1000; i++) { expect += i % 3 != 0 && boxes[i][0][0] <= 10; }
+        assert(ray_hits == expect);
+
+        // callbacks may query the tree again without disturbing the outer query
+        std::set<int> nested_hits;
+        int inner_calls = 0;
+        tree.query(q, [&](int p) {
+            nested_hits.insert(p);
+            tree.query(boxes[p].data(), [&](int) { inner_calls++; });
+            tree.raycast({ -10, 0, 0 }, { 1, 0, 0 }, [&](int, float) { inner_calls++; }, 20);
+        });
+        assert(nested_hits == hits);
+        assert(inner_calls > 0);
+
+        int nested_ray_hits = 0;
+        tree.raycast({ -10, 0, 0 }, { 1, 0, 0 }, [&](int p, float) {
+            nested_ray_hits++;
+            tree.query(q, [&](int) { inner_calls++; });
+        }, 20);
+        assert(nested_ray_hits == expect);
+    }
+
+    { // grid queries report each proxy once, even when callbacks query again
+        cd::aabb_grid grid(2);
+        std::vector<std::array<vec<3>, 2>> boxes;
+        for (int i = 0; i < 300; i++)
+        {
+            auto c = vec<3>{ rnd(-20, 20), rnd(-20, 20), rnd(-20, 20) };
+            auto h = vec<3>{ rnd(0.1f, 3), rnd(0.1f, 3), rnd(0.1f, 3) };
+            boxes.push_back({ c - h, c + h });
+            grid.insert(i, boxes.back().data());
+        }
+
+        vec<3> q[2] = { { -8, -8, -8 }, { 8, 8, 8 } };
+        std::multiset<int> hits;
+        grid.query(q, [&](int p) { hits.insert(p); });
+
+        for (int i = 0; i < 300; i++)
+        {
+            // proxies in cells touching q may be reported without overlapping it
+            assert(hits.count(i) <= 1);
+            if (g::game::bvh::overlaps(boxes[i].data(), q)) { assert(hits.count(i) == 1); }
+        }
+
+        std::multiset<int> nested_hits;
+        grid.query(q, [&](int p) {
+            nested_hits.insert(p);
+            std::multiset<int> inner;
+            grid.query(boxes[p].data(), [&](int o) { inner.insert(o); });
+            assert(inner.count(p) == 1);
+            for (auto o : inner) { assert(inner.count(o) == 1); }
+        });
+        assert(nested_hits == hits);
+    }
+
+    check_world(cd::collision_world::method::tree);
+    check_world(cd::collision_world::method::grid);
+
+    { // narrowphase runs on candidate pairs only
+        cd::collision_world world;
+        probe p;
+        cd::sdf_collider ground([](const vec<3>& x) -> float { return x[1]; });
+        cd::sdf_collider far([](const vec<3>& x) -> float { return x[1] + 100; });
+
+        vec<3> pb[2] = { { -1, -0.5f, -1 }, { 1, 1, 1 } };
+        vec<3> gb[2] = { { -10, -1, -10 }, { 10, 0, 10 } };
+        vec<3> fb[2] = { { -10, -101, -10 }, { 10, -100, 10 } };
+        auto hp = world.add(&p, pb);
+        auto hg = world.add(&ground, gb);
+        world.add(&far, fb);
+
+        p.cast({ 0, 1, 0 }, { 0, -1, 0 });
+
+        int calls = 0;
+        world.collide([&](cd::collision_world::handle a, cd::collision_world::handle b, const std::vector<cd::intersection>& hits) {
+            calls++;
+            assert((a == hp && b == hg) || (a == hg && b == hp));
+            assert(hits.size() == 1);
+            assert(fabsf(hits[0].point[1]) < 1e-3f);
+        });
+
+        assert(calls == 1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include ".test.h"
+#include "g.h"
+
+using bounds = g::game::bvh::bounds;
+
+static float rnd() { return (rand() % 10000) / 10000.f; }
+
+static bounds random_box()
+{
+	vec<3> c = { rnd() * 200 - 100, rnd() * 200 - 100, rnd() * 200 - 100 };
+	vec<3> h = { rnd() * 4 + 0.1f, rnd() * 4 + 0.1f, rnd() * 4 + 0.1f };
+	return { c - h, c + h };
+}
+
+static void check_queries(const g::game::bvh& tree, const std::vector<bounds>& boxes)
+{
+	for (int q = 0; q < 50; q++)
+	{ // box queries
+		auto qb = random_box();
+		vec<3> box[2] = { qb[0] - 10, qb[1] + 10 };
+		std::vector<bool> found(boxes.size(), false);
+
+		tree.query(box, [&](size_t i) { assert(!found[i]); found[i] = true; });
+
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			vec<3> b[2] = { boxes[i][0], boxes[i][1] };
+			assert(found[i] == g::game::bvh::overlaps(b, box));
+		}
+	}
+
+	for (int q = 0; q < 50; q++)
+	{ // ray queries
+		vec<3> o = { rnd() * 300 - 150, rnd() * 300 - 150, rnd() * 300 - 150 };
+		vec<3> d = { rnd() * 2 - 1, rnd() * 2 - 1, rnd() * 2 - 1 };
+		vec<3> inv_d = { 1 / d[0], 1 / d[1], 1 / d[2] };
+		std::vector<float> found(boxes.size(), -1);
+
+		tree.raycast(o, d, [&](size_t i, float t) { found[i] = t; }, 100);
+
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			vec<3> b[2] = { boxes[i][0], boxes[i][1] };
+			auto t = g::game::bvh::ray_box(o, inv_d, b, 100);
+			assert((found[i] >= 0) == (t <= 100));
+			assert(found[i] < 0 || fabsf(found[i] - t) < 1e-4);
+		}
+	}
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+	srand(7);
+	std::vector<bounds> boxes;
+	for (int i = 0; i < 2000; i++) { boxes.push_back(random_box()); }
+
+	for (auto sah : { true, false })
+	{
+		g::game::bvh tree;
+		tree.build(boxes, sah);
+
+		assert(tree.items.size() == boxes.size());
+		check_queries(tree, boxes);
+
+		// move every item, then a few individually
+		auto moved = boxes;
+		for (auto& b : moved) { b[0] += 3; b[1] += 3; }
+		tree.boxes = moved;
+		tree.refit();
+		check_queries(tree, moved);
+
+		for (size_t i = 0; i < moved.size(); i += 97)
+		{
+			moved[i] = random_box();
+			tree.refit(i, moved[i]);
+		}
+		check_queries(tree, moved);
+
+		// the root bounds every item
+		for (auto& b : moved)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				assert(tree.nodes[0].box[0][a] <= b[0][a]);
+				assert(tree.nodes[0].box[1][a] >= b[1][a]);
+			}
+		}
+	}
+
+	{ // scene instances
+		g::game::vox_scene scene;
+		scene.models.push_back(g::game::voxels<uint8_t>(2, 2, 2));
+
+		for (int i = 0; i < 100; i++)
+		{
+			auto& inst = scene.instances["inst" + std::to_string(i)];
+			inst.model = &scene.models[0];
+			inst.transform = mat<4, 4>::translation({ (float)(i * 10), 0, 0 });
+		}
+
+		std::vector<std::string> hit;
+		scene.instances_along({ -10, 0, 0 }, { 1, 0, 0 }, [&](const std::string& name, g::game::vox_scene::model_instance&, float t) {
+			hit.push_back(name);
+		}, 25);
+		std::sort(hit.begin(), hit.end());
+		assert((hit == std::vector<std::string>{ "inst0", "inst1" }));
+
+		auto c = scene.corners();
+		assert(std::get<0>(c)[0] == -1);
+		assert(std::get<1>(c)[0] == 991);
+
+		// moving an instance is reflected once it is refit
+		scene.instances["inst50"].transform = mat<4, 4>::translation({ 0, 50, 0 });
+		scene.refit_bvh("inst50");
+		c = scene.corners();
+		assert(std::get<1>(c)[1] == 51);
+
+		vec<3> box[2] = { { -1, 45, -1 }, { 1, 55, 1 } };
+		hit.clear();
+		scene.instances_in(box, [&](const std::string& name, g::game::vox_scene::model_instance&) { hit.push_back(name); });
+		assert(hit.size() == 1 && hit[0] == "inst50");
+
+		// corners follow instances even before the bvh is refit
+		scene.instances["inst51"].transform = mat<4, 4>::translation({ 0, 0, -70 });
+		c = scene.corners();
+		assert(std::get<0>(c)[2] == -71);
+
+		// the tree is rebuilt once the instance count changes
+		scene.instances.erase("inst50");
+		hit.clear();
+		scene.instances_in(box, [&](const std::string& name, g::game::vox_scene::model_instance&) { hit.push_back(name); });
+		assert(hit.empty());
+
+		scene.instances.erase("inst0");
+		scene.instances["late"] = scene.instances["inst1"];
+		scene.instances["late"].transform = mat<4, 4>::translation({ 0, 50, 0 });
+
+		// same count, so the removed instance is skipped rather than looked up
+		vec<3> origin_box[2] = { { -1, -1, -1 }, { 1, 1, 1 } };
+		hit.clear();
+		scene.instances_in(origin_box, [&](const std::string& name, g::game::vox_scene::model_instance&) { hit.push_back(name); });
+		assert(hit.empty());
+
+		scene.build_bvh();
+		hit.clear();
+		scene.instances_in(box, [&](const std::string& name, g::game::vox_scene::model_instance&) { hit.push_back(name); });
+		assert(hit.size() == 1 && hit[0] == "late");
+
+		// refitting a single instance accounts for its group
+		scene.groups.push_back({ nullptr, mat<4, 4>::translation({ 0, 0, 200 }) });
+		scene.instances["late"].group = &scene.groups[0];
+		scene.refit_bvh("late");
+		hit.clear();
+		scene.instances_in(box, [&](const std::string& name, g::game::vox_scene::model_instance&) { hit.push_back(name); });
+		assert(hit.empty());
+
+		vec<3> moved_box[2] = { { -1, 45, 199 }, { 1, 55, 201 } };
+		scene.instances_in(moved_box, [&](const std::string& name, g::game::vox_scene::model_instance&) { hit.push_back(name); });
+		assert(hit.size() == 1 && hit[0] == "late");
+	}
+
+	return 0;
+}
@@ -0,0 +1,149 @@
+#include ".test.h"
+#include "g.h"
+
+using namespace g::dyn;
+
+// contacts for unit diameter spheres resting on the plane y = 0 and each other
+static void find_contacts(rigid_body_system& bodies, cr::solver& solver, const std::vector<size_t>& spheres)
+{
+    const float r = 0.5f;
+
+    for (auto i : spheres)
+    {
+        auto p = bodies[i].position();
+        if (p[1] < r)
+        {
+            cr::contact c;
+            c.a = i;
+            c.point = { p[0], 0, p[2] };
+            c.normal = { 0, -1, 0 };
+            c.depth = r - p[1];
+            solver.contacts.push_back(c);
+        }
+
+        for (auto j : spheres)
+        {
+            if (j <= i) { continue; }
+
+            auto d = bodies[j].position() - p;
+            auto dist = d.magnitude();
+            if (dist < 2 * r)
+            {
+                cr::contact c;
+                c.a = i;
+                c.b = j;
+                c.normal = d / dist;
+                c.point = p + c.normal * r;
+                c.depth = 2 * r - dist;
+                solver.contacts.push_back(c);
+            }
+        }
+    }
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    const float dt = 1 / 60.f;
+
+    { // two stacks come to rest as separate islands, then sleep
+        rigid_body_system bodies;
+        cr::solver solver(bodies);
+        std::vector<size_t> spheres;
+
+        for (int s = 0; s < 2; s++)
+        for (int i = 0; i < 4; i++)
+        {
+            spheres.push_back(bodies.add(1, { s * 10.f, 0.5f + i * 1.05f, 0 }).index);
+        }
+
+        for (int step = 0; step < 600; step++)
+        {
+            find_contacts(bodies, solver, spheres);
+            solver.step(dt);
+
+            // once the spheres have settled onto each other
+            if (step == 20) { assert(solver.island_count() == 2); }
+        }
+
+        assert(solver.awake_count() == 0);
+
+        for (int s = 0; s < 2; s++)
+        for (int i = 0; i < 4; i++)
+        {
+            auto p = bodies[s * 4 + i].position();
+            assert(fabsf(p[1] - (0.5f + i)) < 0.05f);
+            assert(fabsf(p[0] - s * 10.f) < 0.01f);
+        }
+
+        // sleeping bodies stay put
+        auto before = bodies[3].position();
+        for (int step = 0; step < 60; step++)
+        {
+            find_contacts(bodies, solver, spheres);
+            solver.step(dt);
+        }
+        assert(bodies[3].position() == before);
+
+        // a push wakes only that stack
+        bodies[0].dyn_apply_local_force({}, { 100, 0, 0 });
+        find_contacts(bodies, solver, spheres);
+        solver.step(dt);
+        assert(solver.island_count() == 1);
+        assert(solver.awake_count() == 4);
+        assert(!solver.is_awake(4));
+    }
+
+    { // a pendulum stays on its joint
+        rigid_body_system bodies;
+        cr::solver solver(bodies);
+        auto bob = bodies.add(1, { 2, 0, 0 });
+
+        cr::ball_joint j;
+        j.b = bob.index;
+        j.anchor_a = { 0, 0, 0 };
+        j.anchor_b = { -2, 0, 0 };
+        solver.joints.push_back(j);
+
+        for (int step = 0; step < 300; step++)
+        {
+            solver.step(dt);
+
+            auto anchor = bob.position() + bob.to_global({ -2, 0, 0 });
+            assert(anchor.magnitude() < 0.05f);
+        }
+
+        // it has swung down
+        assert(bob.position()[1] < -0.5f);
+    }
+
+    { // solving islands in parallel matches solving them serially
+        rigid_body_system a, b;
+        cr::solver sa(a), sb(b);
+        g::proc::thread_pool<4> pool;
+        std::vector<size_t> spheres;
+
+        for (int s = 0; s < 8; s++)
+        {
+            spheres.push_back(a.add(1, { s * 3.f, 0.5f, 0 }).index);
+            b.add(1, { s * 3.f, 0.5f, 0 });
+            spheres.push_back(a.add(1, { s * 3.f + 0.3f, 1.45f, 0 }).index);
+            b.add(1, { s * 3.f + 0.3f, 1.45f, 0 });
+        }
+
+        for (int step = 0; step < 120; step++)
+        {
+            find_contacts(a, sa, spheres);
+            find_contacts(b, sb, spheres);
+            sa.step(dt);
+            sb.step(dt, pool);
+        }
+
+        for (auto i : spheres) { assert(a[i].position() == b[i].position()); }
+    }
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include ".test.h"
+#include "g.h"
+
+using namespace g::dyn;
+
+static cd::box make_box(const vec<3>& center, const vec<3>& half, const quat<>& q={0, 0, 0, 1})
+{
+    auto R = q.inverse();
+    return { center, R.rotate({ half[0], 0, 0 }), R.rotate({ 0, half[1], 0 }), R.rotate({ 0, 0, half[2] }) };
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    { // time of impact between convex shapes
+        auto a = make_box({ 0, 0, 0 }, { 0.5f, 0.5f, 0.5f });
+        auto b = make_box({ 5, 0.3f, 0 }, { 0.5f, 0.5f, 0.5f });
+
+        auto hit = cd::sweep_convex(a, { 10, 0, 0 }, b);
+        assert(hit);
+        assert(fabsf(hit.time - 0.4f) < 1e-3f);
+        assert(hit.normal.is_near({ -1, 0, 0 }, 1e-3f));
+        assert(fabsf(hit.point[0] - 4.5f) < 1e-3f);
+
+        // too short, moving away and passing by
+        assert(!cd::sweep_convex(a, { 3, 0, 0 }, b));
+        assert(!cd::sweep_convex(a, { -10, 0, 0 }, b));
+        assert(!cd::sweep_convex(a, { 10, 0, 3 }, b));
+
+        // a sphere against a rotated box, meeting its corner
+        auto diamond = make_box({ 0, 0, 0 }, { 1, 1, 1 }, quat<>::from_axis_angle({ 0, 0, 1 }, M_PI / 4));
+        cd::sphere s = { { -10, 0, 0 }, 0.5f };
+        hit = cd::sweep_convex(s, { 20, 0, 0 }, diamond);
+        assert(hit);
+        assert(fabsf(hit.time * 20 - (10 - sqrtf(2) - 0.5f)) < 1e-3f);
+        assert(hit.normal.is_near({ -1, 0, 0 }, 1e-3f));
+
+        // touching, sliding along the surface isn't a hit
+        auto floor = make_box({ 0, -1, 0 }, { 10, 0.5f, 10 });
+        cd::sphere resting = { { 0, 0, 0 }, 0.5f };
+        assert(!cd::sweep_convex(resting, { 3, 0, 0 }, floor));
+        assert(cd::sweep_convex(resting, { 3, -0.1f, 0 }, floor));
+
+        cd::shape_collider capsule(cd::capsule{ { 3, -1, 0 }, { 3, 1, 0 }, 0.25f });
+        hit = cd::sweep(s, { 20, 0, 0 }, capsule);
+        assert(hit);
+        assert(fabsf(hit.time * 20 - 12.25f) < 1e-3f);
+    }
+
+    { // fast particles stop at thin walls, but only if continuous
+        cd::shape_collider wall(make_box({ 10, 0, 0 }, { 0.01f, 5, 5 }));
+        auto sweep = [&](const vec<3>& from, const vec<3>& d) { return cd::sweep(cd::sphere{ from, 0.1f }, d, wall); };
+
+        particle bullet = { { 0, 0, 0 }, { 600, 0, 0 } };
+        particle tracer = bullet;
+        tracer.continuous = true;
+
+        bullet.dyn_step(1 / 30.f, sweep);
+        auto hit = tracer.dyn_step(1 / 30.f, sweep);
+
+        assert(bullet.position[0] > 10);
+        assert(hit);
+        assert(fabsf(tracer.position[0] - 9.89f) < 1e-3f);
+        assert(fabsf(tracer.velocity[0]) < 1e-6f);
+        assert(fabsf(hit.point[0] - 9.99f) < 1e-3f);
+    }
+
+    { // a sphere falling onto an sdf stops on it, and keeps moving along it
+        g::game::sdf ground = [](const vec<3>& p) -> float { return p[1]; };
+        rigid_body ball;
+        ball.mass = 1;
+        ball.update_inertia_tensor();
+        ball.continuous = true;
+        ball.position = { 0, 10, 0 };
+        ball.linear_momentum = { 4, -100, 0 };
+
+        auto sweep = [&](const vec<3>& from, const vec<3>& d) { return cd::sweep(cd::sphere{ from, 0.5f }, d, ground); };
+        auto hit = ball.dyn_step(0.5f, sweep);
+
+        assert(hit);
+        assert(hit.normal.is_near({ 0, 1, 0 }, 1e-3f));
+        assert(fabsf(ball.position[1] - 0.5f) < 1e-3f);
+        assert(fabsf(ball.position[0] - 2) < 1e-3f);
+        assert(ball.linear_momentum.is_near({ 4, 0, 0 }, 1e-3f));
+
+        ball.dyn_step(0.5f, sweep);
+        assert(fabsf(ball.position[0] - 4) < 1e-3f);
+        assert(fabsf(ball.position[1] - 0.5f) < 1e-3f);
+    }
+
+    { // conservative advancement of a box's corners through a thin sdf wall
+        g::game::sdf slab = [](const vec<3>& p) -> float { return fabsf(p[0] - 5) - 0.02f; };
+        auto b = make_box({ 0, 0, 0 }, { 0.5f, 0.5f, 0.5f }, quat<>::from_axis_angle({ 0, 1, 0 }, 0.3f));
+
+        auto hit = cd::sweep(b, { 50, 0, 0 }, slab);
+        assert(hit);
+        float leading = 0;
+        for (int i = 0; i < 8; i++) { leading = std::max(leading, b.corner(i)[0]); }
+        assert(fabsf(b.position[0] + hit.time * 50 + leading - 4.98f) < 1e-3f);
+        assert(hit.normal.is_near({ -1, 0, 0 }, 1e-2f));
+
+        assert(!cd::sweep(b, { 4, 0, 0 }, slab));
+        assert(!cd::sweep(b, { -50, 0, 0 }, slab));
+    }
+
+    { // continuous bodies of a system, and of a solver
+        cd::shape_collider wall(make_box({ 10, 0, 0 }, { 0.01f, 5, 5 }));
+        auto sweep = [&](rigid_body_system::body, const vec<3>& from, const vec<3>& d) {
+            return cd::sweep(cd::sphere{ from, 0.25f }, d, wall);
+        };
+
+        rigid_body_system bodies;
+        for (int i = 0; i < 20; i++)
+        {
+            auto b = bodies.add(1, { 0, 0, (float)i * 0.1f });
+            b.velocity({ 1000, 0, 0 });
+            b.continuous(i % 2 == 0);
+        }
+
+        bodies.dyn_step(1 / 30.f, sweep);
+        for (size_t i = 0; i < bodies.size(); i++)
+        {
+            auto x = bodies[i].position()[0];
+            if (bodies[i].continuous())
+            {
+                assert(fabsf(x - 9.74f) < 1e-3f);
+                assert(fabsf(bodies[i].velocity()[0]) < 1e-4f);
+                assert(fabsf(bodies[i].linear_momentum()[0]) < 1e-4f);
+            }
+            else
+            {
+                assert(x > 10);
+            }
+        }
+
+        rigid_body_system falling;
+        cr::solver solver(falling);
+        auto body = falling.add(1, { 0, 5, 0 });
+        body.continuous(true);
+        body.velocity({ 0, -200, 0 });
+        cd::shape_collider floor(make_box({ 0, -0.05f, 0 }, { 10, 0.05f, 10 }));
+        solver.sweep = [&](rigid_body_system::body, const vec<3>& from, const vec<3>& d) {
+            return cd::sweep(cd::sphere{ from, 0.5f }, d, floor);
+        };
+
+        for (int step = 0; step < 30; step++)
+        {
+            auto ball = cd::shape_collider(cd::sphere{ body.position(), 0.5f });
+            solver.add(ball.contact(floor), body.index, cr::fixed);
+            solver.step(1 / 10.f);
+            assert(body.position()[1] > 0.4f);
+        }
+
+        assert(fabsf(body.position()[1] - 0.5f) < 0.02f);
+    }
+
+    return 0;
+}
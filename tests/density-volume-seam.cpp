@@ -0,0 +1,86 @@
+#include ".test.h"
+#include "g.h"
+
+using V = g::gfx::vertex::pos_norm;
+using seam = g::gfx::density_volume<V>::seam;
+using lod_signature = g::gfx::density_volume<V>::lod_signature;
+
+// blocks with x >= 1 are meshed at half the resolution of those with x < 1
+static lod_signature lods_at(int bx)
+{
+    lod_signature lods;
+
+    for (int z = -1; z <= 1; z++)
+    for (int y = -1; y <= 1; y++)
+    for (int x = -1; x <= 1; x++)
+    {
+        lods[(x + 1) + 3 * ((y + 1) + 3 * (z + 1))] = (bx + x) >= 1 ? 1 : 0;
+    }
+
+    return lods;
+}
+
+static void mesh_block(const g::game::sdf& sdf, int bx, unsigned divisions, std::vector<V>& verts, std::vector<uint32_t>& inds)
+{
+    seam s = { sdf, { vec<3>{ (float)bx, 0, 0 }, vec<3>{ (float)bx + 1, 1, 1 } }, 1, divisions, lods_at(bx) };
+    vec<3> box[2] = { s.box[0], s.box[1] };
+
+    g::game::sdf field = [&](const vec<3>& p) -> float { return s.field(p); };
+    g::gfx::mesh<V> m;
+    m.from_sdf(verts, inds, field, [&](const g::game::sdf&, const vec<3>& p) -> V {
+        return { s.snap(p), {} };
+    }, box, divisions >> s.lods[13]);
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    // a sphere straddling the face shared by the two blocks at x = 1
+    g::game::sdf sdf = [](const vec<3>& p) -> float {
+        return (p - vec<3>{ 1.1f, 0.5f, 0.45f }).magnitude() - 0.37f;
+    };
+
+    std::vector<V> fine_verts, coarse_verts;
+    std::vector<uint32_t> fine_inds, coarse_inds;
+
+    mesh_block(sdf, 0, 16, fine_verts, fine_inds);
+    mesh_block(sdf, 1, 16, coarse_verts, coarse_inds);
+
+    // edges of coarse triangles that lie on the shared face
+    std::vector<std::pair<vec<3>, vec<3>>> coarse_edges;
+    for (unsigned i = 0; i < coarse_inds.size(); i += 3)
+    for (unsigned j = 0; j < 3; j++)
+    {
+        auto& p0 = coarse_verts[coarse_inds[i + j]].position;
+        auto& p1 = coarse_verts[coarse_inds[i + (j + 1) % 3]].position;
+        if (near(p0[0], 1, 1e-4) && near(p1[0], 1, 1e-4)) { coarse_edges.push_back({p0, p1}); }
+    }
+
+    assert(coarse_edges.size() > 0);
+
+    // every fine vertex on the shared face must lie on the coarse boundary
+    unsigned checked = 0;
+    for (auto& v : fine_verts)
+    {
+        if (!near(v.position[0], 1, 1e-4)) { continue; }
+
+        float best = 1e9;
+        for (auto& e : coarse_edges)
+        {
+            auto s = e.second - e.first;
+            auto t = std::min(1.f, std::max(0.f, (v.position - e.first).dot(s) / s.dot(s)));
+            best = std::min(best, (e.first + s * t - v.position).magnitude());
+        }
+
+        assert(best < 1e-4);
+        checked++;
+    }
+
+    std::cerr << checked << " seam vertices checked" << std::endl;
+    assert(checked > coarse_edges.size());
+
+	return 0;
+}
@@ -0,0 +1,115 @@
+#include ".test.h"
+#include "g.h"
+
+using V = g::gfx::vertex::pos_norm;
+using volume = g::gfx::density_volume<V>;
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    g::game::sdf sdf = [](const vec<3>& p) -> float { return p[1]; };
+    auto generator = [](const g::game::sdf&, const vec<3>& p) -> V { return { p, { 0, 1, 0 } }; };
+
+    // a projection which sees everything, or nothing
+    auto everything = mat<4, 4>::I();
+    everything[0][0] = everything[1][1] = everything[2][2] = 1e-3f;
+    auto nothing = mat<4, 4>::I();
+    nothing[0][0] = nothing[1][1] = nothing[2][2] = 0;
+    nothing[3][3] = -1; // every point behind the camera
+
+    { // blocks nearest the camera are meshed first, hidden blocks later
+        std::vector<vec<3>> offsets;
+        for (int z = -2; z <= 2; z++)
+        for (int y = -2; y <= 2; y++)
+        for (int x = -2; x <= 2; x++)
+        {
+            offsets.push_back({ (float)x, (float)y, (float)z });
+        }
+
+        volume dv(sdf, generator, offsets);
+        dv.scale = 2;
+        vec<3> pos = { 5, 5, 5 };
+
+        auto pending = dv.schedule(pos, everything);
+        assert(pending.size() == offsets.size());
+        assert((pending[0].index == vec<3, int>{ 2, 2, 2 }));
+        for (size_t i = 1; i < pending.size(); i++)
+        {
+            assert(pending[i - 1].priority <= pending[i].priority);
+            assert(pending[i].block_ptr == nullptr);
+        }
+
+        auto hidden = dv.schedule(pos, nothing);
+        for (size_t i = 0; i < hidden.size(); i++)
+        {
+            assert(hidden[i].index == pending[i].index);
+            assert(fabsf(hidden[i].priority - pending[i].priority * dv.hidden_penalty) < 1e-4f);
+        }
+    }
+
+    { // out of range blocks are cached, and the least recently used are evicted
+        volume dv(sdf, generator, { { 0, 0, 0 } });
+        dv.cache_size = 2;
+
+        volume::block* b[3];
+        for (int i = 0; i < 3; i++)
+        {
+            b[i] = dv.acquire();
+            b[i]->index = { i * 10, 0, 0 };
+            dv.resident[b[i]->index] = b[i];
+        }
+
+        for (int i = 0; i < 3; i++) { dv.cache(b[i]); }
+        assert(dv.resident.empty());
+        assert(dv.cached.size() == 2);
+        assert(b[0]->state == volume::residency::free);
+        assert(b[1]->state == volume::residency::cached);
+        assert(b[2]->state == volume::residency::cached);
+
+        // revisiting a cached block reuses it without remeshing
+        auto pending = dv.schedule({ 20.5f, 0.5f, 0.5f }, everything);
+        assert(pending.empty());
+        assert(dv.resident.size() == 1 && (dv.resident[{ 20, 0, 0 }] == b[2]));
+        assert(b[2]->state == volume::residency::resident);
+        assert(dv.cached.size() == 1);
+
+        // free blocks are handed out first, then the least recently cached
+        assert(dv.acquire() == b[0]);
+        assert(dv.acquire() == b[1]);
+        assert(dv.cached.empty());
+
+        // leaving its range caches the resident block again
+        dv.schedule({ 100.5f, 0.5f, 0.5f }, everything);
+        assert(b[2]->state == volume::residency::cached);
+        assert((dv.cached.count({ 20, 0, 0 }) == 1));
+    }
+
+    { // the lod bias only moves once the blocks meshed at the last one have landed
+        volume dv(sdf, generator, { { 0, 0, 0 } });
+        dv.divisions = 8;
+        dv.lod_levels = 3;
+        dv.triangle_budget = 100;
+        dv.triangles = 1000;
+
+        dv.in_flight = 1;
+        assert(!dv.balance_lod(0));
+        dv.in_flight = 0;
+        assert(!dv.balance_lod(4));
+        assert(dv.lod_bias == 0);
+
+        assert(dv.balance_lod(0) && dv.lod_bias == 1);
+        assert(dv.balance_lod(0) && dv.lod_bias == 2);
+        assert(!dv.balance_lod(0) && dv.lod_bias == 2);
+
+        // within budget, but not so far under it that refining would overshoot
+        dv.triangles = 80;
+        assert(!dv.balance_lod(0));
+        dv.triangles = 10;
+        assert(dv.balance_lod(0) && dv.lod_bias == 1);
+    }
+
+    return 0;
+}
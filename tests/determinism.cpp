@@ -0,0 +1,185 @@
+#include ".test.h"
+#include "g.h"
+
+using namespace g::dyn;
+
+struct agent
+{
+    uint8_t genes[16] = {};
+    float fitness = 0;
+
+    uint8_t* genome_buf() { return genes; }
+    size_t genome_size() const { return sizeof(genes); }
+    float score() const { return fitness; }
+};
+
+static uint64_t simulate(bool shuffle, int steps, int perturb_step=-1)
+{
+    rigid_body_system bodies;
+    cr::solver solver(bodies);
+    solver.deterministic = true;
+    g::utils::rng generator(7);
+
+    // a stack of spheres per column
+    std::vector<size_t> spheres;
+    for (int c = 0; c < 4; c++)
+    for (int i = 0; i < 5; i++)
+    {
+        spheres.push_back(bodies.add(1, { c * 3.f + generator.uniform(-0.1f, 0.1f), 0.5f + i * 1.01f, 0 }).index);
+    }
+
+    uint64_t h = 0;
+    for (int step = 0; step < steps; step++)
+    {
+        for (size_t i = 0; i < spheres.size(); i++)
+        {
+            auto bi = bodies[spheres[i]];
+            auto m = cd::collide(cd::sphere{ bi.position(), 0.5f }, cd::box{ { 0, -0.5f, 0 }, { 100, 0, 0 }, { 0, 0.5f, 0 }, { 0, 0, 100 } });
+            solver.add(m, bi.index, cr::fixed);
+
+            for (size_t j = i + 1; j < spheres.size(); j++)
+            {
+                auto bj = bodies[spheres[j]];
+                solver.add(cd::collide(cd::sphere{ bi.position(), 0.5f }, cd::sphere{ bj.position(), 0.5f }), bi.index, bj.index);
+            }
+        }
+
+        if (shuffle)
+        {
+            for (size_t i = solver.contacts.size(); i > 1; i--)
+            {
+                std::swap(solver.contacts[i - 1], solver.contacts[generator.below(i)]);
+            }
+        }
+
+        if (step == perturb_step) { bodies[3].position(bodies[3].position() + vec<3>{ 1e-6f, 0, 0 }); }
+
+        solver.step(1 / 60.f);
+        h = g::utils::hash64(&h, sizeof(h), solver.checksum());
+    }
+
+    return h;
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    { // seeded generators repeat their sequences
+        g::utils::rng a(42), b(42), c(43);
+        bool differs = false;
+        for (int i = 0; i < 100; i++)
+        {
+            auto x = a.next();
+            assert(x == b.next());
+            differs |= x != c.next();
+        }
+        assert(differs);
+
+        // PCG32's reference sequence for seed 42, stream 54
+        g::utils::rng ref(42, 54);
+        assert(ref.next() == 0xa15c02b7);
+        assert(ref.next() == 0x7b47f409);
+
+        // an empty range returns 0 and doesn't disturb the sequence
+        g::utils::rng empty(42, 54), ahead(42, 54);
+        assert(empty.below(0) == 0);
+        assert(empty.next() == ahead.next());
+
+        float mean = 0, var = 0;
+        unsigned counts[5] = {};
+        const int n = 100000;
+        for (int i = 0; i < n; i++)
+        {
+            auto u = a.uniform();
+            assert(u >= 0 && u < 1);
+            counts[a.below(5)]++;
+
+            auto x = a.normal(1, 2);
+            mean += x / n;
+            var += (x - 1) * (x - 1) / n;
+        }
+        assert(fabsf(mean - 1) < 0.05f);
+        assert(fabsf(var - 4) < 0.1f);
+        for (auto c : counts) { assert(c > n / 5 * 0.95f && c < n / 5 * 1.05f); }
+    }
+
+    { // evolution with a seeded generator breeds the same generation
+        std::vector<agent> runs[2];
+        for (auto& g_1 : runs)
+        {
+            g::utils::rng generator(3);
+            std::vector<agent> g_0(50);
+            for (size_t i = 0; i < g_0.size(); i++)
+            {
+                for (auto& gene : g_0[i].genes) { gene = generator.below(256); }
+                g_0[i].fitness = (float)(i % 7);
+            }
+
+            g::ai::evolution::generation_desc desc;
+            desc.mutation_rate = 0.05f;
+            g::ai::evolution::generation(g_0, g_1, desc, generator);
+        }
+
+        assert(runs[0].size() == 50 && runs[1].size() == 50);
+        for (size_t i = 0; i < runs[0].size(); i++)
+        {
+            assert(memcmp(runs[0][i].genes, runs[1][i].genes, sizeof(agent::genes)) == 0);
+        }
+    }
+
+    { // fixed point arithmetic
+        fixed a = 3.25f, b = -1.5f;
+        assert((float)(a + b) == 1.75f);
+        assert((float)(a - b) == 4.75f);
+        assert((float)(a * b) == -4.875f);
+        assert(fabsf((float)(a / b) + 2.1666667f) < 1e-4f);
+        assert((float)(fixed(1) / 3 * 3) > 0.9999f);
+        assert(fabsf((float)sqrt(fixed(2)) - 1.4142135f) < 2e-5f);
+        assert((float)sqrt(fixed(10000)) == 100);
+        assert(abs(b) == fixed(1.5f));
+        assert(b < a && -a < b);
+        assert(fixed::from_raw(1) * fixed::from_raw(1) == fixed());
+
+        // a projectile integrated in fixed point
+        vec<3, fixed> p = { 0, 0, 0 }, v = { 10, 20, 0 }, g = { 0, fixed(-9.8f), 0 };
+        fixed dt = 1 / 64.f;
+        for (int i = 0; i < 128; i++)
+        {
+            v += g * dt;
+            p += v * dt;
+        }
+
+        // semi-implicit euler with 128 steps of 1/64s lands near the exact parabola
+        assert(fabsf((float)p[0] - 20) < 1e-3f);
+        assert(fabsf((float)p[1] - (40 - 0.5f * 9.8f * 4 - 0.5f * 9.8f * 2 / 64)) < 0.01f);
+    }
+
+    { // a solver's results don't depend on the order contacts are added
+        auto reference = simulate(false, 120);
+        assert(simulate(true, 120) == reference);
+        assert(simulate(false, 120, 60) != reference);
+    }
+
+    { // broadphase pairs are ordered
+        cd::collision_world world;
+        cd::ray_collider colliders[16];
+        for (int i = 15; i >= 0; i--)
+        {
+            vec<3> box[2] = { { i * 0.5f, 0, 0 }, { i * 0.5f + 1, 1, 1 } };
+            world.add(colliders + i, box);
+        }
+
+        world.update_pairs();
+        auto& pairs = world.pairs();
+        assert(pairs.size() > 0);
+        for (size_t i = 1; i < pairs.size(); i++)
+        {
+            assert(pairs[i - 1].a < pairs[i].a || (pairs[i - 1].a == pairs[i].a && pairs[i - 1].b < pairs[i].b));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include ".test.h"
+#include "g.h"
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+	g::game::voxels<uint8_t> vox(24, 20, 18);
+	vec<3> center = { 11.5f, 9.5f, 8.5f };
+	float radius = 6;
+
+	// a solid ball, and a lone voxel off to the side
+	vox.each([&](size_t x, size_t y, size_t z, uint8_t& v) {
+		vec<3> p = { x + 0.5f, y + 0.5f, z + 0.5f };
+		v = (p - center).magnitude() < radius ? 1 : 0;
+	});
+	vox.set(21, 2, 2, 1);
+
+	g::game::distance_field field(vox);
+
+	assert((field.size == vec<3, size_t>{ 26, 22, 20 }));
+
+	{ // grid distances match the nearest voxel of the opposite kind found by brute force
+		srand(3);
+		for (int i = 0; i < 300; i++)
+		{
+			int x = rand() % vox.width, y = rand() % vox.height, z = rand() % vox.depth;
+			bool solid = vox.idx(x, y, z) != 0;
+			float best = std::numeric_limits<float>::infinity();
+
+			for (int bz = -1; bz <= (int)vox.depth; bz++)
+			for (int by = -1; by <= (int)vox.height; by++)
+			for (int bx = -1; bx <= (int)vox.width; bx++)
+			{
+				bool in = bx >= 0 && by >= 0 && bz >= 0 && bx < (int)vox.width && by < (int)vox.height && bz < (int)vox.depth;
+				bool other = in && vox.idx(bx, by, bz) != 0;
+				if (other == solid) { continue; }
+
+				best = std::min(best, vec<3>{ (float)(bx - x), (float)(by - y), (float)(bz - z) }.magnitude());
+			}
+
+			auto expected = solid ? -(best - 0.5f) : best - 0.5f;
+			assert(fabsf(field.at(x + 1, y + 1, z + 1) - expected) < 1e-4);
+		}
+	}
+
+	{ // the field approximates the ball's distance near it
+		auto sdf = field.to_sdf();
+		for (int i = 0; i < 200; i++)
+		{
+			vec<3> dir = { (rand() % 200) - 100.f, (rand() % 200) - 100.f, (rand() % 200) - 100.f };
+			if (dir.magnitude() == 0) { continue; }
+			dir = dir.unit();
+
+			auto p = center + dir * (radius + 1.5f);
+			if (p[0] > 18) { continue; } // keep clear of the lone voxel
+
+			assert(fabsf(sdf(p) - 1.5f) < 0.75f);
+			assert(field.gradient(p).unit().dot(dir) > 0.8f);
+		}
+
+		assert(sdf(center) < -radius + 1);
+	}
+
+	{ // beyond the grid distances keep growing and never overestimate
+		vec<3> p = { -20, 9.5f, 8.5f };
+		auto d = field.sample(p);
+		assert(d > 20);
+		assert(d <= (p - center).magnitude() - radius + 0.5f);
+	}
+
+	{ // world placement and scale
+		g::game::distance_field scaled(vox, { 10, 0, 0 }, 0.5f);
+		auto p = vec<3>{ 10, 0, 0 } + (center + vec<3>{ 0, radius + 2, 0 }) * 0.5f;
+		assert(fabsf(scaled.sample(p) - field.sample(center + vec<3>{ 0, radius + 2, 0 }) * 0.5f) < 1e-4);
+	}
+
+	{ // the same field is produced across threads
+		g::proc::thread_pool<4> pool;
+		g::game::distance_field pooled(vox, pool);
+		assert(pooled.distances == field.distances);
+	}
+
+	return 0;
+}
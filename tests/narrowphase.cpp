@@ -0,0 +1,291 @@
+#include ".test.h"
+#include "g.h"
+
+using namespace g::dyn;
+
+static float rnd(float lo, float hi) { return lo + (hi - lo) * (rand() / (float)RAND_MAX); }
+
+static cd::box make_box(const vec<3>& center, const vec<3>& half, const quat<>& q={0, 0, 0, 1})
+{
+    auto R = q.inverse();
+    return { center, R.rotate({ half[0], 0, 0 }), R.rotate({ 0, half[1], 0 }), R.rotate({ 0, 0, half[2] }) };
+}
+
+// area of the convex polygon through the manifold's points, about its normal
+static float spanned_area(const cd::manifold& m)
+{
+    vec<3> c = {};
+    for (unsigned i = 0; i < m.count; i++) { c += m.points[i].point / (float)m.count; }
+
+    auto u = vec<3>::cross(m.normal, fabsf(m.normal[0]) < 0.9f ? vec<3>{ 1, 0, 0 } : vec<3>{ 0, 1, 0 }).unit();
+    auto v = vec<3>::cross(m.normal, u);
+    std::vector<std::pair<float, vec<3>>> around;
+    for (unsigned i = 0; i < m.count; i++)
+    {
+        auto d = m.points[i].point - c;
+        around.push_back({ atan2f(d.dot(v), d.dot(u)), d });
+    }
+    std::sort(around.begin(), around.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+    float area = 0;
+    for (size_t i = 0; i < around.size(); i++)
+    {
+        area += vec<3>::cross(around[i].second, around[(i + 1) % around.size()].second).dot(m.normal) * 0.5f;
+    }
+    return area;
+}
+
+static cd::convex_hull hull_of(const cd::box& b)
+{
+    cd::convex_hull h;
+    for (int i = 0; i < 8; i++)
+    {
+        h.points.push_back(b.position + b.half_x * ((i & 1) ? 1.f : -1.f) + b.half_y * ((i & 2) ? 1.f : -1.f) + b.half_z * ((i & 4) ? 1.f : -1.f));
+    }
+    return h;
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    srand(2);
+
+    { // rays report the normal of the face of the box they enter
+        auto b = make_box({ 0, 0, 0 }, { 1, 2, 3 }, quat<>::from_axis_angle({ 0, 1, 0 }, M_PI / 2));
+        cd::ray r = { { 10, 0.5f, 0.2f }, { -1, 0, 0 } };
+        auto hit = r.intersect_box(b);
+        assert(hit);
+        assert(fabsf(hit.time - 7) < 1e-4f);
+        assert(hit.normal.is_near({ 1, 0, 0 }, 1e-4f));
+
+        cd::ray up = { { 0.2f, -5, 0 }, { 0, 2, 0 } };
+        hit = up.intersect_box(b);
+        assert(fabsf(hit.time - 1.5f) < 1e-4f);
+        assert(hit.normal.is_near({ 0, -1, 0 }, 1e-4f));
+
+        cd::ray miss = { { 0, 5, 0 }, { 1, 0, 0 } };
+        assert(!miss.intersect_box(b));
+    }
+
+    { // spheres and capsules
+        auto m = cd::collide(cd::sphere{ { 0, 0, 0 }, 1 }, cd::sphere{ { 1.5f, 0, 0 }, 1 });
+        assert(m.count == 1);
+        assert(m.normal.is_near({ 1, 0, 0 }, 1e-5f));
+        assert(fabsf(m.points[0].depth - 0.5f) < 1e-5f);
+
+        // parallel capsules touch along their overlap
+        m = cd::collide(cd::capsule{ { 0, 0, 0 }, { 4, 0, 0 }, 0.5f }, cd::capsule{ { 1, 0.9f, 0 }, { 6, 0.9f, 0 }, 0.5f });
+        assert(m.count == 2);
+        assert(m.normal.is_near({ 0, 1, 0 }, 1e-4f));
+        assert(fabsf(m.points[0].depth - 0.1f) < 1e-4f && fabsf(m.points[1].depth - 0.1f) < 1e-4f);
+    }
+
+    { // spheres against boxes, from outside and inside
+        auto b = make_box({ 0, 0, 0 }, { 1, 1, 1 });
+        auto m = cd::collide(cd::sphere{ { 0, 1.5f, 0 }, 1 }, b);
+        assert(m.normal.is_near({ 0, -1, 0 }, 1e-5f));
+        assert(fabsf(m.points[0].depth - 0.5f) < 1e-5f);
+
+        m = cd::collide(b, cd::sphere{ { 0.8f, 0, 0 }, 0.5f });
+        assert(m.normal.is_near({ 1, 0, 0 }, 1e-5f));
+        assert(fabsf(m.points[0].depth - 0.7f) < 1e-5f);
+
+        assert(!cd::collide(cd::sphere{ { 2, 2, 0 }, 1 }, b));
+    }
+
+    { // a box resting on another touches at 4 corners, even when turned
+        auto ground = make_box({ 0, -1, 0 }, { 5, 1, 5 });
+        for (float angle : { 0.f, 0.3f, 0.785f })
+        {
+            auto b = make_box({ 0.2f, 0.45f, 0 }, { 0.5f, 0.5f, 0.5f }, quat<>::from_axis_angle({ 0, 1, 0 }, angle));
+            auto m = cd::collide(ground, b);
+            assert(m.count == 4);
+            assert(m.normal.is_near({ 0, 1, 0 }, 1e-4f));
+            for (unsigned i = 0; i < m.count; i++)
+            {
+                assert(fabsf(m.points[i].depth - 0.05f) < 1e-4f);
+                assert(fabsf(m.points[i].point[1] + 0.025f) < 1e-4f);
+            }
+
+            auto flipped = cd::collide(b, ground);
+            assert(flipped.normal.is_near({ 0, -1, 0 }, 1e-4f));
+        }
+
+        // crossed edges touch at one point
+        auto a = make_box({ 0, 0, 0 }, { 2, 0.5f, 0.5f }, quat<>::from_axis_angle({ 1, 0, 0 }, M_PI / 4));
+        auto b = make_box({ 0, 1.3f, 0 }, { 0.5f, 0.5f, 2 }, quat<>::from_axis_angle({ 0, 0, 1 }, M_PI / 4));
+        auto m = cd::collide(a, b);
+        assert(m.count == 1);
+        assert(m.normal.is_near({ 0, 1, 0 }, 1e-3f));
+        auto expected = 0.5f * sqrtf(2) * 2 - 1.3f;
+        assert(fabsf(m.points[0].depth - expected) < 1e-3f);
+    }
+
+    { // clipping that gives more than 4 points keeps 4 distinct ones spanning them
+        auto a = make_box({ 0, 0, 0 }, { 0.5f, 0.5f, 0.5f });
+        auto b = make_box({ 0, 0.95f, 0 }, { 0.5f, 0.5f, 0.5f }, quat<>::from_axis_angle({ 0, 1, 0 }, M_PI / 4));
+        auto m = cd::collide(a, b);
+        assert(m.count == 4);
+
+        // every other corner of the octagon, which inscribes a square of area 2r^2
+        auto r = 0.5f / cosf(M_PI / 8);
+        assert(spanned_area(m) > 2 * r * r - 1e-3f);
+
+        for (unsigned i = 0; i < m.count; i++)
+        for (unsigned j = i + 1; j < m.count; j++)
+        {
+            assert(m.points[i].feature != m.points[j].feature);
+            assert((m.points[i].point - m.points[j].point).magnitude() > 0.1f);
+        }
+
+        // the same for either winding of the candidates about the normal
+        for (auto winding : { 1.f, -1.f })
+        {
+            cd::contact_point octagon[8];
+            for (int i = 0; i < 8; i++)
+            {
+                auto t = winding * i * (float)M_PI / 4;
+                octagon[i] = { { cosf(t), 0, sinf(t) }, 0.1f, (uint32_t)i };
+            }
+
+            cd::manifold reduced;
+            reduced.normal = { 0, 1, 0 };
+            reduced.reduce(octagon, 8);
+            assert(reduced.count == 4);
+            assert(fabsf(spanned_area(reduced) - 2) < 1e-4f);
+        }
+    }
+
+    { // contact features follow the geometry, not the order points are found in
+        auto ground = make_box({ 0, -1, 0 }, { 5, 1, 5 });
+        auto before = cd::collide(ground, make_box({ 0.2f, 0.45f, 0 }, { 0.5f, 0.5f, 0.5f }, quat<>::from_axis_angle({ 0, 1, 0 }, 0.3f)));
+        auto after = cd::collide(ground, make_box({ 0.21f, 0.45f, 0.01f }, { 0.5f, 0.5f, 0.5f }, quat<>::from_axis_angle({ 0, 1, 0 }, 0.32f)));
+        assert(before.count == 4 && after.count == 4);
+
+        for (unsigned i = 0; i < before.count; i++)
+        {
+            unsigned same = 0;
+            for (unsigned j = 0; j < after.count; j++)
+            {
+                if (after.points[j].feature != before.points[i].feature) { continue; }
+                same++;
+                assert(after.points[j].point.is_near(before.points[i].point, 0.05f));
+            }
+            assert(same == 1);
+        }
+
+        // as do the ends of a capsule rolling along a face
+        auto rolled = cd::collide(cd::capsule{ { -1, 0.4f, 0 }, { 1, 0.4f, 0 }, 0.5f }, ground);
+        auto rolled_on = cd::collide(cd::capsule{ { -1, 0.4f, 0.3f }, { 1, 0.4f, 0.3f }, 0.5f }, ground);
+        assert(rolled.count == 2 && rolled_on.count == 2);
+        assert(rolled.points[0].feature != rolled.points[1].feature);
+
+        for (unsigned i = 0; i < 2; i++)
+        for (unsigned j = 0; j < 2; j++)
+        {
+            if (rolled.points[i].feature != rolled_on.points[j].feature) { continue; }
+            assert(rolled_on.points[j].point.is_near(rolled.points[i].point + vec<3>{ 0, 0, 0.3f }, 1e-4f));
+        }
+    }
+
+    { // shapes that are flat where they meet are separated across their plane
+        cd::convex_hull a, b;
+        a.points = { { 0, -1, -1 }, { 0, 1, -1 }, { 0, 1, 1 }, { 0, -1, 1 } };
+        b.points = { { 0, 0, 0 }, { 0, 2, 0 }, { 0, 2, 2 }, { 0, 0, 2 } };
+
+        auto m = cd::collide(a, b);
+        assert(m);
+        assert(fabsf(fabsf(m.normal[0]) - 1) < 1e-4f);
+        assert(fabsf(m.points[0].depth) < 1e-4f);
+    }
+
+    { // the separating axis test agrees with GJK and EPA on random boxes
+        int overlapping = 0;
+        for (int i = 0; i < 500; i++)
+        {
+            auto qa = quat<>::from_axis_angle(vec<3>{ rnd(-1, 1), rnd(-1, 1), rnd(-1, 1) }.unit(), rnd(0, 3));
+            auto qb = quat<>::from_axis_angle(vec<3>{ rnd(-1, 1), rnd(-1, 1), rnd(-1, 1) }.unit(), rnd(0, 3));
+            auto a = make_box({ 0, 0, 0 }, { rnd(0.2f, 1), rnd(0.2f, 1), rnd(0.2f, 1) }, qa);
+            auto b = make_box({ rnd(-2, 2), rnd(-2, 2), rnd(-2, 2) }, { rnd(0.2f, 1), rnd(0.2f, 1), rnd(0.2f, 1) }, qb);
+
+            auto sat = cd::collide(a, b);
+            auto gjk = cd::collide(hull_of(a), hull_of(b));
+            assert((bool)sat == (bool)gjk);
+            assert(cd::overlaps(a, b) == (bool)gjk);
+
+            if (sat)
+            {
+                overlapping++;
+
+                // the least overlap of the separating axes is the penetration depth
+                float overlap[15], e_a[3], e_b[3];
+                vec<3> u_a[3], u_b[3];
+                cd::box_sat(a, b, overlap, u_a, e_a, u_b, e_b);
+                float least = overlap[0];
+                for (int k = 1; k < 15; k++) { least = std::min(least, overlap[k]); }
+                assert(fabsf(least - gjk.points[0].depth) < 0.02f);
+
+                // faces are preferred over edges by a small margin
+                float deepest = 0;
+                for (unsigned k = 0; k < sat.count; k++) { deepest = std::max(deepest, sat.points[k].depth); }
+                assert(deepest >= least - 1e-4f && deepest <= least / 0.95f + 0.02f);
+            }
+        }
+        assert(overlapping > 50);
+    }
+
+    { // capsules lying on a box touch at both ends
+        auto b = make_box({ 0, -1, 0 }, { 5, 1, 5 });
+        auto m = cd::collide(cd::capsule{ { -1, 0.4f, 0 }, { 1, 0.4f, 0 }, 0.5f }, b);
+        assert(m.count == 2);
+        assert(m.normal.is_near({ 0, -1, 0 }, 1e-4f));
+        assert(fabsf(m.points[0].depth - 0.1f) < 1e-4f);
+    }
+
+    { // shapes collide with rays and with each other through the collider interface
+        cd::shape_collider hull(hull_of(make_box({ 0, 0, 0 }, { 1, 1, 1 })));
+        cd::shape_collider capsule(cd::capsule{ { 0, -1, 5 }, { 0, 1, 5 }, 0.5f });
+        cd::shape_collider ball(cd::sphere{ { 0, 1.8f, 0 }, 1 });
+
+        auto hit = hull.ray_intersects({ { -5, 0.3f, 0.1f }, { 2, 0, 0 } });
+        assert(hit);
+        assert(fabsf(hit.time - 2) < 1e-3f);
+        assert(hit.normal.is_near({ -1, 0, 0 }, 1e-3f));
+        assert(!hull.ray_intersects({ { -5, 3, 0 }, { 1, 0, 0 } }));
+
+        hit = capsule.ray_intersects({ { 0, 5, 5 }, { 0, -1, 0 } });
+        assert(fabsf(hit.time - 3.5f) < 1e-4f);
+        assert(hit.normal.is_near({ 0, 1, 0 }, 1e-4f));
+        hit = capsule.ray_intersects({ { -5, 0.5f, 5 }, { 1, 0, 0 } });
+        assert(fabsf(hit.time - 4.5f) < 1e-4f);
+
+        auto m = ball.contact(hull);
+        assert(m);
+        assert(m.normal.is_near({ 0, -1, 0 }, 1e-3f));
+        assert(fabsf(m.points[0].depth - 0.2f) < 1e-3f);
+        assert(!capsule.contact(ball));
+    }
+
+    { // a box dropped on an sdf comes to rest on it
+        g::game::sdf ground = [](const vec<3>& p) -> float { return p[1]; };
+        rigid_body_system bodies;
+        cr::solver solver(bodies);
+        auto body = bodies.add(1, { 0, 2, 0 }, quat<>::from_axis_angle({ 0, 0, 1 }, 0.1f));
+        cd::shape_collider shape(cd::box{});
+
+        for (int step = 0; step < 300; step++)
+        {
+            shape.box_shape = { body.position(), body.to_global({ 0.5f, 0, 0 }), body.to_global({ 0, 0.5f, 0 }), body.to_global({ 0, 0, 0.5f }) };
+            solver.add(shape.contact(ground), body.index, cr::fixed);
+            solver.step(1 / 60.f);
+        }
+
+        assert(fabsf(body.position()[1] - 0.5f) < 0.02f);
+        assert(fabsf(body.up()[1]) > 0.99f || fabsf(body.left()[1]) > 0.99f);
+    }
+
+    return 0;
+}
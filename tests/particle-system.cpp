@@ -0,0 +1,162 @@
+#include ".test.h"
+#include "g.h"
+
+#include <chrono>
+
+using namespace g::dyn;
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    { // particles fall under gravity and drag, changing color as they age
+        particle_system ps(16);
+        ps.gravity = { 0, -10, 0 };
+        ps.drag = 0.5f;
+        ps.color_over_life[0] = { 1, 0, 0, 1 };
+        ps.color_over_life[1] = { 0, 0, 1, 0 };
+        ps.size_over_life[0] = 1;
+        ps.size_over_life[1] = 3;
+
+        assert(ps.emit({ 0, 0, 0 }, { 2, 0, 0 }, 1));
+        assert(ps.size() == 1);
+
+        vec<3> p = { 0, 0, 0 }, v = { 2, 0, 0 };
+        const float dt = 1 / 50.f;
+        for (int i = 0; i < 25; i++)
+        {
+            ps.update(dt);
+            v = (v + vec<3>{ 0, -10, 0 } * dt) * (1 / (1 + 0.5f * dt));
+            p += v * dt;
+        }
+
+        assert(vec<3>({ ps.position[0][0], ps.position[1][0], ps.position[2][0] }).is_near(p, 1e-4f));
+        assert(vec<3>({ ps.velocity[0][0], ps.velocity[1][0], ps.velocity[2][0] }).is_near(v, 1e-4f));
+        assert(ps.color_of(0).is_near({ 0.5f, 0, 0.5f, 0.5f }, 1e-3f));
+        assert(fabsf(ps.size_of(0) - 2) < 1e-3f);
+
+        for (int i = 0; i < 26; i++) { ps.update(dt); }
+        assert(ps.size() == 0);
+    }
+
+    { // expired particles are replaced by the last live one
+        particle_system ps(8);
+        for (int i = 0; i < 8; i++) { assert(ps.emit({ (float)i, 0, 0 }, {}, i % 2 ? 10.f : 0.5f)); }
+        assert(!ps.emit({}, {}, 1));
+
+        ps.update(1);
+        assert(ps.size() == 4);
+        for (size_t i = 0; i < ps.size(); i++) { assert((int)ps.position[0][i] % 2 == 1); }
+    }
+
+    { // emitters spawn at their rate, with seeded jitter
+        particle_system a(1024, 5), b(1024, 5);
+        for (auto ps : { &a, &b })
+        {
+            particle_system::emitter e;
+            e.position = { 0, 10, 0 };
+            e.position_spread = 1;
+            e.velocity = { 0, 5, 0 };
+            e.velocity_spread = 2;
+            e.rate = 120;
+            e.lifetime = 2;
+            e.lifetime_spread = 0.5f;
+            ps->emitters.push_back(e);
+
+            for (int i = 0; i < 60; i++) { ps->update(1 / 60.f); }
+        }
+
+        assert(a.size() >= 119 && a.size() <= 120);
+        assert(a.size() == b.size());
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            assert(a.position[0][i] == b.position[0][i]);
+            assert(a.velocity[1][i] == b.velocity[1][i]);
+            assert(fabsf(a.velocity[0][i]) <= 2);
+        }
+    }
+
+    { // jitter wider than the lifetime never gives a particle a negative or zero lifetime
+        particle_system ps(1024, 3);
+        particle_system::emitter e;
+        e.rate = 600;
+        e.lifetime = 0.1f;
+        e.lifetime_spread = 1;
+        ps.emitters.push_back(e);
+        ps.update(1 / 60.f);
+
+        assert(ps.size() > 0);
+        for (size_t i = 0; i < ps.size(); i++)
+        {
+            assert(ps.inv_lifetime[i] > 0 && ps.inv_lifetime[i] <= 1 / particle_system::min_lifetime);
+            assert(ps.life(i) >= 0 && ps.life(i) <= 1);
+        }
+    }
+
+    { // parallel and serial updates agree, and a million particles update quickly
+        const size_t n = 1 << 20;
+        particle_system serial(n, 1);
+        serial.drag = 0.1f;
+        g::utils::rng random(9);
+        for (size_t i = 0; i < n; i++)
+        {
+            serial.emit({ random.uniform(-100, 100), random.uniform(0, 100), random.uniform(-100, 100) },
+                        { random.uniform(-1, 1), random.uniform(-1, 1), random.uniform(-1, 1) },
+                        random.uniform(1, 10));
+        }
+        auto parallel = serial;
+
+        g::proc::thread_pool<4> pool;
+        for (int i = 0; i < 10; i++)
+        {
+            serial.update(1 / 60.f);
+            parallel.update(1 / 60.f, pool);
+        }
+
+        assert(serial.size() == parallel.size());
+        for (size_t i = 0; i < serial.size(); i++)
+        {
+            assert(serial.position[1][i] == parallel.position[1][i]);
+            assert(serial.age[i] == parallel.age[i]);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 10; i++) { serial.update(1 / 60.f); }
+        auto serial_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 10;
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 10; i++) { parallel.update(1 / 60.f, pool); }
+        auto parallel_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 10;
+
+        std::cerr << n << " particles: " << serial_us << "us per update, " << parallel_us << "us on 4 threads" << std::endl;
+    }
+
+    { // instances are sorted back to front
+        particle_system ps(4096, 3);
+        g::utils::rng random(4);
+        for (int i = 0; i < 4000; i++)
+        {
+            ps.emit({ random.uniform(-50, 50), random.uniform(-50, 50), random.uniform(-50, 50) }, {}, 1);
+        }
+        ps.update(0.25f);
+
+        g::gfx::primative::particles renderer;
+        vec<3> eye = { 1, 2, 3 }, forward = vec<3>{ 1, -1, 0.5f }.unit();
+        renderer.sort(ps, eye, forward);
+
+        assert(renderer.instances.size() == 4000);
+        float last = std::numeric_limits<float>::infinity();
+        for (auto& inst : renderer.instances)
+        {
+            auto depth = (inst.position - eye).dot(forward);
+            assert(depth <= last);
+            last = depth;
+            assert(inst.color[3] == 191);
+            assert(inst.size == 1);
+        }
+    }
+
+    return 0;
+}
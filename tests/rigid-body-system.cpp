@@ -0,0 +1,109 @@
+#include ".test.h"
+#include "g.h"
+
+using namespace g::dyn;
+
+static float rnd(float lo, float hi) { return lo + (hi - lo) * (rand() / (float)RAND_MAX); }
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    srand(1);
+    constexpr size_t n = 100;
+
+    std::vector<rigid_body> reference(n);
+    rigid_body_system system;
+    system.reserve(n);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        auto m = rnd(1, 10);
+        vec<3> p = { rnd(-10, 10), 0, rnd(-10, 10) };
+
+        reference[i].mass = m;
+        reference[i].update_inertia_tensor();
+        reference[i].position = p;
+        reference[i].velocity = {};
+
+        auto b = system.add(m, p);
+        assert(b.index == i);
+    }
+
+    // arrays are aligned for vector loads
+    assert(((uintptr_t)system.position[0].data() & 31) == 0);
+    assert(((uintptr_t)system.orientation[3].data() & 31) == 0);
+
+    const float dt = 1 / 60.f;
+    for (int step = 0; step < 120; step++)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            vec<3> point = { rnd(-1, 1), 0, rnd(-1, 1) };
+            vec<3> force = { rnd(-2, 2), rnd(-2, 2), rnd(-2, 2) };
+
+            reference[i].dyn_apply_local_force(point, force);
+            system[i].dyn_apply_local_force(point, force);
+
+            reference[i].dyn_step(dt);
+        }
+
+        system.dyn_step(dt);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            auto b = system[i];
+            assert(b.position().is_near(reference[i].position, 1e-3));
+            assert(b.velocity().is_near(reference[i].velocity, 1e-3));
+            assert(b.angular_momentum().is_near(reference[i].angular_momentum, 1e-3));
+            assert(b.orientation().is_near(reference[i].orientation, 1e-3));
+            assert(b.forward().is_near(reference[i].forward(), 1e-3));
+        }
+    }
+
+    { // integrating in parallel batches matches the serial loop
+        rigid_body_system a = system, b = system;
+        g::proc::thread_pool<4> pool;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            a[i].dyn_apply_global_force({ 1, 0, 0 }, { 0, (float)i, 0 });
+            b[i].dyn_apply_global_force({ 1, 0, 0 }, { 0, (float)i, 0 });
+        }
+
+        a.dyn_step(dt);
+        b.dyn_step(dt, pool, 16);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            assert(a[i].position() == b[i].position());
+            assert(a[i].orientation() == b[i].orientation());
+        }
+    }
+
+    { // orientations stay unit length however far a body turns in one step
+        rigid_body_system fast = system;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            fast.angular_momentum[0][i] = rnd(-1, 1) * 1e4f;
+            fast.angular_momentum[1][i] = rnd(-1, 1) * 1e4f;
+            fast.angular_momentum[2][i] = rnd(-1, 1) * 1e4f;
+        }
+
+        for (int step = 0; step < 10; step++)
+        {
+            fast.dyn_step(0.1f);
+
+            for (size_t i = 0; i < n; i++)
+            {
+                auto q = fast[i].orientation();
+                assert(fabsf(q.magnitude() - 1) < 1e-5f);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include ".test.h"
+#include "g.h"
+
+#include <map>
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    using V = g::gfx::vertex::pos_norm;
+
+    // cube of half width 0.5, rotated slightly so its faces don't line up with the grid
+    auto q = quat<>::from_axis_angle({ 0, 1, 0 }, 0.3f);
+    g::game::sdf cube = [&](const vec<3>& p) -> float {
+        auto r = q.rotate(p);
+        auto d = r.abs() - vec<3>{ 0.5f, 0.5f, 0.5f };
+        auto outside = d.take_max({ 0, 0, 0 }).magnitude();
+        auto inside = std::min(std::max(d[0], std::max(d[1], d[2])), 0.f);
+        return -(outside + inside);
+    };
+
+    auto generator = [](const g::game::sdf& sdf, const vec<3>& pos) -> V {
+        return { pos, g::game::normal_from_sdf(sdf, pos, 0.01f) };
+    };
+
+    vec<3> corners[2] = {{ -1, -1, -1 }, { 1, 1, 1 }};
+
+    g::gfx::mesh<V> m;
+    std::vector<V> mc_verts, dc_verts, collapsed_verts;
+    std::vector<uint32_t> mc_inds, dc_inds, collapsed_inds;
+
+    m.from_sdf(mc_verts, mc_inds, cube, generator, corners, 32);
+    m.from_sdf_dual(dc_verts, dc_inds, cube, generator, corners, 32);
+    m.from_sdf_dual(collapsed_verts, collapsed_inds, cube, generator, corners, 32, 1e-4f);
+
+    std::cerr << "marching cubes: " << mc_inds.size() / 3 << " triangles" << std::endl;
+    std::cerr << "dual contouring: " << dc_inds.size() / 3 << " triangles" << std::endl;
+    std::cerr << "collapsed dual contouring: " << collapsed_inds.size() / 3 << " triangles" << std::endl;
+
+    assert(dc_inds.size() > 0 && dc_inds.size() % 3 == 0);
+    assert(collapsed_inds.size() > 0 && collapsed_inds.size() % 3 == 0);
+    assert(collapsed_inds.size() * 4 < dc_inds.size());
+
+    // every vertex should lie on the surface of the cube
+    for (auto& v : dc_verts) { assert(std::abs(cube(v.position)) < 5e-3f); }
+    for (auto& v : collapsed_verts) { assert(std::abs(cube(v.position)) < 5e-3f); }
+
+    // sharp corners of the cube should be reproduced
+    for (int i = 0; i < 8; i++)
+    {
+        vec<3> corner = { i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f };
+        corner = q.inverse().rotate(corner);
+
+        auto closest = [&](const std::vector<V>& verts) {
+            float min_dist = 1000;
+            for (auto& v : verts) { min_dist = std::min(min_dist, (v.position - corner).magnitude()); }
+            return min_dist;
+        };
+
+        // marching cubes cuts corners off by about a cell
+        assert(closest(mc_verts) > 0.03f);
+        assert(closest(dc_verts) < 5e-3f);
+        assert(closest(collapsed_verts) < 5e-3f);
+    }
+
+    // without collapsing the mesh should be closed, each edge shared by two triangles
+    std::map<std::pair<uint32_t, uint32_t>, int> edges;
+    for (unsigned i = 0; i < dc_inds.size(); i += 3)
+    for (unsigned j = 0; j < 3; j++)
+    {
+        auto a = dc_inds[i + j], b = dc_inds[i + (j + 1) % 3];
+        edges[{ std::min(a, b), std::max(a, b) }]++;
+    }
+    for (auto& kvp : edges) { assert(kvp.second == 2); }
+
+    // triangles should face out of the cube, the same as marching cubes
+    auto outward = [&](const std::vector<V>& verts, const std::vector<uint32_t>& inds) {
+        int out = 0;
+        for (unsigned i = 0; i < inds.size(); i += 3)
+        {
+            auto& p0 = verts[inds[i]].position;
+            auto& p1 = verts[inds[i + 1]].position;
+            auto& p2 = verts[inds[i + 2]].position;
+            auto n = vec<3>::cross(p1 - p0, p2 - p0);
+            out += n.dot(p0 + p1 + p2) > 0 ? 1 : -1;
+        }
+        return out;
+    };
+
+    assert((outward(mc_verts, mc_inds) > 0) == (outward(dc_verts, dc_inds) > 0));
+    assert(std::abs(outward(dc_verts, dc_inds)) == (int)dc_inds.size() / 3);
+
+	return 0;
+}
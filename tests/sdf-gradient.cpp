@@ -0,0 +1,88 @@
+#include ".test.h"
+#include "g.h"
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    using V = g::gfx::vertex::pos_norm;
+
+    g::game::sdf sphere = [](const vec<3>& p) -> float {
+        return 0.8f - p.magnitude();
+    };
+
+    g::game::sdf_gradient sphere_gradient = [](const vec<3>& p) -> vec<3> {
+        return -p.unit();
+    };
+
+    // the tetrahedral estimate should match the analytic gradient
+    std::vector<vec<3>> points = {
+        { 0.8f, 0, 0 }, { 0, -0.5f, 0.3f }, { 0.2f, 0.4f, -0.6f }, { -1, 1, 1 },
+    };
+
+    for (auto& p : points)
+    {
+        auto grad = g::game::gradient_from_sdf(sphere, p, 0.001f);
+        assert(grad.is_near(sphere_gradient(p), 0.01f));
+        assert(g::game::normal_from_sdf(sphere, p, 0.001f).is_near(sphere_gradient(p), 0.01f));
+    }
+
+    // batched normals should match the single point version
+    std::vector<vec<3>> normals;
+    g::game::normals_from_sdf(sphere, points, normals, 0.001f);
+    assert(normals.size() == points.size());
+    for (unsigned i = 0; i < points.size(); i++)
+    {
+        assert(normals[i].is_near(g::game::normal_from_sdf(sphere, points[i], 0.001f), 1e-5f));
+    }
+
+    // gradients taken from the samples of a grid should be close to the real thing
+    vec<3> corners[2] = {{ -1, -1, -1 }, { 1, 1, 1 }};
+    g::game::sdf_grid grid;
+    grid.resize(corners, 32);
+    grid.sample(sphere);
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        auto& p = points[i];
+        assert(grid.gradient(p).unit().is_near(sphere_gradient(p), 0.05f));
+    }
+
+    // meshing with a gradient generator should produce the same surface, with
+    // normals computed from the samples the mesher took
+    auto generator = [](const g::game::sdf& sdf, const vec<3>& pos) -> V {
+        return { pos, g::game::normal_from_sdf(sdf, pos, 0.01f) };
+    };
+
+    unsigned calls = 0;
+    g::game::sdf counted = [&](const vec<3>& p) -> float { calls++; return sphere(p); };
+    auto gradient_generator = [](const g::game::sdf& sdf, const vec<3>& pos, const vec<3>& grad) -> V {
+        return { pos, grad.unit() };
+    };
+
+    g::gfx::mesh<V> m;
+    std::vector<V> verts, grad_verts;
+    std::vector<uint32_t> inds, grad_inds;
+
+    m.from_sdf(verts, inds, sphere, generator, corners, 24);
+    m.from_sdf(grad_verts, grad_inds, counted, gradient_generator, corners, 24);
+
+    assert(calls == 25 * 25 * 25);
+    assert(inds == grad_inds);
+    for (unsigned i = 0; i < verts.size(); i++)
+    {
+        assert(verts[i].position.is_near(grad_verts[i].position, 0));
+        assert(grad_verts[i].normal.dot(verts[i].normal) > 0.99f);
+    }
+
+    // the sdf collider should report the analytic normal when it has one
+    g::dyn::cd::sdf_collider collider(sphere, sphere_gradient);
+    g::dyn::cd::ray r = { { 2, 0.1f, 0 }, { -1, 0, 0 } };
+    auto hit = collider.ray_intersects(r);
+    assert(hit);
+    assert(hit.normal.is_near(sphere_gradient(hit.point), 1e-5f));
+
+	return 0;
+}
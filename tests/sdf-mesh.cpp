@@ -0,0 +1,58 @@
+#include ".test.h"
+#include "g.h"
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    using V = g::gfx::vertex::pos_norm;
+
+    g::game::sdf sphere = [](const vec<3>& p) -> float {
+        return 0.8f - p.magnitude();
+    };
+
+    auto generator = [](const g::game::sdf& sdf, const vec<3>& pos) -> V {
+        return { pos, g::game::normal_from_sdf(sdf, pos, 0.01f) };
+    };
+
+    vec<3> corners[2] = {{ -1, -1, -1 }, { 1, 1, 1 }};
+
+    g::gfx::mesh<V> m;
+    std::vector<V> serial_verts, parallel_verts;
+    std::vector<uint32_t> serial_inds, parallel_inds;
+
+    m.from_sdf(serial_verts, serial_inds, sphere, generator, corners, 24);
+
+    g::proc::thread_pool<3> pool;
+    g::game::sdf_grid grid;
+    m.from_sdf(parallel_verts, parallel_inds, sphere, generator, corners, 24, pool, grid);
+
+    std::cerr << serial_verts.size() << " vertices " << serial_inds.size() << " indices" << std::endl;
+
+    assert(serial_verts.size() > 0);
+    assert(serial_inds.size() % 3 == 0);
+
+    // parallel output must match the serial output exactly
+    assert(serial_verts.size() == parallel_verts.size());
+    assert(serial_inds == parallel_inds);
+    for (unsigned i = 0; i < serial_verts.size(); i++)
+    {
+        assert(serial_verts[i].position.is_near(parallel_verts[i].position, 0));
+    }
+
+    // every vertex should sit on the surface of the sphere
+    for (auto& v : parallel_verts)
+    {
+        assert(near(v.position.magnitude(), 0.8f, 0.01f));
+    }
+
+    // the grid should be reusable for another volume
+    vec<3> half[2] = {{ 0, -1, -1 }, { 1, 1, 1 }};
+    m.from_sdf(parallel_verts, parallel_inds, sphere, generator, half, 12, pool, grid);
+    assert(grid.samples.size() == 13 * 13 * 13);
+    assert(parallel_verts.size() > 0 && parallel_verts.size() < serial_verts.size());
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+#include ".test.h"
+#include "g.h"
+
+using namespace g::dyn;
+
+struct feet : public cd::ray_collider
+{
+    void cast(const vec<3>& o, const vec<3>& d)
+    {
+        ray_list.clear();
+        ray_list.push_back({ o, d });
+    }
+};
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    unsigned calls = 0;
+    g::game::sdf sphere = [&](const vec<3>& p) -> float { calls++; return p.magnitude() - 1; };
+
+    { // far hits converge onto the surface
+        cd::sdf_collider collider(sphere);
+        cd::ray r = { { 0, 0, 100 }, { 0, 0, -2 } };
+        auto hit = collider.ray_intersects(r);
+        assert(hit);
+        assert(fabsf(hit.time - 49.5f) < 1e-3f);
+        assert(hit.point.is_near({ 0, 0, 1 }, 1e-3f));
+        assert(hit.normal.is_near({ 0, 0, 1 }, 1e-3f));
+
+        // and misses are reported as such
+        cd::ray miss = { { 0, 2, 100 }, { 0, 0, -1 } };
+        assert(!collider.ray_intersects(miss));
+    }
+
+    { // over relaxation takes fewer steps to find the same hits
+        g::game::sdf cubes = [&](const vec<3>& p) -> float {
+            calls++;
+            vec<3> q = { fmodf(fabsf(p[0]), 4.f) - 2, p[1], fmodf(fabsf(p[2]), 4.f) - 2 };
+            return std::max(std::max(fabsf(q[0]), fabsf(q[1])), fabsf(q[2])) - 0.5f;
+        };
+
+        cd::sdf_collider plain(cubes), relaxed(cubes);
+        relaxed.trace.relaxation = 1.2f;
+        plain.trace.max_steps = relaxed.trace.max_steps = 256;
+
+        unsigned plain_calls = 0, relaxed_calls = 0;
+        for (int i = 0; i < 64; i++)
+        {
+            // shallow rays over a field of cubes take the most steps
+            cd::ray r = { { 0.5f, 3, 0.5f }, { 1, -0.05f - i * 0.001f, 0.3f } };
+
+            calls = 0;
+            auto a = plain.ray_intersects(r);
+            plain_calls += calls;
+
+            calls = 0;
+            auto b = relaxed.ray_intersects(r);
+            relaxed_calls += calls;
+
+            assert(a && b);
+            assert(fabsf(a.time - b.time) < 1e-3f);
+        }
+
+        assert(relaxed_calls < plain_calls);
+    }
+
+    { // max distance
+        cd::sdf_collider collider(sphere);
+        collider.trace.max_distance = 10;
+        cd::ray r = { { 0, 0, 20 }, { 0, 0, -1 } };
+        assert(!collider.ray_intersects(r));
+        r.position = { 0, 0, 5 };
+        assert(collider.ray_intersects(r));
+    }
+
+    { // rays starting inside trace back to where they entered
+        g::game::sdf ground = [](const vec<3>& p) -> float { return p[1]; };
+        cd::sdf_collider collider(ground);
+        cd::ray r = { { 0, -0.2f, 0 }, { 0.5f, -1, 0 } };
+        auto hit = collider.ray_intersects(r);
+        assert(hit);
+        assert(fabsf(hit.time + 0.2f) < 1e-3f);
+
+        // or forward to where they leave, if they entered elsewhere
+        cd::ray out = { { 0, -0.2f, 0 }, { 0, 1, 0 } };
+        hit = collider.ray_intersects(out);
+        assert(hit);
+        assert(fabsf(hit.time - 0.2f) < 1e-3f);
+    }
+
+    { // packets evaluate the batched sdf, matching rays traced alone
+        unsigned batches = 0;
+        g::game::sdf_batch batch = [&](const vec<3>* p, float* d, size_t n) {
+            batches++;
+            assert(n <= cd::sdf_collider::PACKET);
+            for (size_t i = 0; i < n; i++) { d[i] = p[i].magnitude() - 1; }
+        };
+
+        cd::sdf_collider single(sphere), packet(sphere, nullptr, batch);
+
+        std::vector<cd::ray> rays;
+        for (int i = 0; i < 20; i++)
+        {
+            rays.push_back({ { 5, i * 0.1f - 1, 0.2f }, { -1, 0, 0 } });
+        }
+        rays[3].direction = {}; // no direction, no hit
+
+        std::vector<cd::intersection> hits(rays.size());
+        packet.rays_intersect(rays.data(), rays.size(), hits.data());
+        assert(batches > 0);
+
+        calls = 0;
+        for (size_t i = 0; i < rays.size(); i++)
+        {
+            auto expected = single.ray_intersects(rays[i]);
+            assert((bool)expected == (bool)hits[i]);
+            if (expected) { assert(expected.time == hits[i].time); }
+        }
+        assert(!hits[3]);
+        assert(calls > 0);
+    }
+
+    { // a fast falling ray finds the ground it will pass through this step
+        g::game::sdf ground = [](const vec<3>& p) -> float { return p[1]; };
+        cd::sdf_collider collider(ground);
+        feet f;
+        f.cast({ 0, 0.5f, 0 }, { 0, -5, 0 });
+
+        auto& hits = f.intersections(collider, 1);
+        assert(hits.size() == 1);
+        assert(fabsf(hits[0].time - 0.1f) < 1e-4f);
+
+        auto& too_slow = collider.intersections(f, 0.05f);
+        assert(too_slow.empty());
+    }
+
+    return 0;
+}
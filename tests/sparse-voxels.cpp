@@ -0,0 +1,69 @@
+#include ".test.h"
+#include "g.h"
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    // mostly empty volume with a couple of small solid regions
+    g::game::voxels<uint8_t> dense(70, 40, 33);
+
+    for (size_t z = 2; z < 6; z++)
+    for (size_t y = 3; y < 9; y++)
+    for (size_t x = 60; x < 70; x++)
+    {
+        dense.idx2(x, y, z) = 1 + (x % 3);
+    }
+    dense.idx2(20, 39, 32) = 7;
+
+    g::game::sparse_voxels<uint8_t> sparse(dense);
+
+    std::cerr << sparse.brick_count() << " bricks, " << sparse.memory_usage() << " bytes" << std::endl;
+
+    assert(sparse.size.is_near(dense.size));
+    assert(sparse.brick_count() == 5);
+    assert(sparse.memory_usage() * 10 < dense.v.size());
+
+    // reads should match the dense volume everywhere
+    for (size_t z = 0; z < dense.depth; z++)
+    for (size_t y = 0; y < dense.height; y++)
+    for (size_t x = 0; x < dense.width; x++)
+    {
+        const auto& s = sparse;
+        assert(s.idx(x, y, z) == dense.idx2(x, y, z));
+    }
+
+    assert(sparse.center_of_mass(true).is_near(dense.center_of_mass(true)));
+
+    unsigned found = 0;
+    sparse.find(7, [&](size_t x, size_t y, size_t z) {
+        assert(x == 20 && y == 39 && z == 32);
+        found++;
+    });
+    assert(found == 1);
+
+    // searching for empty voxels finds every one of them, without allocating
+    size_t empty = 0;
+    sparse.find(0, [&](size_t x, size_t y, size_t z) {
+        assert(dense.idx2(x, y, z) == 0);
+        empty++;
+    });
+    assert(empty == dense.v.size() - 4 * 6 * 10 - 1);
+    assert(sparse.brick_count() == 5);
+
+    // writing zeros into empty space shouldn't allocate
+    sparse.set(0, 0, 0, 0);
+    assert(sparse.brick_count() == 5);
+    sparse.set(0, 0, 0, 3);
+    assert(sparse.brick_count() == 6);
+    assert((sparse[vec<3, size_t>{ 0, 0, 0 }] == 3));
+
+    // converting back should produce the original volume plus the new voxel
+    dense.idx2(0, 0, 0) = 3;
+    auto round_trip = sparse.dense();
+    assert(round_trip.v == dense.v);
+
+	return 0;
+}
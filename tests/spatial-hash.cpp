@@ -0,0 +1,136 @@
+#include ".test.h"
+#include "g.h"
+
+#include <chrono>
+
+using namespace g::dyn;
+
+static std::vector<size_t> brute_within(const std::vector<vec<3>>& points, const vec<3>& p, float r)
+{
+    std::vector<size_t> out;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if ((points[i] - p).dot(points[i] - p) <= r * r) { out.push_back(i); }
+    }
+    return out;
+}
+
+static std::vector<size_t> brute_nearest(const std::vector<vec<3>>& points, const vec<3>& p, size_t k, float r)
+{
+    std::vector<std::pair<float, size_t>> all;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        auto d2 = (points[i] - p).dot(points[i] - p);
+        if (d2 <= r * r) { all.push_back({ d2, i }); }
+    }
+    std::sort(all.begin(), all.end());
+
+    std::vector<size_t> out;
+    for (size_t i = 0; i < std::min(k, all.size()); i++) { out.push_back(all[i].second); }
+    return out;
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    g::utils::rng random(11);
+    std::vector<vec<3>> points;
+    for (int i = 0; i < 5000; i++)
+    {
+        points.push_back({ random.uniform(-50, 50), random.uniform(-50, 50), random.uniform(-5, 5) });
+    }
+
+    { // radius and nearest queries match a brute force search
+        // few buckets, so that many cells share each one
+        for (size_t buckets : { (size_t)1 << 14, (size_t)8 })
+        {
+            cd::spatial_hash hash(2, buckets);
+            hash.rebuild(points);
+            assert(hash.size() == points.size());
+
+            for (int q = 0; q < 200; q++)
+            {
+                vec<3> p = { random.uniform(-60, 60), random.uniform(-60, 60), random.uniform(-6, 6) };
+                auto r = random.uniform(0, 8);
+
+                std::vector<size_t> found;
+                assert(hash.within(p, r, found) == found.size());
+                std::sort(found.begin(), found.end());
+                assert(found == brute_within(points, p, r));
+
+                auto k = random.below(20);
+                std::vector<size_t> nearest;
+                hash.nearest(p, k, nearest);
+                assert(nearest == brute_nearest(points, p, k, std::numeric_limits<float>::infinity()));
+
+                hash.nearest(p, k, nearest, r);
+                assert(nearest == brute_nearest(points, p, k, r));
+            }
+        }
+    }
+
+    { // a radius spanning more cells than there are buckets
+        cd::spatial_hash hash(0.5f, 64);
+        hash.rebuild(points);
+
+        std::vector<size_t> found;
+        hash.within({ 0, 0, 0 }, 30, found);
+        std::sort(found.begin(), found.end());
+        assert(found == brute_within(points, { 0, 0, 0 }, 30));
+
+        std::vector<size_t> nearest;
+        hash.nearest({ 100, 100, 0 }, 3, nearest);
+        assert(nearest == brute_nearest(points, { 100, 100, 0 }, 3, std::numeric_limits<float>::infinity()));
+    }
+
+    { // empty, and every point in one cell
+        cd::spatial_hash hash(1);
+        std::vector<size_t> out;
+        hash.rebuild(nullptr, 0);
+        assert(hash.within({ 0, 0, 0 }, 10, out) == 0);
+        assert(hash.nearest({ 0, 0, 0 }, 4, out) == 0);
+
+        std::vector<vec<3>> stacked(10, vec<3>{ 0.5f, 0.5f, 0.5f });
+        hash.rebuild(stacked);
+        assert(hash.nearest({ 0, 0, 0 }, 4, out) == 4);
+        assert(out == std::vector<size_t>({ 0, 1, 2, 3 }));
+    }
+
+    { // a parallel rebuild answers queries identically, in the same order
+        const size_t n = 1 << 20;
+        std::vector<vec<3>> many(n);
+        for (auto& p : many) { p = { random.uniform(-500, 500), random.uniform(-500, 500), random.uniform(-500, 500) }; }
+
+        g::proc::thread_pool<4> pool;
+        cd::spatial_hash serial(4, 1 << 16), parallel(4, 1 << 16);
+
+        auto start = std::chrono::steady_clock::now();
+        serial.rebuild(many);
+        auto serial_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        parallel.rebuild(many.data(), many.size(), pool);
+        auto parallel_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        std::cerr << n << " points: " << serial_us << "us per rebuild, " << parallel_us << "us on 4 threads" << std::endl;
+
+        for (int q = 0; q < 100; q++)
+        {
+            auto& p = many[random.below(n)];
+            std::vector<size_t> a, b;
+            serial.within(p, 12, a);
+            parallel.within(p, 12, b);
+            assert(a == b && a.size() > 0);
+
+            serial.nearest(p, 8, a);
+            parallel.nearest(p, 8, b);
+            assert(a == b && a.size() == 8);
+            assert(many[a[0]].is_near(p, 0));
+        }
+    }
+
+    return 0;
+}
@@ -68,6 +68,43 @@ TEST
 		
 		std::cout << flat.size.to_string() << std::endl;
 		assert(flat.size.is_near(vec<3, size_t>{40, 39, 17}));
+
+		// the scene hasn't changed, so the cached result should be returned
+		auto& cached = scene.flatten();
+		auto cached_data = cached.v.data();
+		assert(cached.v == flat.v);
+		assert(&scene.flatten() == &cached);
+		assert(scene.flatten().v.data() == cached_data);
+
+		// moving an instance, or writing to a model without `set`, invalidates it
+		auto& inst = scene.instances.begin()->second;
+		auto transform = inst.transform;
+		inst.transform = mat<4, 4>::translation({ 1, 0, 0 }) * transform;
+		assert(scene.flatten().v.data() != cached_data);
+		inst.transform = transform;
+		assert(scene.flatten().v == flat.v);
+
+		cached_data = scene.flatten().v.data();
+		inst.model->idx(0, 0, 0) += 1;
+		assert(scene.flatten().v != flat.v);
+		inst.model->idx(0, 0, 0) -= 1;
+		assert(scene.flatten().v.data() != cached_data);
+		assert(scene.flatten().v == flat.v);
+
+		// editing a model should invalidate the cached result, and flattening
+		// across threads should agree with the serial result
+		auto& model = *scene.instances.begin()->second.model;
+		auto original = model.idx(0, 0, 0);
+		model.set(0, 0, 0, original + 1);
+
+		g::proc::thread_pool<4> pool;
+		auto parallel = scene.flatten(pool);
+		auto serial = scene.flatten<g::game::voxels<uint8_t>>();
+		assert(parallel.v != flat.v);
+		assert(parallel.v == serial.v);
+
+		model.set(0, 0, 0, original);
+		assert(scene.flatten(pool).v == flat.v);
 	}
 	return 0;
 }
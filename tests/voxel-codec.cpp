@@ -0,0 +1,137 @@
+#include ".test.h"
+#include "g.h"
+
+using namespace g::game;
+
+static voxels<uint8_t> terrain(size_t w, size_t h, size_t d, unsigned seed)
+{
+	voxels<uint8_t> vox(w, h, d);
+	srand(seed);
+
+	vox.each([&](size_t x, size_t y, size_t z, uint8_t& v) {
+		auto height = 4 + (x * 3 + z * 5) % 9;
+		if (y < height) { v = y < 3 ? 1 : 2 + (x / 4) % 3; }
+		if (rand() % 50 == 0) { v = 1 + rand() % 200; } // noise to exercise literals
+	});
+
+	return vox;
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+	auto vox = terrain(37, 24, 29, 1);
+
+	{ // round trip
+		auto bytes = voxel_codec::encode(vox);
+		voxels<uint8_t> out;
+
+		assert(bytes.size() < vox.v.size() / 2);
+		assert(voxel_codec::decode(bytes, out));
+		assert(out.size == vox.size);
+		assert(out.v == vox.v);
+	}
+
+	{ // single valued and empty models
+		voxels<uint8_t> empty(16, 16, 16), solid(16, 16, 16);
+		solid.each([](size_t, size_t, size_t, uint8_t& v) { v = 7; });
+
+		for (auto m : { &empty, &solid })
+		{
+			auto bytes = voxel_codec::encode(*m);
+			voxels<uint8_t> out;
+			assert(voxel_codec::decode(bytes, out));
+			assert(out.v == m->v);
+			assert(bytes.size() < 16 * 16 * 2 + 64);
+		}
+	}
+
+	{ // deltas against a base
+		auto edited = vox;
+		for (size_t x = 10; x < 20; x++) { edited.set(x, 20, 10, 9); }
+		edited.set(0, 0, 0, 0);
+
+		auto full = voxel_codec::encode(edited);
+		auto delta = voxel_codec::encode(edited, &vox);
+		assert(delta.size() < full.size() / 4);
+
+		voxels<uint8_t> out;
+		assert(voxel_codec::decode(delta, out, &vox));
+		assert(out.v == edited.v);
+
+		// the wrong base, or none at all, is rejected
+		auto other = terrain(37, 24, 29, 2);
+		assert(!voxel_codec::decode(delta, out, &other));
+		assert(!voxel_codec::decode(delta, out));
+	}
+
+	{ // streaming one byte at a time, columns become available as they arrive
+		auto bytes = voxel_codec::encode(vox);
+		voxel_codec::decoder dec;
+		size_t last_ready = 0;
+
+		for (size_t i = 0; i < bytes.size(); i++)
+		{
+			assert(!dec.done());
+			assert(dec.feed(&bytes[i], 1));
+			assert(dec.columns_ready() >= last_ready);
+			last_ready = dec.columns_ready();
+		}
+
+		assert(dec.done());
+		assert(dec.vox.v == vox.v);
+	}
+
+	{ // corrupt and truncated input fails without crashing
+		auto bytes = voxel_codec::encode(vox);
+		voxels<uint8_t> out;
+
+		assert(!voxel_codec::decode(bytes.data(), bytes.size() - 1, out));
+
+		auto extra = bytes;
+		extra.push_back(0);
+		assert(!voxel_codec::decode(extra, out));
+
+		srand(5);
+		for (int i = 0; i < 200; i++)
+		{
+			auto corrupt = bytes;
+			corrupt[rand() % corrupt.size()] ^= 1 << (rand() % 8);
+			voxel_codec::decode(corrupt, out);
+		}
+	}
+
+	{ // headers claiming more voxels than allowed, or than the data could hold
+		auto header = [](uint32_t w, uint32_t h, uint32_t d) {
+			std::vector<uint8_t> bytes = { 'G', 'V', 'X', voxel_codec::version };
+			for (auto v : { w, h, d }) { for (int i = 0; i < 4; i++) { bytes.push_back(v >> (8 * i)); } }
+			bytes.push_back(0); // flags
+			bytes.push_back(0); // bits
+			return bytes;
+		};
+
+		voxels<uint8_t> out;
+		assert(!voxel_codec::decode(header(1 << 16, 1 << 16, 1), out));
+		assert(!voxel_codec::decode(header(1 << 12, 1 << 12, 1 << 12), out));
+
+		// within the limit, but an 18 byte packet can't encode 4096 columns
+		assert(!voxel_codec::decode(header(16, 64, 64), out));
+
+		// a streaming decoder doesn't allocate until columns arrive
+		voxel_codec::decoder dec;
+		auto bytes = header(4096, 64, 64);
+		assert(dec.feed(bytes.data(), bytes.size()));
+		assert(dec.vox.v.capacity() == 0);
+
+		// the limit is configurable
+		auto small = voxel_codec::encode(vox);
+		assert(!voxel_codec::decode(small, out, nullptr, vox.v.size() - 1));
+		assert(voxel_codec::decode(small, out, nullptr, vox.v.size()));
+		assert(out.v == vox.v);
+	}
+
+	return 0;
+}
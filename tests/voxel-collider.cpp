@@ -0,0 +1,136 @@
+#include ".test.h"
+#include "g.h"
+
+using namespace g::dyn;
+
+// first solid voxel along the ray found by testing the ray against every voxel
+static float brute_force(const g::game::voxels<uint8_t>& vox, const cd::ray& r, const vec<3>& pos, float scale)
+{
+    auto best = std::numeric_limits<float>::infinity();
+
+    for (size_t z = 0; z < vox.depth; z++)
+    for (size_t y = 0; y < vox.height; y++)
+    for (size_t x = 0; x < vox.width; x++)
+    {
+        if (vox.idx(x, y, z) == 0) { continue; }
+
+        auto lo = pos + vec<3>{ (float)x, (float)y, (float)z } * scale;
+        float t_enter = -std::numeric_limits<float>::infinity(), t_exit = std::numeric_limits<float>::infinity();
+
+        for (int a = 0; a < 3; a++)
+        {
+            auto t0 = (lo[a] - r.position[a]) / r.direction[a];
+            auto t1 = (lo[a] + scale - r.position[a]) / r.direction[a];
+            if (t0 > t1) { std::swap(t0, t1); }
+            t_enter = std::max(t_enter, t0);
+            t_exit = std::min(t_exit, t1);
+        }
+
+        if (t_enter <= t_exit && t_exit >= 0) { best = std::min(best, std::max(t_enter, 0.f)); }
+    }
+
+    return best;
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    g::game::voxels<uint8_t> vox(37, 21, 29);
+    srand(1);
+
+    // a floor, and a few scattered voxels leaving most bricks empty
+    for (size_t z = 0; z < vox.depth; z++)
+    for (size_t x = 0; x < vox.width; x++)
+    {
+        vox.set(x, 0, z, 1);
+    }
+
+    for (int i = 0; i < 40; i++) { vox.set(rand() % vox.width, rand() % vox.height, rand() % vox.depth, 2); }
+
+    vec<3> pos = { -4, -2, 3 };
+    float scale = 0.5f;
+    cd::voxel_collider<> collider(vox, pos, scale);
+
+    { // straight down onto the floor
+        cd::ray r = { pos + vec<3>{ 10.25f, 30, 5.25f }, { 0, -1, 0 } };
+        auto h = collider.cast(r);
+        auto expected = brute_force(vox, r, pos, scale);
+
+        assert(h.hit);
+        assert(fabsf(h.hit.time - expected) < 1e-4);
+        assert(h.hit.normal.is_near({ 0, 1, 0 }));
+    }
+
+    { // random rays agree with testing every voxel
+        std::vector<cd::ray> rays;
+
+        for (int i = 0; i < 2000; i++)
+        {
+            auto rnd = []() { return (rand() % 10000) / 10000.f; };
+            vec<3> o = pos + vec<3>{ rnd() * 30 - 6, rnd() * 20 - 5, rnd() * 25 - 5 };
+            vec<3> d = { rnd() * 2 - 1, rnd() * 2 - 1, rnd() * 2 - 1 };
+            rays.push_back({ o, d });
+        }
+
+        std::vector<cd::voxel_collider<>::voxel_hit> hits;
+        collider.cast(rays, hits);
+
+        for (size_t i = 0; i < rays.size(); i++)
+        {
+            auto& h = hits[i];
+            auto expected = brute_force(vox, rays[i], pos, scale);
+
+            if (std::isinf(expected)) { assert(!h.hit); continue; }
+
+            assert(h.hit);
+            assert(fabsf(h.hit.time - expected) < 1e-3);
+            assert(vox.idx(h.voxel[0], h.voxel[1], h.voxel[2]) != 0);
+
+            // the hit point lies on the hit voxel, and the normal points back at the ray
+            auto lo = pos + h.voxel.cast<float>() * scale;
+            for (int a = 0; a < 3; a++)
+            {
+                assert(h.hit.point[a] >= lo[a] - 1e-3);
+                assert(h.hit.point[a] <= lo[a] + scale + 1e-3);
+            }
+
+            if (expected > 0) { assert(h.hit.normal.dot(rays[i].direction) < 0); }
+        }
+
+        // results are the same when cast across threads
+        g::proc::thread_pool<4> pool;
+        std::vector<cd::voxel_collider<>::voxel_hit> pooled;
+        collider.cast(rays, pooled, pool, std::numeric_limits<float>::infinity(), 64);
+
+        for (size_t i = 0; i < rays.size(); i++)
+        {
+            assert(bool(pooled[i].hit) == bool(hits[i].hit));
+            assert(!hits[i].hit || pooled[i].voxel == hits[i].voxel);
+        }
+    }
+
+    { // max_t limits the search
+        cd::ray r = { pos + vec<3>{ 10.25f, 30, 5.25f }, { 0, -1, 0 } };
+        auto h = collider.cast(r);
+        assert(!collider.cast(r, h.hit.time * 0.5f).hit);
+    }
+
+    { // bricks are refreshed after an edit
+        cd::ray r = { pos + vec<3>{ 0.25f, 15, 0.25f }, { 0, -1, 0 } };
+        for (size_t y = 1; y < vox.height; y++) { vox.set(0, y, 0, 0); }
+        collider.update({ 0, 0, 0 }, { 0, vox.height - 1, 0 });
+        auto floor_t = collider.cast(r).hit.time;
+
+        vox.set(0, 20, 0, 3);
+        collider.update({ 0, 20, 0 }, { 0, 20, 0 });
+        auto h = collider.cast(r);
+
+        assert(h.hit.time < floor_t);
+        assert((h.voxel == vec<3, size_t>{ 0, 20, 0 }));
+    }
+
+    return 0;
+}
@@ -14,5 +14,63 @@ TEST
 
     assert(vox1.hash() != vox2.hash());
 
+    // reference values for XXH64
+    assert(g::utils::hash64("", 0) == 0xef46db3751d8e999ull);
+    assert(g::utils::hash64("abc", 3) == 0x44bc2cf5ad770999ull);
+
+    { // byte sized voxels whose count isn't a multiple of the word size
+        uint8_t bytes[3 * 3 * 3] = {};
+        g::game::voxels<uint8_t> a(bytes, 3, 3, 3);
+        bytes[26] = 1;
+        g::game::voxels<uint8_t> b(bytes, 3, 3, 3);
+
+        assert(a.hash() != b.hash());
+
+        // same contents, different dimensions
+        g::game::voxels<uint8_t> c(bytes, 9, 3, 1);
+        assert(b.hash() != c.hash());
+    }
+
+    { // incremental updates should match hashing from scratch
+        g::game::voxels<uint8_t> big(40, 40, 40);
+        auto empty_hash = big.hash();
+
+        big.set(39, 39, 39, 5);
+        auto edited_hash = big.hash();
+        assert(edited_hash != empty_hash);
+
+        g::game::voxels<uint8_t> fresh(40, 40, 40);
+        fresh.idx(39, 39, 39) = 5;
+        assert(fresh.hash() == edited_hash);
+
+        // writes through any non-const accessor are noticed
+        big.idx(0, 0, 0) = 1;
+        assert(big.hash() != edited_hash);
+
+        big.set(0, 0, 0, 0);
+        assert(big.hash() == edited_hash);
+
+        big[vec<3, size_t>{ 20, 30, 10 }] = 9;
+        auto indexed_hash = big.hash();
+        assert(indexed_hash != edited_hash);
+
+        big.idx2(20, 30, 10) = 0;
+        assert(big.hash() == edited_hash);
+
+        big.each([](size_t x, size_t y, size_t z, uint8_t& v) { if (x == 20 && y == 30 && z == 10) { v = 9; } });
+        assert(big.hash() == indexed_hash);
+
+        // reading doesn't dirty anything
+        const auto& view = big;
+        assert(view.idx(20, 30, 10) == 9);
+        for (auto dirty : big.dirty_bricks) { assert(!dirty); }
+
+        // only direct writes to the storage need marking
+        big.v[big.layout.index(20, 30, 10)] = 0;
+        assert(big.hash() == indexed_hash);
+        big.mark_dirty(20, 30, 10);
+        assert(big.hash() == edited_hash);
+    }
+
 	return 0;
 }
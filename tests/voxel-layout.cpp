@@ -0,0 +1,58 @@
+#include ".test.h"
+#include "g.h"
+
+template<typename LAYOUT>
+void check_layout()
+{
+    // voxel data as it is stored in .vox files, x fastest
+    uint8_t raw[5 * 7 * 3];
+    for (unsigned i = 0; i < sizeof(raw); i++) { raw[i] = i; }
+
+    g::game::voxels<uint8_t, LAYOUT> vox(raw, 5, 7, 3);
+
+    // every coordinate should be visited once, in storage order
+    std::vector<bool> seen(vox.v.size());
+    size_t visited = 0, last = 0;
+    vox.layout.each([&](size_t x, size_t y, size_t z, size_t i) {
+        assert(vox.layout.index(x, y, z) == i);
+        size_t cx, cy, cz;
+        vox.layout.coord(i, cx, cy, cz);
+        assert(cx == x && cy == y && cz == z);
+        assert(!seen[i]);
+        assert(visited == 0 || i > last);
+        seen[i] = true;
+        last = i;
+        visited++;
+    });
+    assert(visited == sizeof(raw));
+
+    for (size_t z = 0; z < 3; z++)
+    for (size_t y = 0; y < 7; y++)
+    for (size_t x = 0; x < 5; x++)
+    {
+        assert(vox.idx(x, y, z) == x + 5 * y + 35 * z);
+        assert(vox.idx2(x, y, z) == vox.idx(x, y, z));
+    }
+
+    unsigned found = 0;
+    vox.find(17, [&](size_t x, size_t y, size_t z) {
+        assert(x == 2 && y == 3 && z == 0);
+        found++;
+    });
+    assert(found == 1);
+
+    assert(vox.center_of_mass(true).is_near({ 2.519231f, 3.528846f, 1.509615f }, 0.0001f));
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    check_layout<g::game::voxel_layout::x_major>();
+    check_layout<g::game::voxel_layout::z_major>();
+    check_layout<g::game::voxel_layout::morton>();
+
+	return 0;
+}
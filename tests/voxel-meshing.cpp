@@ -0,0 +1,146 @@
+#include ".test.h"
+#include "g.h"
+
+#include <map>
+
+using V = g::gfx::vertex::pos_norm;
+using face = std::array<int, 5>; /**< axis, sign, plane, u, v of a unit face */
+
+static V vertex(ogt_mesh_vertex* v)
+{
+    return { { v->pos.x, v->pos.y, v->pos.z }, { v->normal.x, v->normal.y, v->normal.z } };
+}
+
+/**
+ * Counts how many times each unit voxel face is covered by a triangle of the
+ * mesh. Each cell is sampled slightly off its center, so that it never lies
+ * on the diagonal shared by the two triangles of a quad.
+ */
+static std::map<face, int> coverage(const std::vector<V>& verts, const std::vector<uint32_t>& inds)
+{
+    std::map<face, int> faces;
+
+    for (size_t t = 0; t < inds.size(); t += 3)
+    {
+        const V* tri[3] = { &verts[inds[t]], &verts[inds[t + 1]], &verts[inds[t + 2]] };
+        auto& n = tri[0]->normal;
+        int axis = fabsf(n[0]) > 0.5f ? 0 : (fabsf(n[1]) > 0.5f ? 1 : 2);
+        int sign = n[axis] > 0 ? 1 : -1;
+        int ua = (axis + 1) % 3, va = (axis + 2) % 3;
+        int plane = (int)lroundf(tri[0]->position[axis]);
+
+        vec<2> p[3];
+        vec<2> lo = { 1e9f, 1e9f }, hi = { -1e9f, -1e9f };
+        for (int k = 0; k < 3; k++)
+        {
+            assert(fabsf(tri[k]->position[axis] - plane) < 1e-4f);
+            p[k] = { tri[k]->position[ua], tri[k]->position[va] };
+            lo = lo.take_min(p[k]);
+            hi = hi.take_max(p[k]);
+        }
+
+        for (int j = (int)floorf(lo[1]); j < (int)ceilf(hi[1]); j++)
+        for (int i = (int)floorf(lo[0]); i < (int)ceilf(hi[0]); i++)
+        {
+            vec<2> s = { i + 0.513f, j + 0.531f };
+            float side[3];
+            for (int k = 0; k < 3; k++)
+            {
+                auto e = p[(k + 1) % 3] - p[k], d = s - p[k];
+                side[k] = e[0] * d[1] - e[1] * d[0];
+            }
+
+            auto inside = (side[0] > 0 && side[1] > 0 && side[2] > 0) || (side[0] < 0 && side[1] < 0 && side[2] < 0);
+            if (inside) { faces[{ axis, sign, plane, i, j }]++; }
+        }
+    }
+
+    return faces;
+}
+
+static std::map<face, int> chunked(const g::game::voxels<uint8_t>& vox, size_t chunk_size, g::gfx::voxel_mesher mode, const ogt_mesh_rgba* palette)
+{
+    std::vector<V> verts;
+    std::vector<uint32_t> inds;
+    std::vector<uint8_t> padded;
+
+    for (size_t z = 0; z < vox.depth; z += chunk_size)
+    for (size_t y = 0; y < vox.height; y += chunk_size)
+    for (size_t x = 0; x < vox.width; x += chunk_size)
+    {
+        vec<3, size_t> origin = { x, y, z };
+        auto extent = (origin + chunk_size).take_min(vox.size) - origin;
+
+        // each chunk is meshed separately, as on a thread pool
+        std::vector<V> chunk_verts;
+        std::vector<uint32_t> chunk_inds;
+        g::gfx::mesh_factory::pad_chunk(vox, origin, extent, padded);
+        g::gfx::mesh_factory::mesh_chunk<V>(padded.data(), extent, origin.cast<float>(), palette, mode, vertex, chunk_verts, chunk_inds);
+
+        for (auto i : chunk_inds) { inds.push_back(i + verts.size()); }
+        verts.insert(verts.end(), chunk_verts.begin(), chunk_verts.end());
+    }
+
+    return coverage(verts, inds);
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    ogt_mesh_rgba palette[256] = {};
+    for (int i = 0; i < 256; i++) { palette[i] = { (uint8_t)i, 0, 0, 255 }; }
+
+    // blobs of a few colors, with sizes which don't divide into the chunks
+    g::game::voxels<uint8_t> vox(11, 9, 7);
+    g::utils::rng random(5);
+    for (size_t z = 0; z < vox.depth; z++)
+    for (size_t y = 0; y < vox.height; y++)
+    for (size_t x = 0; x < vox.width; x++)
+    {
+        if (random.uniform() < 0.6f) { vox.set(x, y, z, 1 + (x / 4 + z / 3) % 3); }
+    }
+
+    std::vector<V> verts;
+    std::vector<uint32_t> inds;
+    g::gfx::mesh_factory::mesh_voxels<V>(vox.v.data(), vox.size, palette, g::gfx::voxel_mesher::simple, vertex, nullptr, verts, inds);
+    auto naive = coverage(verts, inds);
+    auto naive_triangles = inds.size() / 3;
+
+    assert(naive.size() > 0);
+    for (auto& kvp : naive) { assert(kvp.second == 1); }
+
+    { // every exposed face, and only those, is covered exactly once
+        size_t exposed = 0;
+        vox.each([&](size_t x, size_t y, size_t z, const uint8_t& v) {
+            if (v == 0) { return; }
+            for (int a = 0; a < 3; a++)
+            for (int s = -1; s <= 1; s += 2)
+            {
+                long n[3] = { (long)x, (long)y, (long)z };
+                n[a] += s;
+                auto outside = n[a] < 0 || n[a] >= (long)vox.size[a];
+                if (outside || vox.idx(n[0], n[1], n[2]) == 0) { exposed++; }
+            }
+        });
+        assert(naive.size() == exposed);
+    }
+
+    // greedy meshing merges faces, but covers the same ones
+    verts.clear();
+    inds.clear();
+    g::gfx::mesh_factory::mesh_voxels<V>(vox.v.data(), vox.size, palette, g::gfx::voxel_mesher::greedy, vertex, nullptr, verts, inds);
+    assert(coverage(verts, inds) == naive);
+    assert(inds.size() / 3 < naive_triangles);
+
+    // chunk seams neither duplicate nor drop faces
+    for (size_t chunk_size : { 2, 4, 5, 16 })
+    {
+        assert(chunked(vox, chunk_size, g::gfx::voxel_mesher::simple, palette) == naive);
+        assert(chunked(vox, chunk_size, g::gfx::voxel_mesher::greedy, palette) == naive);
+    }
+
+    return 0;
+}
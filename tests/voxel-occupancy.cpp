@@ -0,0 +1,80 @@
+#include ".test.h"
+#include "g.h"
+
+template<typename LAYOUT>
+void check_occupancy()
+{
+    g::game::voxels<uint8_t, LAYOUT> tracked(70, 33, 45), untracked(70, 33, 45);
+
+    srand(1);
+    for (unsigned i = 0; i < 500; i++)
+    {
+        size_t x = rand() % 70, y = rand() % 33, z = rand() % 45;
+        uint8_t c = 1 + rand() % 4;
+        tracked.idx(x, y, z) = c;
+        untracked.idx(x, y, z) = c;
+    }
+
+    tracked.track_occupancy();
+
+    assert(tracked.count() == untracked.count());
+    assert(tracked.center_of_mass(true).is_near(untracked.center_of_mass(true), 0.0001f));
+
+    std::vector<vec<3, size_t>> found_tracked, found_untracked;
+    tracked.find(3, [&](size_t x, size_t y, size_t z) { found_tracked.push_back({ x, y, z }); });
+    untracked.find(3, [&](size_t x, size_t y, size_t z) { found_untracked.push_back({ x, y, z }); });
+    assert(found_tracked.size() > 0);
+    assert(found_tracked.size() == found_untracked.size());
+    for (unsigned i = 0; i < found_tracked.size(); i++)
+    {
+        assert(found_tracked[i] == found_untracked[i]);
+    }
+
+    // set keeps the mask current
+    auto count = tracked.count();
+    tracked.set(69, 32, 44, 0);
+    tracked.set(69, 32, 44, 9);
+    assert(tracked.count() == count + 1);
+    tracked.set(69, 32, 44, 0);
+    assert(tracked.count() == count);
+
+    unsigned nines = 0;
+    tracked.set(0, 0, 0, 9);
+    tracked.find(9, [&](size_t x, size_t y, size_t z) {
+        assert(x == 0 && y == 0 && z == 0);
+        nines++;
+    });
+    assert(nines == 1);
+
+    // writes through every other accessor are picked up before the mask is used
+    tracked.idx(1, 1, 1) = 9;
+    untracked.idx(1, 1, 1) = 9;
+    tracked[vec<3, size_t>{ 2, 2, 2 }] = 9;
+    untracked[vec<3, size_t>{ 2, 2, 2 }] = 9;
+    tracked.set(0, 0, 0, 0);
+    untracked.set(0, 0, 0, 0);
+    assert(std::as_const(tracked).count() == untracked.count());
+    assert(tracked.count() == untracked.count());
+
+    nines = 0;
+    tracked.find(9, [&](size_t, size_t, size_t) { nines++; });
+    assert(nines == 2);
+
+    tracked.each([](size_t x, size_t, size_t, uint8_t& v) { if (x == 3) { v = 0; } });
+    untracked.each([](size_t x, size_t, size_t, uint8_t& v) { if (x == 3) { v = 0; } });
+    assert(tracked.count() == untracked.count());
+    assert(tracked.center_of_mass(true).is_near(untracked.center_of_mass(true), 0.0001f));
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+    check_occupancy<g::game::voxel_layout::z_major>();
+    check_occupancy<g::game::voxel_layout::x_major>();
+    check_occupancy<g::game::voxel_layout::morton>();
+
+	return 0;
+}
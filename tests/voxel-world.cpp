@@ -0,0 +1,116 @@
+#include ".test.h"
+#include "g.h"
+
+using V = g::gfx::vertex::pos_norm_color;
+using world = g::gfx::voxel_world<V, 2>;
+
+static V vertex(ogt_mesh_vertex* v)
+{
+	return { { v->pos.x, v->pos.y, v->pos.z }, { v->normal.x, v->normal.y, v->normal.z }, {} };
+}
+
+static bool is_dirty(world& w, const vec<3, size_t>& ci)
+{
+	auto& c = w.chunks[w.chunk_index(ci)];
+	return c.queued && c.is_dirty();
+}
+
+// marks every chunk as meshed without touching the gpu
+static void clean(world& w)
+{
+	for (auto ci : w.dirty)
+	{
+		w.chunks[ci].queued = false;
+		w.chunks[ci].meshed_version = w.chunks[ci].version;
+	}
+
+	w.dirty.clear();
+}
+
+/**
+ * A test is nothing more than a stripped down C program
+ * returning 0 is success. Use asserts to check for errors
+ */
+TEST
+{
+	ogt_vox_palette palette = {};
+	world w(vec<3, size_t>{40, 16, 16}, palette, vertex, g::gfx::voxel_mesher::greedy, 8);
+
+	assert((w.chunk_dims == vec<3, size_t>{5, 2, 2}));
+	assert(w.dirty.size() == w.chunks.size());
+	assert((w.chunks.back().extent == vec<3, size_t>{8, 8, 8}));
+
+	clean(w);
+
+	{ // a write inside a chunk dirties only that chunk
+		w.set(12, 4, 4, 1);
+		assert(w.dirty.size() == 1);
+		assert(is_dirty(w, {1, 0, 0}));
+		assert(w.get(12, 4, 4) == 1);
+		clean(w);
+	}
+
+	{ // writing the same value again changes nothing
+		w.set(12, 4, 4, 1);
+		assert(w.dirty.size() == 0);
+	}
+
+	{ // a write on a chunk border dirties the neighbor sharing it
+		w.set(15, 4, 4, 2);
+		assert(w.dirty.size() == 2);
+		assert(is_dirty(w, {1, 0, 0}));
+		assert(is_dirty(w, {2, 0, 0}));
+		clean(w);
+
+		// only faces are culled across borders, so diagonal neighbors are untouched
+		w.set(16, 7, 4, 2);
+		assert(w.dirty.size() == 3);
+		assert(is_dirty(w, {1, 0, 0}));
+		assert(is_dirty(w, {2, 0, 0}));
+		assert(is_dirty(w, {2, 1, 0}));
+		assert(!is_dirty(w, {1, 1, 0}));
+		clean(w);
+	}
+
+	{ // repeated writes queue a chunk once
+		for (size_t x = 9; x < 15; x++) { w.set(x, 3, 3, 3); }
+		assert(w.dirty.size() == 1);
+		clean(w);
+	}
+
+	{ // fills dirty every chunk they or their apron touch
+		w.fill({0, 0, 0}, {7, 7, 7}, 4);
+		assert(w.dirty.size() == 4);
+		assert(is_dirty(w, {0, 0, 0}));
+		assert(is_dirty(w, {1, 0, 0}));
+		assert(is_dirty(w, {0, 1, 0}));
+		assert(is_dirty(w, {0, 0, 1}));
+		clean(w);
+	}
+
+	{ // chunks mesh their snapshot, edits made after it leave the chunk dirty
+		auto& c = w.chunks[w.chunk_index({0, 0, 0})];
+		w.set(2, 2, 2, 0);
+		g::gfx::mesh_factory::pad_chunk(w.volume, c.origin, c.extent, c.padded);
+		c.meshing_version = c.version;
+		w.set(3, 3, 3, 0);
+
+		w.mesh_chunk(c);
+		assert(c.vertices.size() > 0);
+		assert(c.indices.size() % 3 == 0);
+
+		c.meshed_version = c.meshing_version;
+		assert(c.is_dirty());
+
+		for (auto& v : c.vertices)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				assert(v.position[a] >= c.origin[a]);
+				assert(v.position[a] <= c.origin[a] + c.extent[a]);
+			}
+		}
+	}
+
+	return 0;
+}